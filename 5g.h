@@ -2,6 +2,7 @@
 #define _5G_H_
 
 #include <string>
+#include <mutex>
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
@@ -9,6 +10,12 @@
 #include <stdio.h>
 
 #include "LDPC.h"  //  Важно: этот include должен быть здесь
+#include "5g_at.h"
+#include "5g_parse.h"
+#include "5g_cache.h"
+#include "5g_data.h"
+#include "5g_cmux.h"
+#include "telemetry.h"
 
 typedef struct {
     int fd;
@@ -17,23 +24,162 @@ typedef struct {
     std::string imei;
     std::string imsi;
     int rssi;
+    fiveg_at_engine_t* at;  // движок AT-команд, NULL - прямой обмен через fd
+    fiveg_state_cache_t* cache;  // кэш состояния модема, NULL - каждый запрос идёт в модем
+    fiveg_data_stream_t* data;  // поток данных, NULL - линия в режиме команд
+    fiveg_cmux_t* cmux;  // мультиплексор CMUX, NULL - fd без каналов
+    telemetry_t* telemetry;  // сегмент телеметрии (время ответа AT, RSSI/BER), NULL - без неё
+    std::string at_rx;  // байты, прочитанные прямым обменом после финальной строки
+    std::mutex at_lock;  // прямой обмен: на линии одна команда за раз (fd и at_rx)
 } fiveg_connection_t;
 
 #define FIVEG_SUCCESS 0
 #define FIVEG_ERROR_GENERAL -1
 #define FIVEG_ERROR_NO_SIGNAL -2
 #define FIVEG_ERROR_NOT_CONNECTED -3
+#define FIVEG_ERROR_TIMEOUT -4
 
-// Функция для отправки AT-команды модему
-int send_at_command(fiveg_connection_t* connection, const char* command, char* response, int response_size);
+// Обмен одной командой, без учёта в телеметрии (см. send_at_command)
+int fiveg_at_exchange(fiveg_connection_t* connection, const char* command, char* response, int response_size) {
+    if (response_size > 0) {
+        response[0] = '\0';
+    }
+
+    fiveg_at_result_t result;
+    if (connection->at) {
+        result = fiveg_at_send(connection->at, command).get();
+    } else {
+        // Без движка: запись команды и чтение блоками до финальной
+        // строки, строки с чужим префиксом (URC) и эхо отбрасываются.
+        // Что пришло после финальной строки, остаётся в at_rx до
+        // следующей команды (или уходит движку и потоку данных). Кэш
+        // обновляет разные поля из разных потоков, поэтому обмен идёт
+        // под at_lock
+        std::lock_guard<std::mutex> guard(connection->at_lock);
+        std::string prefix = fiveg_at_command_prefix(command);
+        size_t echo_len = strlen(command);
+        if (echo_len > 0 && command[echo_len - 1] == '\r') {
+            echo_len--;
+        }
+        long long deadline = fiveg_at_now_ms() + fiveg_at_default_timeout(command);
+        std::string& rx = connection->at_rx;
+        size_t pos = 0;  // начало неразобранных байтов в rx
+
+        result.status = FIVEG_ERROR_TIMEOUT;
+        if (fiveg_at_write_all(connection->fd, command, strlen(command)) < 0) {
+            return FIVEG_ERROR_GENERAL;
+        }
+        while (result.status == FIVEG_ERROR_TIMEOUT) {
+            size_t eol = rx.find_first_of("\r\n", pos);
+            if (eol == std::string::npos) {
+                rx.erase(0, pos);
+                pos = 0;
+                if (rx.size() >= FIVEG_AT_LINE_MAX) {
+                    rx.resize(FIVEG_AT_LINE_MAX - 1);  // слишком длинная строка обрезается
+                }
+                long long left = deadline - fiveg_at_now_ms();
+                struct pollfd pfd = {connection->fd, POLLIN, 0};
+                if (left <= 0 || poll(&pfd, 1, (int)left) <= 0) {
+                    break;
+                }
+                char buf[FIVEG_AT_READ_SIZE];
+                ssize_t len = read(connection->fd, buf, sizeof(buf));
+                if (len <= 0) {
+                    if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+                        continue;
+                    }
+                    rx.clear();
+                    return FIVEG_ERROR_NOT_CONNECTED;
+                }
+                rx.append(buf, len);
+                continue;
+            }
+
+            char* line = &rx[pos];
+            size_t line_len = eol - pos;
+            pos = eol + 1;
+            if (rx[eol] == '\r' && pos < rx.size() && rx[pos] == '\n') {
+                pos++;  // \n из пары \r\n, чтобы после CONNECT в at_rx остались только данные
+            }
+            if (line_len == 0) {
+                continue;
+            }
+            if (line_len >= FIVEG_AT_LINE_MAX) {
+                line_len = FIVEG_AT_LINE_MAX - 1;
+            }
+            line[line_len] = '\0';
+
+            int cme_error;
+            int status = fiveg_at_final_status(line, &cme_error);
+            if (status != 1) {
+                result.status = status;
+            } else if ((line_len == echo_len && memcmp(command, line, echo_len) == 0) ||
+                       (line[0] == '+' && (prefix.empty() || strncmp(line, prefix.c_str(), prefix.size()) != 0))) {
+                continue;
+            } else {
+                if (!result.response.empty()) {
+                    result.response += '\n';
+                }
+                result.response += line;
+                if (fiveg_at_single_line(command)) {
+                    result.status = FIVEG_SUCCESS;
+                }
+            }
+        }
+        rx.erase(0, pos);
+    }
+
+    if (response_size > 0) {
+        snprintf(response, response_size, "%s", result.response.c_str());
+    }
+    return result.status;
+}
+
+// Функция для отправки AT-команды модему. В response попадают
+// информационные строки ответа (без эха и финального OK) через '\n'.
+// Если запущен движок (fiveg_start_at_engine), команда встаёт в его
+// очередь и вызов ждёт только своего ответа; URC при этом уходят
+// подписчикам, а не в response. С подключённой телеметрией время
+// ответа и итог команды записываются в её сегмент.
+int send_at_command(fiveg_connection_t* connection, const char* command, char* response, int response_size) {
+    if (!connection->telemetry) {
+        return fiveg_at_exchange(connection, command, response, response_size);
+    }
+    int64_t start = telemetry_now_ns();
+    int result = fiveg_at_exchange(connection, command, response, response_size);
+    telemetry_request(&connection->telemetry->data->at, (telemetry_now_ns() - start) / 1000, result,
+                      result == FIVEG_ERROR_TIMEOUT);
+    return result;
+}
+
+// Запуск движка AT-команд на connection->fd: после этого все
+// *_impl функции идут через его очередь, а приложение может отправлять
+// команды асинхронно (fiveg_send_at_async)
+int fiveg_start_at_engine_impl(fiveg_connection_t* connection) {
+    if (connection->at) {
+        return FIVEG_SUCCESS;
+    }
+    std::lock_guard<std::mutex> guard(connection->at_lock);
+    connection->at = fiveg_at_engine_create(connection->fd, connection->at_rx.data(), connection->at_rx.size());
+    connection->at_rx.clear();
+    if (connection->at && connection->cmux) {
+        fiveg_at_engine_watch_urc(connection->at, fiveg_cmux_channel_fd(connection->cmux, FIVEG_CMUX_DLCI_URC));
+    }
+    return connection->at ? FIVEG_SUCCESS : FIVEG_ERROR_GENERAL;
+}
+
+void fiveg_stop_at_engine_impl(fiveg_connection_t* connection) {
+    fiveg_at_engine_destroy(connection->at);
+    connection->at = NULL;
+}
 
 // --- Реализация функций ---
 
-// ... (Реализация функций fiveg_get_signal_strength_impl, fiveg_get_network_operator_impl, 
-// fiveg_get_ip_address_impl, fiveg_get_imei_impl, fiveg_get_imsi_impl, fiveg_connect_impl, fiveg_send_data_impl) ...
+// ... (Реализация функции fiveg_connect_impl) ...
 
-// Проверка состояния модема
-int fiveg_check_modem_status_impl(fiveg_connection_t* connection) {
+// Проверка состояния модема. Если csq не передан, значения выводятся
+// на экран, как раньше; иначе результат только записывается в csq.
+int fiveg_check_modem_status_impl(fiveg_connection_t* connection, fiveg_csq_t* csq = nullptr) {
     char command[] = "AT+CSQ\r";
     char response[256];
     int result = send_at_command(connection, command, response, sizeof(response));
@@ -41,21 +187,30 @@ int fiveg_check_modem_status_impl(fiveg_connection_t* connection) {
         return result;
     }
 
-    // Парсинг ответа (пример, проверьте формат ответа в документации)
-    int rssi, ber;
-    if (sscanf(response, "+CSQ: %d,%d", &rssi, &ber) == 2) {
-        printf("Сила сигнала (RSSI): %d, BER: %d\n", rssi, ber);
-        return FIVEG_SUCCESS;
-    } else {
+    fiveg_csq_t parsed;
+    if (fiveg_parse_csq(response, &parsed) < 0) {
         return FIVEG_ERROR_GENERAL;
     }
+    if (connection->telemetry) {
+        telemetry_set_signal(connection->telemetry, parsed.rssi, parsed.ber);
+    }
+    if (csq) {
+        *csq = parsed;
+    } else {
+        printf("Сила сигнала (RSSI): %d, BER: %d\n", parsed.rssi, parsed.ber);
+    }
+    return FIVEG_SUCCESS;
 }
 
 // Получение информации о сети
-int fiveg_get_network_info_impl(fiveg_connection_t* connection) {
+int fiveg_get_network_info_impl(fiveg_connection_t* connection, fiveg_cops_t* cops = nullptr) {
     char command[] = "AT+COPS?\r";
     char response[256];
-    return send_at_command(connection, command, response, sizeof(response));
+    int result = send_at_command(connection, command, response, sizeof(response));
+    if (result == FIVEG_SUCCESS && cops && fiveg_parse_cops(response, cops) < 0) {
+        return FIVEG_ERROR_GENERAL;
+    }
+    return result;
 }
 
 // Настройка APN
@@ -74,10 +229,14 @@ int fiveg_start_connection_impl(fiveg_connection_t* connection) {
 }
 
 // Получение IP-адреса (через AT+CIFSR)
-int fiveg_get_ip_address_cifsr_impl(fiveg_connection_t* connection) {
+int fiveg_get_ip_address_cifsr_impl(fiveg_connection_t* connection, fiveg_cifsr_t* address = nullptr) {
     char command[] = "AT+CIFSR\r";
     char response[256];
-    return send_at_command(connection, command, response, sizeof(response));
+    int result = send_at_command(connection, command, response, sizeof(response));
+    if (result == FIVEG_SUCCESS && address && fiveg_parse_cifsr(response, address) < 0) {
+        return FIVEG_ERROR_NOT_CONNECTED;
+    }
+    return result;
 }
 
 // Отключение от сети (через AT+CGATT=0)
@@ -88,10 +247,29 @@ int fiveg_deactivate_network_impl(fiveg_connection_t* connection) {
 }
 
 // Проверка статуса подключения
-int fiveg_check_connection_status_impl(fiveg_connection_t* connection) {
+int fiveg_check_connection_status_impl(fiveg_connection_t* connection, fiveg_cgact_t* contexts = nullptr) {
     char command[] = "AT+CGACT?\r";
     char response[256];
-    return send_at_command(connection, command, response, sizeof(response));
+    int result = send_at_command(connection, command, response, sizeof(response));
+    if (result == FIVEG_SUCCESS && contexts && fiveg_parse_cgact(response, contexts) < 0) {
+        return FIVEG_ERROR_GENERAL;
+    }
+    return result;
+}
+
+// Состояние регистрации: сначала в 5G (AT+C5GREG?), для модемов без
+// 5G - в LTE (AT+CEREG?)
+int fiveg_get_registration_impl(fiveg_connection_t* connection, fiveg_reg_t* reg) {
+    char response[256];
+    int result = send_at_command(connection, "AT+C5GREG?\r", response, sizeof(response));
+    if (result == FIVEG_SUCCESS) {
+        return fiveg_parse_reg(response, "+C5GREG", reg) < 0 ? FIVEG_ERROR_GENERAL : FIVEG_SUCCESS;
+    }
+    result = send_at_command(connection, "AT+CEREG?\r", response, sizeof(response));
+    if (result == FIVEG_SUCCESS && fiveg_parse_reg(response, "+CEREG", reg) < 0) {
+        return FIVEG_ERROR_GENERAL;
+    }
+    return result;
 }
 
 // Перезагрузка модема
@@ -101,6 +279,244 @@ int fiveg_restart_modem_impl(fiveg_connection_t* connection) {
     return send_at_command(connection, command, response, sizeof(response));
 }
 
+// --- Кэш состояния модема ---
+
+// Запрос одного поля кэша у модема; результат пишется в поле state
+int fiveg_query_state_field(fiveg_connection_t* connection, int field, fiveg_state_t* state) {
+    char response[256];
+    int result;
+
+    switch (field) {
+    case FIVEG_CACHE_SIGNAL:
+        return fiveg_check_modem_status_impl(connection, &state->csq);
+    case FIVEG_CACHE_OPERATOR:
+        return fiveg_get_network_info_impl(connection, &state->cops);
+    case FIVEG_CACHE_ADDRESS:
+        return fiveg_get_ip_address_cifsr_impl(connection, &state->address);
+    case FIVEG_CACHE_REGISTRATION:
+        return fiveg_get_registration_impl(connection, &state->reg);
+    case FIVEG_CACHE_IMEI:
+    case FIVEG_CACHE_IMSI:
+        result = send_at_command(connection, field == FIVEG_CACHE_IMEI ? "AT+CGSN\r" : "AT+CIMI\r",
+                                 response, sizeof(response));
+        if (result == FIVEG_SUCCESS &&
+            fiveg_parse_id(response, field == FIVEG_CACHE_IMEI ? &state->imei : &state->imsi) < 0) {
+            return FIVEG_ERROR_GENERAL;
+        }
+        return result;
+    default:
+        return FIVEG_ERROR_GENERAL;
+    }
+}
+
+// Снимок состояния, в котором поле field свежее. Устаревшее поле
+// запрашивается у модема одним потоком; остальные потоки, которым нужно
+// то же поле, ждут этот запрос и берут его результат из кэша.
+int fiveg_cached_state(fiveg_connection_t* connection, int field, fiveg_state_t* state) {
+    fiveg_state_cache_t* cache = connection->cache;
+    if (!cache) {
+        return fiveg_query_state_field(connection, field, state);
+    }
+
+    fiveg_cache_read(cache, state);
+    if (fiveg_cache_fresh(cache, state, field)) {
+        return FIVEG_SUCCESS;
+    }
+
+    std::lock_guard<std::mutex> guard(cache->refresh_lock[field]);
+    fiveg_cache_read(cache, state);
+    if (fiveg_cache_fresh(cache, state, field)) {
+        return FIVEG_SUCCESS;
+    }
+    int result = fiveg_query_state_field(connection, field, state);
+    if (result == FIVEG_SUCCESS) {
+        fiveg_cache_store(cache, field, (const char*)state + fiveg_cache_layout[field].offset);
+    }
+    return result;
+}
+
+// Уровень сигнала в дБм (-113..-51), по +CSQ
+int fiveg_get_signal_strength_impl(fiveg_connection_t* connection, int* signal_strength) {
+    fiveg_state_t state;
+    int result = fiveg_cached_state(connection, FIVEG_CACHE_SIGNAL, &state);
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+    if (state.csq.rssi < 0 || state.csq.rssi > 31) {
+        return FIVEG_ERROR_NO_SIGNAL;
+    }
+    *signal_strength = -113 + 2 * state.csq.rssi;
+    return FIVEG_SUCCESS;
+}
+
+int fiveg_get_network_operator_impl(fiveg_connection_t* connection, char* operator_name, int buffer_size) {
+    fiveg_state_t state;
+    int result = fiveg_cached_state(connection, FIVEG_CACHE_OPERATOR, &state);
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+    if (state.cops.oper[0] == '\0') {
+        return FIVEG_ERROR_NOT_CONNECTED;
+    }
+    snprintf(operator_name, buffer_size, "%s", state.cops.oper);
+    return FIVEG_SUCCESS;
+}
+
+int fiveg_get_ip_address_impl(fiveg_connection_t* connection, char* ip_address, int buffer_size) {
+    fiveg_state_t state;
+    int result = fiveg_cached_state(connection, FIVEG_CACHE_ADDRESS, &state);
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+    snprintf(ip_address, buffer_size, "%s", state.address.address);
+    return FIVEG_SUCCESS;
+}
+
+// IMEI и IMSI берутся из кэша (с ним - один запрос к модему). Поля
+// connection->imei и connection->imsi не заполняются: их запись из
+// нескольких потоков была бы гонкой
+int fiveg_get_imei_impl(fiveg_connection_t* connection, char* imei, int buffer_size) {
+    fiveg_state_t state;
+    int result = fiveg_cached_state(connection, FIVEG_CACHE_IMEI, &state);
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+    snprintf(imei, buffer_size, "%s", state.imei.digits);
+    return FIVEG_SUCCESS;
+}
+
+int fiveg_get_imsi_impl(fiveg_connection_t* connection, char* imsi, int buffer_size) {
+    fiveg_state_t state;
+    int result = fiveg_cached_state(connection, FIVEG_CACHE_IMSI, &state);
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+    snprintf(imsi, buffer_size, "%s", state.imsi.digits);
+    return FIVEG_SUCCESS;
+}
+
+// Включение кэша. Если движок AT уже запущен, кэш обновляется по URC;
+// останавливать кэш нужно до остановки движка.
+int fiveg_start_state_cache_impl(fiveg_connection_t* connection) {
+    if (!connection->cache) {
+        connection->cache = fiveg_cache_create();
+        if (connection->at) {
+            fiveg_cache_attach(connection->cache, connection->at);
+        }
+    }
+    return FIVEG_SUCCESS;
+}
+
+void fiveg_stop_state_cache_impl(fiveg_connection_t* connection) {
+    fiveg_cache_destroy(connection->cache);
+    connection->cache = NULL;
+}
+
+// --- Передача данных ---
+
+// Перевод линии в режим данных (после CONNECT или перехода модема в
+// прозрачный режим): raw termios с контролем потока flow. Движок AT
+// должен быть остановлен - дальше по fd идут сырые байты. Под CMUX
+// данные идут по своему каналу, движок AT при этом продолжает работать,
+// а контроль потока ведёт мультиплексор.
+int fiveg_start_data_mode_impl(fiveg_connection_t* connection, int flow = FIVEG_FLOW_RTSCTS) {
+    if (connection->data) {
+        return FIVEG_SUCCESS;
+    }
+    if (connection->cmux) {
+        connection->data = fiveg_data_open(fiveg_cmux_channel_fd(connection->cmux, FIVEG_CMUX_DLCI_DATA), FIVEG_FLOW_NONE);
+        return connection->data ? FIVEG_SUCCESS : FIVEG_ERROR_GENERAL;
+    }
+    if (connection->at) {
+        return FIVEG_ERROR_GENERAL;
+    }
+    connection->data = fiveg_data_open(connection->fd, flow);
+    if (connection->data) {
+        fiveg_data_put(connection->data, connection->at_rx.data(), connection->at_rx.size());
+        connection->at_rx.clear();
+    }
+    return connection->data ? FIVEG_SUCCESS : FIVEG_ERROR_GENERAL;
+}
+
+// Возврат в режим команд: очередь дописывается, настройки линии
+// восстанавливаются
+int fiveg_stop_data_mode_impl(fiveg_connection_t* connection) {
+    if (!connection->data) {
+        return FIVEG_SUCCESS;
+    }
+    int result = fiveg_data_flush(connection->data);
+    fiveg_data_close(connection->data);
+    connection->data = NULL;
+    return result;
+}
+
+// Отправка данных; при первом вызове линия переводится в режим данных
+// с аппаратным контролем потока
+int fiveg_send_data_impl(fiveg_connection_t* connection, const void* data, size_t data_length) {
+    int result = fiveg_start_data_mode_impl(connection);
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+    return fiveg_data_send(connection->data, data, data_length);
+}
+
+// Приём до buffer_size байт; возвращает их число, 0 при таймауте или
+// код ошибки
+int fiveg_receive_data_impl(fiveg_connection_t* connection, void* buffer, size_t buffer_size, int timeout_ms) {
+    if (!connection->data) {
+        return FIVEG_ERROR_NOT_CONNECTED;
+    }
+    return fiveg_data_read(connection->data, buffer, buffer_size, timeout_ms);
+}
+
+// --- Мультиплексор CMUX ---
+
+// Перевод модема в CMUX (AT+CMUX) и запуск мультиплексора. После этого
+// connection->fd - канал AT-команд: *_impl функции и движок AT работают
+// по нему, URC движок читает из своего канала, а данные
+// (fiveg_start_data_mode) идут по третьему каналу одновременно с
+// командами. Движок AT и режим данных должны быть остановлены.
+int fiveg_start_cmux_impl(fiveg_connection_t* connection, int mode = FIVEG_CMUX_BASIC) {
+    if (connection->cmux) {
+        return FIVEG_SUCCESS;
+    }
+    if (connection->at || connection->data) {
+        return FIVEG_ERROR_GENERAL;
+    }
+    char command[64];
+    char response[256];
+    snprintf(command, sizeof(command), "AT+CMUX=%d,0,5,%d\r", mode, FIVEG_CMUX_N1);
+    int result = send_at_command(connection, command, response, sizeof(response));
+    if (result != FIVEG_SUCCESS) {
+        return result;
+    }
+
+    fiveg_cmux_t* cmux = fiveg_cmux_create(connection->fd, mode);
+    if (!cmux) {
+        return FIVEG_ERROR_NOT_CONNECTED;
+    }
+    connection->cmux = cmux;
+    connection->fd = fiveg_cmux_channel_fd(cmux, FIVEG_CMUX_DLCI_AT);
+    connection->at_rx.clear();
+    return FIVEG_SUCCESS;
+}
+
+// Выход из CMUX: каналы закрываются, модем возвращается в режим команд
+// на линии. Движок AT и режим данных должны быть остановлены.
+int fiveg_stop_cmux_impl(fiveg_connection_t* connection) {
+    if (!connection->cmux) {
+        return FIVEG_SUCCESS;
+    }
+    if (connection->at || connection->data) {
+        return FIVEG_ERROR_GENERAL;
+    }
+    connection->fd = connection->cmux->fd;
+    connection->at_rx.clear();
+    fiveg_cmux_destroy(connection->cmux);
+    connection->cmux = NULL;
+    return FIVEG_SUCCESS;
+}
+
 // --- Макросы для вызова функций ---
 
 #define fiveg_get_signal_strength(connection, signal_strength) fiveg_get_signal_strength_impl(connection, signal_strength)
@@ -113,13 +529,53 @@ int fiveg_restart_modem_impl(fiveg_connection_t* connection) {
 
 // --- Новые макросы для добавленных функций ---
 
-#define fiveg_check_modem_status(connection) fiveg_check_modem_status_impl(connection)
-#define fiveg_get_network_info(connection) fiveg_get_network_info_impl(connection)
+// Необязательный последний аргумент - структура для разобранного ответа
+#define fiveg_check_modem_status(...) fiveg_check_modem_status_impl(__VA_ARGS__)
+#define fiveg_get_network_info(...) fiveg_get_network_info_impl(__VA_ARGS__)
 #define fiveg_set_apn(connection, apn, username, password) fiveg_set_apn_impl(connection, apn, username, password)
 #define fiveg_start_connection(connection) fiveg_start_connection_impl(connection)
-#define fiveg_get_ip_address_cifsr(connection) fiveg_get_ip_address_cifsr_impl(connection)
+#define fiveg_get_ip_address_cifsr(...) fiveg_get_ip_address_cifsr_impl(__VA_ARGS__)
 #define fiveg_deactivate_network(connection) fiveg_deactivate_network_impl(connection)
-#define fiveg_check_connection_status(connection) fiveg_check_connection_status_impl(connection)
+#define fiveg_check_connection_status(...) fiveg_check_connection_status_impl(__VA_ARGS__)
+#define fiveg_get_registration(connection, reg) fiveg_get_registration_impl(connection, reg)
 #define fiveg_restart_modem(connection) fiveg_restart_modem_impl(connection)
 
+// --- Движок AT-команд ---
+
+#define fiveg_start_at_engine(connection) fiveg_start_at_engine_impl(connection)
+#define fiveg_stop_at_engine(connection) fiveg_stop_at_engine_impl(connection)
+#define fiveg_send_at_async(connection, command, callback, user) fiveg_at_send_async((connection)->at, command, callback, user)
+#define fiveg_send_at_future(connection, command) fiveg_at_send((connection)->at, command)
+#define fiveg_subscribe_urc(connection, prefix, callback, user) fiveg_at_subscribe((connection)->at, prefix, callback, user)
+
+// --- Кэш состояния модема ---
+
+#define fiveg_start_state_cache(connection) fiveg_start_state_cache_impl(connection)
+#define fiveg_stop_state_cache(connection) fiveg_stop_state_cache_impl(connection)
+#define fiveg_get_state_snapshot(connection, state) fiveg_cache_read((connection)->cache, state)
+#define fiveg_set_state_ttl(connection, field, ttl_ms) fiveg_cache_set_ttl((connection)->cache, field, ttl_ms)
+
+// --- Передача данных ---
+
+// Необязательный аргумент - контроль потока (FIVEG_FLOW_*)
+#define fiveg_start_data_mode(...) fiveg_start_data_mode_impl(__VA_ARGS__)
+#define fiveg_stop_data_mode(connection) fiveg_stop_data_mode_impl(connection)
+#define fiveg_queue_data(connection, data, data_length) fiveg_data_queue((connection)->data, data, data_length)
+#define fiveg_flush_data(connection) fiveg_data_flush((connection)->data)
+#define fiveg_receive_data(connection, buffer, buffer_size, timeout_ms) fiveg_receive_data_impl(connection, buffer, buffer_size, timeout_ms)
+#define fiveg_print_data_stats(connection, out) fiveg_data_print_stats((connection)->data, out)
+
+// --- Мультиплексор CMUX ---
+
+// Необязательный аргумент - режим кадров (FIVEG_CMUX_BASIC или FIVEG_CMUX_ADVANCED)
+#define fiveg_start_cmux(...) fiveg_start_cmux_impl(__VA_ARGS__)
+#define fiveg_stop_cmux(connection) fiveg_stop_cmux_impl(connection)
+#define fiveg_print_cmux_stats(connection, out) fiveg_cmux_print_stats((connection)->cmux, out)
+
+// --- Телеметрия ---
+
+// Сегмент открывается вызывающим (telemetry_attach) и закрывается после
+// отключения: fiveg_attach_telemetry(connection, NULL)
+#define fiveg_attach_telemetry(connection, segment) ((connection)->telemetry = (segment))
+
 #endif // _5G_H_
\ No newline at end of file
@@ -0,0 +1,534 @@
+#ifndef _5G_AT_H_
+#define _5G_AT_H_
+
+// Асинхронный движок AT-команд. Движок владеет дескриптором модема:
+// все записи и чтения выполняет один поток, который ждёт в epoll данных
+// от модема, новых команд и таймаутов. Команды ставятся в очередь, и
+// следующая команда уходит в модем сразу после финального ответа на
+// предыдущую, без возврата управления приложению. Финальные ответы
+// (OK, ERROR, +CME ERROR и т.д.) сопоставляются с командой в полёте,
+// а незапрошенные сообщения (URC) передаются подписчикам.
+//
+// Результат команды доступен через std::future или через callback.
+// Callback'и вызываются в потоке движка и не должны блокироваться.
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define FIVEG_AT_TIMEOUT_MS 5000
+// Регистрация в сети и активация контекста могут занимать до 85 секунд
+#define FIVEG_AT_LONG_TIMEOUT_MS 90000
+#define FIVEG_AT_LINE_MAX 1024
+#define FIVEG_AT_READ_SIZE 4096
+
+// Коды совпадают с FIVEG_* из 5g.h
+#define FIVEG_AT_OK 0
+#define FIVEG_AT_ERROR -1
+#define FIVEG_AT_DISCONNECTED -3
+#define FIVEG_AT_TIMEOUT -4
+
+typedef struct {
+    int status;              // FIVEG_AT_OK или код ошибки
+    int cme_error;           // номер из +CME ERROR / +CMS ERROR, иначе -1
+    std::string final_line;  // финальная строка ответа ("OK", "ERROR", ...)
+    std::string response;    // информационные строки ответа через '\n'
+} fiveg_at_result_t;
+
+typedef void (*fiveg_at_callback_t)(const fiveg_at_result_t* result, void* user);
+typedef void (*fiveg_urc_callback_t)(const char* line, void* user);
+
+struct fiveg_at_request {
+    std::string command;     // команда с завершающим '\r'
+    std::string prefix;      // префикс строк ответа, например "+CSQ"
+    int timeout_ms;
+    bool single_line;        // ответ без финальной строки
+    fiveg_at_callback_t callback;
+    void* user;
+    bool has_promise;
+    std::promise<fiveg_at_result_t> promise;
+    fiveg_at_result_t result;
+};
+
+struct fiveg_urc_subscriber {
+    std::string prefix;      // пустой префикс - все URC
+    fiveg_urc_callback_t callback;
+    void* user;
+};
+
+typedef struct fiveg_at_engine {
+    int fd;
+    int wake_fd;
+    int epoll_fd;
+    std::thread reader;
+    std::atomic<bool> stopping;
+    bool disconnected;
+
+    std::mutex lock;                                // защищает queue и urcs
+    std::mutex dispatch_lock;                       // удерживается на время вызова подписчиков URC
+    std::deque<struct fiveg_at_request*> queue;
+    std::vector<struct fiveg_urc_subscriber> urcs;
+
+    // Состояние потока движка, без блокировки
+    struct fiveg_at_request* current;
+    long long deadline_ms;
+    char line[FIVEG_AT_LINE_MAX];
+    size_t line_len;
+
+    // Отдельный канал URC (CMUX): все строки из него - URC
+    int urc_fd;
+    char urc_line[FIVEG_AT_LINE_MAX];
+    size_t urc_line_len;
+} fiveg_at_engine_t;
+
+static inline long long fiveg_at_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Финальная строка ответа: возвращает код результата или 1, если строка
+// не финальная
+static inline int fiveg_at_final_status(const char* line, int* cme_error) {
+    *cme_error = -1;
+    if (strcmp(line, "OK") == 0 || strncmp(line, "CONNECT", 7) == 0) {
+        return FIVEG_AT_OK;
+    }
+    if (strncmp(line, "+CME ERROR:", 11) == 0 || strncmp(line, "+CMS ERROR:", 11) == 0) {
+        *cme_error = atoi(line + 11);
+        return FIVEG_AT_ERROR;
+    }
+    if (strcmp(line, "ERROR") == 0 || strcmp(line, "NO CARRIER") == 0 || strcmp(line, "BUSY") == 0 ||
+        strcmp(line, "NO ANSWER") == 0 || strcmp(line, "NO DIALTONE") == 0) {
+        return FIVEG_AT_ERROR;
+    }
+    return 1;
+}
+
+// Префикс строк ответа по тексту команды: "AT+COPS?" -> "+COPS".
+// Для команд без префикса (ATI, AT+CIFSR отвечает голым адресом)
+// ответом считаются все строки без '+' в начале.
+static inline std::string fiveg_at_command_prefix(const std::string& command) {
+    if (command.size() < 3 || (command[2] != '+' && command[2] != '^' && command[2] != '$')) {
+        return std::string();
+    }
+    size_t end = command.find_first_of("=?\r", 2);
+    return command.substr(2, end == std::string::npos ? std::string::npos : end - 2);
+}
+
+static inline int fiveg_at_default_timeout(const std::string& command) {
+    static const char* const slow[] = {"AT+CIICR", "AT+CGATT", "AT+CGACT=", "AT+COPS=", "AT+ZRESTART"};
+    for (size_t i = 0; i < sizeof(slow) / sizeof(slow[0]); i++) {
+        if (command.compare(0, strlen(slow[i]), slow[i]) == 0) {
+            return FIVEG_AT_LONG_TIMEOUT_MS;
+        }
+    }
+    return FIVEG_AT_TIMEOUT_MS;
+}
+
+// AT+CIFSR отвечает одним адресом без финального OK: первая
+// информационная строка завершает такую команду
+static inline bool fiveg_at_single_line(const std::string& command) {
+    return command.compare(0, 8, "AT+CIFSR") == 0;
+}
+
+static inline void fiveg_at_complete(struct fiveg_at_request* req, int status) {
+    req->result.status = status;
+    if (req->callback) {
+        req->callback(&req->result, req->user);
+    }
+    if (req->has_promise) {
+        req->promise.set_value(req->result);
+    }
+    delete req;
+}
+
+static inline void fiveg_at_dispatch_urc(fiveg_at_engine_t* engine, const char* line) {
+    std::vector<struct fiveg_urc_subscriber> subscribers;
+    std::lock_guard<std::mutex> dispatch_guard(engine->dispatch_lock);
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        subscribers = engine->urcs;
+    }
+    for (size_t i = 0; i < subscribers.size(); i++) {
+        const std::string& prefix = subscribers[i].prefix;
+        if (prefix.empty() || strncmp(line, prefix.c_str(), prefix.size()) == 0) {
+            subscribers[i].callback(line, subscribers[i].user);
+        }
+    }
+}
+
+// Разбор одной строки от модема
+static inline void fiveg_at_handle_line(fiveg_at_engine_t* engine, const char* line) {
+    struct fiveg_at_request* req = engine->current;
+
+    if (!req) {
+        fiveg_at_dispatch_urc(engine, line);
+        return;
+    }
+
+    // Эхо команды (если модем не настроен ATE0)
+    if (req->command.compare(0, req->command.size() - 1, line) == 0) {
+        return;
+    }
+
+    int cme_error;
+    int status = fiveg_at_final_status(line, &cme_error);
+    if (status != 1) {
+        req->result.cme_error = cme_error;
+        req->result.final_line = line;
+        engine->current = NULL;
+        fiveg_at_complete(req, status);
+        return;
+    }
+
+    // Строка с чужим префиксом пришла между командой и ответом - это URC
+    if ((line[0] == '+' || line[0] == '^' || line[0] == '$') &&
+        (req->prefix.empty() || strncmp(line, req->prefix.c_str(), req->prefix.size()) != 0 ||
+         line[req->prefix.size()] != ':')) {
+        fiveg_at_dispatch_urc(engine, line);
+        return;
+    }
+    if (strcmp(line, "RING") == 0) {
+        fiveg_at_dispatch_urc(engine, line);
+        return;
+    }
+
+    if (!req->result.response.empty()) {
+        req->result.response += '\n';
+    }
+    req->result.response += line;
+    if (req->single_line) {
+        engine->current = NULL;
+        fiveg_at_complete(req, FIVEG_AT_OK);
+    }
+}
+
+// Сборка строк из принятых байтов. Пустые строки (между \r\n ответа)
+// пропускаются; слишком длинная строка обрезается. Строки из канала URC
+// передаются подписчикам, минуя команду в полёте.
+static inline void fiveg_at_feed(fiveg_at_engine_t* engine, const char* buf, size_t len, bool urc) {
+    char* line = urc ? engine->urc_line : engine->line;
+    size_t* line_len = urc ? &engine->urc_line_len : &engine->line_len;
+    for (size_t i = 0; i < len; i++) {
+        char c = buf[i];
+        if (c == '\r' || c == '\n') {
+            if (*line_len > 0) {
+                line[*line_len] = '\0';
+                *line_len = 0;
+                if (urc) {
+                    fiveg_at_dispatch_urc(engine, line);
+                } else {
+                    fiveg_at_handle_line(engine, line);
+                }
+            }
+        } else if (*line_len < FIVEG_AT_LINE_MAX - 1) {
+            line[(*line_len)++] = c;
+        }
+    }
+}
+
+// Чтение всех доступных байтов
+static inline int fiveg_at_read(fiveg_at_engine_t* engine, bool urc) {
+    int fd = urc ? engine->urc_fd : engine->fd;
+    char buf[FIVEG_AT_READ_SIZE];
+    for (;;) {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN ? 0 : -1;
+        }
+        if (len == 0) {
+            return -1;
+        }
+        fiveg_at_feed(engine, buf, (size_t)len, urc);
+    }
+}
+
+static inline int fiveg_at_write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                // Буфер tty заполнен (аппаратный контроль потока): ждём
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+// Отправка следующей команды из очереди, если модем свободен
+static inline void fiveg_at_start_next(fiveg_at_engine_t* engine) {
+    while (!engine->current) {
+        struct fiveg_at_request* req;
+        {
+            std::lock_guard<std::mutex> guard(engine->lock);
+            if (engine->queue.empty()) {
+                return;
+            }
+            req = engine->queue.front();
+            engine->queue.pop_front();
+        }
+
+        if (fiveg_at_write_all(engine->fd, req->command.data(), req->command.size()) < 0) {
+            fiveg_at_complete(req, FIVEG_AT_ERROR);
+            continue;
+        }
+        engine->current = req;
+        engine->deadline_ms = fiveg_at_now_ms() + req->timeout_ms;
+    }
+}
+
+// Все команды в очереди и в полёте завершаются с ошибкой status
+static inline void fiveg_at_fail_all(fiveg_at_engine_t* engine, int status) {
+    if (engine->current) {
+        fiveg_at_complete(engine->current, status);
+        engine->current = NULL;
+    }
+    std::deque<struct fiveg_at_request*> pending;
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        pending.swap(engine->queue);
+    }
+    for (size_t i = 0; i < pending.size(); i++) {
+        fiveg_at_complete(pending[i], status);
+    }
+}
+
+static inline void fiveg_at_reader_main(fiveg_at_engine_t* engine) {
+    struct epoll_event events[3];
+
+    while (!engine->stopping.load()) {
+        int timeout = -1;
+        if (engine->current) {
+            long long left = engine->deadline_ms - fiveg_at_now_ms();
+            timeout = left > 0 ? (int)left : 0;
+        }
+
+        int count = epoll_wait(engine->epoll_fd, events, 3, timeout);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == engine->wake_fd) {
+                uint64_t value;
+                if (read(engine->wake_fd, &value, sizeof(value)) < 0) {
+                    // Счётчик eventfd уже прочитан - не ошибка
+                }
+            } else if (events[i].data.fd == engine->urc_fd) {
+                if (fiveg_at_read(engine, true) < 0 || (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                    epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, engine->urc_fd, NULL);
+                }
+            } else if (fiveg_at_read(engine, false) < 0 || (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                // Модем пропал (USB отключён, tty закрыт)
+                epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, engine->fd, NULL);
+                std::lock_guard<std::mutex> guard(engine->lock);
+                engine->disconnected = true;
+            }
+        }
+
+        if (engine->disconnected) {
+            fiveg_at_fail_all(engine, FIVEG_AT_DISCONNECTED);
+            continue;
+        }
+        if (engine->current && fiveg_at_now_ms() >= engine->deadline_ms) {
+            struct fiveg_at_request* req = engine->current;
+            engine->current = NULL;
+            fiveg_at_complete(req, FIVEG_AT_TIMEOUT);
+        }
+        fiveg_at_start_next(engine);
+    }
+
+    fiveg_at_fail_all(engine, FIVEG_AT_DISCONNECTED);
+}
+
+static inline void fiveg_at_engine_destroy(fiveg_at_engine_t* engine);
+
+// Запуск движка на открытом и настроенном (termios) дескрипторе модема.
+// Дескриптор переводится в неблокирующий режим; закрывает его вызывающий.
+// pending - байты, уже прочитанные из fd до запуска (хвост прямого
+// обмена): они разбираются раньше всего, что придёт потом.
+static inline fiveg_at_engine_t* fiveg_at_engine_create(int fd, const char* pending = NULL, size_t pending_len = 0) {
+    fiveg_at_engine_t* engine = new fiveg_at_engine_t();
+    engine->fd = fd;
+    engine->stopping = false;
+    engine->disconnected = false;
+    engine->current = NULL;
+    engine->line_len = 0;
+    engine->urc_fd = -1;
+    engine->urc_line_len = 0;
+    engine->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (engine->wake_fd < 0 || engine->epoll_fd < 0) {
+        fiveg_at_engine_destroy(engine);
+        return NULL;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = engine->wake_fd;
+    epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, engine->wake_fd, &ev);
+    ev.data.fd = fd;
+    if (epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        fiveg_at_engine_destroy(engine);
+        return NULL;
+    }
+
+    fiveg_at_feed(engine, pending, pending_len, false);
+    engine->reader = std::thread(fiveg_at_reader_main, engine);
+    return engine;
+}
+
+static inline void fiveg_at_wake(fiveg_at_engine_t* engine) {
+    uint64_t one = 1;
+    if (write(engine->wake_fd, &one, sizeof(one)) < 0) {
+        // Счётчик eventfd переполнен быть не может, поток и так проснётся
+    }
+}
+
+// Чтение URC из отдельного дескриптора (канал URC мультиплексора).
+// Подключается один раз, сразу после создания движка.
+static inline int fiveg_at_engine_watch_urc(fiveg_at_engine_t* engine, int fd) {
+    if (engine->urc_fd >= 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    engine->urc_fd = fd;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// Остановка движка: команды, не получившие ответа, завершаются с
+// FIVEG_AT_DISCONNECTED
+static inline void fiveg_at_engine_destroy(fiveg_at_engine_t* engine) {
+    if (!engine) {
+        return;
+    }
+    if (engine->reader.joinable()) {
+        engine->stopping = true;
+        fiveg_at_wake(engine);
+        engine->reader.join();
+    }
+    if (engine->epoll_fd >= 0) {
+        close(engine->epoll_fd);
+    }
+    if (engine->wake_fd >= 0) {
+        close(engine->wake_fd);
+    }
+    delete engine;
+}
+
+static inline struct fiveg_at_request* fiveg_at_new_request(const char* command, int timeout_ms) {
+    struct fiveg_at_request* req = new fiveg_at_request();
+    req->command = command;
+    if (req->command.empty() || req->command[req->command.size() - 1] != '\r') {
+        req->command += '\r';
+    }
+    req->prefix = fiveg_at_command_prefix(req->command);
+    req->single_line = fiveg_at_single_line(req->command);
+    req->timeout_ms = timeout_ms > 0 ? timeout_ms : fiveg_at_default_timeout(req->command);
+    req->callback = NULL;
+    req->user = NULL;
+    req->has_promise = false;
+    req->result.status = FIVEG_AT_ERROR;
+    req->result.cme_error = -1;
+    return req;
+}
+
+static inline void fiveg_at_enqueue(fiveg_at_engine_t* engine, struct fiveg_at_request* req) {
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        if (!engine->disconnected) {
+            engine->queue.push_back(req);
+            req = NULL;
+        }
+    }
+    if (req) {
+        fiveg_at_complete(req, FIVEG_AT_DISCONNECTED);
+        return;
+    }
+    fiveg_at_wake(engine);
+}
+
+// Постановка команды в очередь с callback'ом. timeout_ms <= 0 - таймаут
+// по умолчанию для этой команды.
+static inline void fiveg_at_send_async(fiveg_at_engine_t* engine, const char* command,
+                                       fiveg_at_callback_t callback, void* user, int timeout_ms = 0) {
+    struct fiveg_at_request* req = fiveg_at_new_request(command, timeout_ms);
+    req->callback = callback;
+    req->user = user;
+    fiveg_at_enqueue(engine, req);
+}
+
+// Постановка команды в очередь; результат забирается из future
+static inline std::future<fiveg_at_result_t> fiveg_at_send(fiveg_at_engine_t* engine, const char* command,
+                                                           int timeout_ms = 0) {
+    struct fiveg_at_request* req = fiveg_at_new_request(command, timeout_ms);
+    req->has_promise = true;
+    std::future<fiveg_at_result_t> result = req->promise.get_future();
+    fiveg_at_enqueue(engine, req);
+    return result;
+}
+
+// Подписка на URC по префиксу ("+CEREG", "+CSQ", "RING"); пустой префикс -
+// все URC
+static inline void fiveg_at_subscribe(fiveg_at_engine_t* engine, const char* prefix,
+                                      fiveg_urc_callback_t callback, void* user) {
+    struct fiveg_urc_subscriber subscriber;
+    subscriber.prefix = prefix ? prefix : "";
+    subscriber.callback = callback;
+    subscriber.user = user;
+    std::lock_guard<std::mutex> guard(engine->lock);
+    engine->urcs.push_back(subscriber);
+}
+
+// Отписка. После возврата callback больше не вызывается, поэтому user
+// можно освобождать. Вызывать из самого callback'а нельзя.
+static inline void fiveg_at_unsubscribe(fiveg_at_engine_t* engine, fiveg_urc_callback_t callback, void* user) {
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        for (size_t i = 0; i < engine->urcs.size();) {
+            if (engine->urcs[i].callback == callback && engine->urcs[i].user == user) {
+                engine->urcs.erase(engine->urcs.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+    // Дожидаемся рассылки, которая могла начаться до удаления
+    std::lock_guard<std::mutex> dispatch_guard(engine->dispatch_lock);
+}
+
+#endif // _5G_AT_H_
@@ -0,0 +1,205 @@
+#ifndef _5G_CACHE_H_
+#define _5G_CACHE_H_
+
+// Кэш состояния модема: уровень сигнала, оператор, адрес, регистрация,
+// IMEI и IMSI. У каждого поля свой срок жизни (TTL); IMEI и IMSI
+// запрашиваются один раз. Если запущен движок AT-команд, кэш
+// подписывается на URC регистрации и уровня сигнала и обновляется по ним,
+// без опроса модема.
+//
+// Снимок состояния читается без блокировок (seqlock): читатель никогда
+// не ждёт ни tty, ни писателя и всегда получает согласованный набор
+// полей. Писатели (поток движка и поток, обновляющий устаревшее поле)
+// упорядочены мьютексом.
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <string.h>
+#include "5g_at.h"
+#include "5g_parse.h"
+
+enum {
+    FIVEG_CACHE_SIGNAL,
+    FIVEG_CACHE_OPERATOR,
+    FIVEG_CACHE_ADDRESS,
+    FIVEG_CACHE_REGISTRATION,
+    FIVEG_CACHE_IMEI,
+    FIVEG_CACHE_IMSI,
+    FIVEG_CACHE_FIELDS
+};
+
+// Сроки жизни по умолчанию, мс; 0 - значение не устаревает
+#define FIVEG_CACHE_SIGNAL_TTL_MS 2000
+#define FIVEG_CACHE_OPERATOR_TTL_MS 30000
+#define FIVEG_CACHE_ADDRESS_TTL_MS 10000
+#define FIVEG_CACHE_REGISTRATION_TTL_MS 10000
+
+typedef struct {
+    fiveg_csq_t csq;
+    fiveg_cops_t cops;
+    fiveg_cifsr_t address;
+    fiveg_reg_t reg;
+    fiveg_id_t imei;
+    fiveg_id_t imsi;
+    long long updated_ms[FIVEG_CACHE_FIELDS];  // время обновления, 0 - значения нет
+} fiveg_state_t;
+
+// Расположение полей в снимке: запись поля - одно копирование по таблице
+struct fiveg_cache_slot {
+    uint16_t offset;
+    uint16_t size;
+};
+
+static constexpr struct fiveg_cache_slot fiveg_cache_layout[FIVEG_CACHE_FIELDS] = {
+    {offsetof(fiveg_state_t, csq), sizeof(fiveg_csq_t)},
+    {offsetof(fiveg_state_t, cops), sizeof(fiveg_cops_t)},
+    {offsetof(fiveg_state_t, address), sizeof(fiveg_cifsr_t)},
+    {offsetof(fiveg_state_t, reg), sizeof(fiveg_reg_t)},
+    {offsetof(fiveg_state_t, imei), sizeof(fiveg_id_t)},
+    {offsetof(fiveg_state_t, imsi), sizeof(fiveg_id_t)},
+};
+
+typedef struct fiveg_state_cache {
+    std::atomic<unsigned int> seq;             // нечётный - идёт запись
+    fiveg_state_t state;
+    std::mutex write_lock;
+    std::mutex refresh_lock[FIVEG_CACHE_FIELDS];  // один запрос к модему на поле
+    std::atomic<int> ttl_ms[FIVEG_CACHE_FIELDS];  // меняется из любого потока (fiveg_cache_set_ttl)
+    fiveg_at_engine_t* engine;                 // движок, на URC которого есть подписка
+} fiveg_state_cache_t;
+
+static inline fiveg_state_cache_t* fiveg_cache_create(void) {
+    fiveg_state_cache_t* cache = new fiveg_state_cache_t();
+    cache->seq = 0;
+    memset(&cache->state, 0, sizeof(cache->state));
+    cache->ttl_ms[FIVEG_CACHE_SIGNAL] = FIVEG_CACHE_SIGNAL_TTL_MS;
+    cache->ttl_ms[FIVEG_CACHE_OPERATOR] = FIVEG_CACHE_OPERATOR_TTL_MS;
+    cache->ttl_ms[FIVEG_CACHE_ADDRESS] = FIVEG_CACHE_ADDRESS_TTL_MS;
+    cache->ttl_ms[FIVEG_CACHE_REGISTRATION] = FIVEG_CACHE_REGISTRATION_TTL_MS;
+    cache->ttl_ms[FIVEG_CACHE_IMEI] = 0;
+    cache->ttl_ms[FIVEG_CACHE_IMSI] = 0;
+    cache->engine = NULL;
+    return cache;
+}
+
+// Согласованный снимок без блокировки: копия повторяется, если во время
+// копирования шла запись
+static inline void fiveg_cache_read(fiveg_state_cache_t* cache, fiveg_state_t* out) {
+    for (;;) {
+        unsigned int before = cache->seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(out, &cache->state, sizeof(*out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (cache->seq.load(std::memory_order_relaxed) == before) {
+            return;
+        }
+    }
+}
+
+// Изменение снимка под write_lock; update получает state для правки
+template <typename Update>
+static inline void fiveg_cache_modify(fiveg_state_cache_t* cache, Update update) {
+    std::lock_guard<std::mutex> guard(cache->write_lock);
+    unsigned int seq = cache->seq.load(std::memory_order_relaxed);
+    cache->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    update(&cache->state);
+    cache->seq.store(seq + 2, std::memory_order_release);
+}
+
+// Запись поля field из value (тот же тип, что и в fiveg_state_t)
+static inline void fiveg_cache_store(fiveg_state_cache_t* cache, int field, const void* value) {
+    long long now = fiveg_at_now_ms();
+    fiveg_cache_modify(cache, [&](fiveg_state_t* state) {
+        memcpy((char*)state + fiveg_cache_layout[field].offset, value, fiveg_cache_layout[field].size);
+        state->updated_ms[field] = now;
+    });
+}
+
+static inline void fiveg_cache_invalidate(fiveg_state_cache_t* cache, int field) {
+    fiveg_cache_modify(cache, [&](fiveg_state_t* state) { state->updated_ms[field] = 0; });
+}
+
+static inline bool fiveg_cache_fresh(const fiveg_state_cache_t* cache, const fiveg_state_t* state, int field) {
+    long long updated = state->updated_ms[field];
+    if (updated == 0) {
+        return false;
+    }
+    int ttl_ms = cache->ttl_ms[field].load(std::memory_order_relaxed);
+    return ttl_ms == 0 || fiveg_at_now_ms() - updated < ttl_ms;
+}
+
+// Срок жизни поля, 0 - без срока. Читатели увидят новое значение при
+// следующей проверке свежести.
+static inline void fiveg_cache_set_ttl(fiveg_state_cache_t* cache, int field, int ttl_ms) {
+    cache->ttl_ms[field].store(ttl_ms, std::memory_order_relaxed);
+}
+
+// Поле из снимка в out (по таблице расположения)
+static inline void fiveg_cache_field(const fiveg_state_t* state, int field, void* out) {
+    memcpy(out, (const char*)state + fiveg_cache_layout[field].offset, fiveg_cache_layout[field].size);
+}
+
+// URC регистрации и уровня сигнала. Смена состояния регистрации делает
+// устаревшими оператора и адрес: они будут запрошены при следующем чтении.
+static inline void fiveg_cache_handle_urc(const char* line, void* user) {
+    fiveg_state_cache_t* cache = (fiveg_state_cache_t*)user;
+
+    if (strncmp(line, "+CSQ:", 5) == 0) {
+        fiveg_csq_t csq;
+        if (fiveg_parse_csq(line, &csq) == 0) {
+            fiveg_cache_store(cache, FIVEG_CACHE_SIGNAL, &csq);
+        }
+        return;
+    }
+
+    static const char* const prefixes[] = {"+C5GREG", "+CEREG", "+CGREG", "+CREG"};
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+        fiveg_reg_t reg;
+        if (fiveg_parse_reg(line, prefixes[i], &reg) < 0) {
+            continue;
+        }
+        long long now = fiveg_at_now_ms();
+        // CS и GPRS регистрация в кэш не пишется, только сбрасывает поля
+        bool store = i < 2;
+        fiveg_cache_modify(cache, [&](fiveg_state_t* state) {
+            if (state->reg.stat != reg.stat || !store) {
+                state->updated_ms[FIVEG_CACHE_OPERATOR] = 0;
+                state->updated_ms[FIVEG_CACHE_ADDRESS] = 0;
+            }
+            if (store) {
+                state->reg = reg;
+                state->updated_ms[FIVEG_CACHE_REGISTRATION] = now;
+            }
+        });
+        return;
+    }
+}
+
+// Подписка на URC движка и включение отчётов о регистрации с номером
+// соты (режим 2). Команды отправляются асинхронно; модем без 5G
+// ответит ERROR на +C5GREG, это не мешает остальным.
+static inline void fiveg_cache_attach(fiveg_state_cache_t* cache, fiveg_at_engine_t* engine) {
+    static const char* const prefixes[] = {"+CSQ", "+C5GREG", "+CEREG", "+CGREG", "+CREG"};
+    cache->engine = engine;
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+        fiveg_at_subscribe(engine, prefixes[i], fiveg_cache_handle_urc, cache);
+    }
+    fiveg_at_send_async(engine, "AT+CEREG=2\r", NULL, NULL);
+    fiveg_at_send_async(engine, "AT+C5GREG=2\r", NULL, NULL);
+}
+
+static inline void fiveg_cache_destroy(fiveg_state_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    if (cache->engine) {
+        fiveg_at_unsubscribe(cache->engine, fiveg_cache_handle_urc, cache);
+    }
+    delete cache;
+}
+
+#endif // _5G_CACHE_H_
@@ -0,0 +1,847 @@
+#ifndef _5G_CMUX_H_
+#define _5G_CMUX_H_
+
+// Мультиплексор 3GPP TS 27.010 (CMUX): одна линия модема делится на
+// виртуальные каналы (DLCI), чтобы команды AT, данные и URC шли
+// одновременно. Запрос уровня сигнала больше не ждёт, пока допишется
+// поток данных, и наоборот.
+//
+// Каждый канал отдаётся приложению как дескриптор (сторона socketpair),
+// поэтому движок AT-команд и поток данных работают с ним так же, как с
+// tty. Линию обслуживает один поток: он разбирает кадры от модема,
+// раскладывает их по каналам и режет исходящие байты каналов на кадры.
+// Кадры разных каналов чередуются по кругу (канал управления - первым),
+// так что длинная очередь данных не задерживает команду больше чем на
+// один кадр.
+//
+// У каждого канала своя очередь в обе стороны и свой контроль потока:
+// если приложение не успевает читать канал, модему уходит MSC с битом FC
+// для этого канала; MSC с FC от модема останавливает передачу только по
+// своему каналу. Поддерживаются базовый (флаг 0xF9, поле длины) и
+// расширенный (флаг 0x7E, байт-стаффинг) режимы кадров. FCS считается
+// по таблице.
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+// Режимы кадров, как в AT+CMUX=<mode>
+#define FIVEG_CMUX_BASIC 0
+#define FIVEG_CMUX_ADVANCED 1
+
+// Назначение каналов
+#define FIVEG_CMUX_DLCI_CONTROL 0
+#define FIVEG_CMUX_DLCI_AT 1
+#define FIVEG_CMUX_DLCI_DATA 2
+#define FIVEG_CMUX_DLCI_URC 3
+#define FIVEG_CMUX_CHANNELS 4
+
+#define FIVEG_CMUX_N1 1024            // наибольшая длина поля данных кадра
+#define FIVEG_CMUX_N1_MAX 32768
+#define FIVEG_CMUX_T1_MS 300          // ожидание ответа на SABM/DISC/CLD
+#define FIVEG_CMUX_N2 3               // число повторов SABM/DISC
+#define FIVEG_CMUX_TX_QUEUE 65536     // исходящая очередь канала
+#define FIVEG_CMUX_RX_HIGH 65536      // входящая очередь: выше - FC модему
+#define FIVEG_CMUX_RX_LOW 16384       // ниже - снятие FC
+
+// Флаги и байт-стаффинг
+#define FIVEG_CMUX_FLAG_BASIC 0xF9
+#define FIVEG_CMUX_FLAG_ADVANCED 0x7E
+#define FIVEG_CMUX_ESCAPE 0x7D
+#define FIVEG_CMUX_ESCAPE_XOR 0x20
+
+// Поле адреса: EA, C/R, DLCI
+#define FIVEG_CMUX_EA 0x01
+#define FIVEG_CMUX_CR 0x02
+
+// Поле управления (без бита P/F)
+#define FIVEG_CMUX_SABM 0x2F
+#define FIVEG_CMUX_UA 0x63
+#define FIVEG_CMUX_DM 0x0F
+#define FIVEG_CMUX_DISC 0x43
+#define FIVEG_CMUX_UIH 0xEF
+#define FIVEG_CMUX_UI 0x03
+#define FIVEG_CMUX_PF 0x10
+
+// Сообщения канала управления (тип с EA, без C/R)
+#define FIVEG_CMUX_MSG_PN 0x81
+#define FIVEG_CMUX_MSG_CLD 0xC1
+#define FIVEG_CMUX_MSG_TEST 0x21
+#define FIVEG_CMUX_MSG_FCON 0xA1
+#define FIVEG_CMUX_MSG_FCOFF 0x61
+#define FIVEG_CMUX_MSG_MSC 0xE1
+#define FIVEG_CMUX_MSG_NSC 0x11
+
+// Сигналы V.24 в MSC
+#define FIVEG_CMUX_V24_FC 0x02
+#define FIVEG_CMUX_V24_RTC 0x04
+#define FIVEG_CMUX_V24_RTR 0x08
+#define FIVEG_CMUX_V24_DV 0x80
+
+// --- FCS ---
+
+// CRC-8 по TS 27.010 (полином x^8+x^2+x+1, отражённый, начальное 0xFF).
+// FCS кадра - дополнение CRC; CRC по кадру вместе с FCS даёт 0xCF.
+#define FIVEG_CMUX_FCS_GOOD 0xCF
+
+struct fiveg_cmux_crc_table {
+    uint8_t crc[256];
+};
+
+static constexpr struct fiveg_cmux_crc_table fiveg_cmux_make_crc_table() {
+    struct fiveg_cmux_crc_table table = {};
+    for (int i = 0; i < 256; i++) {
+        uint8_t crc = (uint8_t)i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (uint8_t)((crc >> 1) ^ 0xE0) : (uint8_t)(crc >> 1);
+        }
+        table.crc[i] = crc;
+    }
+    return table;
+}
+
+static constexpr struct fiveg_cmux_crc_table fiveg_cmux_crc = fiveg_cmux_make_crc_table();
+
+static inline uint8_t fiveg_cmux_crc_update(uint8_t crc, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = fiveg_cmux_crc.crc[crc ^ data[i]];
+    }
+    return crc;
+}
+
+// --- Кадры ---
+
+typedef struct {
+    uint8_t dlci;
+    bool cr;
+    uint8_t control;         // без бита P/F
+    bool pf;
+    const uint8_t* info;
+    size_t len;
+} fiveg_cmux_frame_t;
+
+static inline void fiveg_cmux_put(int mode, std::string* out, uint8_t byte) {
+    if (mode == FIVEG_CMUX_ADVANCED &&
+        (byte == FIVEG_CMUX_FLAG_ADVANCED || byte == FIVEG_CMUX_ESCAPE || byte == 0x11 || byte == 0x13)) {
+        out->push_back((char)FIVEG_CMUX_ESCAPE);
+        byte ^= FIVEG_CMUX_ESCAPE_XOR;
+    }
+    out->push_back((char)byte);
+}
+
+// Кадр в out. FCS в кадрах UIH считается только по заголовку, в
+// остальных - и по полю данных.
+static inline void fiveg_cmux_encode(int mode, uint8_t dlci, bool cr, uint8_t control, const uint8_t* info,
+                                     size_t len, std::string* out) {
+    uint8_t header[4];
+    size_t header_len = 0;
+    header[header_len++] = (uint8_t)((dlci << 2) | (cr ? FIVEG_CMUX_CR : 0) | FIVEG_CMUX_EA);
+    header[header_len++] = control;
+    if (mode == FIVEG_CMUX_BASIC) {
+        if (len <= 127) {
+            header[header_len++] = (uint8_t)((len << 1) | FIVEG_CMUX_EA);
+        } else {
+            header[header_len++] = (uint8_t)((len & 0x7F) << 1);
+            header[header_len++] = (uint8_t)(len >> 7);
+        }
+    }
+    uint8_t crc = fiveg_cmux_crc_update(0xFF, header, header_len);
+    if ((control & ~FIVEG_CMUX_PF) != FIVEG_CMUX_UIH) {
+        crc = fiveg_cmux_crc_update(crc, info, len);
+    }
+    uint8_t fcs = 0xFF - crc;
+
+    if (mode == FIVEG_CMUX_BASIC) {
+        out->reserve(out->size() + header_len + len + 3);
+        out->push_back((char)FIVEG_CMUX_FLAG_BASIC);
+        out->append((const char*)header, header_len);
+        if (len) {
+            out->append((const char*)info, len);
+        }
+        out->push_back((char)fcs);
+        out->push_back((char)FIVEG_CMUX_FLAG_BASIC);
+        return;
+    }
+    out->push_back((char)FIVEG_CMUX_FLAG_ADVANCED);
+    for (size_t i = 0; i < header_len; i++) {
+        fiveg_cmux_put(mode, out, header[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+        fiveg_cmux_put(mode, out, info[i]);
+    }
+    fiveg_cmux_put(mode, out, fcs);
+    out->push_back((char)FIVEG_CMUX_FLAG_ADVANCED);
+}
+
+// Сообщение канала управления (в кадре UIH на DLCI 0)
+static inline void fiveg_cmux_encode_message(int mode, bool initiator, uint8_t type, bool command,
+                                             const uint8_t* value, size_t len, std::string* out) {
+    uint8_t msg[2 + 16];
+    if (len > 16) {
+        return;
+    }
+    msg[0] = (uint8_t)(type | (command ? FIVEG_CMUX_CR : 0));
+    msg[1] = (uint8_t)((len << 1) | FIVEG_CMUX_EA);
+    if (len) {
+        memcpy(msg + 2, value, len);
+    }
+    fiveg_cmux_encode(mode, FIVEG_CMUX_DLCI_CONTROL, initiator, FIVEG_CMUX_UIH, msg, len + 2, out);
+}
+
+// MSC для канала dlci: сигналы V.24 и бит FC (остановка передачи)
+static inline void fiveg_cmux_encode_msc(int mode, bool initiator, uint8_t dlci, bool stop, std::string* out) {
+    uint8_t value[2];
+    value[0] = (uint8_t)((dlci << 2) | FIVEG_CMUX_CR | FIVEG_CMUX_EA);
+    value[1] = FIVEG_CMUX_EA | FIVEG_CMUX_V24_RTC | FIVEG_CMUX_V24_RTR | FIVEG_CMUX_V24_DV |
+               (stop ? FIVEG_CMUX_V24_FC : 0);
+    fiveg_cmux_encode_message(mode, initiator, FIVEG_CMUX_MSG_MSC, true, value, sizeof(value), out);
+}
+
+// Разбор потока байтов линии в кадры. Кадры с неверным FCS, длиной
+// больше n1 или оборванные отбрасываются, разбор продолжается со
+// следующего флага.
+enum {
+    FIVEG_CMUX_HUNT,         // поиск флага
+    FIVEG_CMUX_ADDRESS,      // после флага
+    FIVEG_CMUX_CONTROL,
+    FIVEG_CMUX_LENGTH,
+    FIVEG_CMUX_INFO,
+    FIVEG_CMUX_FCS,
+    FIVEG_CMUX_CLOSE,
+    FIVEG_CMUX_BODY,         // расширенный режим: байты до флага
+};
+
+typedef struct {
+    int mode;
+    size_t n1;
+    int state;
+    bool escape;
+    size_t pos;              // байтов в buf
+    size_t header;           // длина заголовка (адрес, управление, длина)
+    size_t need;             // осталось байтов поля данных
+    unsigned long long frames;
+    unsigned long long bad_fcs;
+    unsigned long long dropped;
+    uint8_t buf[4 + FIVEG_CMUX_N1_MAX + 1];
+} fiveg_cmux_decoder_t;
+
+static inline void fiveg_cmux_decoder_init(fiveg_cmux_decoder_t* dec, int mode, size_t n1) {
+    dec->mode = mode;
+    dec->n1 = n1 < FIVEG_CMUX_N1_MAX ? n1 : FIVEG_CMUX_N1_MAX;
+    dec->state = FIVEG_CMUX_HUNT;
+    dec->escape = false;
+    dec->pos = 0;
+    dec->frames = 0;
+    dec->bad_fcs = 0;
+    dec->dropped = 0;
+}
+
+// Проверка FCS и передача кадра из buf (заголовок, данные, FCS)
+template <typename Handler>
+static inline void fiveg_cmux_deliver(fiveg_cmux_decoder_t* dec, size_t info_len, Handler& on_frame) {
+    const uint8_t* buf = dec->buf;
+    uint8_t control = buf[1] & ~FIVEG_CMUX_PF;
+    uint8_t crc = fiveg_cmux_crc_update(0xFF, buf, dec->header);
+    if (control != FIVEG_CMUX_UIH) {
+        crc = fiveg_cmux_crc_update(crc, buf + dec->header, info_len);
+    }
+    crc = fiveg_cmux_crc.crc[crc ^ buf[dec->header + info_len]];
+    if (crc != FIVEG_CMUX_FCS_GOOD || !(buf[0] & FIVEG_CMUX_EA)) {
+        dec->bad_fcs++;
+        return;
+    }
+    fiveg_cmux_frame_t frame;
+    frame.dlci = buf[0] >> 2;
+    frame.cr = (buf[0] & FIVEG_CMUX_CR) != 0;
+    frame.control = control;
+    frame.pf = (buf[1] & FIVEG_CMUX_PF) != 0;
+    frame.info = buf + dec->header;
+    frame.len = info_len;
+    dec->frames++;
+    on_frame(&frame);
+}
+
+// Разбор len байтов; on_frame(const fiveg_cmux_frame_t*) вызывается для
+// каждого целого кадра, frame->info действителен только во время вызова
+template <typename Handler>
+static inline void fiveg_cmux_decode(fiveg_cmux_decoder_t* dec, const uint8_t* data, size_t len,
+                                     Handler on_frame) {
+    uint8_t flag = dec->mode == FIVEG_CMUX_BASIC ? FIVEG_CMUX_FLAG_BASIC : FIVEG_CMUX_FLAG_ADVANCED;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        if (dec->mode == FIVEG_CMUX_ADVANCED) {
+            if (b == flag) {
+                if (dec->state == FIVEG_CMUX_BODY && dec->pos >= 3) {
+                    dec->header = 2;
+                    fiveg_cmux_deliver(dec, dec->pos - 3, on_frame);
+                }
+                dec->state = FIVEG_CMUX_BODY;
+                dec->escape = false;
+                dec->pos = 0;
+            } else if (dec->state != FIVEG_CMUX_BODY) {
+                continue;
+            } else if (b == FIVEG_CMUX_ESCAPE) {
+                dec->escape = true;
+            } else if (dec->pos >= dec->n1 + 3) {
+                dec->dropped++;
+                dec->state = FIVEG_CMUX_HUNT;
+            } else {
+                dec->buf[dec->pos++] = dec->escape ? (uint8_t)(b ^ FIVEG_CMUX_ESCAPE_XOR) : b;
+                dec->escape = false;
+            }
+            continue;
+        }
+
+        switch (dec->state) {
+        case FIVEG_CMUX_HUNT:
+            if (b == flag) {
+                dec->state = FIVEG_CMUX_ADDRESS;
+            }
+            break;
+        case FIVEG_CMUX_ADDRESS:
+            // Закрывающий флаг кадра может быть и открывающим следующего
+            if (b != flag) {
+                dec->buf[0] = b;
+                dec->pos = 1;
+                dec->state = FIVEG_CMUX_CONTROL;
+            }
+            break;
+        case FIVEG_CMUX_CONTROL:
+            dec->buf[dec->pos++] = b;
+            dec->state = FIVEG_CMUX_LENGTH;
+            break;
+        case FIVEG_CMUX_LENGTH:
+            // Длина - один октет с EA или два: во втором старшие 8 бит
+            dec->buf[dec->pos++] = b;
+            if (dec->pos == 3 && !(b & FIVEG_CMUX_EA)) {
+                break;
+            }
+            dec->need = dec->pos == 3 ? (size_t)(b >> 1) : (size_t)(dec->buf[2] >> 1) | ((size_t)b << 7);
+            dec->header = dec->pos;
+            if (dec->need > dec->n1) {
+                dec->dropped++;
+                dec->state = FIVEG_CMUX_HUNT;
+            } else {
+                dec->state = dec->need ? FIVEG_CMUX_INFO : FIVEG_CMUX_FCS;
+            }
+            break;
+        case FIVEG_CMUX_INFO: {
+            // Поле данных копируется целиком, без разбора по байту
+            size_t chunk = len - i < dec->need ? len - i : dec->need;
+            memcpy(dec->buf + dec->pos, data + i, chunk);
+            dec->pos += chunk;
+            dec->need -= chunk;
+            i += chunk - 1;
+            if (dec->need == 0) {
+                dec->state = FIVEG_CMUX_FCS;
+            }
+            break;
+        }
+        case FIVEG_CMUX_FCS:
+            dec->buf[dec->pos++] = b;
+            dec->state = FIVEG_CMUX_CLOSE;
+            break;
+        case FIVEG_CMUX_CLOSE:
+            if (b == flag) {
+                fiveg_cmux_deliver(dec, dec->pos - dec->header - 1, on_frame);
+                dec->state = FIVEG_CMUX_ADDRESS;
+            } else {
+                dec->dropped++;
+                dec->state = FIVEG_CMUX_HUNT;
+            }
+            break;
+        }
+    }
+}
+
+// --- Мультиплексор ---
+
+typedef struct {
+    unsigned long long tx_bytes;
+    unsigned long long rx_bytes;
+    unsigned long long tx_frames;
+    unsigned long long rx_frames;
+    unsigned long long remote_stops;   // MSC с FC от модема
+    unsigned long long local_stops;    // наши MSC с FC
+} fiveg_cmux_channel_stats_t;
+
+struct fiveg_cmux_channel {
+    int app_fd;              // отдаётся приложению
+    int mux_fd;              // сторона мультиплексора
+    bool app_closed;         // приложение закрыло свою сторону
+
+    // Под lock
+    bool open;               // канал установлен (получен UA на SABM)
+    bool refused;            // модем ответил DM
+    uint8_t pending;         // SABM или DISC, ждущий ответа
+
+    // Состояние потока мультиплексора, без блокировки
+    bool remote_stopped;     // модем прислал FC: передача по каналу стоит
+    bool local_stopped;      // мы отправили FC
+    std::string tx;          // байты приложения, ещё не разрезанные на кадры
+    size_t tx_off;
+    std::string rx;          // байты от модема, не принятые приложением
+    size_t rx_off;
+    fiveg_cmux_channel_stats_t stats;
+};
+
+typedef struct fiveg_cmux {
+    int fd;                  // линия модема
+    int mode;
+    size_t n1;
+    int saved_flags;
+    int wake_fd;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    std::mutex lock;                    // защищает control_out, open/refused/pending, closed, dead
+    std::condition_variable changed;    // ответ модема на SABM/DISC/CLD
+    std::string control_out;            // кадры DLCI 0 и ответы, уходят первыми
+    bool closed;                        // модем подтвердил CLD
+    bool dead;                          // линия пропала
+
+    // Состояние потока мультиплексора
+    struct fiveg_cmux_channel channels[FIVEG_CMUX_CHANNELS];
+    bool aggregate_stopped;             // FCoff от модема
+    std::string out;                    // кадры, отдаваемые в линию
+    size_t out_off;
+    int next_channel;                   // очередь кадров по кругу
+    fiveg_cmux_decoder_t decoder;
+} fiveg_cmux_t;
+
+static inline void fiveg_cmux_wake(fiveg_cmux_t* mux) {
+    uint64_t one = 1;
+    if (write(mux->wake_fd, &one, sizeof(one)) < 0) {
+        // Счётчик eventfd переполнен быть не может, поток и так проснётся
+    }
+}
+
+// Кадр управления в приоритетную очередь; вызывается под lock
+static inline void fiveg_cmux_send_control(fiveg_cmux_t* mux, uint8_t dlci, bool cr, uint8_t control) {
+    fiveg_cmux_encode(mux->mode, dlci, cr, control, NULL, 0, &mux->control_out);
+}
+
+// Входящие байты канала - приложению; контроль потока по уровню очереди
+static inline void fiveg_cmux_push_rx(fiveg_cmux_t* mux, int dlci) {
+    struct fiveg_cmux_channel* ch = &mux->channels[dlci];
+    while (ch->rx_off < ch->rx.size() && !ch->app_closed) {
+        ssize_t len = send(ch->mux_fd, ch->rx.data() + ch->rx_off, ch->rx.size() - ch->rx_off,
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                ch->app_closed = true;
+            }
+            break;
+        }
+        ch->rx_off += len;
+    }
+    if (ch->rx_off == ch->rx.size() || ch->app_closed) {
+        ch->rx.clear();
+        ch->rx_off = 0;
+    }
+
+    size_t pending = ch->rx.size() - ch->rx_off;
+    bool stop = pending > FIVEG_CMUX_RX_HIGH;
+    if (stop == ch->local_stopped || (!stop && pending > FIVEG_CMUX_RX_LOW)) {
+        return;
+    }
+    ch->local_stopped = stop;
+    if (stop) {
+        ch->stats.local_stops++;
+    }
+    std::lock_guard<std::mutex> guard(mux->lock);
+    fiveg_cmux_encode_msc(mux->mode, true, (uint8_t)dlci, stop, &mux->control_out);
+}
+
+// Сообщение канала управления от модема
+static inline void fiveg_cmux_handle_message(fiveg_cmux_t* mux, const uint8_t* msg, size_t len) {
+    if (len < 2) {
+        return;
+    }
+    uint8_t type = msg[0] & ~FIVEG_CMUX_CR;
+    bool command = (msg[0] & FIVEG_CMUX_CR) != 0;
+    size_t value_len = msg[1] >> 1;
+    const uint8_t* value = msg + 2;
+    if (!(msg[1] & FIVEG_CMUX_EA) || value_len > len - 2) {
+        return;
+    }
+    if (!command) {
+        // Подтверждения наших MSC не нужны; важен только ответ на CLD
+        if (type == FIVEG_CMUX_MSG_CLD) {
+            std::lock_guard<std::mutex> guard(mux->lock);
+            mux->closed = true;
+            mux->changed.notify_all();
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mux->lock);
+    switch (type) {
+    case FIVEG_CMUX_MSG_MSC:
+        if (value_len >= 2) {
+            int dlci = value[0] >> 2;
+            if (dlci > 0 && dlci < FIVEG_CMUX_CHANNELS) {
+                bool stop = (value[1] & FIVEG_CMUX_V24_FC) != 0;
+                if (stop && !mux->channels[dlci].remote_stopped) {
+                    mux->channels[dlci].stats.remote_stops++;
+                }
+                mux->channels[dlci].remote_stopped = stop;
+            }
+        }
+        break;
+    case FIVEG_CMUX_MSG_FCON:
+        mux->aggregate_stopped = false;
+        break;
+    case FIVEG_CMUX_MSG_FCOFF:
+        mux->aggregate_stopped = true;
+        break;
+    case FIVEG_CMUX_MSG_CLD:
+        mux->closed = true;
+        mux->changed.notify_all();
+        break;
+    case FIVEG_CMUX_MSG_TEST:
+        break;
+    default: {
+        // Неизвестная команда: NSC с её типом
+        uint8_t nsc = msg[0];
+        fiveg_cmux_encode_message(mux->mode, true, FIVEG_CMUX_MSG_NSC, false, &nsc, 1, &mux->control_out);
+        return;
+    }
+    }
+    // Ответ - то же сообщение со сброшенным C/R
+    fiveg_cmux_encode_message(mux->mode, true, type, false, value, value_len, &mux->control_out);
+}
+
+static inline void fiveg_cmux_handle_frame(fiveg_cmux_t* mux, const fiveg_cmux_frame_t* frame) {
+    int dlci = frame->dlci;
+    if (dlci >= FIVEG_CMUX_CHANNELS) {
+        if (frame->control == FIVEG_CMUX_SABM) {
+            std::lock_guard<std::mutex> guard(mux->lock);
+            fiveg_cmux_send_control(mux, frame->dlci, false, FIVEG_CMUX_DM | FIVEG_CMUX_PF);
+        }
+        return;
+    }
+    struct fiveg_cmux_channel* ch = &mux->channels[dlci];
+
+    switch (frame->control) {
+    case FIVEG_CMUX_UA:
+    case FIVEG_CMUX_DM: {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        if (frame->control == FIVEG_CMUX_DM) {
+            ch->refused = true;
+            ch->open = false;
+        } else {
+            ch->open = ch->pending == FIVEG_CMUX_SABM;
+        }
+        ch->pending = 0;
+        mux->changed.notify_all();
+        break;
+    }
+    case FIVEG_CMUX_SABM:
+    case FIVEG_CMUX_DISC: {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        ch->open = frame->control == FIVEG_CMUX_SABM;
+        fiveg_cmux_send_control(mux, frame->dlci, false, FIVEG_CMUX_UA | FIVEG_CMUX_PF);
+        if (dlci == FIVEG_CMUX_DLCI_CONTROL && !ch->open) {
+            mux->closed = true;
+        }
+        mux->changed.notify_all();
+        break;
+    }
+    case FIVEG_CMUX_UIH:
+    case FIVEG_CMUX_UI:
+        if (dlci == FIVEG_CMUX_DLCI_CONTROL) {
+            fiveg_cmux_handle_message(mux, frame->info, frame->len);
+            break;
+        }
+        ch->stats.rx_frames++;
+        ch->stats.rx_bytes += frame->len;
+        if (!ch->app_closed) {
+            ch->rx.append((const char*)frame->info, frame->len);
+            fiveg_cmux_push_rx(mux, dlci);
+        }
+        break;
+    }
+}
+
+// Заполнение буфера линии: сначала кадры управления, затем по одному
+// кадру данных от каждого канала по кругу, пока в буфере меньше двух
+// полных кадров
+static inline void fiveg_cmux_fill_out(fiveg_cmux_t* mux) {
+    if (mux->out_off == mux->out.size()) {
+        mux->out.clear();
+        mux->out_off = 0;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        mux->out.append(mux->control_out);
+        mux->control_out.clear();
+    }
+    if (mux->aggregate_stopped) {
+        return;
+    }
+    size_t budget = 2 * (mux->n1 + 8);
+    bool progress = true;
+    while (mux->out.size() - mux->out_off < budget && progress) {
+        progress = false;
+        for (int n = 1; n < FIVEG_CMUX_CHANNELS; n++) {
+            int dlci = 1 + (mux->next_channel + n - 1) % (FIVEG_CMUX_CHANNELS - 1);
+            struct fiveg_cmux_channel* ch = &mux->channels[dlci];
+            size_t pending = ch->tx.size() - ch->tx_off;
+            if (pending == 0 || ch->remote_stopped || !ch->open) {
+                continue;
+            }
+            size_t len = pending < mux->n1 ? pending : mux->n1;
+            fiveg_cmux_encode(mux->mode, (uint8_t)dlci, true, FIVEG_CMUX_UIH,
+                              (const uint8_t*)ch->tx.data() + ch->tx_off, len, &mux->out);
+            ch->tx_off += len;
+            if (ch->tx_off == ch->tx.size()) {
+                ch->tx.clear();
+                ch->tx_off = 0;
+            }
+            ch->stats.tx_frames++;
+            ch->stats.tx_bytes += len;
+            mux->next_channel = dlci % (FIVEG_CMUX_CHANNELS - 1);
+            progress = true;
+        }
+    }
+}
+
+// Линия пропала: приложения получают конец файла на своих каналах
+static inline void fiveg_cmux_set_dead(fiveg_cmux_t* mux) {
+    for (int dlci = 1; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+        shutdown(mux->channels[dlci].mux_fd, SHUT_RDWR);
+    }
+    std::lock_guard<std::mutex> guard(mux->lock);
+    mux->dead = true;
+    mux->changed.notify_all();
+}
+
+static inline void fiveg_cmux_main(fiveg_cmux_t* mux) {
+    struct pollfd pfds[2 + FIVEG_CMUX_CHANNELS];
+    uint8_t buf[65536];
+
+    while (!mux->stopping.load()) {
+        fiveg_cmux_fill_out(mux);
+
+        pfds[0].fd = mux->fd;
+        pfds[0].events = POLLIN | (mux->out_off < mux->out.size() ? POLLOUT : 0);
+        pfds[1].fd = mux->wake_fd;
+        pfds[1].events = POLLIN;
+        for (int dlci = 1; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+            struct fiveg_cmux_channel* ch = &mux->channels[dlci];
+            pfds[1 + dlci].fd = ch->app_closed ? -1 : ch->mux_fd;
+            pfds[1 + dlci].events = (ch->tx.size() - ch->tx_off < FIVEG_CMUX_TX_QUEUE ? POLLIN : 0) |
+                                    (ch->rx_off < ch->rx.size() ? POLLOUT : 0);
+        }
+        if (poll(pfds, 1 + FIVEG_CMUX_CHANNELS, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            uint64_t value;
+            if (read(mux->wake_fd, &value, sizeof(value)) < 0) {
+                // Счётчик eventfd уже прочитан - не ошибка
+            }
+        }
+
+        if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t len = read(mux->fd, buf, sizeof(buf));
+            if (len > 0) {
+                fiveg_cmux_decode(&mux->decoder, buf, len,
+                                  [mux](const fiveg_cmux_frame_t* frame) { fiveg_cmux_handle_frame(mux, frame); });
+            } else if (len == 0 || (errno != EINTR && errno != EAGAIN)) {
+                // Модем пропал (USB отключён, tty закрыт)
+                fiveg_cmux_set_dead(mux);
+                return;
+            }
+        }
+        if (pfds[0].revents & POLLOUT) {
+            ssize_t len = write(mux->fd, mux->out.data() + mux->out_off, mux->out.size() - mux->out_off);
+            if (len > 0) {
+                mux->out_off += len;
+            } else if (len < 0 && errno != EINTR && errno != EAGAIN) {
+                fiveg_cmux_set_dead(mux);
+                return;
+            }
+        }
+
+        for (int dlci = 1; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+            struct fiveg_cmux_channel* ch = &mux->channels[dlci];
+            short revents = pfds[1 + dlci].revents;
+            if (revents & POLLOUT) {
+                fiveg_cmux_push_rx(mux, dlci);
+            }
+            if (revents & (POLLIN | POLLHUP)) {
+                size_t space = FIVEG_CMUX_TX_QUEUE - (ch->tx.size() - ch->tx_off);
+                ssize_t len = recv(ch->mux_fd, buf, space < sizeof(buf) ? space : sizeof(buf), MSG_DONTWAIT);
+                if (len > 0) {
+                    ch->tx.append((const char*)buf, len);
+                } else if (len == 0 || (errno != EINTR && errno != EAGAIN)) {
+                    ch->app_closed = true;
+                }
+            }
+        }
+    }
+}
+
+// Запрос SABM или DISC по каналу с повтором по T1; true - модем ответил UA
+static inline bool fiveg_cmux_request(fiveg_cmux_t* mux, int dlci, uint8_t control) {
+    bool want_open = control == FIVEG_CMUX_SABM;
+    std::unique_lock<std::mutex> guard(mux->lock);
+    for (int attempt = 0; attempt < FIVEG_CMUX_N2; attempt++) {
+        mux->channels[dlci].pending = control;
+        mux->channels[dlci].refused = false;
+        fiveg_cmux_send_control(mux, (uint8_t)dlci, true, control | FIVEG_CMUX_PF);
+        fiveg_cmux_wake(mux);
+        bool answered = mux->changed.wait_for(guard, std::chrono::milliseconds(FIVEG_CMUX_T1_MS), [&] {
+            return mux->channels[dlci].pending == 0 || mux->dead;
+        });
+        if (answered) {
+            return !mux->dead && !mux->channels[dlci].refused && mux->channels[dlci].open == want_open;
+        }
+    }
+    return false;
+}
+
+static inline void fiveg_cmux_destroy(fiveg_cmux_t* mux);
+
+// Запуск мультиплексора на линии fd, модем уже переведён в CMUX
+// (AT+CMUX). Открывает канал управления и каналы AT, данных и URC;
+// NULL - модем не ответил или отказал в канале.
+static inline fiveg_cmux_t* fiveg_cmux_create(int fd, int mode, size_t n1 = FIVEG_CMUX_N1) {
+    fiveg_cmux_t* mux = new fiveg_cmux_t();
+    mux->fd = fd;
+    mux->mode = mode;
+    mux->n1 = n1 < FIVEG_CMUX_N1_MAX ? n1 : FIVEG_CMUX_N1_MAX;
+    mux->stopping = false;
+    mux->closed = false;
+    mux->dead = false;
+    mux->aggregate_stopped = false;
+    mux->out_off = 0;
+    mux->next_channel = 0;
+    fiveg_cmux_decoder_init(&mux->decoder, mode, mux->n1);
+    for (int dlci = 0; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+        struct fiveg_cmux_channel* ch = &mux->channels[dlci];
+        ch->app_fd = -1;
+        ch->mux_fd = -1;
+        ch->app_closed = false;
+        ch->open = false;
+        ch->refused = false;
+        ch->pending = 0;
+        ch->remote_stopped = false;
+        ch->local_stopped = false;
+        ch->tx_off = 0;
+        ch->rx_off = 0;
+        memset(&ch->stats, 0, sizeof(ch->stats));
+    }
+
+    mux->saved_flags = fcntl(fd, F_GETFL);
+    mux->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mux->saved_flags < 0 || mux->wake_fd < 0) {
+        fiveg_cmux_destroy(mux);
+        return NULL;
+    }
+    for (int dlci = 1; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+            fiveg_cmux_destroy(mux);
+            return NULL;
+        }
+        mux->channels[dlci].app_fd = pair[0];
+        mux->channels[dlci].mux_fd = pair[1];
+        fcntl(pair[1], F_SETFL, O_NONBLOCK);
+    }
+    fcntl(fd, F_SETFL, mux->saved_flags | O_NONBLOCK);
+    mux->thread = std::thread(fiveg_cmux_main, mux);
+
+    // Канал управления открывается первым
+    for (int dlci = 0; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+        if (!fiveg_cmux_request(mux, dlci, FIVEG_CMUX_SABM)) {
+            fiveg_cmux_destroy(mux);
+            return NULL;
+        }
+    }
+    return mux;
+}
+
+// Дескриптор канала dlci для приложения
+static inline int fiveg_cmux_channel_fd(const fiveg_cmux_t* mux, int dlci) {
+    return dlci > 0 && dlci < FIVEG_CMUX_CHANNELS ? mux->channels[dlci].app_fd : -1;
+}
+
+// Закрытие каналов (DISC), выход модема из CMUX (CLD) и остановка
+// потока. Движок AT и поток данных на каналах должны быть уже
+// остановлены: их дескрипторы закрываются. Линия fd не закрывается.
+static inline void fiveg_cmux_destroy(fiveg_cmux_t* mux) {
+    if (!mux) {
+        return;
+    }
+    if (mux->thread.joinable()) {
+        for (int dlci = FIVEG_CMUX_CHANNELS - 1; dlci > 0; dlci--) {
+            fiveg_cmux_request(mux, dlci, FIVEG_CMUX_DISC);
+        }
+        std::unique_lock<std::mutex> guard(mux->lock);
+        if (!mux->dead && !mux->closed) {
+            fiveg_cmux_encode_message(mux->mode, true, FIVEG_CMUX_MSG_CLD, true, NULL, 0, &mux->control_out);
+            fiveg_cmux_wake(mux);
+            mux->changed.wait_for(guard, std::chrono::milliseconds(FIVEG_CMUX_T1_MS),
+                                  [&] { return mux->closed || mux->dead; });
+        }
+        guard.unlock();
+        mux->stopping = true;
+        fiveg_cmux_wake(mux);
+        mux->thread.join();
+    }
+    for (int dlci = 1; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+        if (mux->channels[dlci].app_fd >= 0) {
+            close(mux->channels[dlci].app_fd);
+        }
+        if (mux->channels[dlci].mux_fd >= 0) {
+            close(mux->channels[dlci].mux_fd);
+        }
+    }
+    if (mux->wake_fd >= 0) {
+        close(mux->wake_fd);
+    }
+    if (mux->saved_flags >= 0) {
+        fcntl(mux->fd, F_SETFL, mux->saved_flags);
+    }
+    delete mux;
+}
+
+// Счётчики по каналам. Читаются без блокировки: значения приблизительные,
+// пока поток мультиплексора работает.
+static inline void fiveg_cmux_print_stats(const fiveg_cmux_t* mux, FILE* out) {
+    static const char* const names[FIVEG_CMUX_CHANNELS] = {"control", "at", "data", "urc"};
+    for (int dlci = 1; dlci < FIVEG_CMUX_CHANNELS; dlci++) {
+        const fiveg_cmux_channel_stats_t* stats = &mux->channels[dlci].stats;
+        fprintf(out, "cmux %s: tx %llu bytes / %llu frames, rx %llu bytes / %llu frames, stops %llu remote / %llu local\n",
+                names[dlci], stats->tx_bytes, stats->tx_frames, stats->rx_bytes, stats->rx_frames,
+                stats->remote_stops, stats->local_stops);
+    }
+    fprintf(out, "cmux line: %llu frames, %llu bad FCS, %llu dropped\n", mux->decoder.frames, mux->decoder.bad_fcs,
+            mux->decoder.dropped);
+}
+
+#endif // _5G_CMUX_H_
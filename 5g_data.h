@@ -0,0 +1,547 @@
+#ifndef _5G_DATA_H_
+#define _5G_DATA_H_
+
+// Потоковая передача данных через модем в режиме данных (после CONNECT,
+// в прозрачном режиме TCP/IP стека модема и т.п.): по tty идут сырые
+// байты, а не строки AT-команд, поэтому на это время поток данных
+// владеет дескриптором единолично - движок AT-команд должен быть
+// остановлен.
+//
+// Отправка. Мелкие записи копируются в блоки по FIVEG_DATA_CHUNK байт,
+// блоки стоят в очереди и уходят одним writev (до FIVEG_DATA_IOV_MAX
+// блоков за вызов). Большой буфер приложения не копируется: он
+// дописывается к тому же writev последним элементом. Частичная запись
+// продвигает смещение в первом блоке; EAGAIN означает, что буфер tty
+// заполнен (модем снял CTS или прислал XOFF), и поток ждёт POLLOUT,
+// а не крутится в цикле.
+//
+// Приём. Данные читаются readv прямо в свободное место кольцевого
+// буфера (двумя частями при переходе через конец); буфер выделяется
+// один раз. Если буфер заполнен, чтение прекращается до тех пор, пока
+// приложение не заберёт данные, и модем тормозится контролем потока.
+//
+// Статистика разделяет время на системные вызовы (хост), ожидание
+// готовности tty (модем или линия не принимают данные) и ожидание
+// данных от модема, плюс перцентили задержки блока от постановки в
+// очередь до записи в tty.
+
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+#define FIVEG_DATA_CHUNK 16384
+#define FIVEG_DATA_IOV_MAX 64
+#define FIVEG_DATA_FLUSH_BYTES (4 * FIVEG_DATA_CHUNK)  // очередь сбрасывается при таком объёме
+#define FIVEG_DATA_RING_SIZE (256 * 1024)              // степень двойки
+#define FIVEG_DATA_TIMEOUT_MS 30000
+
+// Коды совпадают с FIVEG_* из 5g.h
+#define FIVEG_DATA_OK 0
+#define FIVEG_DATA_ERROR -1
+#define FIVEG_DATA_DISCONNECTED -3
+#define FIVEG_DATA_TIMEOUT -4
+
+// Контроль потока на линии
+#define FIVEG_FLOW_NONE 0
+#define FIVEG_FLOW_RTSCTS 1
+#define FIVEG_FLOW_XONXOFF 2
+
+// Гистограмма задержек: 4 корзины на каждую степень двойки микросекунд
+#define FIVEG_LATENCY_BUCKETS 160
+
+typedef struct {
+    uint64_t count[FIVEG_LATENCY_BUCKETS];
+    uint64_t total;
+    long long max_us;
+} fiveg_latency_hist_t;
+
+typedef struct {
+    char* data;              // FIVEG_DATA_CHUNK байт
+    size_t len;
+    size_t offset;           // сколько уже записано в tty
+    long long queued_us;     // когда в блок попал первый байт
+} fiveg_data_chunk_t;
+
+typedef struct {
+    long long started_us;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint64_t writev_calls;
+    uint64_t partial_writes;
+    uint64_t tx_blocked;         // EAGAIN: tty не принимает данные
+    uint64_t rx_reads;
+    uint64_t rx_ring_full;       // чтение отложено: приложение не забирает данные
+    long long write_us;          // время в writev
+    long long blocked_us;        // ожидание POLLOUT
+    long long read_us;           // время в readv
+    long long rx_wait_us;        // ожидание данных от модема
+    int max_outq;                // пик очереди вывода tty (TIOCOUTQ), байт
+    fiveg_latency_hist_t latency;
+} fiveg_data_stats_t;
+
+typedef struct fiveg_data_stream {
+    int fd;
+    int flow;
+    int saved_flags;
+    struct termios saved_termios;
+    bool termios_saved;
+
+    std::deque<fiveg_data_chunk_t> queue;
+    std::vector<char*> spare;    // блоки для повторного использования
+    size_t queued_bytes;
+
+    char* ring;
+    size_t ring_head;            // позиция записи (растёт без ограничения)
+    size_t ring_tail;            // позиция чтения
+
+    fiveg_data_stats_t stats;
+} fiveg_data_stream_t;
+
+static inline long long fiveg_data_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline int fiveg_latency_bucket(long long us) {
+    if (us < 4) {
+        return us < 0 ? 0 : (int)us;
+    }
+    int log = 63 - __builtin_clzll((unsigned long long)us);
+    int bucket = (log - 1) * 4 + (int)((us >> (log - 2)) & 3);
+    return bucket < FIVEG_LATENCY_BUCKETS ? bucket : FIVEG_LATENCY_BUCKETS - 1;
+}
+
+// Нижняя граница корзины, мкс
+static inline long long fiveg_latency_bucket_floor(int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    int log = bucket / 4 + 1;
+    return (long long)(4 + bucket % 4) << (log - 2);
+}
+
+static inline void fiveg_latency_add(fiveg_latency_hist_t* hist, long long us) {
+    hist->count[fiveg_latency_bucket(us)]++;
+    hist->total++;
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+}
+
+// Перцентиль (0..100) как верхняя граница корзины, не больше максимума
+static inline long long fiveg_latency_percentile(const fiveg_latency_hist_t* hist, double percentile) {
+    if (hist->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(hist->total * percentile / 100.0);
+    uint64_t seen = 0;
+    for (int i = 0; i < FIVEG_LATENCY_BUCKETS; i++) {
+        seen += hist->count[i];
+        if (seen > rank) {
+            long long upper = i + 1 < FIVEG_LATENCY_BUCKETS ? fiveg_latency_bucket_floor(i + 1) - 1 : hist->max_us;
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
+
+// Настройка линии: сырой режим и нужный контроль потока. Скорость не
+// меняется.
+static inline int fiveg_data_set_flow(fiveg_data_stream_t* stream, int flow) {
+    struct termios tio;
+    if (tcgetattr(stream->fd, &tio) < 0) {
+        // Не tty (сокет, pipe): настраивать нечего
+        stream->flow = FIVEG_FLOW_NONE;
+        return errno == ENOTTY || errno == EINVAL ? FIVEG_DATA_OK : FIVEG_DATA_ERROR;
+    }
+    if (!stream->termios_saved) {
+        stream->saved_termios = tio;
+        stream->termios_saved = true;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (flow == FIVEG_FLOW_RTSCTS) {
+        tio.c_cflag |= CRTSCTS;
+    } else if (flow == FIVEG_FLOW_XONXOFF) {
+        // XON/XOFF обрабатывает драйвер tty: остановленный вывод виден
+        // приложению как EAGAIN, как и при снятом CTS
+        tio.c_iflag |= IXON | IXOFF;
+        tio.c_cc[VSTART] = 0x11;
+        tio.c_cc[VSTOP] = 0x13;
+    }
+    // VMIN = 1: при O_NONBLOCK пустой tty даёт EAGAIN, а 0 от read
+    // остаётся признаком обрыва линии
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(stream->fd, TCSANOW, &tio) < 0) {
+        return FIVEG_DATA_ERROR;
+    }
+    stream->flow = flow;
+    return FIVEG_DATA_OK;
+}
+
+static inline void fiveg_data_close(fiveg_data_stream_t* stream);
+
+static inline fiveg_data_stream_t* fiveg_data_open(int fd, int flow) {
+    fiveg_data_stream_t* stream = new fiveg_data_stream_t();
+    stream->fd = fd;
+    stream->termios_saved = false;
+    stream->queued_bytes = 0;
+    stream->ring_head = 0;
+    stream->ring_tail = 0;
+    memset(&stream->stats, 0, sizeof(stream->stats));
+    stream->stats.started_us = fiveg_data_now_us();
+    stream->saved_flags = fcntl(fd, F_GETFL);
+    stream->ring = (char*)malloc(FIVEG_DATA_RING_SIZE);
+    if (stream->saved_flags < 0 || !stream->ring || fiveg_data_set_flow(stream, flow) < 0) {
+        fiveg_data_close(stream);
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, stream->saved_flags | O_NONBLOCK);
+    return stream;
+}
+
+// Закрытие потока: неотправленные данные отбрасываются, настройки
+// линии и флаги дескриптора возвращаются. Сам fd не закрывается.
+static inline void fiveg_data_close(fiveg_data_stream_t* stream) {
+    if (!stream) {
+        return;
+    }
+    if (stream->termios_saved) {
+        tcsetattr(stream->fd, TCSANOW, &stream->saved_termios);
+    }
+    if (stream->saved_flags >= 0) {
+        fcntl(stream->fd, F_SETFL, stream->saved_flags);
+    }
+    for (size_t i = 0; i < stream->queue.size(); i++) {
+        free(stream->queue[i].data);
+    }
+    for (size_t i = 0; i < stream->spare.size(); i++) {
+        free(stream->spare[i]);
+    }
+    free(stream->ring);
+    delete stream;
+}
+
+// Запись очереди и, если передан, буфера extra одним writev до полного
+// опустошения или истечения deadline_us. *extra_done - сколько байт
+// extra уже записано.
+static inline int fiveg_data_write_queue(fiveg_data_stream_t* stream, const char* extra, size_t extra_len,
+                                         size_t* extra_done, long long deadline_us) {
+    fiveg_data_stats_t* stats = &stream->stats;
+    while (!stream->queue.empty() || *extra_done < extra_len) {
+        struct iovec iov[FIVEG_DATA_IOV_MAX + 1];
+        int count = 0;
+        size_t want = 0;
+        for (size_t i = 0; i < stream->queue.size() && count < FIVEG_DATA_IOV_MAX; i++) {
+            fiveg_data_chunk_t* chunk = &stream->queue[i];
+            iov[count].iov_base = chunk->data + chunk->offset;
+            iov[count].iov_len = chunk->len - chunk->offset;
+            want += iov[count++].iov_len;
+        }
+        // Буфер приложения - только после всей очереди, иначе нарушится порядок
+        if (count == (int)stream->queue.size() && *extra_done < extra_len) {
+            iov[count].iov_base = (void*)(extra + *extra_done);
+            iov[count].iov_len = extra_len - *extra_done;
+            want += iov[count++].iov_len;
+        }
+
+        long long start = fiveg_data_now_us();
+        ssize_t written = writev(stream->fd, iov, count);
+        long long end = fiveg_data_now_us();
+        stats->write_us += end - start;
+        stats->writev_calls++;
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                return errno == EIO || errno == EPIPE ? FIVEG_DATA_DISCONNECTED : FIVEG_DATA_ERROR;
+            }
+            stats->tx_blocked++;
+            long long left = deadline_us - end;
+            if (left <= 0) {
+                return FIVEG_DATA_TIMEOUT;
+            }
+            struct pollfd pfd = {stream->fd, POLLOUT, 0};
+            int ready = poll(&pfd, 1, (int)((left + 999) / 1000));
+            stats->blocked_us += fiveg_data_now_us() - end;
+            if (ready > 0 && (pfd.revents & (POLLERR | POLLHUP))) {
+                return FIVEG_DATA_DISCONNECTED;
+            }
+            continue;
+        }
+
+        stats->tx_bytes += written;
+        if ((size_t)written < want) {
+            stats->partial_writes++;
+        }
+        int outq;
+        if (ioctl(stream->fd, TIOCOUTQ, &outq) == 0 && outq > stats->max_outq) {
+            stats->max_outq = outq;
+        }
+
+        // Продвижение по записанным блокам
+        size_t left = (size_t)written;
+        while (left > 0 && !stream->queue.empty()) {
+            fiveg_data_chunk_t* chunk = &stream->queue.front();
+            size_t rest = chunk->len - chunk->offset;
+            if (left < rest) {
+                chunk->offset += left;
+                left = 0;
+                break;
+            }
+            left -= rest;
+            fiveg_latency_add(&stats->latency, end - chunk->queued_us);
+            stream->queued_bytes -= chunk->len;
+            stream->spare.push_back(chunk->data);
+            stream->queue.pop_front();
+        }
+        *extra_done += left;
+    }
+    return FIVEG_DATA_OK;
+}
+
+// Постановка данных в очередь без записи в tty. Очередь сбрасывается
+// сама, когда набирается FIVEG_DATA_FLUSH_BYTES.
+static inline int fiveg_data_queue(fiveg_data_stream_t* stream, const void* data, size_t len) {
+    const char* bytes = (const char*)data;
+    long long now = fiveg_data_now_us();
+    while (len > 0) {
+        if (stream->queue.empty() || stream->queue.back().len == FIVEG_DATA_CHUNK) {
+            fiveg_data_chunk_t chunk;
+            if (!stream->spare.empty()) {
+                chunk.data = stream->spare.back();
+                stream->spare.pop_back();
+            } else if (!(chunk.data = (char*)malloc(FIVEG_DATA_CHUNK))) {
+                return FIVEG_DATA_ERROR;
+            }
+            chunk.len = 0;
+            chunk.offset = 0;
+            chunk.queued_us = now;
+            stream->queue.push_back(chunk);
+        }
+        fiveg_data_chunk_t* tail = &stream->queue.back();
+        size_t part = FIVEG_DATA_CHUNK - tail->len;
+        if (part > len) {
+            part = len;
+        }
+        memcpy(tail->data + tail->len, bytes, part);
+        tail->len += part;
+        stream->queued_bytes += part;
+        bytes += part;
+        len -= part;
+    }
+    if (stream->queued_bytes >= FIVEG_DATA_FLUSH_BYTES) {
+        size_t none = 0;
+        return fiveg_data_write_queue(stream, NULL, 0, &none, fiveg_data_now_us() + FIVEG_DATA_TIMEOUT_MS * 1000LL);
+    }
+    return FIVEG_DATA_OK;
+}
+
+// Запись всей очереди
+static inline int fiveg_data_flush(fiveg_data_stream_t* stream, int timeout_ms = FIVEG_DATA_TIMEOUT_MS) {
+    size_t none = 0;
+    return fiveg_data_write_queue(stream, NULL, 0, &none, fiveg_data_now_us() + timeout_ms * 1000LL);
+}
+
+// Синхронная отправка: мелкие данные идут через очередь, буфер от
+// FIVEG_DATA_CHUNK и больше пишется без копирования вместе с очередью.
+// Возвращает управление, когда все данные переданы драйверу tty.
+static inline int fiveg_data_send(fiveg_data_stream_t* stream, const void* data, size_t len,
+                                  int timeout_ms = FIVEG_DATA_TIMEOUT_MS) {
+    long long start = fiveg_data_now_us();
+    long long deadline = start + timeout_ms * 1000LL;
+    if (len < FIVEG_DATA_CHUNK) {
+        size_t none = 0;
+        int result = fiveg_data_queue(stream, data, len);
+        return result < 0 ? result : fiveg_data_write_queue(stream, NULL, 0, &none, deadline);
+    }
+    size_t done = 0;
+    int result = fiveg_data_write_queue(stream, (const char*)data, len, &done, deadline);
+    if (result == FIVEG_DATA_OK) {
+        fiveg_latency_add(&stream->stats.latency, fiveg_data_now_us() - start);
+    }
+    return result;
+}
+
+// --- Приём ---
+
+static inline size_t fiveg_data_available(const fiveg_data_stream_t* stream) {
+    return stream->ring_head - stream->ring_tail;
+}
+
+// Непрерывный участок принятых данных (до конца буфера); после
+// обработки его нужно освободить fiveg_data_consume
+static inline size_t fiveg_data_peek(const fiveg_data_stream_t* stream, const char** data) {
+    size_t pos = stream->ring_tail & (FIVEG_DATA_RING_SIZE - 1);
+    size_t len = fiveg_data_available(stream);
+    if (len > FIVEG_DATA_RING_SIZE - pos) {
+        len = FIVEG_DATA_RING_SIZE - pos;
+    }
+    *data = stream->ring + pos;
+    return len;
+}
+
+static inline void fiveg_data_consume(fiveg_data_stream_t* stream, size_t len) {
+    stream->ring_tail += len;
+}
+
+// Байты, принятые из tty до открытия потока (прочитанные вместе с
+// CONNECT), - в кольцевой буфер раньше всего остального. Возвращает,
+// сколько поместилось.
+static inline size_t fiveg_data_put(fiveg_data_stream_t* stream, const char* data, size_t len) {
+    size_t space = FIVEG_DATA_RING_SIZE - fiveg_data_available(stream);
+    if (len > space) {
+        len = space;
+    }
+    for (size_t done = 0; done < len;) {
+        size_t pos = stream->ring_head & (FIVEG_DATA_RING_SIZE - 1);
+        size_t chunk = len - done < FIVEG_DATA_RING_SIZE - pos ? len - done : FIVEG_DATA_RING_SIZE - pos;
+        memcpy(stream->ring + pos, data + done, chunk);
+        stream->ring_head += chunk;
+        done += chunk;
+    }
+    stream->stats.rx_bytes += len;
+    return len;
+}
+
+// Чтение из tty в кольцевой буфер. Ждёт данных не дольше timeout_ms;
+// возвращает число принятых байт (0 - таймаут или буфер полон) или код
+// ошибки.
+static inline int fiveg_data_receive(fiveg_data_stream_t* stream, int timeout_ms) {
+    fiveg_data_stats_t* stats = &stream->stats;
+    size_t space = FIVEG_DATA_RING_SIZE - fiveg_data_available(stream);
+    if (space == 0) {
+        stats->rx_ring_full++;
+        return 0;
+    }
+    size_t pos = stream->ring_head & (FIVEG_DATA_RING_SIZE - 1);
+    struct iovec iov[2];
+    int count = 1;
+    iov[0].iov_base = stream->ring + pos;
+    iov[0].iov_len = FIVEG_DATA_RING_SIZE - pos < space ? FIVEG_DATA_RING_SIZE - pos : space;
+    if (iov[0].iov_len < space) {
+        iov[1].iov_base = stream->ring;
+        iov[1].iov_len = space - iov[0].iov_len;
+        count = 2;
+    }
+
+    long long deadline = fiveg_data_now_us() + timeout_ms * 1000LL;
+    for (;;) {
+        long long start = fiveg_data_now_us();
+        ssize_t len = readv(stream->fd, iov, count);
+        long long end = fiveg_data_now_us();
+        stats->read_us += end - start;
+        if (len > 0) {
+            stats->rx_reads++;
+            stats->rx_bytes += len;
+            stream->ring_head += len;
+            return (int)len;
+        }
+        if (len == 0) {
+            return FIVEG_DATA_DISCONNECTED;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN) {
+            return errno == EIO ? FIVEG_DATA_DISCONNECTED : FIVEG_DATA_ERROR;
+        }
+        long long left = deadline - end;
+        if (left <= 0) {
+            return 0;
+        }
+        struct pollfd pfd = {stream->fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, (int)((left + 999) / 1000));
+        stats->rx_wait_us += fiveg_data_now_us() - end;
+        if (ready == 0) {
+            return 0;
+        }
+        if (ready > 0 && !(pfd.revents & POLLIN) && (pfd.revents & (POLLERR | POLLHUP))) {
+            return FIVEG_DATA_DISCONNECTED;
+        }
+    }
+}
+
+// Копирование до len принятых байт в buffer; если в кольце пусто - ждёт
+// данных не дольше timeout_ms
+static inline int fiveg_data_read(fiveg_data_stream_t* stream, void* buffer, size_t len, int timeout_ms) {
+    if (fiveg_data_available(stream) == 0) {
+        int result = fiveg_data_receive(stream, timeout_ms);
+        if (result <= 0) {
+            return result;
+        }
+    }
+    size_t copied = 0;
+    while (copied < len) {
+        const char* data;
+        size_t part = fiveg_data_peek(stream, &data);
+        if (part == 0) {
+            break;
+        }
+        if (part > len - copied) {
+            part = len - copied;
+        }
+        memcpy((char*)buffer + copied, data, part);
+        fiveg_data_consume(stream, part);
+        copied += part;
+    }
+    return (int)copied;
+}
+
+// --- Отчёт ---
+
+static inline void fiveg_data_print_stats(const fiveg_data_stream_t* stream, FILE* out) {
+    const fiveg_data_stats_t* stats = &stream->stats;
+    long long elapsed = fiveg_data_now_us() - stats->started_us;
+    if (elapsed <= 0) {
+        elapsed = 1;
+    }
+    double seconds = elapsed / 1e6;
+    fprintf(out, "Передано: %llu байт (%.2f Мбит/с), принято: %llu байт (%.2f Мбит/с) за %.3f с\n",
+            (unsigned long long)stats->tx_bytes, stats->tx_bytes * 8 / seconds / 1e6,
+            (unsigned long long)stats->rx_bytes, stats->rx_bytes * 8 / seconds / 1e6, seconds);
+    fprintf(out, "writev: %llu вызовов, %.0f байт в среднем, частичных: %llu, tty занят: %llu раз, пик очереди tty: %d байт\n",
+            (unsigned long long)stats->writev_calls,
+            stats->writev_calls ? (double)stats->tx_bytes / stats->writev_calls : 0.0,
+            (unsigned long long)stats->partial_writes, (unsigned long long)stats->tx_blocked, stats->max_outq);
+    fprintf(out, "Задержка записи, мкс: p50 %lld, p90 %lld, p99 %lld, max %lld (%llu блоков)\n",
+            fiveg_latency_percentile(&stats->latency, 50), fiveg_latency_percentile(&stats->latency, 90),
+            fiveg_latency_percentile(&stats->latency, 99), stats->latency.max_us,
+            (unsigned long long)stats->latency.total);
+
+    double host = 100.0 * (stats->write_us + stats->read_us) / elapsed;
+    double modem_tx = 100.0 * stats->blocked_us / elapsed;
+    double modem_rx = 100.0 * stats->rx_wait_us / elapsed;
+    fprintf(out, "Время: системные вызовы %.1f%%, ожидание готовности tty %.1f%%, ожидание данных модема %.1f%%\n",
+            host, modem_tx, modem_rx);
+    const char* verdict;
+    if (modem_tx >= host && modem_tx >= 10.0) {
+        verdict = "модем или линия: tty не успевает принимать данные (контроль потока, скорость порта)";
+    } else if (host >= 10.0) {
+        verdict = "хост: время уходит на системные вызовы";
+    } else if (stats->rx_ring_full > 0) {
+        verdict = "приложение: не успевает забирать принятые данные";
+    } else {
+        verdict = "приложение: данные поступают медленнее, чем их принимает модем";
+    }
+    fprintf(out, "Узкое место: %s\n", verdict);
+}
+
+#endif // _5G_DATA_H_
@@ -0,0 +1,452 @@
+#ifndef _5G_PARSE_H_
+#define _5G_PARSE_H_
+
+// Разбор ответов модема на AT-команды в типизированные структуры.
+// Формат каждого ответа описан таблицей полей, которая строится на этапе
+// компиляции; разбор идёт одним проходом по строке, без выделения памяти
+// и без sscanf/strtol, поэтому не зависит от локали. Числа в кавычках
+// (TAC, идентификатор соты) разбираются как шестнадцатеричные.
+//
+// Все функции принимают ответ целиком (несколько строк через '\n', как
+// его возвращает send_at_command) и ищут в нём строки со своим префиксом.
+// Возвращают 0 при успехе и -1, если строки нет или она не разобрана.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FIVEG_OPERATOR_MAX 64
+#define FIVEG_ADDRESS_MAX 46
+#define FIVEG_MAX_CONTEXTS 8
+
+// +CSQ: <rssi>,<ber>
+typedef struct {
+    int32_t rssi;            // 0..31, 99 - неизвестно
+    int32_t ber;             // 0..7, 99 - неизвестно
+} fiveg_csq_t;
+
+// +COPS: <mode>[,<format>,<oper>[,<AcT>]]
+typedef struct {
+    int32_t mode;
+    int32_t format;
+    char oper[FIVEG_OPERATOR_MAX];
+    int32_t act;             // 7 - E-UTRAN, 11/12/13 - NR
+} fiveg_cops_t;
+
+// +CGACT: <cid>,<state>, по строке на контекст
+typedef struct {
+    int32_t cid;
+    int32_t state;           // 1 - активен
+} fiveg_pdp_context_t;
+
+typedef struct {
+    int count;
+    fiveg_pdp_context_t contexts[FIVEG_MAX_CONTEXTS];
+} fiveg_cgact_t;
+
+// Ответ AT+CIFSR: адрес без префикса
+typedef struct {
+    char address[FIVEG_ADDRESS_MAX];
+    int is_ipv4;
+    uint8_t ipv4[4];
+} fiveg_cifsr_t;
+
+// +CREG / +CGREG / +CEREG / +C5GREG, ответ на запрос (<n>,<stat>,...)
+// и URC (<stat>,...). Поля, которых нет в строке, равны -1.
+typedef struct {
+    int32_t n;               // режим отчётов, только в ответе на запрос
+    int32_t stat;            // 1 - домашняя сеть, 5 - роуминг
+    int64_t tac;
+    int64_t ci;              // до 36 бит для NR
+    int32_t act;
+} fiveg_reg_t;
+
+// IMEI (AT+CGSN) и IMSI (AT+CIMI): строка из цифр
+typedef struct {
+    char digits[20];
+} fiveg_id_t;
+
+enum {
+    FIVEG_FIELD_INT,         // десятичное число со знаком
+    FIVEG_FIELD_HEX,         // шестнадцатеричное число в кавычках
+    FIVEG_FIELD_STR,         // строка, в кавычках или без
+};
+
+struct fiveg_at_field {
+    uint8_t type;
+    uint16_t offset;
+    uint16_t size;
+};
+
+struct fiveg_at_schema {
+    const char* prefix;      // "+CSQ"
+    uint8_t prefix_len;
+    uint8_t required;        // обязательных полей
+    uint8_t field_count;
+    const struct fiveg_at_field* fields;
+};
+
+// Таблица символов: значение шестнадцатеричной цифры или 0xff
+struct fiveg_at_char_table {
+    uint8_t hex[256];
+};
+
+static constexpr struct fiveg_at_char_table fiveg_at_make_char_table() {
+    struct fiveg_at_char_table table = {};
+    for (int c = 0; c < 256; c++) {
+        table.hex[c] = 0xff;
+        if (c >= '0' && c <= '9') {
+            table.hex[c] = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            table.hex[c] = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            table.hex[c] = c - 'A' + 10;
+        }
+    }
+    return table;
+}
+
+static constexpr struct fiveg_at_char_table fiveg_at_chars = fiveg_at_make_char_table();
+
+#define FIVEG_FIELD(type, st, member) {type, offsetof(st, member), sizeof(((st*)0)->member)}
+#define FIVEG_SCHEMA(prefix, required, fields) \
+    {prefix, sizeof(prefix) - 1, required, sizeof(fields) / sizeof(fields[0]), fields}
+
+static constexpr struct fiveg_at_field fiveg_csq_fields[] = {
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_csq_t, rssi),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_csq_t, ber),
+};
+
+static constexpr struct fiveg_at_field fiveg_cops_fields[] = {
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_cops_t, mode),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_cops_t, format),
+    FIVEG_FIELD(FIVEG_FIELD_STR, fiveg_cops_t, oper),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_cops_t, act),
+};
+
+static constexpr struct fiveg_at_field fiveg_cgact_fields[] = {
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_pdp_context_t, cid),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_pdp_context_t, state),
+};
+
+// Ответ на запрос регистрации начинается с <n>, URC - сразу с <stat>
+static constexpr struct fiveg_at_field fiveg_reg_read_fields[] = {
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_reg_t, n),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_reg_t, stat),
+    FIVEG_FIELD(FIVEG_FIELD_HEX, fiveg_reg_t, tac),
+    FIVEG_FIELD(FIVEG_FIELD_HEX, fiveg_reg_t, ci),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_reg_t, act),
+};
+
+static constexpr struct fiveg_at_field fiveg_reg_urc_fields[] = {
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_reg_t, stat),
+    FIVEG_FIELD(FIVEG_FIELD_HEX, fiveg_reg_t, tac),
+    FIVEG_FIELD(FIVEG_FIELD_HEX, fiveg_reg_t, ci),
+    FIVEG_FIELD(FIVEG_FIELD_INT, fiveg_reg_t, act),
+};
+
+static constexpr struct fiveg_at_schema fiveg_csq_schema = FIVEG_SCHEMA("+CSQ", 2, fiveg_csq_fields);
+static constexpr struct fiveg_at_schema fiveg_cops_schema = FIVEG_SCHEMA("+COPS", 1, fiveg_cops_fields);
+static constexpr struct fiveg_at_schema fiveg_cgact_schema = FIVEG_SCHEMA("+CGACT", 2, fiveg_cgact_fields);
+
+// Разбор числа; конец поля - запятая или конец строки
+static inline const char* fiveg_at_parse_int(const char* p, const char* end, int64_t* value) {
+    int negative = 0;
+    int64_t result = 0;
+    const char* start;
+
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    start = p;
+    while (p < end && (unsigned char)(*p - '0') < 10) {
+        if (result < INT32_MAX) {
+            result = result * 10 + (*p - '0');
+        }
+        p++;
+    }
+    if (p == start) {
+        return NULL;
+    }
+    *value = negative ? -result : result;
+    return p;
+}
+
+static inline const char* fiveg_at_parse_hex(const char* p, const char* end, int64_t* value) {
+    int quoted = p < end && *p == '"';
+    int64_t result = 0;
+    const char* start;
+
+    p += quoted;
+    start = p;
+    while (p < end && fiveg_at_chars.hex[(unsigned char)*p] != 0xff) {
+        if (p - start < 15) {
+            result = (result << 4) | fiveg_at_chars.hex[(unsigned char)*p];
+        }
+        p++;
+    }
+    if (p == start) {
+        return NULL;
+    }
+    if (quoted) {
+        if (p == end || *p != '"') {
+            return NULL;
+        }
+        p++;
+    }
+    *value = result;
+    return p;
+}
+
+// Строка копируется с обрезкой до size - 1 байт
+static inline const char* fiveg_at_parse_str(const char* p, const char* end, char* out, size_t size) {
+    const char* start;
+    const char* stop;
+
+    if (p < end && *p == '"') {
+        start = ++p;
+        while (p < end && *p != '"') {
+            p++;
+        }
+        if (p == end) {
+            return NULL;
+        }
+        stop = p++;
+    } else {
+        start = p;
+        while (p < end && *p != ',') {
+            p++;
+        }
+        stop = p;
+    }
+
+    size_t len = stop - start;
+    if (len > size - 1) {
+        len = size - 1;
+    }
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return p;
+}
+
+// Значения по умолчанию для полей, которых нет в строке
+static inline void fiveg_at_clear_fields(const struct fiveg_at_schema* schema, void* out) {
+    for (int i = 0; i < schema->field_count; i++) {
+        const struct fiveg_at_field* field = &schema->fields[i];
+        char* dst = (char*)out + field->offset;
+        if (field->type == FIVEG_FIELD_STR) {
+            dst[0] = '\0';
+        } else if (field->size == sizeof(int64_t)) {
+            int64_t none = -1;
+            memcpy(dst, &none, sizeof(none));
+        } else {
+            int32_t none = -1;
+            memcpy(dst, &none, sizeof(none));
+        }
+    }
+}
+
+// Разбор аргументов строки (после "<префикс>: ") по таблице полей.
+// Пустое поле (",,") пропускается и остаётся со значением по умолчанию.
+static inline int fiveg_at_parse_fields(const char* p, const char* end, const struct fiveg_at_schema* schema,
+                                        void* out) {
+    int parsed = 0;
+
+    fiveg_at_clear_fields(schema, out);
+    for (int i = 0; i < schema->field_count && p < end; i++) {
+        const struct fiveg_at_field* field = &schema->fields[i];
+        char* dst = (char*)out + field->offset;
+
+        if (*p != ',') {
+            int64_t value = 0;
+            const char* next;
+            if (field->type == FIVEG_FIELD_STR) {
+                next = fiveg_at_parse_str(p, end, dst, field->size);
+            } else if (field->type == FIVEG_FIELD_HEX) {
+                next = fiveg_at_parse_hex(p, end, &value);
+            } else {
+                next = fiveg_at_parse_int(p, end, &value);
+            }
+            if (!next) {
+                return -1;
+            }
+            if (field->type != FIVEG_FIELD_STR) {
+                if (field->size == sizeof(int64_t)) {
+                    memcpy(dst, &value, sizeof(value));
+                } else {
+                    int32_t narrow = (int32_t)value;
+                    memcpy(dst, &narrow, sizeof(narrow));
+                }
+            }
+            p = next;
+        }
+        parsed++;
+
+        if (p < end) {
+            if (*p != ',') {
+                return -1;
+            }
+            p++;
+        }
+    }
+    return parsed >= schema->required ? 0 : -1;
+}
+
+// Поиск следующей строки ответа с префиксом; возвращает начало
+// аргументов, *line_end - конец строки, *next - начало следующей строки
+static inline const char* fiveg_at_find_line(const char* text, const char* prefix, size_t prefix_len,
+                                             const char** line_end) {
+    const char* p = text;
+    while (*p) {
+        const char* end = strchr(p, '\n');
+        if (!end) {
+            end = p + strlen(p);
+        }
+        // Перевод строки в ответе может быть и "\r\n"
+        const char* stop = end;
+        while (stop > p && (stop[-1] == '\r' || stop[-1] == ' ')) {
+            stop--;
+        }
+        if ((size_t)(stop - p) > prefix_len && memcmp(p, prefix, prefix_len) == 0 && p[prefix_len] == ':') {
+            const char* args = p + prefix_len + 1;
+            while (args < stop && *args == ' ') {
+                args++;
+            }
+            *line_end = stop;
+            return args;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return NULL;
+}
+
+static inline int fiveg_at_parse(const char* response, const struct fiveg_at_schema* schema, void* out) {
+    const char* end;
+    const char* args = fiveg_at_find_line(response, schema->prefix, schema->prefix_len, &end);
+    if (!args) {
+        return -1;
+    }
+    return fiveg_at_parse_fields(args, end, schema, out);
+}
+
+static inline int fiveg_parse_csq(const char* response, fiveg_csq_t* out) {
+    return fiveg_at_parse(response, &fiveg_csq_schema, out);
+}
+
+static inline int fiveg_parse_cops(const char* response, fiveg_cops_t* out) {
+    return fiveg_at_parse(response, &fiveg_cops_schema, out);
+}
+
+// Все строки +CGACT ответа, не больше FIVEG_MAX_CONTEXTS
+static inline int fiveg_parse_cgact(const char* response, fiveg_cgact_t* out) {
+    const char* p = response;
+    const char* end;
+    const char* args;
+
+    out->count = 0;
+    while (out->count < FIVEG_MAX_CONTEXTS &&
+           (args = fiveg_at_find_line(p, fiveg_cgact_schema.prefix, fiveg_cgact_schema.prefix_len, &end)) != NULL) {
+        if (fiveg_at_parse_fields(args, end, &fiveg_cgact_schema, &out->contexts[out->count]) < 0) {
+            return -1;
+        }
+        out->count++;
+        p = end;
+    }
+    return 0;
+}
+
+// Регистрация в сети; prefix - "+CREG", "+CGREG", "+CEREG" или "+C5GREG".
+// Форма строки определяется по второму полю: в ответе на запрос это
+// <stat> без кавычек, в URC - <tac> в кавычках (или поля нет вовсе).
+static inline int fiveg_parse_reg(const char* response, const char* prefix, fiveg_reg_t* out) {
+    static constexpr struct fiveg_at_schema read_schema = FIVEG_SCHEMA("", 2, fiveg_reg_read_fields);
+    static constexpr struct fiveg_at_schema urc_schema = FIVEG_SCHEMA("", 1, fiveg_reg_urc_fields);
+    const char* end;
+    const char* args = fiveg_at_find_line(response, prefix, strlen(prefix), &end);
+    if (!args) {
+        return -1;
+    }
+
+    const char* comma = (const char*)memchr(args, ',', end - args);
+    int read_form = comma && comma + 1 < end && comma[1] != '"';
+    if (read_form) {
+        return fiveg_at_parse_fields(args, end, &read_schema, out);
+    }
+    out->n = -1;
+    return fiveg_at_parse_fields(args, end, &urc_schema, out);
+}
+
+// Первая строка ответа без префикса: адрес IPv4 или IPv6
+static inline int fiveg_parse_cifsr(const char* response, fiveg_cifsr_t* out) {
+    const char* p = response;
+    while (*p == '\r' || *p == '\n' || *p == ' ') {
+        p++;
+    }
+    size_t len = strcspn(p, "\r\n ");
+    if (len == 0 || len >= FIVEG_ADDRESS_MAX) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (fiveg_at_chars.hex[(unsigned char)p[i]] == 0xff && p[i] != '.' && p[i] != ':') {
+            return -1;
+        }
+    }
+    memcpy(out->address, p, len);
+    out->address[len] = '\0';
+
+    // Четыре десятичных октета через точку
+    const char* end = p + len;
+    out->is_ipv4 = 1;
+    for (int i = 0; i < 4; i++) {
+        int64_t octet;
+        const char* next = fiveg_at_parse_int(p, end, &octet);
+        if (!next || octet < 0 || octet > 255 || (i < 3 && (next == end || *next != '.')) ||
+            (i == 3 && next != end)) {
+            out->is_ipv4 = 0;
+            break;
+        }
+        out->ipv4[i] = (uint8_t)octet;
+        p = next + 1;
+    }
+    if (!out->is_ipv4) {
+        memset(out->ipv4, 0, sizeof(out->ipv4));
+    }
+    return 0;
+}
+
+// IMEI/IMSI: первая строка из одних цифр (некоторые модемы добавляют
+// префикс "+CGSN: ", он пропускается)
+static inline int fiveg_parse_id(const char* response, fiveg_id_t* out) {
+    const char* p = response;
+    while (*p) {
+        const char* start = p;
+        if (*p == '+') {
+            const char* colon = strchr(p, ':');
+            const char* eol = strchr(p, '\n');
+            if (colon && (!eol || colon < eol)) {
+                p = colon + 1;
+                while (*p == ' ' || *p == '"') {
+                    p++;
+                }
+            }
+        }
+        size_t len = 0;
+        while ((unsigned char)(p[len] - '0') < 10) {
+            len++;
+        }
+        if (len >= 6 && len < sizeof(out->digits)) {
+            memcpy(out->digits, p, len);
+            out->digits[len] = '\0';
+            return 0;
+        }
+        p = strchr(start, '\n');
+        if (!p) {
+            break;
+        }
+        p++;
+    }
+    return -1;
+}
+
+#endif // _5G_PARSE_H_
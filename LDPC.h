@@ -0,0 +1,995 @@
+#ifndef _LDPC_H_
+#define _LDPC_H_
+
+// Канальный кодек LDPC 5G NR (TS 38.212, 5.3.2 и 5.4.2): базовые графы
+// BG1 и BG2, все 51 размер подъёма Zc, выбор графа и Zc, кодер,
+// согласование скорости (выбор бит по версии избыточности и перемежение
+// по модуляции) и обратная операция для мягких бит, послойный декодер
+// min-sum со смещением и ранним остановом по синдрому.
+//
+// Таблица сдвигов BG2 (Table 5.3.2-3) встроена и ставится при первом
+// ldpc_code_init. BG1 (Table 5.3.2-2) загружается из файла спецификации
+// (ldpc_load_base_graph) или передаётся массивом (ldpc_base_graph_set);
+// так же можно заменить и встроенную BG2. Формат - строка таблицы на
+// строку: "i j V0 V1 ... V7", где i - строка, j - столбец графа, V -
+// сдвиги для iLS 0..7. Сверка файла со встроенной таблицей: ldpcbench -V.
+//
+// Биты кодера хранятся по одному в байте (0/1). Мягкие биты - int8,
+// положительное значение - бит 0; смещение min-sum по умолчанию подобрано
+// для LLR, умноженных на 4 перед округлением. Проверочные узлы слоя обрабатываются
+// сразу для всех Zc строк подъёма: на x86 с AVX2 по 32 строки за
+// инструкцию, на ARM с NEON по 16, иначе - скалярно. Ядро выбирается
+// при сборке; у декодера его можно заменить (check_node), например на
+// скалярное для сверки.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) && !defined(LDPC_SCALAR)
+#include <immintrin.h>
+#define LDPC_KERNEL_AVX2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(LDPC_SCALAR)
+#include <arm_neon.h>
+#define LDPC_KERNEL_NEON
+#endif
+
+// LDPC_BUILD_NEON - собрать ядро NEON, не выбирая его для декодера
+// (проверка на другой архитектуре с заменой интринсиков, см. ldpcbench)
+#if defined(LDPC_KERNEL_NEON) || defined(LDPC_BUILD_NEON)
+#define LDPC_HAVE_NEON_KERNEL
+#endif
+
+#define LDPC_BG1 1
+#define LDPC_BG2 2
+
+#define LDPC_ZMAX 384
+#define LDPC_ILS_COUNT 8
+#define LDPC_MAX_ROWS 46
+#define LDPC_MAX_COLS 68
+#define LDPC_MAX_EDGES 320     // в BG1 316 ненулевых элементов, в BG2 197
+#define LDPC_MAX_DEGREE 24     // наибольшая степень строки (в BG1 - 19)
+#define LDPC_CORE_ROWS 4       // строки с двухдиагональной частью ядра
+#define LDPC_ALIGN 32          // шаг блоков в буферах декодера кратен ему
+#define LDPC_LLR_MAX 127
+#define LDPC_MSG_MAX 63        // предел модуля сообщения проверки, см. ниже
+
+#define LDPC_DEFAULT_ITERATIONS 8
+#define LDPC_DEFAULT_OFFSET 1
+
+// Базовый граф в виде списка ненулевых элементов по строкам
+struct ldpc_base_graph {
+    int id;                                    // LDPC_BG1/LDPC_BG2, 0 - не загружен
+    int rows;
+    int cols;
+    int kb;                                    // информационные столбцы: 22 или 10
+    int edge_count;
+    uint16_t row_start[LDPC_MAX_ROWS + 1];
+    uint8_t col[LDPC_MAX_EDGES];
+    uint16_t shift[LDPC_MAX_EDGES][LDPC_ILS_COUNT];
+};
+
+static struct ldpc_base_graph ldpc_base_graphs[2];
+
+// Наборы размеров подъёма (Table 5.3.2-1), строка - индекс iLS
+static const uint16_t ldpc_lifting_sets[LDPC_ILS_COUNT][8] = {
+    {2, 4, 8, 16, 32, 64, 128, 256},
+    {3, 6, 12, 24, 48, 96, 192, 384},
+    {5, 10, 20, 40, 80, 160, 320},
+    {7, 14, 28, 56, 112, 224},
+    {9, 18, 36, 72, 144, 288},
+    {11, 22, 44, 88, 176, 352},
+    {13, 26, 52, 104, 208},
+    {15, 30, 60, 120, 240},
+};
+
+// Начальные позиции версий избыточности (Table 5.4.2.1-2): k0 =
+// floor(num * Ncb / (den * Zc)) * Zc
+static const uint8_t ldpc_rv_num[2][4] = {{0, 17, 33, 56}, {0, 13, 25, 43}};
+static const uint8_t ldpc_rv_den[2] = {66, 50};
+
+// Ребро из таблицы: i, j и сдвиги для iLS 0..7
+typedef int16_t ldpc_table_entry_t[2 + LDPC_ILS_COUNT];
+
+// Установка базового графа из таблицы спецификации. Элементы должны идти
+// по возрастанию строки, внутри строки - по возрастанию столбца; строка
+// i >= 4 обязана содержать свой столбец расширения kb + i.
+static inline int ldpc_base_graph_set(int bg, const ldpc_table_entry_t* entries, int count) {
+    if ((bg != LDPC_BG1 && bg != LDPC_BG2) || count <= 0 || count > LDPC_MAX_EDGES) {
+        return -1;
+    }
+    struct ldpc_base_graph graph;
+    memset(&graph, 0, sizeof(graph));
+    graph.rows = bg == LDPC_BG1 ? 46 : 42;
+    graph.cols = bg == LDPC_BG1 ? 68 : 52;
+    graph.kb = bg == LDPC_BG1 ? 22 : 10;
+
+    int row = 0;
+    bool has_extension = false;
+    for (int e = 0; e < count; e++) {
+        int i = entries[e][0];
+        int j = entries[e][1];
+        if (i < row || i >= graph.rows || j < 0 || j >= graph.cols) {
+            return -1;
+        }
+        for (; row < i; row++) {
+            if (graph.row_start[row] == e || (row >= LDPC_CORE_ROWS && !has_extension)) {
+                return -1;
+            }
+            graph.row_start[row + 1] = e;
+            has_extension = false;
+        }
+        if (e > graph.row_start[row] && j <= graph.col[e - 1]) {
+            return -1;
+        }
+        if (e - graph.row_start[row] >= LDPC_MAX_DEGREE) {
+            return -1;
+        }
+        // В строках ядра - только информационные столбцы и столбцы ядра,
+        // в строке расширения - ровно один свой проверочный столбец
+        if (j >= graph.kb + LDPC_CORE_ROWS) {
+            if (j != graph.kb + i) {
+                return -1;
+            }
+            has_extension = true;
+        }
+        graph.col[e] = (uint8_t)j;
+        for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+            if (entries[e][2 + ils] < 0) {
+                return -1;
+            }
+            graph.shift[e][ils] = (uint16_t)entries[e][2 + ils];
+        }
+    }
+    if (row != graph.rows - 1 || (row >= LDPC_CORE_ROWS && !has_extension)) {
+        return -1;
+    }
+    graph.row_start[graph.rows] = count;
+    graph.edge_count = count;
+    graph.id = bg;
+    ldpc_base_graphs[bg - 1] = graph;
+    return 0;
+}
+
+// Table 5.3.2-3: базовый граф BG2
+static const ldpc_table_entry_t ldpc_bg2_table[] = {
+    {0, 0, 9, 174, 0, 72, 3, 156, 143, 145},
+    {0, 1, 117, 97, 0, 110, 26, 143, 19, 131},
+    {0, 2, 204, 166, 0, 23, 53, 14, 176, 71},
+    {0, 3, 26, 66, 0, 181, 35, 3, 165, 21},
+    {0, 6, 189, 71, 0, 95, 115, 40, 196, 23},
+    {0, 9, 205, 172, 0, 8, 127, 123, 13, 112},
+    {0, 10, 0, 0, 0, 1, 0, 0, 0, 1},
+    {0, 11, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 0, 167, 27, 137, 53, 19, 17, 18, 142},
+    {1, 3, 166, 36, 124, 156, 94, 65, 27, 174},
+    {1, 4, 253, 48, 0, 115, 104, 63, 3, 183},
+    {1, 5, 125, 92, 0, 156, 66, 1, 102, 27},
+    {1, 6, 226, 31, 88, 115, 84, 55, 185, 96},
+    {1, 7, 156, 187, 0, 200, 98, 37, 17, 23},
+    {1, 8, 224, 185, 0, 29, 69, 171, 14, 9},
+    {1, 9, 252, 3, 55, 31, 50, 133, 180, 167},
+    {1, 11, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 12, 0, 0, 0, 0, 0, 0, 0, 0},
+    {2, 0, 81, 25, 20, 152, 95, 98, 126, 74},
+    {2, 1, 114, 114, 94, 131, 106, 168, 163, 31},
+    {2, 3, 44, 117, 99, 46, 92, 107, 47, 3},
+    {2, 4, 52, 110, 9, 191, 110, 82, 183, 53},
+    {2, 8, 240, 114, 108, 91, 111, 142, 132, 155},
+    {2, 10, 1, 1, 1, 0, 1, 1, 1, 0},
+    {2, 12, 0, 0, 0, 0, 0, 0, 0, 0},
+    {2, 13, 0, 0, 0, 0, 0, 0, 0, 0},
+    {3, 1, 8, 136, 38, 185, 120, 53, 36, 239},
+    {3, 2, 58, 175, 15, 6, 121, 174, 48, 171},
+    {3, 4, 158, 113, 102, 36, 22, 174, 18, 95},
+    {3, 5, 104, 72, 146, 124, 4, 127, 111, 110},
+    {3, 6, 209, 123, 12, 124, 73, 17, 203, 159},
+    {3, 7, 54, 118, 57, 110, 49, 89, 3, 199},
+    {3, 8, 18, 28, 53, 156, 128, 17, 191, 43},
+    {3, 9, 128, 186, 46, 133, 79, 105, 160, 75},
+    {3, 10, 0, 0, 0, 1, 0, 0, 0, 1},
+    {3, 13, 0, 0, 0, 0, 0, 0, 0, 0},
+    {4, 0, 179, 72, 0, 200, 42, 86, 43, 29},
+    {4, 1, 214, 74, 136, 16, 24, 67, 27, 140},
+    {4, 11, 71, 29, 157, 101, 51, 83, 117, 180},
+    {4, 14, 0, 0, 0, 0, 0, 0, 0, 0},
+    {5, 0, 231, 10, 0, 185, 40, 79, 136, 121},
+    {5, 1, 41, 44, 131, 138, 140, 84, 49, 41},
+    {5, 5, 194, 121, 142, 170, 84, 35, 36, 169},
+    {5, 7, 159, 80, 141, 219, 137, 103, 132, 88},
+    {5, 11, 103, 48, 64, 193, 71, 60, 62, 207},
+    {5, 15, 0, 0, 0, 0, 0, 0, 0, 0},
+    {6, 0, 155, 129, 0, 123, 109, 47, 7, 137},
+    {6, 5, 228, 92, 124, 55, 87, 154, 34, 72},
+    {6, 7, 45, 100, 99, 31, 107, 10, 198, 172},
+    {6, 9, 28, 49, 45, 222, 133, 155, 168, 124},
+    {6, 11, 158, 184, 148, 209, 139, 29, 12, 56},
+    {6, 16, 0, 0, 0, 0, 0, 0, 0, 0},
+    {7, 1, 129, 80, 0, 103, 97, 48, 163, 86},
+    {7, 5, 147, 186, 45, 13, 135, 125, 78, 186},
+    {7, 7, 140, 16, 148, 105, 35, 24, 143, 87},
+    {7, 11, 3, 102, 96, 150, 108, 47, 107, 172},
+    {7, 13, 116, 143, 78, 181, 65, 55, 58, 154},
+    {7, 17, 0, 0, 0, 0, 0, 0, 0, 0},
+    {8, 0, 142, 118, 0, 147, 70, 53, 101, 176},
+    {8, 1, 94, 70, 65, 43, 69, 31, 177, 169},
+    {8, 12, 230, 152, 87, 152, 88, 161, 22, 225},
+    {8, 18, 0, 0, 0, 0, 0, 0, 0, 0},
+    {9, 1, 203, 28, 0, 2, 97, 104, 186, 167},
+    {9, 8, 205, 132, 97, 30, 40, 142, 27, 238},
+    {9, 10, 61, 185, 51, 184, 24, 99, 205, 48},
+    {9, 11, 247, 178, 85, 83, 49, 64, 81, 68},
+    {9, 19, 0, 0, 0, 0, 0, 0, 0, 0},
+    {10, 0, 11, 59, 0, 174, 46, 111, 125, 38},
+    {10, 1, 185, 104, 17, 150, 41, 25, 60, 217},
+    {10, 6, 0, 22, 156, 8, 101, 174, 177, 208},
+    {10, 7, 117, 52, 20, 56, 96, 23, 51, 232},
+    {10, 20, 0, 0, 0, 0, 0, 0, 0, 0},
+    {11, 0, 11, 32, 0, 99, 28, 91, 39, 178},
+    {11, 7, 236, 92, 7, 138, 30, 175, 29, 214},
+    {11, 9, 210, 174, 4, 110, 116, 24, 35, 168},
+    {11, 13, 56, 154, 2, 99, 64, 141, 8, 51},
+    {11, 21, 0, 0, 0, 0, 0, 0, 0, 0},
+    {12, 1, 63, 39, 0, 46, 33, 122, 18, 124},
+    {12, 3, 111, 93, 113, 217, 122, 11, 155, 122},
+    {12, 11, 14, 11, 48, 109, 131, 4, 49, 72},
+    {12, 22, 0, 0, 0, 0, 0, 0, 0, 0},
+    {13, 0, 83, 49, 0, 37, 76, 29, 32, 48},
+    {13, 1, 2, 125, 112, 113, 37, 91, 53, 57},
+    {13, 8, 38, 35, 102, 143, 62, 27, 95, 167},
+    {13, 13, 222, 166, 26, 140, 47, 127, 186, 219},
+    {13, 23, 0, 0, 0, 0, 0, 0, 0, 0},
+    {14, 1, 115, 19, 0, 36, 143, 11, 91, 82},
+    {14, 6, 145, 118, 138, 95, 51, 145, 20, 232},
+    {14, 11, 3, 21, 57, 40, 130, 8, 52, 204},
+    {14, 13, 232, 163, 27, 116, 97, 166, 109, 162},
+    {14, 24, 0, 0, 0, 0, 0, 0, 0, 0},
+    {15, 0, 51, 68, 0, 116, 139, 137, 174, 38},
+    {15, 10, 175, 63, 73, 200, 96, 103, 108, 217},
+    {15, 11, 213, 81, 99, 110, 128, 40, 102, 157},
+    {15, 25, 0, 0, 0, 0, 0, 0, 0, 0},
+    {16, 1, 203, 87, 0, 75, 48, 78, 125, 170},
+    {16, 9, 142, 177, 79, 158, 9, 158, 31, 23},
+    {16, 11, 8, 135, 111, 134, 28, 17, 54, 175},
+    {16, 12, 242, 64, 143, 97, 8, 165, 176, 202},
+    {16, 26, 0, 0, 0, 0, 0, 0, 0, 0},
+    {17, 1, 254, 158, 0, 48, 120, 134, 57, 196},
+    {17, 5, 124, 23, 24, 132, 43, 23, 201, 173},
+    {17, 11, 114, 9, 109, 206, 65, 62, 142, 195},
+    {17, 12, 64, 6, 18, 2, 42, 163, 35, 218},
+    {17, 27, 0, 0, 0, 0, 0, 0, 0, 0},
+    {18, 0, 220, 186, 0, 68, 17, 173, 129, 128},
+    {18, 6, 194, 6, 18, 16, 106, 31, 203, 211},
+    {18, 7, 50, 46, 86, 156, 142, 22, 140, 210},
+    {18, 28, 0, 0, 0, 0, 0, 0, 0, 0},
+    {19, 0, 87, 58, 0, 35, 79, 13, 110, 39},
+    {19, 1, 20, 42, 158, 138, 28, 135, 124, 84},
+    {19, 10, 185, 156, 154, 86, 41, 145, 52, 88},
+    {19, 29, 0, 0, 0, 0, 0, 0, 0, 0},
+    {20, 1, 26, 76, 0, 6, 2, 128, 196, 117},
+    {20, 4, 105, 61, 148, 20, 103, 52, 35, 227},
+    {20, 11, 29, 153, 104, 141, 78, 173, 114, 6},
+    {20, 30, 0, 0, 0, 0, 0, 0, 0, 0},
+    {21, 0, 76, 157, 0, 80, 91, 156, 10, 238},
+    {21, 8, 42, 175, 17, 43, 75, 166, 122, 13},
+    {21, 13, 210, 67, 33, 81, 81, 40, 23, 11},
+    {21, 31, 0, 0, 0, 0, 0, 0, 0, 0},
+    {22, 1, 222, 20, 0, 49, 54, 18, 202, 195},
+    {22, 2, 63, 52, 4, 1, 132, 163, 126, 44},
+    {22, 32, 0, 0, 0, 0, 0, 0, 0, 0},
+    {23, 0, 23, 106, 0, 156, 68, 110, 52, 5},
+    {23, 3, 235, 86, 75, 54, 115, 132, 170, 94},
+    {23, 5, 238, 95, 158, 134, 56, 150, 13, 111},
+    {23, 33, 0, 0, 0, 0, 0, 0, 0, 0},
+    {24, 1, 46, 182, 0, 153, 30, 113, 113, 81},
+    {24, 2, 139, 153, 69, 88, 42, 108, 161, 19},
+    {24, 9, 8, 64, 87, 63, 101, 61, 88, 130},
+    {24, 34, 0, 0, 0, 0, 0, 0, 0, 0},
+    {25, 0, 228, 45, 0, 211, 128, 72, 197, 66},
+    {25, 5, 156, 21, 65, 94, 63, 136, 194, 95},
+    {25, 35, 0, 0, 0, 0, 0, 0, 0, 0},
+    {26, 2, 29, 67, 0, 90, 142, 36, 164, 146},
+    {26, 7, 143, 137, 100, 6, 28, 38, 172, 66},
+    {26, 12, 160, 55, 13, 221, 100, 53, 49, 190},
+    {26, 13, 122, 85, 7, 6, 133, 145, 161, 86},
+    {26, 36, 0, 0, 0, 0, 0, 0, 0, 0},
+    {27, 0, 8, 103, 0, 27, 13, 42, 168, 64},
+    {27, 6, 151, 50, 32, 118, 10, 104, 193, 181},
+    {27, 37, 0, 0, 0, 0, 0, 0, 0, 0},
+    {28, 1, 98, 70, 0, 216, 106, 64, 14, 7},
+    {28, 2, 101, 111, 126, 212, 77, 24, 186, 144},
+    {28, 5, 135, 168, 110, 193, 43, 149, 46, 16},
+    {28, 38, 0, 0, 0, 0, 0, 0, 0, 0},
+    {29, 0, 18, 110, 0, 108, 133, 139, 50, 25},
+    {29, 4, 28, 17, 154, 61, 25, 161, 27, 57},
+    {29, 39, 0, 0, 0, 0, 0, 0, 0, 0},
+    {30, 2, 71, 120, 0, 106, 87, 84, 70, 37},
+    {30, 5, 240, 154, 35, 44, 56, 173, 17, 139},
+    {30, 7, 9, 52, 51, 185, 104, 93, 50, 221},
+    {30, 9, 84, 56, 134, 176, 70, 29, 6, 17},
+    {30, 40, 0, 0, 0, 0, 0, 0, 0, 0},
+    {31, 1, 106, 3, 0, 147, 80, 117, 115, 201},
+    {31, 13, 1, 170, 20, 182, 139, 148, 189, 46},
+    {31, 41, 0, 0, 0, 0, 0, 0, 0, 0},
+    {32, 0, 242, 84, 0, 108, 32, 116, 110, 179},
+    {32, 5, 44, 8, 20, 21, 89, 73, 0, 14},
+    {32, 12, 166, 17, 122, 110, 71, 142, 163, 116},
+    {32, 42, 0, 0, 0, 0, 0, 0, 0, 0},
+    {33, 2, 132, 165, 0, 71, 135, 105, 163, 46},
+    {33, 7, 164, 179, 88, 12, 6, 137, 173, 2},
+    {33, 10, 235, 124, 13, 109, 2, 29, 179, 106},
+    {33, 43, 0, 0, 0, 0, 0, 0, 0, 0},
+    {34, 0, 147, 173, 0, 29, 37, 11, 197, 184},
+    {34, 12, 85, 177, 19, 201, 25, 41, 191, 135},
+    {34, 13, 36, 12, 78, 69, 114, 162, 193, 141},
+    {34, 44, 0, 0, 0, 0, 0, 0, 0, 0},
+    {35, 1, 57, 77, 0, 91, 60, 126, 157, 85},
+    {35, 5, 40, 184, 157, 165, 137, 152, 167, 225},
+    {35, 11, 63, 18, 6, 55, 93, 172, 181, 175},
+    {35, 45, 0, 0, 0, 0, 0, 0, 0, 0},
+    {36, 0, 140, 25, 0, 1, 121, 73, 197, 178},
+    {36, 2, 38, 151, 63, 175, 129, 154, 167, 112},
+    {36, 7, 154, 170, 82, 83, 26, 129, 179, 106},
+    {36, 46, 0, 0, 0, 0, 0, 0, 0, 0},
+    {37, 10, 219, 37, 0, 40, 97, 167, 181, 154},
+    {37, 13, 151, 31, 144, 12, 56, 38, 193, 114},
+    {37, 47, 0, 0, 0, 0, 0, 0, 0, 0},
+    {38, 1, 31, 84, 0, 37, 1, 112, 157, 42},
+    {38, 5, 66, 151, 93, 97, 70, 7, 173, 41},
+    {38, 11, 38, 190, 19, 46, 1, 19, 191, 105},
+    {38, 48, 0, 0, 0, 0, 0, 0, 0, 0},
+    {39, 0, 239, 93, 0, 106, 119, 109, 181, 167},
+    {39, 7, 172, 132, 24, 181, 32, 6, 157, 45},
+    {39, 12, 34, 57, 138, 154, 142, 105, 173, 189},
+    {39, 49, 0, 0, 0, 0, 0, 0, 0, 0},
+    {40, 2, 0, 103, 0, 98, 6, 160, 193, 78},
+    {40, 10, 75, 107, 36, 35, 73, 156, 163, 67},
+    {40, 13, 120, 163, 143, 36, 102, 82, 179, 180},
+    {40, 50, 0, 0, 0, 0, 0, 0, 0, 0},
+    {41, 1, 129, 147, 0, 120, 48, 132, 191, 53},
+    {41, 5, 229, 7, 2, 101, 47, 6, 197, 215},
+    {41, 11, 118, 60, 55, 81, 19, 8, 167, 230},
+    {41, 51, 0, 0, 0, 0, 0, 0, 0, 0},
+};
+
+// Встроенные таблицы - в ldpc_base_graphs, если граф не был загружен
+// раньше. Вызывается из ldpc_code_init, один раз на процесс.
+static inline void ldpc_base_graph_builtin(void) {
+    static const bool done = [] {
+        if (ldpc_base_graphs[LDPC_BG2 - 1].id == 0) {
+            ldpc_base_graph_set(LDPC_BG2, ldpc_bg2_table, sizeof(ldpc_bg2_table) / sizeof(ldpc_bg2_table[0]));
+        }
+        return true;
+    }();
+    (void)done;
+}
+
+// Загрузка базового графа из текстовой таблицы; '#' - комментарий
+static inline int ldpc_load_base_graph(int bg, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    ldpc_table_entry_t entries[LDPC_MAX_EDGES];
+    int count = 0;
+    char line[256];
+    int result = 0;
+    while (fgets(line, sizeof(line), file)) {
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        int v[2 + LDPC_ILS_COUNT];
+        int fields = sscanf(line, "%d %d %d %d %d %d %d %d %d %d",
+                            &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]);
+        if (fields <= 0) {
+            continue;
+        }
+        if (fields != 2 + LDPC_ILS_COUNT || count == LDPC_MAX_EDGES) {
+            result = -1;
+            break;
+        }
+        for (int k = 0; k < 2 + LDPC_ILS_COUNT; k++) {
+            entries[count][k] = (int16_t)v[k];
+        }
+        count++;
+    }
+    fclose(file);
+    return result < 0 ? -1 : ldpc_base_graph_set(bg, entries, count);
+}
+
+// Индекс набора iLS для Zc, -1 - такого размера подъёма нет
+static inline int ldpc_lifting_index(int z) {
+    for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+        for (int k = 0; k < 8 && ldpc_lifting_sets[ils][k]; k++) {
+            if (ldpc_lifting_sets[ils][k] == z) {
+                return ils;
+            }
+        }
+    }
+    return -1;
+}
+
+// Выбор базового графа по размеру транспортного блока A и скорости R (7.2.2)
+static inline int ldpc_select_base_graph(int a, double r) {
+    if (a <= 292 || (a <= 3824 && r <= 0.67) || r <= 0.25) {
+        return LDPC_BG2;
+    }
+    return LDPC_BG1;
+}
+
+// Наименьший Zc, при котором Kb * Zc >= K' (5.3.2); b - размер
+// транспортного блока с CRC, от него зависит Kb для BG2
+static inline int ldpc_select_lifting(int bg, int k_prime, int b) {
+    int kb = 22;
+    if (bg == LDPC_BG2) {
+        kb = b > 640 ? 10 : b > 560 ? 9 : b > 192 ? 8 : 6;
+    }
+    int best = 0;
+    for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+        for (int k = 0; k < 8 && ldpc_lifting_sets[ils][k]; k++) {
+            int z = ldpc_lifting_sets[ils][k];
+            if (kb * z >= k_prime && (best == 0 || z < best)) {
+                best = z;
+            }
+        }
+    }
+    return best;
+}
+
+// Шаг решения ядра: из строки row находится столбец col со сдвигом shift
+struct ldpc_core_step {
+    uint8_t row;
+    uint8_t col;
+    uint16_t shift;
+};
+
+// Параметры кодового блока: граф, Zc и сдвиги рёбер, приведённые по
+// модулю Zc, плюс порядок решения проверочных бит ядра
+typedef struct {
+    const struct ldpc_base_graph* graph;
+    int bg;
+    int z;
+    int ils;
+    int k;              // информационные биты с заполнителями: kb * Zc
+    int k_prime;        // K': биты блока с CRC, остальное до k - заполнители
+    int n;              // длина кодового слова с выколотыми 2Zc битами
+    int ncb;            // кольцевой буфер согласования скорости
+    int stride;         // шаг блоков Zc в буферах декодера
+    int first_col;      // первый проверочный столбец ядра: сумма строк ядра
+    uint16_t first_shift;
+    struct ldpc_core_step core[LDPC_CORE_ROWS - 1];
+    uint16_t shift[LDPC_MAX_EDGES];
+} ldpc_code_t;
+
+// Подготовка кодового блока: K' бит с CRC, b - размер транспортного
+// блока с CRC (для выбора Zc в BG2), ncb_limit - Nref при ограниченном
+// буфере (LBRM), 0 - без ограничения. BG1 должен быть загружен.
+static inline int ldpc_code_init(ldpc_code_t* code, int bg, int k_prime, int b, int ncb_limit = 0) {
+    if (bg != LDPC_BG1 && bg != LDPC_BG2) {
+        return -1;
+    }
+    ldpc_base_graph_builtin();
+    const struct ldpc_base_graph* graph = &ldpc_base_graphs[bg - 1];
+    int z = ldpc_select_lifting(bg, k_prime, b);
+    if (graph->id != bg || z == 0) {
+        return -1;
+    }
+
+    memset(code, 0, sizeof(*code));
+    code->graph = graph;
+    code->bg = bg;
+    code->z = z;
+    code->ils = ldpc_lifting_index(z);
+    code->k = graph->kb * z;
+    code->k_prime = k_prime;
+    code->n = graph->cols * z;
+    code->ncb = (graph->cols - 2) * z;
+    if (ncb_limit > 0 && ncb_limit < code->ncb) {
+        code->ncb = ncb_limit;
+    }
+    code->stride = (z + LDPC_ALIGN - 1) & ~(LDPC_ALIGN - 1);
+    for (int e = 0; e < graph->edge_count; e++) {
+        code->shift[e] = graph->shift[e][code->ils] % z;
+    }
+
+    // Сумма строк ядра: сдвиги каждого проверочного столбца сокращаются
+    // попарно, остаётся один столбец с одним сдвигом - он решается первым
+    int kb = graph->kb;
+    int first_col = -1;
+    for (int c = 0; c < LDPC_CORE_ROWS; c++) {
+        uint16_t shifts[LDPC_CORE_ROWS];
+        int count = 0;
+        for (int r = 0; r < LDPC_CORE_ROWS; r++) {
+            for (int e = graph->row_start[r]; e < graph->row_start[r + 1]; e++) {
+                if (graph->col[e] != kb + c) {
+                    continue;
+                }
+                int found = -1;
+                for (int k = 0; k < count; k++) {
+                    if (shifts[k] == code->shift[e]) {
+                        found = k;
+                    }
+                }
+                if (found >= 0) {
+                    shifts[found] = shifts[--count];
+                } else {
+                    shifts[count++] = code->shift[e];
+                }
+            }
+        }
+        if (count == 1) {
+            if (first_col >= 0) {
+                return -1;
+            }
+            first_col = c;
+            code->first_shift = shifts[0];
+        } else if (count != 0) {
+            return -1;
+        }
+    }
+    if (first_col < 0) {
+        return -1;
+    }
+    code->first_col = kb + first_col;
+
+    // Остальные столбцы ядра - по строкам, где неизвестен ровно один
+    bool known[LDPC_CORE_ROWS] = {false, false, false, false};
+    bool used[LDPC_CORE_ROWS] = {false, false, false, false};
+    known[first_col] = true;
+    for (int step = 0; step < LDPC_CORE_ROWS - 1; step++) {
+        bool progress = false;
+        for (int r = 0; r < LDPC_CORE_ROWS && !progress; r++) {
+            if (used[r]) {
+                continue;
+            }
+            int unknown = 0;
+            int edge = -1;
+            for (int e = graph->row_start[r]; e < graph->row_start[r + 1]; e++) {
+                int c = graph->col[e] - kb;
+                if (c >= 0 && !known[c]) {
+                    unknown++;
+                    edge = e;
+                }
+            }
+            if (unknown != 1) {
+                continue;
+            }
+            used[r] = true;
+            known[graph->col[edge] - kb] = true;
+            code->core[step].row = (uint8_t)r;
+            code->core[step].col = graph->col[edge];
+            code->core[step].shift = code->shift[edge];
+            progress = true;
+        }
+        if (!progress) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// dst ^= P^s src, где P^s - единичная матрица, циклически сдвинутая
+// вправо на s: dst[i] ^= src[(i + s) mod z]
+static inline void ldpc_rotate_xor(uint8_t* dst, const uint8_t* src, int z, int s) {
+    for (int i = 0; i < z - s; i++) {
+        dst[i] ^= src[i + s];
+    }
+    for (int i = z - s; i < z; i++) {
+        dst[i] ^= src[i - (z - s)];
+    }
+}
+
+// Решение P^s x = y: x = P^(z-s) y
+static inline void ldpc_rotate_solve(uint8_t* x, const uint8_t* y, int z, int s) {
+    memset(x, 0, z);
+    ldpc_rotate_xor(x, y, z, (z - s) % z);
+}
+
+// Кодирование K' бит info в codeword (n бит, по биту в байте). Биты
+// с K' до K - заполнители (нули). cols - сколько столбцов кодового слова
+// нужно (0 - все): проверочные биты расширения за ними не считаются.
+static inline void ldpc_encode(const ldpc_code_t* code, const uint8_t* info, uint8_t* codeword, int cols = 0) {
+    const struct ldpc_base_graph* graph = code->graph;
+    int z = code->z;
+    int kb = graph->kb;
+    int rows = graph->rows;
+    if (cols > 0 && cols - kb < rows) {
+        rows = cols - kb < LDPC_CORE_ROWS ? LDPC_CORE_ROWS : cols - kb;
+    }
+
+    memcpy(codeword, info, code->k_prime);
+    memset(codeword + code->k_prime, 0, (size_t)code->n - code->k_prime);
+
+    // Вклад информационной части в строки ядра
+    uint8_t lambda[LDPC_CORE_ROWS][LDPC_ZMAX];
+    uint8_t sum[LDPC_ZMAX];
+    memset(lambda, 0, sizeof(lambda));
+    memset(sum, 0, z);
+    for (int r = 0; r < LDPC_CORE_ROWS; r++) {
+        for (int e = graph->row_start[r]; e < graph->row_start[r + 1] && graph->col[e] < kb; e++) {
+            ldpc_rotate_xor(lambda[r], codeword + graph->col[e] * z, z, code->shift[e]);
+        }
+        for (int i = 0; i < z; i++) {
+            sum[i] ^= lambda[r][i];
+        }
+    }
+
+    ldpc_rotate_solve(codeword + code->first_col * z, sum, z, code->first_shift);
+    for (int step = 0; step < LDPC_CORE_ROWS - 1; step++) {
+        const struct ldpc_core_step* core = &code->core[step];
+        memcpy(sum, lambda[core->row], z);
+        for (int e = graph->row_start[core->row]; e < graph->row_start[core->row + 1]; e++) {
+            if (graph->col[e] >= kb && graph->col[e] != core->col) {
+                ldpc_rotate_xor(sum, codeword + graph->col[e] * z, z, code->shift[e]);
+            }
+        }
+        ldpc_rotate_solve(codeword + core->col * z, sum, z, core->shift);
+    }
+
+    // Строки расширения: свой проверочный столбец - сумма остальных
+    for (int r = LDPC_CORE_ROWS; r < rows; r++) {
+        int last = graph->row_start[r + 1] - 1;
+        memset(sum, 0, z);
+        for (int e = graph->row_start[r]; e < last; e++) {
+            ldpc_rotate_xor(sum, codeword + graph->col[e] * z, z, code->shift[e]);
+        }
+        ldpc_rotate_solve(codeword + graph->col[last] * z, sum, z, code->shift[last]);
+    }
+}
+
+static inline int ldpc_k0(const ldpc_code_t* code, int rv) {
+    int g = code->bg - 1;
+    return (int)((long long)ldpc_rv_num[g][rv & 3] * code->ncb / ((long long)ldpc_rv_den[g] * code->z)) * code->z;
+}
+
+// Обход кольцевого буфера согласования скорости (5.4.2.1) с пропуском
+// заполнителей и перемежением по модуляции (5.4.2.2): visit(pos, idx)
+// получает позицию бита в кодовом слове и в переданной последовательности
+template <typename Visit>
+static inline void ldpc_rate_walk(const ldpc_code_t* code, int rv, int e, int qm, Visit visit) {
+    int z = code->z;
+    int filler_begin = code->k_prime - 2 * z;
+    int filler_end = code->k - 2 * z;
+    int per_row = e / qm;
+    int row = 0;
+    int col = 0;
+    int pos = ldpc_k0(code, rv);
+    for (int k = 0; k < e;) {
+        if (pos < filler_begin || pos >= filler_end) {
+            visit(pos + 2 * z, row + col * qm);
+            k++;
+            if (++col == per_row) {
+                col = 0;
+                row++;
+            }
+        }
+        if (++pos == code->ncb) {
+            pos = 0;
+        }
+    }
+}
+
+// Число столбцов кодового слова, которые попадут в передачу версии rv
+// длиной E: кодеру не нужно считать строки расширения за этой границей
+static inline int ldpc_columns_needed(const ldpc_code_t* code, int rv, int e) {
+    int last = 0;
+    ldpc_rate_walk(code, rv, e, 1, [&](int pos, int) {
+        if (pos > last) {
+            last = pos;
+        }
+    });
+    return last / code->z + 1;
+}
+
+// Согласование скорости: E бит (E кратно qm) версии rv из codeword в out
+static inline void ldpc_rate_match(const ldpc_code_t* code, const uint8_t* codeword, int rv, int e, int qm, uint8_t* out) {
+    ldpc_rate_walk(code, rv, e, qm, [&](int pos, int idx) { out[idx] = codeword[pos]; });
+}
+
+static inline int8_t ldpc_sat_add(int8_t a, int8_t b) {
+    int sum = a + b;
+    return (int8_t)(sum > LDPC_LLR_MAX ? LDPC_LLR_MAX : sum < -LDPC_LLR_MAX ? -LDPC_LLR_MAX : sum);
+}
+
+// Обратное согласование: E мягких бит версии rv раскладываются по
+// позициям кодового слова llr (n значений). combine = false - буфер
+// начинается заново: выколотые и непереданные биты получают 0,
+// заполнители - уверенный 0; combine = true - мягкое сложение с прошлой
+// передачей (HARQ). Возвращает число затронутых столбцов.
+static inline int ldpc_rate_recover(const ldpc_code_t* code, const int8_t* in, int rv, int e, int qm,
+                                    int8_t* llr, bool combine = false) {
+    if (!combine) {
+        memset(llr, 0, code->n);
+        memset(llr + code->k_prime, LDPC_LLR_MAX, (size_t)code->k - code->k_prime);
+    }
+    int last = 0;
+    ldpc_rate_walk(code, rv, e, qm, [&](int pos, int idx) {
+        llr[pos] = ldpc_sat_add(llr[pos], in[idx]);
+        if (pos > last) {
+            last = pos;
+        }
+    });
+    return last / code->z + 1;
+}
+
+// --- Ядра проверочных узлов ---
+//
+// Слой - строка базового графа степени deg. tmp[e] - LLR столбца ребра e,
+// повёрнутые на его сдвиг, msg[e] - прошлое сообщение проверки этому
+// столбцу (шаг stride). Для каждой из lanes строк подъёма:
+// t = tmp - msg, новое сообщение - произведение знаков остальных рёбер
+// на второй или первый минимум модулей минус offset, tmp = t + msg.
+//
+// LLR столбцов насыщаются на LDPC_LLR_MAX, и после насыщения t = tmp - msg
+// меньше настоящего. Пока модуль сообщения не больше LDPC_MSG_MAX (меньше
+// половины LDPC_LLR_MAX), насыщенное значение не может сменить знак за
+// одно обновление; без этого предела уверенные биты (в том числе
+// заполнители) при сильном входе переворачивались.
+//
+// Ядро возвращает ненулевое значение, если после обновления проверка
+// слоя не выполняется или у какого-то столбца сменился знак. Итерация, за
+// которую все слои вернули 0, означает, что жёсткие решения не менялись
+// и удовлетворяют всем строкам: отдельный расчёт синдрома не нужен.
+
+// Переносимое ядро: строки подъёма идут группами по LDPC_ALIGN с
+// постоянной длиной внутреннего цикла, компилятор может его векторизовать
+static inline int ldpc_check_node_scalar(int8_t* tmp, int8_t* msg, int deg, int lanes, int stride, int offset) {
+    uint8_t changed = 0;
+    for (int base = 0; base < lanes; base += LDPC_ALIGN) {
+        int8_t min1[LDPC_ALIGN];
+        int8_t min2[LDPC_ALIGN];
+        uint8_t index[LDPC_ALIGN];
+        uint8_t sign[LDPC_ALIGN];
+        uint8_t parity[LDPC_ALIGN];
+
+        for (int i = 0; i < LDPC_ALIGN; i++) {
+            min1[i] = LDPC_MSG_MAX;
+            min2[i] = LDPC_MSG_MAX;
+            index[i] = 0;
+            sign[i] = 0;
+            parity[i] = 0;
+        }
+        for (int e = 0; e < deg; e++) {
+            const int8_t* cur = tmp + e * stride + base;
+            const int8_t* m = msg + e * stride + base;
+            for (int i = 0; i < LDPC_ALIGN; i++) {
+                int8_t t = ldpc_sat_add(cur[i], (int8_t)-m[i]);
+                int8_t a = (int8_t)(t < 0 ? -t : t);
+                int8_t high = a > min1[i] ? a : min1[i];
+                sign[i] ^= (uint8_t)t;
+                index[i] = a < min1[i] ? (uint8_t)e : index[i];
+                min2[i] = high < min2[i] ? high : min2[i];
+                min1[i] = a < min1[i] ? a : min1[i];
+            }
+        }
+        for (int i = 0; i < LDPC_ALIGN; i++) {
+            min1[i] = (int8_t)(min1[i] > offset ? min1[i] - offset : 0);
+            min2[i] = (int8_t)(min2[i] > offset ? min2[i] - offset : 0);
+        }
+        for (int e = 0; e < deg; e++) {
+            // Копии в локальных массивах: без них компилятор не знает,
+            // что tmp и msg не пересекаются, и не векторизует цикл
+            int8_t cur[LDPC_ALIGN];
+            int8_t m[LDPC_ALIGN];
+            memcpy(cur, tmp + e * stride + base, LDPC_ALIGN);
+            memcpy(m, msg + e * stride + base, LDPC_ALIGN);
+            for (int i = 0; i < LDPC_ALIGN; i++) {
+                int8_t t = ldpc_sat_add(cur[i], (int8_t)-m[i]);
+                int8_t mag = index[i] == e ? min2[i] : min1[i];
+                int8_t neg = (int8_t)(sign[i] ^ (uint8_t)t) >> 7;
+                int8_t r = (int8_t)((mag ^ neg) - neg);
+                int8_t v = ldpc_sat_add(t, r);
+                changed |= (uint8_t)(cur[i] ^ v);
+                parity[i] ^= (uint8_t)v;
+                m[i] = r;
+                cur[i] = v;
+            }
+            memcpy(tmp + e * stride + base, cur, LDPC_ALIGN);
+            memcpy(msg + e * stride + base, m, LDPC_ALIGN);
+        }
+        for (int i = 0; i < LDPC_ALIGN; i++) {
+            changed |= parity[i];
+        }
+    }
+    return changed >> 7;
+}
+
+#if defined(LDPC_KERNEL_AVX2)
+static inline int ldpc_check_node_avx2(int8_t* tmp, int8_t* msg, int deg, int lanes, int stride, int offset) {
+    const __m256i lo = _mm256_set1_epi8(-LDPC_LLR_MAX);
+    const __m256i hi = _mm256_set1_epi8(LDPC_MSG_MAX);
+    const __m256i off = _mm256_set1_epi8((char)offset);
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i changed = _mm256_setzero_si256();
+    for (int i = 0; i < lanes; i += 32) {
+        __m256i min1 = hi;
+        __m256i min2 = hi;
+        __m256i index = _mm256_setzero_si256();
+        __m256i sign = _mm256_setzero_si256();
+        for (int e = 0; e < deg; e++) {
+            __m256i cur = _mm256_load_si256((const __m256i*)(tmp + e * stride + i));
+            __m256i m = _mm256_load_si256((const __m256i*)(msg + e * stride + i));
+            __m256i t = _mm256_max_epi8(_mm256_subs_epi8(cur, m), lo);
+            __m256i a = _mm256_abs_epi8(t);
+            __m256i less = _mm256_cmpgt_epi8(min1, a);
+            sign = _mm256_xor_si256(sign, t);
+            min2 = _mm256_min_epi8(min2, _mm256_max_epi8(min1, a));
+            index = _mm256_blendv_epi8(index, _mm256_set1_epi8((char)e), less);
+            min1 = _mm256_min_epi8(min1, a);
+        }
+        min1 = _mm256_subs_epu8(min1, off);
+        min2 = _mm256_subs_epu8(min2, off);
+        __m256i parity = _mm256_setzero_si256();
+        for (int e = 0; e < deg; e++) {
+            __m256i* pcur = (__m256i*)(tmp + e * stride + i);
+            __m256i* pm = (__m256i*)(msg + e * stride + i);
+            __m256i cur = _mm256_load_si256(pcur);
+            __m256i t = _mm256_max_epi8(_mm256_subs_epi8(cur, _mm256_load_si256(pm)), lo);
+            __m256i mag = _mm256_blendv_epi8(min1, min2, _mm256_cmpeq_epi8(index, _mm256_set1_epi8((char)e)));
+            __m256i r = _mm256_sign_epi8(mag, _mm256_or_si256(_mm256_xor_si256(sign, t), one));
+            __m256i v = _mm256_max_epi8(_mm256_adds_epi8(t, r), lo);
+            changed = _mm256_or_si256(changed, _mm256_xor_si256(cur, v));
+            parity = _mm256_xor_si256(parity, v);
+            _mm256_store_si256(pm, r);
+            _mm256_store_si256(pcur, v);
+        }
+        changed = _mm256_or_si256(changed, parity);
+    }
+    return _mm256_movemask_epi8(changed) != 0;
+}
+#endif
+
+#if defined(LDPC_HAVE_NEON_KERNEL)
+static inline int ldpc_check_node_neon(int8_t* tmp, int8_t* msg, int deg, int lanes, int stride, int offset) {
+    const int8x16_t lo = vdupq_n_s8(-LDPC_LLR_MAX);
+    const int8x16_t zero = vdupq_n_s8(0);
+    const int8x16_t off = vdupq_n_s8((int8_t)offset);
+    int8x16_t changed = zero;
+    for (int i = 0; i < lanes; i += 16) {
+        int8x16_t min1 = vdupq_n_s8(LDPC_MSG_MAX);
+        int8x16_t min2 = min1;
+        uint8x16_t index = vdupq_n_u8(0);
+        int8x16_t sign = zero;
+        for (int e = 0; e < deg; e++) {
+            int8x16_t t = vmaxq_s8(vqsubq_s8(vld1q_s8(tmp + e * stride + i), vld1q_s8(msg + e * stride + i)), lo);
+            int8x16_t a = vabsq_s8(t);
+            uint8x16_t less = vcgtq_s8(min1, a);
+            sign = veorq_s8(sign, t);
+            min2 = vminq_s8(min2, vmaxq_s8(min1, a));
+            index = vbslq_u8(less, vdupq_n_u8((uint8_t)e), index);
+            min1 = vminq_s8(min1, a);
+        }
+        min1 = vmaxq_s8(vsubq_s8(min1, off), zero);
+        min2 = vmaxq_s8(vsubq_s8(min2, off), zero);
+        int8x16_t parity = zero;
+        for (int e = 0; e < deg; e++) {
+            int8_t* pcur = tmp + e * stride + i;
+            int8_t* pm = msg + e * stride + i;
+            int8x16_t cur = vld1q_s8(pcur);
+            int8x16_t t = vmaxq_s8(vqsubq_s8(cur, vld1q_s8(pm)), lo);
+            int8x16_t mag = vbslq_s8(vceqq_u8(index, vdupq_n_u8((uint8_t)e)), min2, min1);
+            int8x16_t r = vbslq_s8(vcltq_s8(veorq_s8(sign, t), zero), vnegq_s8(mag), mag);
+            int8x16_t v = vmaxq_s8(vqaddq_s8(t, r), lo);
+            changed = vorrq_s8(changed, veorq_s8(cur, v));
+            parity = veorq_s8(parity, v);
+            vst1q_s8(pm, r);
+            vst1q_s8(pcur, v);
+        }
+        changed = vorrq_s8(changed, parity);
+    }
+    uint64x2_t bits = vreinterpretq_u64_s8(changed);
+    return ((vgetq_lane_u64(bits, 0) | vgetq_lane_u64(bits, 1)) & 0x8080808080808080ull) != 0;
+}
+#endif
+
+typedef int (*ldpc_check_node_t)(int8_t* tmp, int8_t* msg, int deg, int lanes, int stride, int offset);
+
+// Ядро под текущую сборку. Декодер обрабатывает блок целиком вместе с
+// выравниванием за Zc (lanes = stride): там нули, на результат они не
+// влияют.
+#if defined(LDPC_KERNEL_AVX2)
+static const ldpc_check_node_t ldpc_check_node = ldpc_check_node_avx2;
+#elif defined(LDPC_KERNEL_NEON)
+static const ldpc_check_node_t ldpc_check_node = ldpc_check_node_neon;
+#else
+static const ldpc_check_node_t ldpc_check_node = ldpc_check_node_scalar;
+#endif
+
+// --- Декодер ---
+
+typedef struct {
+    int8_t* app;        // апостериорные LLR: блок stride на столбец
+    int8_t* msg;        // сообщения проверок: блок stride на ребро
+    int8_t* tmp;        // LLR столбцов текущего слоя, повёрнутые на сдвиг
+    int max_iterations;
+    int offset;         // смещение min-sum в единицах LLR
+    ldpc_check_node_t check_node;  // ядро проверочных узлов, по умолчанию ldpc_check_node
+} ldpc_decoder_t;
+
+static inline void ldpc_decoder_destroy(ldpc_decoder_t* decoder) {
+    if (!decoder) {
+        return;
+    }
+    free(decoder->app);
+    free(decoder->msg);
+    free(decoder->tmp);
+    free(decoder);
+}
+
+// Буферы рассчитаны на любой граф и Zc: один декодер на поток
+static inline ldpc_decoder_t* ldpc_decoder_create(void) {
+    ldpc_decoder_t* decoder = (ldpc_decoder_t*)calloc(1, sizeof(*decoder));
+    if (!decoder) {
+        return NULL;
+    }
+    decoder->app = (int8_t*)aligned_alloc(64, LDPC_MAX_COLS * LDPC_ZMAX);
+    decoder->msg = (int8_t*)aligned_alloc(64, LDPC_MAX_EDGES * LDPC_ZMAX);
+    decoder->tmp = (int8_t*)aligned_alloc(64, LDPC_MAX_DEGREE * LDPC_ZMAX);
+    decoder->max_iterations = LDPC_DEFAULT_ITERATIONS;
+    decoder->offset = LDPC_DEFAULT_OFFSET;
+    decoder->check_node = ldpc_check_node;
+    if (!decoder->app || !decoder->msg || !decoder->tmp) {
+        ldpc_decoder_destroy(decoder);
+        return NULL;
+    }
+    return decoder;
+}
+
+// Декодирование llr (n значений, как после ldpc_rate_recover) в K'
+// информационных бит out. cols - число затронутых столбцов из
+// ldpc_rate_recover: строки расширения за ними не обрабатываются
+// (0 - все строки). Возвращает число итераций или -1, если декодер
+// не сошёлся (out всё равно заполняется жёсткими решениями).
+static inline int ldpc_decode(ldpc_decoder_t* decoder, const ldpc_code_t* code, const int8_t* llr, uint8_t* out, int cols = 0) {
+    const struct ldpc_base_graph* graph = code->graph;
+    int z = code->z;
+    int stride = code->stride;
+    int rows = graph->rows;
+    if (cols > 0 && cols - graph->kb < rows) {
+        rows = cols - graph->kb < LDPC_CORE_ROWS ? LDPC_CORE_ROWS : cols - graph->kb;
+    }
+    int active_cols = graph->kb + rows;
+
+    for (int c = 0; c < active_cols; c++) {
+        memcpy(decoder->app + c * stride, llr + c * z, z);
+        memset(decoder->app + c * stride + z, 0, stride - z);
+    }
+    memset(decoder->msg, 0, (size_t)graph->row_start[rows] * stride);
+    memset(decoder->tmp, 0, (size_t)LDPC_MAX_DEGREE * stride);
+
+    int iteration = 0;
+    int unsatisfied = 1;
+    while (unsatisfied && iteration < decoder->max_iterations) {
+        iteration++;
+        unsatisfied = 0;
+        for (int r = 0; r < rows; r++) {
+            int first = graph->row_start[r];
+            int deg = graph->row_start[r + 1] - first;
+            for (int e = 0; e < deg; e++) {
+                const int8_t* src = decoder->app + graph->col[first + e] * stride;
+                int8_t* dst = decoder->tmp + e * stride;
+                int s = code->shift[first + e];
+                memcpy(dst, src + s, z - s);
+                memcpy(dst + z - s, src, s);
+            }
+            unsatisfied |= decoder->check_node(decoder->tmp, decoder->msg + first * stride, deg, stride, stride,
+                                               decoder->offset);
+            for (int e = 0; e < deg; e++) {
+                int8_t* dst = decoder->app + graph->col[first + e] * stride;
+                const int8_t* src = decoder->tmp + e * stride;
+                int s = code->shift[first + e];
+                memcpy(dst + s, src, z - s);
+                memcpy(dst, src + z - s, s);
+            }
+        }
+    }
+
+    for (int i = 0; i < code->k_prime; i++) {
+        out[i] = (uint8_t)decoder->app[(i / z) * stride + i % z] >> 7;
+    }
+    return unsatisfied ? -1 : iteration;
+}
+
+#endif // _LDPC_H_
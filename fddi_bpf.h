@@ -0,0 +1,339 @@
+#ifndef _FDDI_BPF_H_
+#define _FDDI_BPF_H_
+
+// Компилятор простых выражений фильтра в классический BPF для
+// SO_ATTACH_FILTER. Ненужные кадры отбрасываются в ядре до копирования
+// в пользовательское пространство.
+//
+// Выражение - список условий через пробел, все условия должны выполняться.
+// Значения одного условия через запятую - достаточно любого из них:
+//   dsap=42,aa        DSAP (шестнадцатеричный)
+//   ssap=42           SSAP
+//   sap=42            DSAP или SSAP
+//   snap=000000/0800  SNAP: OUI и (необязательно) тип протокола
+//   src=00:11:22:33:44:55, dst=...   адрес в том порядке байт, что в кадре
+//   len=60-1500       длина данных, доставляемых в сокет
+//
+// Поля читаются относительно заголовка канального уровня (SKF_LL_OFF),
+// поэтому фильтр работает одинаково для SOCK_RAW и SOCK_DGRAM.
+
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fddi.h"
+
+#define FDDI_BPF_MAX_TERMS 16
+#define FDDI_BPF_MAX_ALTS 16
+#define FDDI_BPF_MAX_CHECKS 2
+#define FDDI_BPF_MAX_INSNS 1024
+#define FDDI_BPF_SNAPLEN 0x40000
+
+// Смещения полей от начала кадра FDDI (struct fddihdr)
+#define FDDI_BPF_OFF_DADDR 1
+#define FDDI_BPF_OFF_SADDR 7
+#define FDDI_BPF_OFF_DSAP 13
+#define FDDI_BPF_OFF_SSAP 14
+#define FDDI_BPF_OFF_SNAP_CTRL 15
+#define FDDI_BPF_OFF_SNAP_OUI 16
+
+// Одна проверка: загрузка поля и сравнение с lo (равенство, если lo == hi)
+// или с диапазоном [lo, hi]
+struct fddi_bpf_check {
+  unsigned short load;
+  unsigned int offset;
+  unsigned int lo;
+  unsigned int hi;
+};
+
+// Вариант условия: все проверки должны совпасть
+struct fddi_bpf_alt {
+  struct fddi_bpf_check checks[FDDI_BPF_MAX_CHECKS];
+  unsigned int count;
+};
+
+struct fddi_bpf_term {
+  struct fddi_bpf_alt alts[FDDI_BPF_MAX_ALTS];
+  unsigned int count;
+};
+
+struct fddi_bpf_program {
+  struct sock_filter insns[FDDI_BPF_MAX_INSNS];
+  unsigned int len;
+};
+
+static inline void fddi_bpf_check_eq(struct fddi_bpf_check *c, unsigned short size, unsigned int offset,
+                                     unsigned int value) {
+  c->load = BPF_LD | size | BPF_ABS;
+  c->offset = SKF_LL_OFF + offset;
+  c->lo = value;
+  c->hi = value;
+}
+
+static inline int fddi_bpf_parse_hex(const char *s, size_t len, unsigned int *out) {
+  char tmp[16];
+  char *end;
+  if (len == 0 || len >= sizeof(tmp)) {
+    return -1;
+  }
+  memcpy(tmp, s, len);
+  tmp[len] = '\0';
+  *out = strtoul(tmp, &end, 16);
+  return *end == '\0' ? 0 : -1;
+}
+
+static inline int fddi_bpf_parse_addr(const char *s, size_t len, unsigned char addr[FDDI_K_ALEN]) {
+  char tmp[32];
+  unsigned int b[FDDI_K_ALEN];
+  char tail;
+  if (len >= sizeof(tmp)) {
+    return -1;
+  }
+  memcpy(tmp, s, len);
+  tmp[len] = '\0';
+  if (sscanf(tmp, "%2x:%2x:%2x:%2x:%2x:%2x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &tail) != 6) {
+    return -1;
+  }
+  for (int i = 0; i < FDDI_K_ALEN; i++) {
+    addr[i] = b[i];
+  }
+  return 0;
+}
+
+// Разбор одного значения условия key в варианты проверок
+static inline int fddi_bpf_parse_value(const char *key, const char *val, size_t len,
+                                       struct fddi_bpf_term *term) {
+  unsigned int v;
+
+  if (term->count + 2 > FDDI_BPF_MAX_ALTS) {
+    fprintf(stderr, "Too many values for %s\n", key);
+    return -1;
+  }
+  struct fddi_bpf_alt *alt = &term->alts[term->count];
+  memset(alt, 0, sizeof(*alt));
+
+  if (strcmp(key, "dsap") == 0 || strcmp(key, "ssap") == 0 || strcmp(key, "sap") == 0) {
+    if (fddi_bpf_parse_hex(val, len, &v) < 0 || v > 0xff) {
+      return -1;
+    }
+    if (strcmp(key, "sap") == 0) {
+      fddi_bpf_check_eq(&alt[0].checks[0], BPF_B, FDDI_BPF_OFF_DSAP, v);
+      alt[0].count = 1;
+      memset(&alt[1], 0, sizeof(alt[1]));
+      fddi_bpf_check_eq(&alt[1].checks[0], BPF_B, FDDI_BPF_OFF_SSAP, v);
+      alt[1].count = 1;
+      term->count += 2;
+      return 0;
+    }
+    fddi_bpf_check_eq(&alt->checks[0], BPF_B, key[0] == 'd' ? FDDI_BPF_OFF_DSAP : FDDI_BPF_OFF_SSAP, v);
+    alt->count = 1;
+  } else if (strcmp(key, "snap") == 0) {
+    // AA AA 03 и первый байт OUI одним словом, затем остаток OUI и тип
+    const char *slash = (const char *)memchr(val, '/', len);
+    size_t oui_len = slash ? (size_t)(slash - val) : len;
+    unsigned int oui, type = 0;
+    if (oui_len != 6 || fddi_bpf_parse_hex(val, oui_len, &oui) < 0) {
+      return -1;
+    }
+    if (slash && (fddi_bpf_parse_hex(slash + 1, len - oui_len - 1, &type) < 0 || type > 0xffff)) {
+      return -1;
+    }
+    fddi_bpf_check_eq(&alt->checks[0], BPF_W, FDDI_BPF_OFF_DSAP,
+                      (FDDI_EXTENDED_SAP << 24) | (FDDI_EXTENDED_SAP << 16) | (FDDI_UI_CMD << 8) | (oui >> 16));
+    if (slash) {
+      fddi_bpf_check_eq(&alt->checks[1], BPF_W, FDDI_BPF_OFF_SNAP_OUI + 1, ((oui & 0xffff) << 16) | type);
+    } else {
+      fddi_bpf_check_eq(&alt->checks[1], BPF_H, FDDI_BPF_OFF_SNAP_OUI + 1, oui & 0xffff);
+    }
+    alt->count = 2;
+  } else if (strcmp(key, "src") == 0 || strcmp(key, "dst") == 0) {
+    unsigned char a[FDDI_K_ALEN];
+    unsigned int offset = key[0] == 's' ? FDDI_BPF_OFF_SADDR : FDDI_BPF_OFF_DADDR;
+    if (fddi_bpf_parse_addr(val, len, a) < 0) {
+      return -1;
+    }
+    fddi_bpf_check_eq(&alt->checks[0], BPF_W, offset,
+                      ((unsigned int)a[0] << 24) | (a[1] << 16) | (a[2] << 8) | a[3]);
+    fddi_bpf_check_eq(&alt->checks[1], BPF_H, offset + 4, (a[4] << 8) | a[5]);
+    alt->count = 2;
+  } else if (strcmp(key, "len") == 0) {
+    char tmp[32];
+    unsigned int lo, hi;
+    char tail;
+    if (len >= sizeof(tmp)) {
+      return -1;
+    }
+    memcpy(tmp, val, len);
+    tmp[len] = '\0';
+    int n = sscanf(tmp, "%u-%u%c", &lo, &hi, &tail);
+    if (n == 1) {
+      hi = lo;
+    } else if (n != 2 || lo > hi) {
+      return -1;
+    }
+    alt->checks[0].load = BPF_LD | BPF_W | BPF_LEN;
+    alt->checks[0].offset = 0;
+    alt->checks[0].lo = lo;
+    alt->checks[0].hi = hi;
+    alt->count = 1;
+  } else {
+    fprintf(stderr, "Unknown filter key: %s\n", key);
+    return -1;
+  }
+
+  term->count++;
+  return 0;
+}
+
+static inline int fddi_bpf_parse(const char *expr, struct fddi_bpf_term *terms, unsigned int *count) {
+  const char *p = expr;
+  *count = 0;
+
+  while (*p) {
+    while (*p == ' ' || *p == '\t') {
+      p++;
+    }
+    if (*p == '\0') {
+      break;
+    }
+
+    const char *end = p;
+    while (*end && *end != ' ' && *end != '\t') {
+      end++;
+    }
+    const char *eq = (const char *)memchr(p, '=', end - p);
+    if (!eq || eq == p || eq - p >= 8) {
+      fprintf(stderr, "Bad filter term: %.*s\n", (int)(end - p), p);
+      return -1;
+    }
+    if (*count == FDDI_BPF_MAX_TERMS) {
+      fprintf(stderr, "Too many filter terms\n");
+      return -1;
+    }
+
+    char key[8];
+    memcpy(key, p, eq - p);
+    key[eq - p] = '\0';
+
+    struct fddi_bpf_term *term = &terms[*count];
+    term->count = 0;
+    const char *val = eq + 1;
+    while (val <= end) {
+      const char *comma = val;
+      while (comma < end && *comma != ',') {
+        comma++;
+      }
+      if (fddi_bpf_parse_value(key, val, comma - val, term) < 0) {
+        fprintf(stderr, "Bad value in filter term: %.*s\n", (int)(end - p), p);
+        return -1;
+      }
+      val = comma + 1;
+    }
+    (*count)++;
+    p = end;
+  }
+  return 0;
+}
+
+static inline unsigned int fddi_bpf_check_size(const struct fddi_bpf_check *c) {
+  return c->lo == c->hi ? 2 : 3;
+}
+
+static inline unsigned int fddi_bpf_alt_size(const struct fddi_bpf_alt *alt) {
+  unsigned int size = 0;
+  for (unsigned int i = 0; i < alt->count; i++) {
+    size += fddi_bpf_check_size(&alt->checks[i]);
+  }
+  return size;
+}
+
+static inline void fddi_bpf_emit(struct fddi_bpf_program *prog, unsigned short code, unsigned char jt,
+                                 unsigned char jf, unsigned int k) {
+  struct sock_filter insn = {code, jt, jf, k};
+  prog->insns[prog->len++] = insn;
+}
+
+// Каждое условие компилируется в блок: варианты проверяются по очереди,
+// совпадение переходит к следующему условию, а после последнего варианта
+// стоит безусловный переход на "отбросить". Короткие переходы внутри
+// блока всегда укладываются в 8 бит, дальний переход - BPF_JA.
+static inline int fddi_bpf_compile(const char *expr, struct fddi_bpf_program *prog) {
+  static struct fddi_bpf_term terms[FDDI_BPF_MAX_TERMS];
+  unsigned int count;
+
+  prog->len = 0;
+  if (fddi_bpf_parse(expr, terms, &count) < 0) {
+    return -1;
+  }
+
+  unsigned int ja_fixups[FDDI_BPF_MAX_TERMS];
+  for (unsigned int t = 0; t < count; t++) {
+    const struct fddi_bpf_term *term = &terms[t];
+    unsigned int term_size = 1;
+    for (unsigned int a = 0; a < term->count; a++) {
+      term_size += fddi_bpf_alt_size(&term->alts[a]);
+    }
+    if (prog->len + term_size + 2 > FDDI_BPF_MAX_INSNS) {
+      fprintf(stderr, "Filter is too large\n");
+      return -1;
+    }
+    unsigned int pass = prog->len + term_size;
+
+    for (unsigned int a = 0; a < term->count; a++) {
+      const struct fddi_bpf_alt *alt = &term->alts[a];
+      unsigned int next_alt = prog->len + fddi_bpf_alt_size(alt);
+
+      for (unsigned int c = 0; c < alt->count; c++) {
+        const struct fddi_bpf_check *check = &alt->checks[c];
+        int last = c + 1 == alt->count;
+
+        fddi_bpf_emit(prog, check->load, 0, 0, check->offset);
+        if (check->lo == check->hi) {
+          unsigned int at = prog->len;
+          fddi_bpf_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, last ? pass - at - 1 : 0, next_alt - at - 1,
+                        check->lo);
+        } else {
+          unsigned int at = prog->len;
+          fddi_bpf_emit(prog, BPF_JMP | BPF_JGE | BPF_K, 0, next_alt - at - 1, check->lo);
+          at = prog->len;
+          fddi_bpf_emit(prog, BPF_JMP | BPF_JGT | BPF_K, next_alt - at - 1, last ? pass - at - 1 : 0,
+                        check->hi);
+        }
+      }
+    }
+
+    ja_fixups[t] = prog->len;
+    fddi_bpf_emit(prog, BPF_JMP | BPF_JA, 0, 0, 0);
+  }
+
+  fddi_bpf_emit(prog, BPF_RET | BPF_K, 0, 0, FDDI_BPF_SNAPLEN);
+  unsigned int reject = prog->len;
+  fddi_bpf_emit(prog, BPF_RET | BPF_K, 0, 0, 0);
+
+  for (unsigned int t = 0; t < count; t++) {
+    prog->insns[ja_fixups[t]].k = reject - ja_fixups[t] - 1;
+  }
+  return 0;
+}
+
+static inline int fddi_bpf_attach(int fd, const struct fddi_bpf_program *prog) {
+  struct sock_fprog fprog;
+  fprog.len = prog->len;
+  fprog.filter = (struct sock_filter *)prog->insns;
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+    perror("SO_ATTACH_FILTER failed");
+    return -1;
+  }
+  return 0;
+}
+
+// Вывод программы в формате "tcpdump -dd"
+static inline void fddi_bpf_dump(const struct fddi_bpf_program *prog) {
+  for (unsigned int i = 0; i < prog->len; i++) {
+    const struct sock_filter *insn = &prog->insns[i];
+    printf("{ 0x%02x, %u, %u, 0x%08x },\n", insn->code, insn->jt, insn->jf, insn->k);
+  }
+}
+
+#endif // _FDDI_BPF_H_
@@ -0,0 +1,268 @@
+#ifndef _FDDI_DECODE_H_
+#define _FDDI_DECODE_H_
+
+// Разбор кадров FDDI / LLC / SNAP без выделения памяти и без копирования:
+// результат содержит только указатели внутрь исходного буфера и значения
+// полей. Кадр должен начинаться с байта FC (сокет SOCK_RAW).
+//
+// Пакетный интерфейс fddi_batch раскладывает поля пачки кадров
+// (recvmmsg или блок кольца) по отдельным массивам, после чего
+// классификация выполняется одним проходом без ветвлений, который
+// компилятор векторизует.
+
+#include <stdint.h>
+#include <string.h>
+#include "fddi.h"
+
+enum fddi_frame_class {
+  FDDI_CLASS_TRUNCATED,    // кадр короче своего заголовка
+  FDDI_CLASS_TOKEN,        // маркер (без адресов)
+  FDDI_CLASS_SMT,          // управление станцией
+  FDDI_CLASS_MAC,          // кадры уровня MAC
+  FDDI_CLASS_LLC,          // LLC 802.2 без SNAP
+  FDDI_CLASS_SNAP,         // LLC 802.2 + SNAP
+  FDDI_CLASS_IMPLEMENTOR,  // кадры производителя оборудования
+  FDDI_CLASS_RESERVED,     // зарезервированные и неизвестные значения FC
+  FDDI_CLASS_COUNT
+};
+
+static const char *const fddi_class_names[FDDI_CLASS_COUNT] = {
+  "truncated", "token", "smt", "mac", "llc", "snap", "implementor", "reserved",
+};
+
+struct fddi_frame_view {
+  const unsigned char *data;
+  unsigned int len;
+  unsigned char fc;
+  unsigned char cls;
+  unsigned char addr_len;          // 6 или 2 байта, по биту FC
+  const unsigned char *daddr;
+  const unsigned char *saddr;
+
+  // Поля LLC: заполнены для FDDI_CLASS_LLC и FDDI_CLASS_SNAP
+  unsigned char dsap;
+  unsigned char ssap;
+  unsigned char control_len;       // 1 для U-кадров, 2 для I- и S-кадров
+  unsigned short control;
+
+  // Поля SNAP: заполнены для FDDI_CLASS_SNAP
+  const unsigned char *oui;
+  unsigned short ethertype;
+
+  const unsigned char *payload;
+  unsigned int payload_len;
+};
+
+// Класс кадра по байту FC (без учёта LLC/SNAP)
+static inline unsigned char fddi_fc_class(unsigned char fc) {
+  if (fc == FDDI_FC_K_NON_RESTRICTED_TOKEN || fc == FDDI_FC_K_RESTRICTED_TOKEN) {
+    return FDDI_CLASS_TOKEN;
+  }
+  switch (fc & FDDI_FC_K_FORMAT_MASK) {
+  case FDDI_FC_K_FORMAT_LLC:
+    return FDDI_CLASS_LLC;
+  case FDDI_FC_K_FORMAT_IMPLEMENTOR:
+    return FDDI_CLASS_IMPLEMENTOR;
+  case FDDI_FC_K_FORMAT_MANAGEMENT:
+    if ((fc & FDDI_FC_K_CONTROL_MASK) == 0) {
+      return FDDI_CLASS_RESERVED;
+    }
+    return (fc & FDDI_FC_K_CLASS_MASK) ? FDDI_CLASS_MAC : FDDI_CLASS_SMT;
+  default:
+    return FDDI_CLASS_RESERVED;
+  }
+}
+
+// Полный разбор одного кадра. Возвращает класс кадра; при любой длине и
+// содержимом обращается только к байтам [data, data + len).
+static inline unsigned char fddi_decode(const unsigned char *data, unsigned int len,
+                                        struct fddi_frame_view *v) {
+  memset(v, 0, sizeof(*v));
+  v->data = data;
+  v->len = len;
+
+  if (len < 1) {
+    v->cls = FDDI_CLASS_TRUNCATED;
+    return v->cls;
+  }
+  v->fc = data[0];
+  v->cls = fddi_fc_class(v->fc);
+  if (v->cls == FDDI_CLASS_TOKEN) {
+    return v->cls;
+  }
+
+  v->addr_len = (v->fc & FDDI_FC_K_ALEN_MASK) == FDDI_FC_K_ALEN_48 ? FDDI_K_ALEN : 2;
+  unsigned int hdr_len = 1 + 2 * v->addr_len;
+  if (len < hdr_len) {
+    v->cls = FDDI_CLASS_TRUNCATED;
+    return v->cls;
+  }
+  v->daddr = data + 1;
+  v->saddr = data + 1 + v->addr_len;
+  v->payload = data + hdr_len;
+  v->payload_len = len - hdr_len;
+
+  if (v->cls != FDDI_CLASS_LLC) {
+    return v->cls;
+  }
+
+  // LLC: DSAP, SSAP и поле управления длиной 1 или 2 байта
+  const unsigned char *llc = data + hdr_len;
+  unsigned int llc_len = len - hdr_len;
+  if (llc_len < 3) {
+    v->cls = FDDI_CLASS_TRUNCATED;
+    return v->cls;
+  }
+  v->dsap = llc[0];
+  v->ssap = llc[1];
+  v->control_len = (llc[2] & 0x03) == 0x03 ? 1 : 2;
+  if (llc_len < 2u + v->control_len) {
+    v->cls = FDDI_CLASS_TRUNCATED;
+    return v->cls;
+  }
+  v->control = v->control_len == 1 ? llc[2] : (unsigned short)(llc[2] | (llc[3] << 8));
+  v->payload = llc + 2 + v->control_len;
+  v->payload_len = llc_len - 2 - v->control_len;
+
+  if (v->dsap == FDDI_EXTENDED_SAP && v->ssap == FDDI_EXTENDED_SAP && v->control == FDDI_UI_CMD &&
+      v->payload_len >= FDDI_K_OUI_LEN + 2) {
+    v->cls = FDDI_CLASS_SNAP;
+    v->oui = v->payload;
+    v->ethertype = (unsigned short)((v->payload[3] << 8) | v->payload[4]);
+    v->payload += FDDI_K_OUI_LEN + 2;
+    v->payload_len -= FDDI_K_OUI_LEN + 2;
+  }
+  return v->cls;
+}
+
+#define FDDI_BATCH_MAX 64
+// Байты заголовка, нужные для классификации: FC, два 48-битных адреса,
+// LLC (3 байта) и SNAP (5 байт)
+#define FDDI_BATCH_HDR_LEN FDDI_K_SNAP_HLEN
+
+// Пачка кадров в виде "структуры массивов": каждое поле лежит в своём
+// массиве, и цикл классификации работает с ними как с векторами.
+struct fddi_batch {
+  unsigned int count;
+  const unsigned char *data[FDDI_BATCH_MAX];
+  uint16_t len[FDDI_BATCH_MAX];
+  uint16_t ethertype[FDDI_BATCH_MAX];
+  uint8_t fc[FDDI_BATCH_MAX];
+  uint8_t dsap[FDDI_BATCH_MAX];
+  uint8_t ssap[FDDI_BATCH_MAX];
+  uint8_t ctrl[FDDI_BATCH_MAX];
+  uint8_t cls[FDDI_BATCH_MAX];
+};
+
+static inline void fddi_batch_reset(struct fddi_batch *b) {
+  b->count = 0;
+}
+
+// Добавление кадра в пачку; возвращает 0, если пачка заполнена. Заголовок
+// кадра (из recvmmsg или кольца он обычно не в кэше) начинает загружаться
+// сразу, и к классификации пачки он уже в L1.
+static inline int fddi_batch_add(struct fddi_batch *b, const unsigned char *data, unsigned int len) {
+  if (b->count == FDDI_BATCH_MAX) {
+    return 0;
+  }
+  __builtin_prefetch(data);
+  b->data[b->count] = data;
+  b->len[b->count] = len > 0xffff ? 0xffff : len;
+  b->count++;
+  return 1;
+}
+
+// Выбор без ветвления: value, если cond == 1, иначе other
+static inline uint8_t fddi_select(uint8_t cond, uint8_t value, uint8_t other) {
+  uint8_t mask = (uint8_t)(0 - cond);
+  return (uint8_t)((value & mask) | (other & ~mask));
+}
+
+// Классификация всей пачки. Первый проход только читает заголовки: FC и
+// оба возможных положения LLC (после 16- и 48-битных адресов), без
+// зависимости адреса чтения от FC; короткие кадры читаются через буфер,
+// дополненный нулями. Второй проход выбирает нужное положение и вычисляет
+// класс масками, без ветвлений. Он всегда идёт по FDDI_BATCH_MAX
+// элементам (хвост пачки обнулён), поэтому при -O2 компилятор
+// векторизует его целиком, без скалярного остатка.
+static inline void fddi_batch_classify(struct fddi_batch *b) {
+  unsigned int n = b->count;
+  // DSAP, SSAP и первый байт поля управления для обеих длин адреса
+  uint8_t llc16[3][FDDI_BATCH_MAX];
+  uint8_t llc48[3][FDDI_BATCH_MAX];
+
+  for (unsigned int i = 0; i < n; i++) {
+    const unsigned char *p = b->data[i];
+    unsigned char padded[FDDI_BATCH_HDR_LEN];
+    if (__builtin_expect(b->len[i] < FDDI_BATCH_HDR_LEN, 0)) {
+      memset(padded, 0, sizeof(padded));
+      memcpy(padded, p, b->len[i]);
+      p = padded;
+    }
+    b->fc[i] = p[0];
+    llc16[0][i] = p[1 + 2 * 2];
+    llc16[1][i] = p[1 + 2 * 2 + 1];
+    llc16[2][i] = p[1 + 2 * 2 + 2];
+    llc48[0][i] = p[1 + 2 * FDDI_K_ALEN];
+    llc48[1][i] = p[1 + 2 * FDDI_K_ALEN + 1];
+    llc48[2][i] = p[1 + 2 * FDDI_K_ALEN + 2];
+    unsigned int llc = (p[0] & FDDI_FC_K_ALEN_MASK) ? 1 + 2 * FDDI_K_ALEN : 1 + 2 * 2;
+    b->ethertype[i] = (uint16_t)((p[llc + 6] << 8) | p[llc + 7]);
+  }
+  for (unsigned int i = n; i < FDDI_BATCH_MAX; i++) {
+    b->fc[i] = 0;
+    b->len[i] = 0;
+    llc16[0][i] = llc16[1][i] = llc16[2][i] = 0;
+    llc48[0][i] = llc48[1][i] = llc48[2][i] = 0;
+  }
+
+  for (unsigned int i = 0; i < FDDI_BATCH_MAX; i++) {
+    uint8_t fc = b->fc[i];
+    uint8_t format = fc & FDDI_FC_K_FORMAT_MASK;
+    uint8_t control = fc & FDDI_FC_K_CONTROL_MASK;
+    uint8_t sync = (fc & FDDI_FC_K_CLASS_MASK) != 0;
+    uint8_t wide = (fc & FDDI_FC_K_ALEN_MASK) != 0;
+
+    uint8_t dsap = fddi_select(wide, llc48[0][i], llc16[0][i]);
+    uint8_t ssap = fddi_select(wide, llc48[1][i], llc16[1][i]);
+    uint8_t ctrl = fddi_select(wide, llc48[2][i], llc16[2][i]);
+    b->dsap[i] = dsap;
+    b->ssap[i] = ssap;
+    b->ctrl[i] = ctrl;
+    // Наличие заголовка MAC и число байт после него (не больше 255)
+    uint16_t llc = (uint16_t)(1 + 2 * 2 + (wide << 3));
+    uint16_t len = b->len[i];
+    uint16_t rest = (uint16_t)(len - llc);
+    uint8_t has_hdr = len >= llc;
+    uint8_t avail = (uint8_t)(has_hdr ? (rest > 255 ? 255 : rest) : 0);
+
+    uint8_t is_token = (fc == FDDI_FC_K_NON_RESTRICTED_TOKEN) | (fc == FDDI_FC_K_RESTRICTED_TOKEN);
+    uint8_t is_llc = format == FDDI_FC_K_FORMAT_LLC;
+    uint8_t is_impl = format == FDDI_FC_K_FORMAT_IMPLEMENTOR;
+    uint8_t is_mgmt = (format == FDDI_FC_K_FORMAT_MANAGEMENT) & (control != 0);
+    uint8_t is_snap = is_llc & (dsap == FDDI_EXTENDED_SAP) & (ssap == FDDI_EXTENDED_SAP) &
+                      (ctrl == FDDI_UI_CMD) & (avail >= 8);
+    // Для LLC нужны DSAP, SSAP и поле управления (1 или 2 байта)
+    uint8_t control_len = 2 - ((ctrl & 0x03) == 0x03);
+    uint8_t short_llc = is_llc & (avail < 2 + control_len);
+    uint8_t truncated = (uint8_t)(short_llc | (has_hdr ^ 1));
+
+    uint8_t cls = FDDI_CLASS_RESERVED;
+    cls = fddi_select(is_impl, FDDI_CLASS_IMPLEMENTOR, cls);
+    cls = fddi_select(is_mgmt & (sync ^ 1), FDDI_CLASS_SMT, cls);
+    cls = fddi_select(is_mgmt & sync, FDDI_CLASS_MAC, cls);
+    cls = fddi_select(is_llc, FDDI_CLASS_LLC, cls);
+    cls = fddi_select(is_snap, FDDI_CLASS_SNAP, cls);
+    cls = fddi_select(truncated, FDDI_CLASS_TRUNCATED, cls);
+    cls = fddi_select(is_token, FDDI_CLASS_TOKEN, cls);
+    b->cls[i] = cls;
+  }
+}
+
+static inline void fddi_batch_count(const struct fddi_batch *b, unsigned long long counts[FDDI_CLASS_COUNT]) {
+  for (unsigned int i = 0; i < b->count; i++) {
+    counts[b->cls[i]]++;
+  }
+}
+
+#endif // _FDDI_DECODE_H_
@@ -0,0 +1,108 @@
+#ifndef _FDDI_DUMP_H_
+#define _FDDI_DUMP_H_
+
+// Шестнадцатеричный дамп кадров в том же виде, что выводил printf в
+// fddiv: заголовок, по 16 байт в строке и пустая строка после кадра.
+// Текст собирается в буфере вызывающего по таблице "xx " на байт, без
+// printf и без системного вызова на кадр.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <net/if.h>
+#include "fddi.h"
+
+// Худший случай текста для одного кадра: заголовок, 3 символа на байт
+// и перевод строки на каждые 16 байт
+#define FDDI_DUMP_MAX_LEN (64 + IFNAMSIZ + FDDI_K_LLC_LEN * 3 + FDDI_K_LLC_LEN / 16 + 2)
+
+static char fddi_dump_hex[256][3];
+
+static inline void fddi_dump_init(void) {
+  static const char digits[] = "0123456789abcdef";
+  for (int i = 0; i < 256; i++) {
+    fddi_dump_hex[i][0] = digits[i >> 4];
+    fddi_dump_hex[i][1] = digits[i & 0xf];
+    fddi_dump_hex[i][2] = ' ';
+  }
+}
+
+static inline char *fddi_dump_uint(char *out, unsigned int value) {
+  char digits[10];
+  int n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) {
+    *out++ = digits[--n];
+  }
+  return out;
+}
+
+// Текст кадра в out (не больше FDDI_DUMP_MAX_LEN байт при caplen <=
+// FDDI_K_LLC_LEN). При захвате с нескольких интерфейсов в заголовке
+// вместо "FDDI interface" стоит имя интерфейса. В заголовке длина кадра
+// len, выводятся первые caplen байт.
+static inline char *fddi_dump_frame(char *out, const char *ifname, const unsigned char *data, unsigned int len,
+                                    unsigned int caplen) {
+  static const char prefix[] = "Received ";
+  static const char suffix[] = " bytes on FDDI interface:\n";
+  static const char on[] = " bytes on ";
+
+  memcpy(out, prefix, sizeof(prefix) - 1);
+  out = fddi_dump_uint(out + sizeof(prefix) - 1, len);
+  if (ifname) {
+    size_t name_len = strnlen(ifname, IFNAMSIZ);
+    memcpy(out, on, sizeof(on) - 1);
+    out += sizeof(on) - 1;
+    memcpy(out, ifname, name_len);
+    out += name_len;
+    *out++ = ':';
+    *out++ = '\n';
+  } else {
+    memcpy(out, suffix, sizeof(suffix) - 1);
+    out += sizeof(suffix) - 1;
+  }
+
+  for (unsigned int i = 0; i < caplen; i++) {
+    memcpy(out, fddi_dump_hex[data[i]], 3);
+    out += 3;
+    if ((i + 1) % 16 == 0) {
+      *out++ = '\n';
+    }
+  }
+  *out++ = '\n';
+  return out;
+}
+
+// Прежний вывод fddiv: printf на каждый байт. Оставлен как эталон для
+// сравнения в fddigen -P.
+static inline void fddi_dump_printf(FILE *out, const unsigned char *data, unsigned int len) {
+  fprintf(out, "Received %u bytes on FDDI interface:\n", len);
+  for (unsigned int i = 0; i < len; i++) {
+    fprintf(out, "%02x ", data[i]);
+    if ((i + 1) % 16 == 0) {
+      fprintf(out, "\n");
+    }
+  }
+  fprintf(out, "\n");
+}
+
+static inline int fddi_dump_write(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(fd, data, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += written;
+    len -= written;
+  }
+  return 0;
+}
+
+#endif // _FDDI_DUMP_H_
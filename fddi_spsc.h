@@ -0,0 +1,95 @@
+#ifndef _FDDI_SPSC_H_
+#define _FDDI_SPSC_H_
+
+// Очередь "один производитель - один потребитель" для передачи кадров
+// из потока приёма в поток вывода. Слоты фиксированного размера выделяются
+// один раз; поток приёма никогда не ждёт: если очередь полна, кадр
+// отбрасывается и учитывается вызывающим кодом.
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fddi.h"
+
+#define FDDI_SPSC_CACHE_LINE 64
+
+struct fddi_frame_slot {
+  uint64_t ts_ns;
+  unsigned int len;                // длина кадра на проводе
+  unsigned int caplen;             // сколько из них в data (не больше FDDI_K_LLC_LEN)
+  unsigned int iface;              // номер интерфейса, с которого пришёл кадр
+  unsigned char data[FDDI_K_LLC_LEN];
+};
+
+struct fddi_spsc_queue {
+  struct fddi_frame_slot *slots;
+  unsigned int mask;
+
+  // Индекс записи: меняет только производитель
+  alignas(FDDI_SPSC_CACHE_LINE) std::atomic<unsigned int> head;
+  unsigned int cached_tail;
+
+  // Индекс чтения: меняет только потребитель
+  alignas(FDDI_SPSC_CACHE_LINE) std::atomic<unsigned int> tail;
+  unsigned int cached_head;
+};
+
+// Ёмкость округляется вверх до степени двойки
+static inline int fddi_spsc_init(struct fddi_spsc_queue *q, unsigned int capacity) {
+  unsigned int size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  q->slots = (struct fddi_frame_slot *)malloc((size_t)size * sizeof(struct fddi_frame_slot));
+  if (!q->slots) {
+    return -1;
+  }
+  q->mask = size - 1;
+  q->head.store(0, std::memory_order_relaxed);
+  q->tail.store(0, std::memory_order_relaxed);
+  q->cached_tail = 0;
+  q->cached_head = 0;
+  return 0;
+}
+
+static inline void fddi_spsc_destroy(struct fddi_spsc_queue *q) {
+  free(q->slots);
+  q->slots = NULL;
+}
+
+// Производитель: свободный слот или NULL, если очередь заполнена.
+// Слот становится виден потребителю только после fddi_spsc_commit().
+static inline struct fddi_frame_slot *fddi_spsc_reserve(struct fddi_spsc_queue *q) {
+  unsigned int head = q->head.load(std::memory_order_relaxed);
+  if (head - q->cached_tail > q->mask) {
+    q->cached_tail = q->tail.load(std::memory_order_acquire);
+    if (head - q->cached_tail > q->mask) {
+      return NULL;
+    }
+  }
+  return &q->slots[head & q->mask];
+}
+
+static inline void fddi_spsc_commit(struct fddi_spsc_queue *q) {
+  q->head.store(q->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Потребитель: самый старый кадр или NULL, если очередь пуста
+static inline struct fddi_frame_slot *fddi_spsc_front(struct fddi_spsc_queue *q) {
+  unsigned int tail = q->tail.load(std::memory_order_relaxed);
+  if (tail == q->cached_head) {
+    q->cached_head = q->head.load(std::memory_order_acquire);
+    if (tail == q->cached_head) {
+      return NULL;
+    }
+  }
+  return &q->slots[tail & q->mask];
+}
+
+static inline void fddi_spsc_pop(struct fddi_spsc_queue *q) {
+  q->tail.store(q->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+#endif // _FDDI_SPSC_H_
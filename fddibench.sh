@@ -0,0 +1,195 @@
+#!/bin/sh
+# Стенд для измерения производительности fddiv на любой машине с Linux.
+# Создаёт пару veth, для каждого режима захвата запускает fddiv на одной
+# стороне и fddigen на другой, затем выводит устойчивую частоту приёма,
+# долю потерь и процессорное время fddiv на пакет. Нужны права root.
+# Перед замером проверяется, что fddiv -f принимает документированные
+# выражения фильтра и отвергает ошибочные, а после него фильтр в ядре
+# прогоняется на том же потоке кадров: без фильтра, с фильтром,
+# пропускающим кадры SNAP (половину смеси), и с фильтром, не
+# пропускающим ничего. Число принятых кадров сверяется с ожидаемым,
+# процессорное время считается на отправленный кадр.
+# С -P дополнительно замеряется вывод дампа без veth: прежний printf
+# против очереди SPSC и потока вывода (fddigen -P).
+#
+# Capture benchmark for fddiv on any Linux box. Creates a veth pair, runs
+# fddiv on one end and fddigen on the other for each capture mode, then
+# prints the sustained receive rate, drop rate and fddiv CPU time per
+# packet. Requires root.
+#
+# Before the runs, fddiv -f is checked to accept the documented filter
+# expressions and reject malformed ones. After them the in-kernel filter
+# is run on the same frame stream: unfiltered, passing SNAP frames (half
+# of the mix) and passing nothing. The received count is compared with
+# the expected one and CPU time is reported per sent frame.
+# With -P the hex dump output is also measured without veth: the old
+# printf path against the SPSC queue and writer thread (fddigen -P).
+#
+# Usage: fddibench.sh [-r pps] [-d seconds] [-s sizes] [-w workers] [-P]
+#   FDDIV and FDDIGEN point at the binaries (default ./fddiv and ./fddigen).
+
+set -e
+
+FDDIV=${FDDIV:-./fddiv}
+FDDIGEN=${FDDIGEN:-./fddigen}
+RATE=100000
+SECONDS_PER_MODE=10
+SIZES=64:4,512,1500
+WORKERS=$(nproc)
+DUMP=0
+
+while getopts "r:d:s:w:P" opt; do
+  case $opt in
+    r) RATE=$OPTARG ;;
+    d) SECONDS_PER_MODE=$OPTARG ;;
+    s) SIZES=$OPTARG ;;
+    w) WORKERS=$OPTARG ;;
+    P) DUMP=1 ;;
+    *) sed -n 's/^# Usage: /Usage: /p' "$0"; exit 1 ;;
+  esac
+done
+
+TX=fddibench0
+RX=fddibench1
+LOG=$(mktemp -d)
+FAILED=0
+
+# Выражения из описания -f в fddiv и fddi_bpf.h: первые должны
+# компилироваться, вторые - отвергаться с ошибкой
+check_filters() {
+  want=$1
+  shift
+  for expr in "$@"; do
+    if "$FDDIV" -f "$expr" -d > /dev/null 2>&1; then
+      got=accept
+    else
+      got=reject
+    fi
+    if [ "$got" != "$want" ]; then
+      echo "filter check: \"$expr\" should $want" >&2
+      FAILED=1
+    fi
+  done
+}
+
+check_filters accept "dsap=42,aa" "ssap=42" "sap=42" "snap=000000/0800" "snap=000000" \
+  "src=00:11:22:33:44:55" "dst=ff:ff:ff:ff:ff:ff" "len=60-1500" "len=64" "sap=1,2,3,4,5,6,7,8" \
+  "sap=42,aa snap=000000/0800 src=00:11:22:33:44:55 len=60-1500"
+check_filters reject "foo=1" "dsap" "=42" "dsap=" "dsap=42," "dsap=100" "dsap=zz" "snap=0000/0800" \
+  "snap=000000/10000" "src=00:11:22:33:44" "src=00:11:22:33:44:55:66" "len=1500-60" "len=abc" \
+  "sap=1,2,3,4,5,6,7,8,9" \
+  "len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1 len=1"
+if [ "$FAILED" -eq 0 ]; then
+  echo "filter check: documented expressions accepted, malformed ones rejected"
+fi
+
+cleanup() {
+  ip link del "$TX" 2>/dev/null || true
+  rm -rf "$LOG"
+}
+trap cleanup EXIT INT TERM
+
+# MTU veth поднимается до наибольшего кадра FDDI
+ip link add "$TX" type veth peer name "$RX"
+ip link set "$TX" mtu 4500 up
+ip link set "$RX" mtu 4500 up
+
+run_mode() {
+  name=$1
+  shift
+
+  "$FDDIV" -s -i "$RX" "$@" > "$LOG/fddiv.out" 2>&1 &
+  pid=$!
+  sleep 1
+  "$FDDIGEN" -i "$TX" -r "$RATE" -d "$SECONDS_PER_MODE" -s "$SIZES" > "$LOG/fddigen.out"
+  sleep 1
+  kill -INT "$pid"
+  wait "$pid" || true
+
+  sent=$(sed -n 's/^Sent: \([0-9]*\) frames.*/\1/p' "$LOG/fddigen.out")
+  received=$(sed -n 's/^Total: received \([0-9]*\) packets.*/\1/p' "$LOG/fddiv.out")
+  cpu=$(sed -n 's/^Total: .* cpu \([0-9.]*\) us\/packet/\1/p' "$LOG/fddiv.out")
+  if [ -z "$sent" ] || [ -z "$received" ]; then
+    echo "$name: run failed" >&2
+    cat "$LOG/fddiv.out" "$LOG/fddigen.out" >&2
+    return
+  fi
+
+  awk -v name="$name" -v sent="$sent" -v received="$received" -v cpu="$cpu" -v secs="$SECONDS_PER_MODE" 'BEGIN {
+    drop = sent > 0 ? (sent - received) * 100 / sent : 0
+    if (drop < 0) drop = 0
+    printf "%-16s %12d %12d %12.0f %8.2f%% %12s\n", name, sent, received, received / secs, drop, cpu
+  }'
+}
+
+printf "%-16s %12s %12s %12s %9s %12s\n" mode sent received pps drop "us/packet"
+run_mode recv -m recv
+run_mode ring -m ring
+run_mode recv-classify -m recv -c
+run_mode ring-classify -m ring -c
+if [ "$WORKERS" -gt 1 ]; then
+  run_mode "recv-fanout-$WORKERS" -m recv -w "$WORKERS" -F hash
+  run_mode "ring-fanout-$WORKERS" -m ring -w "$WORKERS" -F cpu
+fi
+
+# Фильтр в ядре: отправляется целое число циклов из 256 шаблонов fddigen,
+# поэтому в смеси llc/snap ровно половина кадров - SNAP. Кадры самой пары
+# veth (IPv6 ND и подобные) без фильтра тоже принимаются, поэтому там
+# проверяется только нижняя граница.
+run_filter() {
+  name=$1
+  expected=$2
+  shift 2
+
+  "$FDDIV" -s -m ring -i "$RX" "$@" > "$LOG/fddiv.out" 2>&1 &
+  pid=$!
+  sleep 1
+  "$FDDIGEN" -i "$TX" -r "$RATE" -c "$FILTER_COUNT" -s "$SIZES" > "$LOG/fddigen.out"
+  sleep 1
+  kill -INT "$pid"
+  wait "$pid" || true
+
+  sent=$(sed -n 's/^Sent: \([0-9]*\) frames.*/\1/p' "$LOG/fddigen.out")
+  received=$(sed -n 's/^Total: received \([0-9]*\) packets.*/\1/p' "$LOG/fddiv.out")
+  dropped=$(sed -n 's/^Total: .* dropped \([0-9]*\),.*/\1/p' "$LOG/fddiv.out")
+  cpu=$(sed -n 's/^CPU: \([0-9]*\) us/\1/p' "$LOG/fddiv.out")
+  if [ -z "$sent" ] || [ -z "$received" ]; then
+    echo "$name: run failed" >&2
+    cat "$LOG/fddiv.out" "$LOG/fddigen.out" >&2
+    FAILED=1
+    return
+  fi
+
+  if [ "$sent" -ne "$FILTER_COUNT" ] || [ "$dropped" -ne 0 ]; then
+    check="inexact"
+  elif [ "$name" = "unfiltered" ]; then
+    [ "$received" -ge "$expected" ] && check=ok || check=MISMATCH
+  else
+    [ "$received" -eq "$expected" ] && check=ok || check=MISMATCH
+  fi
+  [ "$check" = MISMATCH ] && FAILED=1
+
+  awk -v name="$name" -v sent="$sent" -v expected="$expected" -v received="$received" -v cpu="$cpu" \
+      -v check="$check" 'BEGIN {
+    printf "%-16s %12d %12d %12d %14.3f %9s\n", name, sent, expected, received,
+           (sent > 0 ? cpu / sent : 0), check
+  }'
+}
+
+FILTER_COUNT=$((RATE * SECONDS_PER_MODE / 256 * 256))
+if [ "$FILTER_COUNT" -eq 0 ]; then
+  FILTER_COUNT=$((256 * 4096))
+fi
+echo
+printf "%-16s %12s %12s %12s %14s %9s\n" filter sent expected received "us/sent frame" check
+run_filter unfiltered "$FILTER_COUNT"
+run_filter snap-ipv4 $((FILTER_COUNT / 2)) -f "snap=000000/0800"
+run_filter none-pass 0 -f "sap=e0"
+
+# Вывод дампа: байты текста в секунду у printf и у очереди с потоком вывода
+if [ "$DUMP" -eq 1 ]; then
+  echo
+  "$FDDIGEN" -P -s "$SIZES"
+fi
+
+exit "$FAILED"
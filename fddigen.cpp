@@ -0,0 +1,766 @@
+// Генератор синтетических кадров FDDI (LLC и SNAP) для проверки
+// производительности fddiv без настоящего кольца FDDI. Кадры отправляются
+// через сокет AF_PACKET на любой интерфейс (обычно одна сторона пары veth)
+// с заданной частотой и смесью размеров. Нужны права root.
+//
+// Пример: fddigen -i veth0 -r 200000 -d 10 -s 64:4,512,1500 -t mix
+//
+// В конце выводится строка "Sent: ...", которую разбирает fddibench.sh.
+//
+// Режим -P ничего не отправляет: та же смесь кадров проходит через
+// прежний вывод fddiv (printf на каждый байт) и через нынешний (очередь
+// SPSC и поток вывода с fddi_dump_frame), выводятся строки "Dump: ..."
+// с байтами текста в секунду. Перед замером проверяется, что текст обоих
+// путей совпадает байт в байт.
+//
+// Режим -D тоже ничего не отправляет: на -c случайных кадрах (любой FC,
+// любая длина, заголовки LLC/SNAP с повышенной вероятностью) пакетная
+// классификация fddi_batch_classify сверяется с fddi_decode, затем
+// выводится "Decode: ..." с кадрами в секунду у обоих путей. Каждый кадр
+// лежит в буфере точно своей длины, поэтому сборка с -fsanitize=address
+// ловит чтение за концом кадра.
+
+
+// Synthetic FDDI frame generator (LLC and SNAP) for measuring fddiv
+// performance without a real FDDI ring. Frames are sent through an
+// AF_PACKET socket on any interface (usually one end of a veth pair) at a
+// given rate and size mix. Requires root.
+//
+// Example: fddigen -i veth0 -r 200000 -d 10 -s 64:4,512,1500 -t mix
+//
+// At the end a "Sent: ..." line is printed for fddibench.sh to parse.
+//
+// The -P mode sends nothing: the same frame mix goes through the old
+// fddiv output (printf per byte) and the current one (SPSC queue and a
+// writer thread using fddi_dump_frame), and "Dump: ..." lines report text
+// bytes per second. Before timing, the text of both paths is checked to
+// be byte-identical.
+//
+// The -D mode sends nothing either: on -c random frames (any FC, any
+// length, LLC/SNAP headers made likely) the batch classifier
+// fddi_batch_classify is checked against fddi_decode, then "Decode: ..."
+// reports frames per second for both paths. Each frame sits in a buffer
+// of exactly its length, so a -fsanitize=address build catches reads past
+// the end of a frame.
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include "fddi.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include "fddi_spsc.h"
+#include "fddi_dump.h"
+#include "fddi_decode.h"
+
+#define FDDIGEN_TEMPLATES 256
+#define FDDIGEN_MAX_SIZES 16
+#define FDDIGEN_BATCH 32
+#define FDDIGEN_FC_LLC 0x54  // асинхронный LLC, 48-битные адреса
+#define FDDIGEN_DUMP_COUNT 200000
+#define FDDIGEN_DUMP_QUEUE 1024        // как FDDI_OUTPUT_QUEUE_SLOTS в fddiv
+#define FDDIGEN_DUMP_BUFFER (1 << 20)  // как FDDI_OUTPUT_BUFFER_SIZE в fddiv
+#define FDDIGEN_FUZZ_COUNT 1000000
+#define FDDIGEN_DECODE_ROUNDS 20000    // проходов по шаблонам в замере -D
+
+enum frame_type {
+  FRAME_LLC,
+  FRAME_SNAP,
+  FRAME_MIX,
+};
+
+struct gen_config {
+  const char *ifname;
+  unsigned long rate;       // кадров в секунду, 0 - без ограничения
+  unsigned int seconds;
+  unsigned long long count;
+  unsigned int sizes[FDDIGEN_MAX_SIZES];
+  unsigned int weights[FDDIGEN_MAX_SIZES];
+  unsigned int size_count;
+  int type;
+  unsigned int batch;
+  int dump_bench;
+  const char *dump_path;
+  int decode_fuzz;
+  unsigned long long seed;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_stop_signal(int sig) {
+  (void)sig;
+  g_stop = 1;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s -i interface [-r pps] [-d seconds | -c count] [-s size[:weight],...]\n"
+          "          [-t llc|snap|mix] [-B batch]\n"
+          "       %s -P [-c count] [-s size[:weight],...] [-t llc|snap|mix] [-o file]\n"
+          "       %s -D [-c count] [-S seed] [-s size[:weight],...] [-t llc|snap|mix]\n"
+          "  -i  interface to send on\n"
+          "  -r  frames per second, 0 for as fast as possible (default 0)\n"
+          "  -d  run time in seconds (default 10)\n"
+          "  -c  number of frames to send instead of a run time\n"
+          "  -s  frame size mix in bytes including the FDDI header (default 64:4,512,1500)\n"
+          "  -t  frame type: llc, snap or mix (default mix)\n"
+          "  -B  frames per sendmmsg call (default %d)\n"
+          "  -P  benchmark the fddiv hex dump (printf vs queue and writer thread) instead of sending\n"
+          "  -o  where -P writes the dump text (default /dev/null)\n"
+          "  -D  check fddi_batch_classify against fddi_decode on random frames, then time both\n"
+          "  -S  random seed for -D (default 1)\n",
+          prog, prog, prog, FDDIGEN_BATCH);
+}
+
+static int parse_sizes(const char *arg, struct gen_config *cfg) {
+  const char *p = arg;
+  cfg->size_count = 0;
+
+  while (*p) {
+    char *end;
+    unsigned long size = strtoul(p, &end, 0);
+    unsigned long weight = 1;
+    if (end == p) {
+      return -1;
+    }
+    if (*end == ':') {
+      p = end + 1;
+      weight = strtoul(p, &end, 0);
+      if (end == p || weight == 0) {
+        return -1;
+      }
+    }
+    if (size < FDDI_K_SNAP_HLEN || size > FDDI_K_LLC_LEN || cfg->size_count == FDDIGEN_MAX_SIZES) {
+      return -1;
+    }
+    cfg->sizes[cfg->size_count] = size;
+    cfg->weights[cfg->size_count] = weight;
+    cfg->size_count++;
+
+    if (*end == ',') {
+      end++;
+    } else if (*end != '\0') {
+      return -1;
+    }
+    p = end;
+  }
+  return cfg->size_count > 0 ? 0 : -1;
+}
+
+static int parse_args(int argc, char **argv, struct gen_config *cfg) {
+  int opt;
+
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->seconds = 10;
+  cfg->type = FRAME_MIX;
+  cfg->batch = FDDIGEN_BATCH;
+  cfg->dump_path = "/dev/null";
+  cfg->seed = 1;
+  parse_sizes("64:4,512,1500", cfg);
+
+  while ((opt = getopt(argc, argv, "i:r:d:c:s:t:B:Po:DS:h")) != -1) {
+    switch (opt) {
+    case 'i':
+      cfg->ifname = optarg;
+      break;
+    case 'r':
+      cfg->rate = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      cfg->seconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      cfg->count = strtoull(optarg, NULL, 0);
+      break;
+    case 's':
+      if (parse_sizes(optarg, cfg) < 0) {
+        fprintf(stderr, "Bad size mix: %s (sizes must be %d..%d)\n", optarg, FDDI_K_SNAP_HLEN,
+                FDDI_K_LLC_LEN);
+        return -1;
+      }
+      break;
+    case 't':
+      if (strcmp(optarg, "llc") == 0) {
+        cfg->type = FRAME_LLC;
+      } else if (strcmp(optarg, "snap") == 0) {
+        cfg->type = FRAME_SNAP;
+      } else if (strcmp(optarg, "mix") == 0) {
+        cfg->type = FRAME_MIX;
+      } else {
+        fprintf(stderr, "Unknown frame type: %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 'B':
+      cfg->batch = strtoul(optarg, NULL, 0);
+      break;
+    case 'P':
+      cfg->dump_bench = 1;
+      break;
+    case 'o':
+      cfg->dump_path = optarg;
+      break;
+    case 'D':
+      cfg->decode_fuzz = 1;
+      break;
+    case 'S':
+      cfg->seed = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  if (cfg->dump_bench) {
+    if (cfg->count == 0) {
+      cfg->count = FDDIGEN_DUMP_COUNT;
+    }
+    return 0;
+  }
+  if (cfg->decode_fuzz) {
+    if (cfg->count == 0) {
+      cfg->count = FDDIGEN_FUZZ_COUNT;
+    }
+    return 0;
+  }
+  if (!cfg->ifname) {
+    fprintf(stderr, "Interface is required\n");
+    return -1;
+  }
+  if (cfg->batch == 0) {
+    fprintf(stderr, "Batch size must be non-zero\n");
+    return -1;
+  }
+  return 0;
+}
+
+// Кадр FDDI: FC, адреса получателя и отправителя, LLC (SAP 0x42, UI) или
+// SNAP (OUI 00-00-00, тип IPv4), затем заполнитель с номером шаблона
+static unsigned int build_frame(unsigned char *frame, unsigned int size, int snap, unsigned int index) {
+  static const unsigned char daddr[FDDI_K_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+  static const unsigned char saddr[FDDI_K_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+  struct fddihdr *hdr = (struct fddihdr *)frame;
+  unsigned int hdr_len;
+
+  hdr->fc = FDDIGEN_FC_LLC;
+  memcpy(hdr->daddr, daddr, FDDI_K_ALEN);
+  memcpy(hdr->saddr, saddr, FDDI_K_ALEN);
+  if (snap) {
+    hdr->hdr.llc_snap.dsap = FDDI_EXTENDED_SAP;
+    hdr->hdr.llc_snap.ssap = FDDI_EXTENDED_SAP;
+    hdr->hdr.llc_snap.ctrl = FDDI_UI_CMD;
+    memset(hdr->hdr.llc_snap.oui, 0, FDDI_K_OUI_LEN);
+    hdr->hdr.llc_snap.ethertype = htons(ETH_P_IP);
+    hdr_len = FDDI_K_SNAP_HLEN;
+  } else {
+    hdr->hdr.llc_8022_1.dsap = 0x42;
+    hdr->hdr.llc_8022_1.ssap = 0x42;
+    hdr->hdr.llc_8022_1.ctrl = FDDI_UI_CMD;
+    hdr_len = FDDI_K_8022_HLEN;
+  }
+
+  for (unsigned int i = hdr_len; i < size; i++) {
+    frame[i] = (unsigned char)(index + i);
+  }
+  return size;
+}
+
+// Шаблоны кадров строятся заранее в пропорциях смеси размеров и типов,
+// поэтому в цикле отправки нет ни случайных чисел, ни заполнения данных
+static unsigned char templates[FDDIGEN_TEMPLATES][FDDI_K_LLC_LEN];
+static unsigned int template_len[FDDIGEN_TEMPLATES];
+
+static void build_templates(const struct gen_config *cfg) {
+  unsigned int total_weight = 0;
+  for (unsigned int i = 0; i < cfg->size_count; i++) {
+    total_weight += cfg->weights[i];
+  }
+  srand(1);
+  for (unsigned int t = 0; t < FDDIGEN_TEMPLATES; t++) {
+    unsigned int pick = rand() % total_weight;
+    unsigned int s = 0;
+    while (pick >= cfg->weights[s]) {
+      pick -= cfg->weights[s];
+      s++;
+    }
+    int snap = cfg->type == FRAME_SNAP || (cfg->type == FRAME_MIX && (t & 1));
+    template_len[t] = build_frame(templates[t], cfg->sizes[s], snap, t);
+  }
+}
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Ожидание момента отправки следующей пачки: сон, если до него больше
+// 50 мкс, иначе активное ожидание ради точности на высоких частотах
+static void wait_until(uint64_t deadline_ns) {
+  uint64_t now = monotonic_ns();
+  if (deadline_ns > now + 50000) {
+    struct timespec ts;
+    uint64_t wake = deadline_ns - 20000;
+    ts.tv_sec = wake / 1000000000ull;
+    ts.tv_nsec = wake % 1000000000ull;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+  }
+  while (monotonic_ns() < deadline_ns && !g_stop) {
+  }
+}
+
+// --- Замер вывода fddiv (-P) ---
+
+// Поток вывода как в fddiv: кадры из очереди в текст крупными блоками
+struct dump_writer {
+  struct fddi_spsc_queue queue;
+  std::atomic<int> stop;
+  int fd;
+  unsigned long long bytes;
+  int failed;
+};
+
+static void *dump_writer_main(void *arg) {
+  struct dump_writer *w = (struct dump_writer *)arg;
+  char *buffer = (char *)malloc(FDDIGEN_DUMP_BUFFER);
+  char *out = buffer;
+  if (!buffer) {
+    w->failed = 1;
+    return NULL;
+  }
+
+  for (;;) {
+    int stopping = w->stop.load(std::memory_order_acquire);
+    struct fddi_frame_slot *slot;
+    int progress = 0;
+
+    while ((slot = fddi_spsc_front(&w->queue)) != NULL) {
+      if (out - buffer > FDDIGEN_DUMP_BUFFER - FDDI_DUMP_MAX_LEN) {
+        w->failed |= fddi_dump_write(w->fd, buffer, out - buffer) < 0;
+        w->bytes += out - buffer;
+        out = buffer;
+      }
+      out = fddi_dump_frame(out, NULL, slot->data, slot->len, slot->caplen);
+      fddi_spsc_pop(&w->queue);
+      progress = 1;
+    }
+    if (progress) {
+      continue;
+    }
+    if (stopping) {
+      break;
+    }
+    if (out != buffer) {
+      w->failed |= fddi_dump_write(w->fd, buffer, out - buffer) < 0;
+      w->bytes += out - buffer;
+      out = buffer;
+    }
+    sched_yield();
+  }
+
+  if (out != buffer) {
+    w->failed |= fddi_dump_write(w->fd, buffer, out - buffer) < 0;
+    w->bytes += out - buffer;
+  }
+  free(buffer);
+  return NULL;
+}
+
+// Текст fddi_dump_frame должен совпадать с прежним printf для каждого шаблона
+static int dump_check(void) {
+  static char fast[FDDI_DUMP_MAX_LEN];
+  char *slow = NULL;
+  size_t slow_len = 0;
+
+  for (unsigned int t = 0; t < FDDIGEN_TEMPLATES; t++) {
+    FILE *f = open_memstream(&slow, &slow_len);
+    if (!f) {
+      perror("open_memstream failed");
+      return -1;
+    }
+    fddi_dump_printf(f, templates[t], template_len[t]);
+    fclose(f);
+    size_t fast_len = fddi_dump_frame(fast, NULL, templates[t], template_len[t], template_len[t]) - fast;
+    int same = fast_len == slow_len && memcmp(fast, slow, slow_len) == 0;
+    free(slow);
+    slow = NULL;
+    if (!same) {
+      fprintf(stderr, "Dump text differs from printf for template %u (%u bytes)\n", t, template_len[t]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static void dump_report(const char *name, unsigned long long frames, unsigned long long bytes, uint64_t ns) {
+  double elapsed = ns / 1e9;
+  printf("Dump: %-6s %llu frames, %llu bytes in %.3f s, %.0f frames/s, %.1f MB/s\n", name, frames, bytes,
+         elapsed, elapsed > 0 ? frames / elapsed : 0.0, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0);
+}
+
+// Один и тот же поток кадров через оба пути вывода. Для очереди отдельно
+// выводится время потока приёма на кадр: только оно задерживает захват.
+static int dump_bench(const struct gen_config *cfg) {
+  fddi_dump_init();
+  if (dump_check() < 0) {
+    return 1;
+  }
+  printf("Dump check: text of %u templates identical to printf\n", FDDIGEN_TEMPLATES);
+
+  FILE *f = fopen(cfg->dump_path, "w");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s: %s\n", cfg->dump_path, strerror(errno));
+    return 1;
+  }
+  uint64_t start = monotonic_ns();
+  for (unsigned long long i = 0; i < cfg->count; i++) {
+    unsigned int t = i % FDDIGEN_TEMPLATES;
+    fddi_dump_printf(f, templates[t], template_len[t]);
+  }
+  fflush(f);
+  long slow_bytes = ftell(f);
+  uint64_t slow_ns = monotonic_ns() - start;
+  fclose(f);
+
+  static struct dump_writer w;
+  w.fd = open(cfg->dump_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (w.fd < 0 || fddi_spsc_init(&w.queue, FDDIGEN_DUMP_QUEUE) < 0) {
+    fprintf(stderr, "Failed to set up the dump writer for %s\n", cfg->dump_path);
+    return 1;
+  }
+  pthread_t thread;
+  start = monotonic_ns();
+  if (pthread_create(&thread, NULL, dump_writer_main, &w) != 0) {
+    fprintf(stderr, "Failed to start dump writer\n");
+    return 1;
+  }
+
+  // В fddiv поток приёма при полной очереди теряет кадр; здесь он ждёт,
+  // чтобы оба пути вывели одно и то же число кадров
+  unsigned long long full = 0;
+  uint64_t waited_ns = 0;
+  for (unsigned long long i = 0; i < cfg->count; i++) {
+    unsigned int t = i % FDDIGEN_TEMPLATES;
+    struct fddi_frame_slot *slot = fddi_spsc_reserve(&w.queue);
+    if (!slot) {
+      uint64_t wait_start = monotonic_ns();
+      full++;
+      while ((slot = fddi_spsc_reserve(&w.queue)) == NULL) {
+        sched_yield();
+      }
+      waited_ns += monotonic_ns() - wait_start;
+    }
+    slot->ts_ns = 0;
+    slot->len = template_len[t];
+    slot->caplen = template_len[t];
+    slot->iface = 0;
+    memcpy(slot->data, templates[t], template_len[t]);
+    fddi_spsc_commit(&w.queue);
+  }
+  uint64_t produce_ns = monotonic_ns() - start - waited_ns;
+  w.stop.store(1, std::memory_order_release);
+  pthread_join(thread, NULL);
+  uint64_t fast_ns = monotonic_ns() - start;
+  close(w.fd);
+  fddi_spsc_destroy(&w.queue);
+  if (w.failed) {
+    fprintf(stderr, "Dump writer failed\n");
+    return 1;
+  }
+
+  // Для канала ftell не работает; тогда байты printf считаются равными
+  // байтам очереди - текст обоих путей проверен выше
+  dump_report("printf", cfg->count, slow_bytes > 0 ? (unsigned long long)slow_bytes : w.bytes, slow_ns);
+  dump_report("queue", cfg->count, w.bytes, fast_ns);
+  printf("Dump: capture thread %.1f ns/frame with the queue (queue full %llu times), %.1f ns/frame with printf\n",
+         (double)produce_ns / cfg->count, full, (double)slow_ns / cfg->count);
+  return 0;
+}
+
+// --- Проверка и замер разбора кадров (-D) ---
+
+static uint64_t fuzz_next(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+// Случайный кадр: длина чаще всего около границ заголовков, FC из
+// интересных значений или любой, на месте LLC часто стоит AA AA 03
+static unsigned int fuzz_frame(uint64_t *rng, unsigned char *frame, unsigned int cap) {
+  static const unsigned char fcs[] = {
+    FDDI_FC_K_NON_RESTRICTED_TOKEN, FDDI_FC_K_RESTRICTED_TOKEN, FDDI_FC_K_VOID, FDDI_FC_K_SMT_MIN,
+    FDDI_FC_K_SMT_MAX, FDDI_FC_K_MAC_MIN, FDDI_FC_K_MAC_MAX, FDDI_FC_K_ASYNC_LLC_MIN,
+    FDDI_FC_K_ASYNC_LLC_DEF, FDDI_FC_K_SYNC_LLC_MIN, 0x10, 0x14, 0x90, FDDI_FC_K_IMPLEMENTOR_MIN,
+    FDDI_FC_K_RESERVED_MIN, 0x01, 0xc0 | 0x0f,
+  };
+  uint64_t r = fuzz_next(rng);
+  unsigned int len;
+
+  switch (r & 7) {
+  case 0: case 1: case 2: case 3:
+    len = (r >> 8) % (FDDI_K_SNAP_HLEN + 4);
+    break;
+  case 4: case 5:
+    len = (r >> 8) % 256;
+    break;
+  case 6:
+    len = (r >> 8) % (FDDI_K_LLC_LEN + 1);
+    break;
+  default:
+    // Длиннее 0xffff: fddi_batch_add ограничивает длину
+    len = (r >> 8) % 8 == 0 ? 0x10000 + (r >> 16) % 64 : (r >> 8) % cap;
+    break;
+  }
+  if (len > cap) {
+    len = cap;
+  }
+
+  for (unsigned int i = 0; i < len; i += 8) {
+    uint64_t bytes = fuzz_next(rng);
+    memcpy(frame + i, &bytes, len - i < 8 ? len - i : 8);
+  }
+  r = fuzz_next(rng);
+  if (len > 0 && (r & 3) != 0) {
+    frame[0] = fcs[(r >> 2) % sizeof(fcs)];
+  }
+  if ((r >> 8) & 1) {
+    // LLC после 48- или 16-битных адресов, поле управления U/I/S
+    unsigned int llc = (r >> 9) & 1 ? 1 + 2 * FDDI_K_ALEN : 1 + 2 * 2;
+    static const unsigned char ctrls[] = {FDDI_UI_CMD, 0x00, 0x01, 0x02, 0x07, 0xff};
+    unsigned char llc_hdr[3] = {FDDI_EXTENDED_SAP, FDDI_EXTENDED_SAP, ctrls[(r >> 10) % sizeof(ctrls)]};
+    for (unsigned int i = 0; i < 3 && llc + i < len; i++) {
+      if ((r >> (16 + i)) & 7) {
+        frame[llc + i] = llc_hdr[i];
+      }
+    }
+  }
+  return len;
+}
+
+static void fuzz_report(const unsigned char *frame, unsigned int len, unsigned char scalar, unsigned char batch) {
+  fprintf(stderr, "Decode mismatch: fddi_decode %s, fddi_batch_classify %s, %u bytes:", fddi_class_names[scalar],
+          fddi_class_names[batch], len);
+  for (unsigned int i = 0; i < len && i < 32; i++) {
+    fprintf(stderr, " %02x", frame[i]);
+  }
+  fprintf(stderr, "\n");
+}
+
+// Разбор всех кадров буфера: каждый в отдельном выделении точно своей
+// длины, чтобы ASan видел выход за кадр
+static int decode_check(const struct gen_config *cfg) {
+  static unsigned char scratch[0x10000 + 64];
+  unsigned char *frames[FDDI_BATCH_MAX];
+  unsigned int lens[FDDI_BATCH_MAX];
+  struct fddi_batch batch;
+  struct fddi_frame_view view;
+  unsigned long long classes[FDDI_CLASS_COUNT];
+  uint64_t rng = cfg->seed ? cfg->seed : 1;
+
+  memset(classes, 0, sizeof(classes));
+  for (unsigned long long done = 0; done < cfg->count;) {
+    unsigned int n = cfg->count - done < FDDI_BATCH_MAX ? cfg->count - done : FDDI_BATCH_MAX;
+    fddi_batch_reset(&batch);
+    for (unsigned int i = 0; i < n; i++) {
+      lens[i] = fuzz_frame(&rng, scratch, sizeof(scratch));
+      frames[i] = (unsigned char *)malloc(lens[i] ? lens[i] : 1);
+      memcpy(frames[i], scratch, lens[i]);
+      fddi_batch_add(&batch, frames[i], lens[i]);
+    }
+    fddi_batch_classify(&batch);
+
+    int failed = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      unsigned char cls = fddi_decode(frames[i], lens[i], &view);
+      if (!failed && cls != batch.cls[i]) {
+        fuzz_report(frames[i], lens[i], cls, batch.cls[i]);
+        failed = 1;
+      }
+      classes[cls]++;
+      free(frames[i]);
+    }
+    if (failed) {
+      fprintf(stderr, "Seed %llu, frame %llu of the run\n", cfg->seed, done);
+      return -1;
+    }
+    done += n;
+  }
+
+  printf("Decode check: %llu random frames, batch and scalar agree;", cfg->count);
+  for (int c = 0; c < FDDI_CLASS_COUNT; c++) {
+    printf(" %s %llu", fddi_class_names[c], classes[c]);
+  }
+  printf("\n");
+  return 0;
+}
+
+static int decode_fuzz(const struct gen_config *cfg) {
+  if (decode_check(cfg) < 0) {
+    return 1;
+  }
+
+  // Замер на шаблонах смеси: разбор по одному кадру и пачками по 64
+  unsigned long long frames = (unsigned long long)FDDIGEN_TEMPLATES * FDDIGEN_DECODE_ROUNDS;
+  struct fddi_frame_view view;
+  volatile unsigned int sink = 0;
+  uint64_t start = monotonic_ns();
+  for (unsigned int round = 0; round < FDDIGEN_DECODE_ROUNDS; round++) {
+    unsigned int acc = 0;
+    for (unsigned int t = 0; t < FDDIGEN_TEMPLATES; t++) {
+      acc += fddi_decode(templates[t], template_len[t], &view);
+    }
+    sink += acc;
+  }
+  uint64_t scalar_ns = monotonic_ns() - start;
+
+  struct fddi_batch batch;
+  unsigned long long counts[FDDI_CLASS_COUNT];
+  memset(counts, 0, sizeof(counts));
+  start = monotonic_ns();
+  for (unsigned int round = 0; round < FDDIGEN_DECODE_ROUNDS; round++) {
+    for (unsigned int t = 0; t < FDDIGEN_TEMPLATES; t += FDDI_BATCH_MAX) {
+      fddi_batch_reset(&batch);
+      for (unsigned int i = 0; i < FDDI_BATCH_MAX; i++) {
+        fddi_batch_add(&batch, templates[t + i], template_len[t + i]);
+      }
+      fddi_batch_classify(&batch);
+      fddi_batch_count(&batch, counts);
+    }
+  }
+  uint64_t batch_ns = monotonic_ns() - start;
+  sink += counts[FDDI_CLASS_SNAP];
+  (void)sink;
+
+  printf("Decode: fddi_decode %.1f Mframes/s (%.2f ns/frame), fddi_batch_classify %.1f Mframes/s (%.2f ns/frame)\n",
+         frames * 1e3 / scalar_ns, (double)scalar_ns / frames, frames * 1e3 / batch_ns, (double)batch_ns / frames);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  struct gen_config cfg;
+  if (parse_args(argc, argv, &cfg) < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (cfg.dump_bench) {
+    build_templates(&cfg);
+    return dump_bench(&cfg);
+  }
+  if (cfg.decode_fuzz) {
+    build_templates(&cfg);
+    return decode_fuzz(&cfg);
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_stop_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  int fd = socket(PF_PACKET, SOCK_RAW, 0);
+  if (fd < 0) {
+    perror("socket creation failed");
+    return 1;
+  }
+
+  // Отправка мимо qdisc: генератор не должен сам быть узким местом
+  int one = 1;
+  setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+
+  struct sockaddr_ll sll;
+  memset(&sll, 0, sizeof(sll));
+  sll.sll_family = AF_PACKET;
+  sll.sll_ifindex = if_nametoindex(cfg.ifname);
+  sll.sll_protocol = 0;
+  if (sll.sll_ifindex == 0) {
+    fprintf(stderr, "Unknown interface %s\n", cfg.ifname);
+    return 1;
+  }
+  if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+    perror("bind failed");
+    return 1;
+  }
+
+  build_templates(&cfg);
+
+  struct mmsghdr *msgs = (struct mmsghdr *)calloc(cfg.batch, sizeof(*msgs));
+  struct iovec *iovs = (struct iovec *)calloc(cfg.batch, sizeof(*iovs));
+  if (!msgs || !iovs) {
+    fprintf(stderr, "Failed to allocate send batch\n");
+    return 1;
+  }
+  for (unsigned int i = 0; i < cfg.batch; i++) {
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  unsigned long long sent = 0;
+  unsigned long long bytes = 0;
+  unsigned long long errors = 0;
+  unsigned int next_template = 0;
+  uint64_t start = monotonic_ns();
+  uint64_t end = cfg.count ? 0 : start + (uint64_t)cfg.seconds * 1000000000ull;
+  uint64_t next_batch = start;
+
+  while (!g_stop) {
+    uint64_t now = monotonic_ns();
+    if (cfg.count ? sent >= cfg.count : now >= end) {
+      break;
+    }
+
+    unsigned int n = cfg.batch;
+    if (cfg.count && cfg.count - sent < n) {
+      n = cfg.count - sent;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      unsigned int t = (next_template + i) % FDDIGEN_TEMPLATES;
+      iovs[i].iov_base = templates[t];
+      iovs[i].iov_len = template_len[t];
+    }
+
+    if (cfg.rate) {
+      wait_until(next_batch);
+      next_batch += (uint64_t)n * 1000000000ull / cfg.rate;
+    }
+
+    int done = sendmmsg(fd, msgs, n, 0);
+    if (done < 0) {
+      if (errno != EINTR) {
+        // ENOBUFS и подобные: кадры пачки считаются неотправленными
+        errors += n;
+      }
+      continue;
+    }
+    for (int i = 0; i < done; i++) {
+      bytes += iovs[i].iov_len;
+    }
+    errors += n - done;
+    sent += done;
+    next_template = (next_template + done) % FDDIGEN_TEMPLATES;
+  }
+
+  double elapsed = (monotonic_ns() - start) / 1e9;
+  printf("Sent: %llu frames, %llu bytes in %.3f s, %.0f pps, %.1f Mbit/s, send errors %llu\n", sent,
+         bytes, elapsed, elapsed > 0 ? sent / elapsed : 0.0, elapsed > 0 ? bytes * 8 / elapsed / 1e6 : 0.0,
+         errors);
+
+  free(msgs);
+  free(iovs);
+  close(fd);
+  return 0;
+}
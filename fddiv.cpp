@@ -9,6 +9,29 @@
 // - Код выводит содержимое пакета в шестнадцатеричном виде.
 // - Код подсчитывает количество полученных пакетов.
 // - Код выводит статистику каждые 10 секунд.
+// - Режим "-m ring" читает кадры прямо из кольцевого буфера TPACKET_V3
+//   без копирования и без отдельного recv() на каждый кадр.
+// - Опция "-w N" запускает N потоков-обработчиков в группе PACKET_FANOUT,
+//   каждый на своём ядре; счётчики потоков суммируются в отчёте.
+// - Шестнадцатеричный вывод формирует отдельный поток: кадры передаются ему
+//   через очереди SPSC, а текст пишется крупными блоками. Опция "-s"
+//   отключает вывод содержимого и оставляет только статистику.
+// - Опция "-o файл" вместо текста пишет кадры целиком (с заголовком FDDI)
+//   в pcapng с наносекундными метками и ротацией файлов (-C, -G, -W).
+// - Опция "-f выражение" компилирует фильтр (SAP, SNAP, адреса, длина)
+//   в BPF, и ненужные кадры отбрасываются ещё в ядре.
+// - Опция "-c" разбирает заголовки FDDI/LLC/SNAP пачками и добавляет
+//   в отчёт число кадров каждого класса.
+// - Опция "-i" задаёт интерфейс вместо "fddi0". При выходе выводится
+//   итог: принято, потеряно и процессорное время на пакет (см. fddibench.sh).
+// - Опцию "-i" можно повторять или перечислить интерфейсы через запятую:
+//   один процесс принимает со всех сразу в цикле epoll, счётчики и файлы
+//   pcapng ведутся по интерфейсам. Выключение, удаление и возвращение
+//   интерфейса отслеживаются через rtnetlink без перезапуска.
+// - Опция "-T путь" дублирует счётчики интерфейсов (пакеты, байты,
+//   потери) в сегмент телеметрии (telemetry.h): потоки приёма прибавляют
+//   к ним по пачке, и telemetry_read снимает их с любой частотой, не
+//   дожидаясь отчёта раз в 10 секунд.
 
 
 // This code is intended to run on ZenithOS, which has root privileges.
@@ -22,77 +45,1329 @@
 // - The code prints the contents of the packet in hexadecimal.
 // - The code counts the number of packets received.
 // - The code prints statistics every 10 seconds.auto 
+// - The "-m ring" mode walks frames in place in a TPACKET_V3 ring buffer,
+//   without a copy and without a recv() call per frame.
+// - The "-w N" option runs N worker threads in a PACKET_FANOUT group,
+//   each pinned to its own core; worker counters are merged in the report.
+// - The hex dump is produced by a separate writer thread: frames reach it
+//   through SPSC queues and the text is written in large blocks. The "-s"
+//   option turns the dump off and keeps only the statistics.
+// - The "-o file" option writes whole frames (with the FDDI header) to
+//   pcapng with nanosecond timestamps and file rotation (-C, -G, -W).
+// - The "-f expression" option compiles a filter (SAP, SNAP, addresses,
+//   length) to BPF so unwanted frames are dropped in the kernel.
+// - The "-c" option decodes FDDI/LLC/SNAP headers in batches and adds
+//   per-class frame counts to the report.
+// - The "-i" option selects an interface other than "fddi0". On exit the
+//   totals are printed: received, dropped and CPU time per packet
+//   (see fddibench.sh).
+// - The "-i" option can be repeated or list interfaces separated by commas:
+//   one process captures from all of them in an epoll loop, with counters
+//   and pcapng files kept per interface. Interfaces going down, being
+//   removed and coming back are tracked over rtnetlink without a restart.
+// - The "-T path" option mirrors the interface counters (packets, bytes,
+//   drops) into a telemetry segment (telemetry.h): the workers add to
+//   them once per batch, and telemetry_read can sample them at any rate
+//   instead of waiting for the 10-second report.
 
 
 
 
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include "fddi.h"
 #include "if_hddi.h"
 #include "fddi2.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <atomic>
+#include "fddi_spsc.h"
+#include "fddi_pcapng.h"
+#include "fddi_dump.h"
+#include "fddi_bpf.h"
+#include "fddi_decode.h"
+#include "telemetry.h"
 
-int main() {
-  int fd = socket(PF_PACKET, SOCK_DGRAM, 0);
+// Параметры кольцевого буфера TPACKET_V3 по умолчанию
+#define FDDI_RING_BLOCK_SIZE (1 << 20)
+#define FDDI_RING_BLOCK_COUNT 64
+#define FDDI_RING_FRAME_SIZE 2048
+#define FDDI_RING_RETIRE_TIMEOUT_MS 60
+
+#define FDDI_DEFAULT_INTERFACE "fddi0"
+#define FDDI_STATS_INTERVAL 10
+#define FDDI_MAX_WORKERS 64
+#define FDDI_MAX_INTERFACES 16
+#define FDDI_RECV_BATCH 32
+// Сколько пачек (или блоков кольца) читается с одного сокета подряд,
+// прежде чем очередь дойдёт до остальных интерфейсов
+#define FDDI_DRAIN_ROUNDS 8
+#define FDDI_CACHE_LINE 64
+#define FDDI_OUTPUT_QUEUE_SLOTS 1024
+#define FDDI_OUTPUT_BUFFER_SIZE (1 << 20)
+
+enum output_mode {
+  OUTPUT_TEXT,     // шестнадцатеричный дамп в stdout
+  OUTPUT_NONE,     // только статистика (-s)
+  OUTPUT_PCAPNG,   // запись в файлы pcapng (-o)
+};
+
+struct capture_config {
+  const char *ifnames[FDDI_MAX_INTERFACES];
+  unsigned int iface_count;
+  int use_ring;
+  unsigned int block_size;
+  unsigned int block_count;
+  unsigned int retire_timeout_ms;
+  unsigned int workers;
+  int fanout_type;
+  unsigned int batch;
+  int output_mode;
+  unsigned int queue_slots;
+  int raw_frames;
+  const char *pcapng_path;
+  unsigned long long rotate_bytes;
+  unsigned int rotate_seconds;
+  unsigned int max_files;
+  const char *filter;
+  int dump_filter;
+  int classify;
+  const char *telemetry_path;
+  struct fddi_bpf_program bpf;
+};
+
+struct capture_ring {
+  unsigned char *map;
+  size_t map_size;
+  unsigned int block_size;
+  unsigned int block_count;
+};
+
+// Счётчики одного сокета. Пишет их только поток-владелец, поэтому атомарная
+// запись без lock-префикса достаточна; выравнивание по строке кэша
+// исключает ложное разделение между потоками.
+struct alignas(FDDI_CACHE_LINE) worker_counters {
+  std::atomic<unsigned long long> packets;
+  std::atomic<unsigned long long> bytes;
+  std::atomic<unsigned long long> kernel_drops;
+  std::atomic<unsigned long long> output_drops;
+  std::atomic<unsigned long long> truncated;    // кадры длиннее слота очереди
+  std::atomic<unsigned long long> classes[FDDI_CLASS_COUNT];
+};
+
+// Сокет потока на одном интерфейсе. Пока интерфейс выключен или удалён,
+// сокет закрыт (fd == -1); счётчики при этом сохраняются.
+struct capture_source {
+  unsigned int iface;              // номер интерфейса в cfg->ifnames
+  int ifindex;
+  int fd;
+  struct capture_ring ring;
+  unsigned int block_num;          // следующий блок кольца
+  std::atomic<int> up;             // для отчёта: сокет открыт
+  struct worker_counters counters;
+  struct telemetry_iface *telemetry;   // слот интерфейса в сегменте (-T), NULL - без него
+};
+
+// Поток приёма: один цикл epoll на сокеты всех интерфейсов и сокет
+// rtnetlink, по которому приходят события включения и выключения.
+struct capture_worker {
+  unsigned int id;
+  int cpu;
+  int epfd;
+  int nlfd;
+  int fanout_group;
+  struct capture_source sources[FDDI_MAX_INTERFACES];
+  unsigned int source_count;
+  struct fddi_spsc_queue queue;
+  const struct capture_config *cfg;
+  pthread_t thread;
+};
+
+static std::atomic<int> g_running(1);
+
+static void handle_stop_signal(int sig) {
+  (void)sig;
+  g_running.store(0);
+}
+
+static void counter_add(std::atomic<unsigned long long> &counter, unsigned long long value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Пачка кадров в счётчиках сокета и в сегменте телеметрии. Слот
+// интерфейса общий для всех потоков, поэтому там сложение атомарное.
+static void count_batch(struct capture_source *src, unsigned long long packets, unsigned long long bytes) {
+  counter_add(src->counters.packets, packets);
+  counter_add(src->counters.bytes, bytes);
+  if (src->telemetry) {
+    telemetry_add(src->telemetry->packets, packets);
+    telemetry_add(src->telemetry->bytes, bytes);
+  }
+}
+
+static void count_kernel_drops(struct capture_source *src, unsigned long long drops) {
+  counter_add(src->counters.kernel_drops, drops);
+  if (src->telemetry && drops) {
+    telemetry_add(src->telemetry->drops, drops);
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-i interface[,interface...]] [-m recv|ring] [-b block_size] [-n block_count] [-t retire_timeout_ms]\n"
+          "          [-w workers] [-F hash|cpu|rr] [-B batch] [-s] [-q queue_slots] [-r]\n"
+          "          [-o file.pcapng [-C megabytes] [-G seconds] [-W files]] [-f filter [-d]] [-c] [-T path]\n"
+          "  -i  interfaces to capture on, repeatable or comma-separated (default %s, max %d)\n"
+          "  -m  capture mode: recv (recvmmsg batches) or ring (TPACKET_V3 mmap ring)\n"
+          "  -b  ring block size in bytes, multiple of the page size (default %d)\n"
+          "  -n  number of ring blocks per worker (default %d)\n"
+          "  -t  block retire timeout in milliseconds (default %d)\n"
+          "  -w  number of worker threads in the fanout group (default 1, max %d)\n"
+          "  -F  fanout policy: hash (flow hash), cpu (receiving CPU) or rr (round-robin)\n"
+          "  -B  frames per recvmmsg call in recv mode (default %d)\n"
+          "  -s  summary only: count frames without dumping their contents\n"
+          "  -q  output queue slots per worker (default %d)\n"
+          "  -r  capture whole link-level frames including the FDDI MAC header\n"
+          "  -o  write frames to a pcapng file instead of the hex dump (implies -r)\n"
+          "  -C  start a new pcapng file after this many megabytes\n"
+          "  -G  start a new pcapng file after this many seconds\n"
+          "  -W  keep at most this many rotated files, reusing the oldest names\n"
+          "  -f  kernel filter, e.g. \"sap=42,aa snap=000000/0800 src=00:11:22:33:44:55 len=60-1500\"\n"
+          "      keys: dsap, ssap, sap, snap=OUI[/TYPE], src, dst, len=MIN[-MAX];\n"
+          "      terms are ANDed, comma-separated values are ORed\n"
+          "  -d  print the compiled BPF program and exit\n"
+          "  -c  count frames per FDDI/LLC/SNAP class in the report (implies -r)\n"
+          "  -T  also publish interface counters to this telemetry segment, e.g. " TELEMETRY_DEFAULT_PATH "\n",
+          prog, FDDI_DEFAULT_INTERFACE, FDDI_MAX_INTERFACES, FDDI_RING_BLOCK_SIZE, FDDI_RING_BLOCK_COUNT, FDDI_RING_RETIRE_TIMEOUT_MS,
+          FDDI_MAX_WORKERS, FDDI_RECV_BATCH, FDDI_OUTPUT_QUEUE_SLOTS);
+}
+
+static int parse_args(int argc, char **argv, struct capture_config *cfg) {
+  int opt;
+
+  cfg->iface_count = 0;
+  cfg->use_ring = 0;
+  cfg->block_size = FDDI_RING_BLOCK_SIZE;
+  cfg->block_count = FDDI_RING_BLOCK_COUNT;
+  cfg->retire_timeout_ms = FDDI_RING_RETIRE_TIMEOUT_MS;
+  cfg->workers = 1;
+  cfg->fanout_type = PACKET_FANOUT_HASH;
+  cfg->batch = FDDI_RECV_BATCH;
+  cfg->output_mode = OUTPUT_TEXT;
+  cfg->queue_slots = FDDI_OUTPUT_QUEUE_SLOTS;
+  cfg->raw_frames = 0;
+  cfg->pcapng_path = NULL;
+  cfg->rotate_bytes = 0;
+  cfg->rotate_seconds = 0;
+  cfg->max_files = 0;
+  cfg->filter = NULL;
+  cfg->dump_filter = 0;
+  cfg->classify = 0;
+  cfg->telemetry_path = NULL;
+
+  while ((opt = getopt(argc, argv, "i:m:b:n:t:w:F:B:sq:ro:C:G:W:f:dcT:h")) != -1) {
+    switch (opt) {
+    case 'i':
+      // Опцию можно повторять, в одном значении имена идут через запятую
+      for (char *name = strtok(optarg, ","); name; name = strtok(NULL, ",")) {
+        if (cfg->iface_count == FDDI_MAX_INTERFACES) {
+          fprintf(stderr, "At most %d interfaces are supported\n", FDDI_MAX_INTERFACES);
+          return -1;
+        }
+        if (strlen(name) >= IFNAMSIZ) {
+          fprintf(stderr, "Interface name too long: %s\n", name);
+          return -1;
+        }
+        cfg->ifnames[cfg->iface_count++] = name;
+      }
+      break;
+    case 'm':
+      if (strcmp(optarg, "ring") == 0) {
+        cfg->use_ring = 1;
+      } else if (strcmp(optarg, "recv") == 0) {
+        cfg->use_ring = 0;
+      } else {
+        fprintf(stderr, "Unknown capture mode: %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 'b':
+      cfg->block_size = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      cfg->block_count = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      cfg->retire_timeout_ms = strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      cfg->workers = strtoul(optarg, NULL, 0);
+      break;
+    case 'F':
+      if (strcmp(optarg, "hash") == 0) {
+        cfg->fanout_type = PACKET_FANOUT_HASH;
+      } else if (strcmp(optarg, "cpu") == 0) {
+        cfg->fanout_type = PACKET_FANOUT_CPU;
+      } else if (strcmp(optarg, "rr") == 0) {
+        cfg->fanout_type = PACKET_FANOUT_LB;
+      } else {
+        fprintf(stderr, "Unknown fanout policy: %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 'B':
+      cfg->batch = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      cfg->output_mode = OUTPUT_NONE;
+      break;
+    case 'q':
+      cfg->queue_slots = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      cfg->raw_frames = 1;
+      break;
+    case 'o':
+      cfg->pcapng_path = optarg;
+      break;
+    case 'C':
+      cfg->rotate_bytes = strtoull(optarg, NULL, 0) * 1000000ull;
+      break;
+    case 'G':
+      cfg->rotate_seconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'W':
+      cfg->max_files = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      cfg->filter = optarg;
+      break;
+    case 'd':
+      cfg->dump_filter = 1;
+      break;
+    case 'c':
+      cfg->classify = 1;
+      cfg->raw_frames = 1;
+      break;
+    case 'T':
+      cfg->telemetry_path = optarg;
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  if (cfg->iface_count == 0) {
+    cfg->ifnames[cfg->iface_count++] = FDDI_DEFAULT_INTERFACE;
+  }
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (cfg->block_size == 0 || cfg->block_size % page_size != 0 ||
+      cfg->block_size < FDDI_RING_FRAME_SIZE) {
+    fprintf(stderr, "Block size must be a non-zero multiple of %ld bytes\n", page_size);
+    return -1;
+  }
+  if (cfg->block_count == 0) {
+    fprintf(stderr, "Block count must be non-zero\n");
+    return -1;
+  }
+  if (cfg->workers == 0 || cfg->workers > FDDI_MAX_WORKERS) {
+    fprintf(stderr, "Worker count must be between 1 and %d\n", FDDI_MAX_WORKERS);
+    return -1;
+  }
+  if (cfg->batch == 0) {
+    fprintf(stderr, "Batch size must be non-zero\n");
+    return -1;
+  }
+  if (cfg->queue_slots == 0) {
+    fprintf(stderr, "Queue size must be non-zero\n");
+    return -1;
+  }
+
+  // В pcapng нужен кадр целиком, поэтому сокет открывается как SOCK_RAW
+  if (cfg->pcapng_path) {
+    cfg->output_mode = OUTPUT_PCAPNG;
+    cfg->raw_frames = 1;
+  }
+  if (cfg->max_files != 0 && cfg->rotate_bytes == 0 && cfg->rotate_seconds == 0) {
+    fprintf(stderr, "-W requires -C or -G\n");
+    return -1;
+  }
+  if (cfg->filter && fddi_bpf_compile(cfg->filter, &cfg->bpf) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+// Передача кадра потоку вывода. Поток приёма не ждёт: если очередь
+// заполнена, кадр не выводится и учитывается в счётчике потерь вывода.
+// В кольце tp_snaplen ограничен только размером блока, поэтому кадр
+// длиннее слота обрезается до FDDI_K_LLC_LEN, а исходная длина сохраняется.
+static void handle_frame(struct capture_worker *worker, struct capture_source *src,
+                         const unsigned char *data, unsigned int len, uint64_t ts_ns) {
+  if (worker->cfg->output_mode == OUTPUT_NONE) {
+    return;
+  }
+
+  struct fddi_frame_slot *slot = fddi_spsc_reserve(&worker->queue);
+  if (!slot) {
+    counter_add(src->counters.output_drops, 1);
+    if (src->telemetry) {
+      telemetry_add(src->telemetry->output_drops, 1);
+    }
+    return;
+  }
+  unsigned int caplen = len;
+  if (caplen > sizeof(slot->data)) {
+    caplen = sizeof(slot->data);
+    counter_add(src->counters.truncated, 1);
+  }
+  slot->ts_ns = ts_ns;
+  slot->len = len;
+  slot->caplen = caplen;
+  slot->iface = src->iface;
+  memcpy(slot->data, data, caplen);
+  fddi_spsc_commit(&worker->queue);
+}
+
+// Классы кадров пачки складываются в счётчики сокета одной записью
+// на класс, а не на кадр
+static void classify_batch(struct worker_counters *counters, struct fddi_batch *batch) {
+  unsigned long long counts[FDDI_CLASS_COUNT];
+  memset(counts, 0, sizeof(counts));
+
+  fddi_batch_classify(batch);
+  fddi_batch_count(batch, counts);
+  for (int i = 0; i < FDDI_CLASS_COUNT; i++) {
+    if (counts[i] != 0) {
+      counter_add(counters->classes[i], counts[i]);
+    }
+  }
+  fddi_batch_reset(batch);
+}
+
+struct output_stage {
+  struct capture_worker *workers;
+  unsigned int count;
+  const struct capture_config *cfg;
+  struct fddi_pcapng_writer pcapng[FDDI_MAX_INTERFACES];   // по файлу на интерфейс
+  std::atomic<int> stop;           // потоки приёма завершены, осталось дочитать очереди
+  pthread_t thread;
+};
+
+static uint64_t realtime_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Поток вывода: забирает кадры из очередей всех потоков приёма и пишет
+// их крупными блоками: текст в stdout или блоки pcapng в файл интерфейса,
+// с которого пришёл кадр. Текстовый
+// буфер сбрасывается только на границе кадров, поэтому строки отчёта не
+// попадают внутрь дампа. Поток завершается по stage->stop, который
+// ставится после остановки потоков приёма, и перед выходом дочитывает
+// очереди: кадры, принятые до SIGINT, не теряются.
+static void *output_main(void *arg) {
+  struct output_stage *stage = (struct output_stage *)arg;
+  int pcapng = stage->cfg->output_mode == OUTPUT_PCAPNG;
+  int multi = stage->cfg->iface_count > 1;
+  int failed = 0;
+  char *buffer = NULL;
+  char *out = NULL;
+  unsigned int idle_rounds = 0;
+
+  if (!pcapng) {
+    buffer = (char *)malloc(FDDI_OUTPUT_BUFFER_SIZE);
+    if (!buffer) {
+      fprintf(stderr, "Failed to allocate output buffer\n");
+      return NULL;
+    }
+    out = buffer;
+  }
+
+  for (;;) {
+    // stop читается до прохода по очередям: если после него очереди
+    // оказались пусты, новых кадров уже не будет
+    int stopping = stage->stop.load(std::memory_order_acquire);
+    int progress = 0;
+
+    for (unsigned int i = 0; i < stage->count; i++) {
+      struct fddi_spsc_queue *queue = &stage->workers[i].queue;
+      struct fddi_frame_slot *slot;
+
+      while ((slot = fddi_spsc_front(queue)) != NULL) {
+        if (failed) {
+          // Файл уже не пишется: очереди только освобождаются
+        } else if (pcapng) {
+          if (fddi_pcapng_write(&stage->pcapng[slot->iface], slot->data, slot->caplen, slot->len,
+                                slot->ts_ns) < 0) {
+            // Запись в файл невозможна (например, диск заполнен):
+            // ошибка уже выведена, захват останавливается
+            failed = 1;
+            g_running.store(0);
+          }
+        } else {
+          if (out - buffer > FDDI_OUTPUT_BUFFER_SIZE - FDDI_DUMP_MAX_LEN) {
+            fddi_dump_write(STDOUT_FILENO, buffer, out - buffer);
+            out = buffer;
+          }
+          out = fddi_dump_frame(out, multi ? stage->cfg->ifnames[slot->iface] : NULL, slot->data, slot->len,
+                                slot->caplen);
+        }
+        fddi_spsc_pop(queue);
+        progress = 1;
+      }
+    }
+
+    if (progress) {
+      idle_rounds = 0;
+      continue;
+    }
+    if (stopping) {
+      break;
+    }
+
+    // Очереди пусты: выводим накопленное и коротко ждём
+    if (pcapng) {
+      for (unsigned int i = 0; i < stage->cfg->iface_count; i++) {
+        fddi_pcapng_flush(&stage->pcapng[i]);
+      }
+    } else if (out != buffer) {
+      fddi_dump_write(STDOUT_FILENO, buffer, out - buffer);
+      out = buffer;
+    }
+    if (++idle_rounds < 64) {
+      sched_yield();
+    } else {
+      usleep(1000);
+    }
+  }
+
+  if (pcapng) {
+    for (unsigned int i = 0; i < stage->cfg->iface_count; i++) {
+      fddi_pcapng_close(&stage->pcapng[i]);
+    }
+  } else {
+    if (out != buffer) {
+      fddi_dump_write(STDOUT_FILENO, buffer, out - buffer);
+    }
+    free(buffer);
+  }
+  return NULL;
+}
+
+// Настройка кольцевого буфера TPACKET_V3. Должна выполняться до bind(),
+// чтобы ни один кадр не прошёл мимо кольца.
+static int setup_ring(int fd, const struct capture_config *cfg, struct capture_ring *ring) {
+  int version = TPACKET_V3;
+  if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+    perror("PACKET_VERSION failed");
+    return -1;
+  }
+
+  struct tpacket_req3 req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = cfg->block_size;
+  req.tp_block_nr = cfg->block_count;
+  req.tp_frame_size = FDDI_RING_FRAME_SIZE;
+  req.tp_frame_nr = (cfg->block_size / FDDI_RING_FRAME_SIZE) * cfg->block_count;
+  req.tp_retire_blk_tov = cfg->retire_timeout_ms;
+  req.tp_feature_req_word = 0;
+
+  if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    perror("PACKET_RX_RING failed");
+    return -1;
+  }
+
+  ring->block_size = cfg->block_size;
+  ring->block_count = cfg->block_count;
+  ring->map_size = (size_t)cfg->block_size * cfg->block_count;
+  ring->map = (unsigned char *)mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd, 0);
+  if (ring->map == MAP_FAILED) {
+    perror("mmap failed");
+    ring->map = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+// Открытие сокета интерфейса: фильтр и кольцо (если нужны), bind на интерфейс,
+// присоединение к группе PACKET_FANOUT, которая возможна только после bind(),
+// и регистрация в epoll потока. При ошибке сокет закрывается.
+static int open_source(struct capture_worker *worker, struct capture_source *src, int ifindex) {
+  const struct capture_config *cfg = worker->cfg;
+  int fd = socket(PF_PACKET, cfg->raw_frames ? SOCK_RAW : SOCK_DGRAM, 0);
   if (fd < 0) {
     perror("socket creation failed");
-    return 1;
+    return -1;
   }
+  src->fd = fd;
+  src->ifindex = ifindex;
+  src->block_num = 0;
 
-  struct sockaddr_ll sll;
-  memset(&sll, 0, sizeof(sll));
-  sll.sll_family = AF_PACKET;
-  sll.sll_ifindex = if_nametoindex("fddi0");
-  sll.sll_protocol = htons(ETH_P_ALL); // Принимаем все протоколы
+  // Фильтр подключается до bind(), чтобы лишние кадры не попали в очередь сокета
+  if (cfg->filter && fddi_bpf_attach(fd, &cfg->bpf) < 0) {
+    goto fail;
+  }
 
-  if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
-    perror("bind failed");
-    return 1;
+  if (cfg->use_ring && setup_ring(fd, cfg, &src->ring) < 0) {
+    goto fail;
   }
 
-  // Переменные для подсчёта пакетов и времени
-  unsigned long long packet_count = 0;
-  time_t last_stats_time = time(NULL);
+  // Метки времени ядра (SO_TIMESTAMPNS) нужны только для pcapng;
+  // в кольце они есть в заголовке каждого кадра
+  if (!cfg->use_ring && cfg->output_mode == OUTPUT_PCAPNG) {
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+      perror("SO_TIMESTAMPNS failed");
+    }
+  }
 
-  // Дальнейшая обработка пакетов FDDI
-  while (1) {
-    char buffer[FDDI_K_LLC_LEN];
-    int bytes_received = recv(fd, buffer, sizeof(buffer), 0);
-    if (bytes_received < 0) {
-      perror("recv failed");
+  {
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifindex;
+    sll.sll_protocol = htons(ETH_P_ALL); // Принимаем все протоколы
+
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+      perror("bind failed");
+      goto fail;
+    }
+  }
+
+  // У каждого интерфейса своя группа: кадры одного интерфейса делятся
+  // между потоками, но не смешиваются с кадрами другого
+  if (cfg->workers > 1) {
+    int fanout_arg = ((worker->fanout_group + src->iface) & 0xffff) | (cfg->fanout_type << 16);
+    if (cfg->fanout_type == PACKET_FANOUT_HASH) {
+      fanout_arg |= PACKET_FANOUT_FLAG_DEFRAG << 16;
+    }
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0) {
+      perror("PACKET_FANOUT failed");
+      goto fail;
+    }
+  }
+
+  {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = src;
+    if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      perror("epoll_ctl failed");
+      goto fail;
+    }
+  }
+  src->up.store(1, std::memory_order_relaxed);
+  return 0;
+
+fail:
+  if (src->ring.map) {
+    munmap(src->ring.map, src->ring.map_size);
+    src->ring.map = NULL;
+  }
+  close(fd);
+  src->fd = -1;
+  return -1;
+}
+
+// Потери ядра из PACKET_STATISTICS. Ядро обнуляет свои счётчики при
+// каждом чтении, поэтому значение относится ко времени с прошлого вызова.
+static unsigned int read_drops(int fd, int use_ring) {
+  if (use_ring) {
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+      return st.tp_drops;
+    }
+  } else {
+    struct tpacket_stats st;
+    socklen_t len = sizeof(st);
+    if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+      return st.tp_drops;
+    }
+  }
+  return 0;
+}
+
+// Закрытие сокета интерфейса; потери ядра забираются до close(), иначе
+// они пропадут вместе с сокетом. Закрытый дескриптор сам уходит из epoll.
+static void close_source(struct capture_worker *worker, struct capture_source *src) {
+  if (src->fd < 0) {
+    return;
+  }
+  count_kernel_drops(src, read_drops(src->fd, worker->cfg->use_ring));
+  if (src->ring.map) {
+    munmap(src->ring.map, src->ring.map_size);
+    src->ring.map = NULL;
+  }
+  close(src->fd);
+  src->fd = -1;
+  src->up.store(0, std::memory_order_relaxed);
+}
+
+// Буферы recvmmsg() потока, общие для всех его сокетов
+struct recv_batch {
+  unsigned int size;
+  size_t control_len;
+  unsigned char *buffers;
+  unsigned char *controls;
+  struct mmsghdr *msgs;
+  struct iovec *iovs;
+};
+
+static void free_recv_batch(struct recv_batch *rx) {
+  free(rx->buffers);
+  free(rx->controls);
+  free(rx->msgs);
+  free(rx->iovs);
+}
+
+static int alloc_recv_batch(struct recv_batch *rx, unsigned int size) {
+  rx->size = size;
+  rx->control_len = CMSG_SPACE(sizeof(struct timespec));
+  rx->buffers = (unsigned char *)malloc((size_t)size * FDDI_K_LLC_LEN);
+  rx->controls = (unsigned char *)calloc(size, rx->control_len);
+  rx->msgs = (struct mmsghdr *)calloc(size, sizeof(*rx->msgs));
+  rx->iovs = (struct iovec *)calloc(size, sizeof(*rx->iovs));
+  if (!rx->buffers || !rx->controls || !rx->msgs || !rx->iovs) {
+    free_recv_batch(rx);
+    return -1;
+  }
+
+  for (unsigned int i = 0; i < size; i++) {
+    rx->iovs[i].iov_base = rx->buffers + (size_t)i * FDDI_K_LLC_LEN;
+    rx->iovs[i].iov_len = FDDI_K_LLC_LEN;
+    rx->msgs[i].msg_hdr.msg_iov = &rx->iovs[i];
+    rx->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  return 0;
+}
+
+// Приём пачками через recvmmsg(): один системный вызов на batch кадров.
+// Сокет читается без ожидания, пока в нём есть кадры, но не больше
+// FDDI_DRAIN_ROUNDS пачек подряд. Возвращает -1 при ошибке сокета.
+static int drain_recv(struct capture_worker *worker, struct capture_source *src, struct recv_batch *rx) {
+  int want_ts = worker->cfg->output_mode == OUTPUT_PCAPNG;
+
+  for (int round = 0; round < FDDI_DRAIN_ROUNDS; round++) {
+    if (want_ts) {
+      for (unsigned int i = 0; i < rx->size; i++) {
+        rx->msgs[i].msg_hdr.msg_control = rx->controls + i * rx->control_len;
+        rx->msgs[i].msg_hdr.msg_controllen = rx->control_len;
+      }
+    }
+
+    int count = recvmmsg(src->fd, rx->msgs, rx->size, MSG_DONTWAIT, NULL);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // ENETDOWN: интерфейс выключен, сокет закроет событие rtnetlink
+      if (errno == EAGAIN || errno == ENETDOWN) {
+        return 0;
+      }
+      perror("recvmmsg failed");
+      return -1;
+    }
+
+    if (worker->cfg->classify) {
+      struct fddi_batch batch;
+      fddi_batch_reset(&batch);
+      for (int i = 0; i < count; i++) {
+        if (!fddi_batch_add(&batch, (const unsigned char *)rx->iovs[i].iov_base, rx->msgs[i].msg_len)) {
+          classify_batch(&src->counters, &batch);
+          fddi_batch_add(&batch, (const unsigned char *)rx->iovs[i].iov_base, rx->msgs[i].msg_len);
+        }
+      }
+      classify_batch(&src->counters, &batch);
+    }
+
+    unsigned long long bytes = 0;
+    for (int i = 0; i < count; i++) {
+      uint64_t ts_ns = 0;
+      if (want_ts) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&rx->msgs[i].msg_hdr);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+          struct timespec ts;
+          memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+          ts_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        }
+      }
+      handle_frame(worker, src, (const unsigned char *)rx->iovs[i].iov_base, rx->msgs[i].msg_len, ts_ns);
+      bytes += rx->msgs[i].msg_len;
+    }
+    count_batch(src, count, bytes);
+
+    // Неполная пачка: очередь сокета пуста, лишний вызов не нужен
+    if ((unsigned int)count < rx->size) {
+      break;
+    }
+  }
+  return 0;
+}
+
+// Приём из кольца TPACKET_V3: кадры разбираются прямо в общей памяти,
+// блок возвращается ядру после обработки всех его кадров. Читаются все
+// готовые блоки, но не больше FDDI_DRAIN_ROUNDS подряд.
+static int drain_ring(struct capture_worker *worker, struct capture_source *src) {
+  struct capture_ring *ring = &src->ring;
+
+  struct fddi_batch batch;
+  fddi_batch_reset(&batch);
+
+  for (int round = 0; round < FDDI_DRAIN_ROUNDS; round++) {
+    struct tpacket_block_desc *pbd =
+        (struct tpacket_block_desc *)(ring->map + (size_t)src->block_num * ring->block_size);
+
+    if ((__atomic_load_n(&pbd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
       break;
     }
 
-    // Обработка принятых данных
-    printf("Received %d bytes on FDDI interface:\n", bytes_received);
+    unsigned int num_pkts = pbd->hdr.bh1.num_pkts;
+    unsigned long long bytes = 0;
+    struct tpacket3_hdr *ppd =
+        (struct tpacket3_hdr *)((unsigned char *)pbd + pbd->hdr.bh1.offset_to_first_pkt);
+
+    for (unsigned int i = 0; i < num_pkts; i++) {
+      const unsigned char *frame = (const unsigned char *)ppd + ppd->tp_mac;
+      uint64_t ts_ns = (uint64_t)ppd->tp_sec * 1000000000ull + ppd->tp_nsec;
+      handle_frame(worker, src, frame, ppd->tp_snaplen, ts_ns);
+      if (worker->cfg->classify && !fddi_batch_add(&batch, frame, ppd->tp_snaplen)) {
+        classify_batch(&src->counters, &batch);
+        fddi_batch_add(&batch, frame, ppd->tp_snaplen);
+      }
+      bytes += ppd->tp_snaplen;
+      ppd = (struct tpacket3_hdr *)((unsigned char *)ppd + ppd->tp_next_offset);
+    }
+    // Пачка разбирается до возврата блока ядру: указатели ведут в кольцо
+    if (worker->cfg->classify) {
+      classify_batch(&src->counters, &batch);
+    }
+    count_batch(src, num_pkts, bytes);
+
+    __atomic_store_n(&pbd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    src->block_num = (src->block_num + 1) % ring->block_count;
+  }
+  return 0;
+}
+
+// Сокет rtnetlink с подпиской на изменения сетевых интерфейсов
+static int open_netlink(void) {
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) {
+    perror("rtnetlink socket failed");
+    return -1;
+  }
+
+  struct sockaddr_nl snl;
+  memset(&snl, 0, sizeof(snl));
+  snl.nl_family = AF_NETLINK;
+  snl.nl_groups = RTMGRP_LINK;
+  if (bind(fd, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+    perror("rtnetlink bind failed");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Запрос полного списка интерфейсов: ответы приходят как RTM_NEWLINK
+// и разбираются тем же кодом, что и события
+static void request_link_dump(int nlfd) {
+  struct {
+    struct nlmsghdr nlh;
+    struct ifinfomsg ifi;
+  } req;
+  memset(&req, 0, sizeof(req));
+  req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+  req.nlh.nlmsg_type = RTM_GETLINK;
+  req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.ifi.ifi_family = AF_UNSPEC;
+  if (send(nlfd, &req, req.nlh.nlmsg_len, 0) < 0) {
+    perror("rtnetlink dump request failed");
+  }
+}
+
+// Приведение сокета интерфейса к его состоянию: выключенный или удалённый
+// интерфейс закрывается, включённый открывается заново. Если интерфейс
+// пересоздан с новым индексом, старый сокет привязан к исчезнувшему
+// устройству, поэтому он тоже открывается заново.
+static void update_source(struct capture_worker *worker, struct capture_source *src, int up, int ifindex) {
+  const char *name = worker->cfg->ifnames[src->iface];
+
+  if (src->fd >= 0 && (!up || ifindex != src->ifindex)) {
+    close_source(worker, src);
+    if (worker->id == 0) {
+      fprintf(stderr, "Interface %s is down, capture paused\n", name);
+    }
+  }
+  if (up && src->fd < 0 && open_source(worker, src, ifindex) == 0 && worker->id == 0) {
+    fprintf(stderr, "Interface %s is up, capture resumed\n", name);
+  }
+}
+
+static void handle_link_message(struct capture_worker *worker, const struct nlmsghdr *nlh) {
+  const struct ifinfomsg *ifi = (const struct ifinfomsg *)NLMSG_DATA(nlh);
+  const char *ifname = NULL;
+  int attr_len = IFLA_PAYLOAD(nlh);
+
+  for (const struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+    if (rta->rta_type == IFLA_IFNAME) {
+      ifname = (const char *)RTA_DATA(rta);
+    }
+  }
+  if (!ifname) {
+    return;
+  }
+
+  int up = nlh->nlmsg_type == RTM_NEWLINK && (ifi->ifi_flags & IFF_UP);
+  for (unsigned int i = 0; i < worker->source_count; i++) {
+    struct capture_source *src = &worker->sources[i];
+    if (strcmp(worker->cfg->ifnames[src->iface], ifname) == 0) {
+      update_source(worker, src, up, ifi->ifi_index);
+    }
+  }
+}
+
+static void poll_netlink(struct capture_worker *worker) {
+  char buf[16384];
+
+  for (;;) {
+    ssize_t len = recv(worker->nlfd, buf, sizeof(buf), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Переполнение очереди: часть событий потеряна, состояние
+      // восстанавливается по полному списку интерфейсов; удалённые
+      // за это время интерфейсы в нём не появятся
+      if (errno == ENOBUFS) {
+        for (unsigned int i = 0; i < worker->source_count; i++) {
+          struct capture_source *src = &worker->sources[i];
+          if (src->fd >= 0 && if_nametoindex(worker->cfg->ifnames[src->iface]) == 0) {
+            update_source(worker, src, 0, src->ifindex);
+          }
+        }
+        request_link_dump(worker->nlfd);
+        continue;
+      }
+      if (errno != EAGAIN) {
+        perror("rtnetlink recv failed");
+      }
+      return;
+    }
+
+    int remaining = len;
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, remaining);
+         nlh = NLMSG_NEXT(nlh, remaining)) {
+      if (nlh->nlmsg_type == RTM_NEWLINK || nlh->nlmsg_type == RTM_DELLINK) {
+        handle_link_message(worker, nlh);
+      }
+    }
+  }
+}
+
+// Цикл событий потока: epoll ждёт готовности любого сокета, готовые
+// сокеты вычитываются по очереди. Раз в секунду (и по таймауту epoll,
+// чтобы заметить остановку без трафика) забираются потери ядра.
+static void capture_loop(struct capture_worker *worker) {
+  struct epoll_event events[FDDI_MAX_INTERFACES + 1];
+  struct recv_batch rx;
+  time_t last_drops_time = time(NULL);
+
+  memset(&rx, 0, sizeof(rx));
+  if (!worker->cfg->use_ring && alloc_recv_batch(&rx, worker->cfg->batch) < 0) {
+    fprintf(stderr, "Failed to allocate receive batch\n");
+    return;
+  }
+
+  while (g_running.load(std::memory_order_relaxed)) {
+    int count = epoll_wait(worker->epfd, events, FDDI_MAX_INTERFACES + 1, 1000);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait failed");
+      break;
+    }
+
+    for (int i = 0; i < count; i++) {
+      struct capture_source *src = (struct capture_source *)events[i].data.ptr;
+      if (!src) {
+        poll_netlink(worker);
+        continue;
+      }
+      // Сокет мог быть закрыт событием rtnetlink в этом же проходе
+      if (src->fd < 0) {
+        continue;
+      }
+      if (events[i].events & EPOLLERR) {
+        // Ошибка сокета (обычно ENETDOWN) сбрасывается чтением SO_ERROR,
+        // иначе epoll будет сообщать о ней снова и снова
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        getsockopt(src->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+      }
+
+      int ret = worker->cfg->use_ring ? drain_ring(worker, src) : drain_recv(worker, src, &rx);
+      if (ret < 0) {
+        fprintf(stderr, "Closing capture on %s after a socket error\n", worker->cfg->ifnames[src->iface]);
+        close_source(worker, src);
+      }
+    }
+
+    time_t now = time(NULL);
+    if (now != last_drops_time) {
+      for (unsigned int i = 0; i < worker->source_count; i++) {
+        struct capture_source *src = &worker->sources[i];
+        if (src->fd >= 0) {
+          count_kernel_drops(src, read_drops(src->fd, worker->cfg->use_ring));
+        }
+      }
+      last_drops_time = now;
+    }
+  }
+
+  free_recv_batch(&rx);
+}
+
+static void *worker_main(void *arg) {
+  struct capture_worker *worker = (struct capture_worker *)arg;
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(worker->cpu, &cpus);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+    fprintf(stderr, "Failed to pin worker to CPU %d\n", worker->cpu);
+  }
+
+  capture_loop(worker);
+
+  // Ошибка в одном потоке останавливает весь приём
+  g_running.store(0);
+  return NULL;
+}
+
+// Подготовка потока: epoll, rtnetlink и сокеты всех интерфейсов
+static int open_worker(struct capture_worker *worker, const int *ifindexes) {
+  worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (worker->epfd < 0) {
+    perror("epoll_create1 failed");
+    return -1;
+  }
+
+  // Без rtnetlink захват работает, но выключение интерфейса не отслеживается
+  worker->nlfd = open_netlink();
+  if (worker->nlfd >= 0) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, worker->nlfd, &ev) < 0) {
+      perror("epoll_ctl failed");
+      return -1;
+    }
+  }
+
+  worker->source_count = worker->cfg->iface_count;
+  for (unsigned int i = 0; i < worker->source_count; i++) {
+    struct capture_source *src = &worker->sources[i];
+    src->iface = i;
+    src->fd = -1;
+    if (open_source(worker, src, ifindexes[i]) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
 
-    // Вывод содержимого пакета в шестнадцатеричном виде
-    for (int i = 0; i < bytes_received; i++) {
-      printf("%02x ", (unsigned char)buffer[i]);
-      if ((i + 1) % 16 == 0) {
-        printf("\n");
+static void close_worker(struct capture_worker *worker) {
+  for (unsigned int i = 0; i < worker->source_count; i++) {
+    close_source(worker, &worker->sources[i]);
+  }
+  if (worker->nlfd >= 0) {
+    close(worker->nlfd);
+    worker->nlfd = -1;
+  }
+  if (worker->epfd >= 0) {
+    close(worker->epfd);
+    worker->epfd = -1;
+  }
+}
+
+// Сумма счётчиков одного интерфейса по всем потокам
+struct iface_totals {
+  unsigned long long packets;
+  unsigned long long bytes;
+  unsigned long long drops;
+  unsigned long long output_drops;
+  unsigned long long truncated;
+  unsigned long long classes[FDDI_CLASS_COUNT];
+  int up;
+};
+
+// Счётчики суммируются без блокировок; totals[0] - сумма по всем
+// интерфейсам, totals[1 + i] - по интерфейсу i
+static void sum_counters(struct capture_worker *workers, unsigned int count,
+                         const struct capture_config *cfg, struct iface_totals *totals) {
+  memset(totals, 0, sizeof(*totals) * (cfg->iface_count + 1));
+  for (unsigned int i = 0; i < count; i++) {
+    for (unsigned int j = 0; j < workers[i].source_count; j++) {
+      const struct capture_source *src = &workers[i].sources[j];
+      struct iface_totals *t = &totals[1 + src->iface];
+      t->packets += src->counters.packets.load(std::memory_order_relaxed);
+      t->bytes += src->counters.bytes.load(std::memory_order_relaxed);
+      t->drops += src->counters.kernel_drops.load(std::memory_order_relaxed);
+      t->output_drops += src->counters.output_drops.load(std::memory_order_relaxed);
+      t->truncated += src->counters.truncated.load(std::memory_order_relaxed);
+      for (int c = 0; c < FDDI_CLASS_COUNT; c++) {
+        t->classes[c] += src->counters.classes[c].load(std::memory_order_relaxed);
       }
+      t->up |= src->up.load(std::memory_order_relaxed);
     }
-    printf("\n");
+  }
 
-    // Подсчёт пакетов
-    packet_count++;
+  for (unsigned int i = 1; i <= cfg->iface_count; i++) {
+    totals[0].packets += totals[i].packets;
+    totals[0].bytes += totals[i].bytes;
+    totals[0].drops += totals[i].drops;
+    totals[0].output_drops += totals[i].output_drops;
+    totals[0].truncated += totals[i].truncated;
+    for (int c = 0; c < FDDI_CLASS_COUNT; c++) {
+      totals[0].classes[c] += totals[i].classes[c];
+    }
+    totals[0].up |= totals[i].up;
+  }
+}
+
+// Вывод статистики каждые 10 секунд: значение за интервал считается как
+// разность с прошлым. При захвате с нескольких интерфейсов после общей
+// строки идёт строка на каждый интерфейс.
+static void report_loop(struct capture_worker *workers, unsigned int count,
+                        const struct capture_config *cfg) {
+  static struct iface_totals last[FDDI_MAX_INTERFACES + 1];
+  static struct iface_totals now[FDDI_MAX_INTERFACES + 1];
+  time_t last_stats_time = time(NULL);
+
+  while (g_running.load()) {
+    sleep(1);
 
-    // Вывод статистики каждые 10 секунд
     time_t current_time = time(NULL);
-    if (current_time - last_stats_time >= 10) {
-      printf("Received %llu packets in the last 10 seconds\n", packet_count);
-      packet_count = 0;
-      last_stats_time = current_time;
+    if (current_time - last_stats_time < FDDI_STATS_INTERVAL) {
+      continue;
     }
+
+    sum_counters(workers, count, cfg, now);
+
+    printf("Received %llu packets in the last %d seconds, dropped %llu, not printed %llu\n",
+           now[0].packets - last[0].packets, FDDI_STATS_INTERVAL, now[0].drops - last[0].drops,
+           now[0].output_drops - last[0].output_drops);
+
+    if (cfg->iface_count > 1) {
+      for (unsigned int i = 1; i <= cfg->iface_count; i++) {
+        printf("  %s: received %llu, dropped %llu, not printed %llu%s\n", cfg->ifnames[i - 1],
+               now[i].packets - last[i].packets, now[i].drops - last[i].drops,
+               now[i].output_drops - last[i].output_drops, now[i].up ? "" : " (down)");
+      }
+    }
+
+    if (cfg->classify) {
+      printf("Frame classes:");
+      for (int c = 0; c < FDDI_CLASS_COUNT; c++) {
+        printf(" %s %llu", fddi_class_names[c], now[0].classes[c] - last[0].classes[c]);
+      }
+      printf("\n");
+    }
+    fflush(stdout);
+    memcpy(last, now, sizeof(last));
+    last_stats_time = current_time;
   }
+}
 
-  close(fd);
+// Итог за всё время работы. Строка "Total:" разбирается fddibench.sh,
+// процессорное время включает все потоки процесса. Вызывается после
+// закрытия сокетов, когда потери ядра уже собраны в счётчики.
+static void print_totals(struct capture_worker *workers, unsigned int count,
+                         const struct capture_config *cfg) {
+  static struct iface_totals totals[FDDI_MAX_INTERFACES + 1];
+  sum_counters(workers, count, cfg, totals);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double cpu_us = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 +
+                  usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+
+  printf("Total: received %llu packets, %llu bytes, dropped %llu, cpu %.3f us/packet\n",
+         totals[0].packets, totals[0].bytes, totals[0].drops,
+         totals[0].packets ? cpu_us / totals[0].packets : 0.0);
+  printf("CPU: %.0f us\n", cpu_us);
+  if (totals[0].output_drops) {
+    printf("Not printed %llu frames: output queue full\n", totals[0].output_drops);
+  }
+  if (totals[0].truncated) {
+    printf("Truncated %llu frames longer than %d bytes in the output\n", totals[0].truncated, FDDI_K_LLC_LEN);
+  }
+  if (cfg->iface_count > 1) {
+    for (unsigned int i = 1; i <= cfg->iface_count; i++) {
+      printf("  %s: received %llu packets, %llu bytes, dropped %llu\n", cfg->ifnames[i - 1],
+             totals[i].packets, totals[i].bytes, totals[i].drops);
+    }
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  static struct capture_config cfg;
+  if (parse_args(argc, argv, &cfg) < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (cfg.dump_filter) {
+    if (cfg.filter) {
+      fddi_bpf_dump(&cfg.bpf);
+    }
+    return 0;
+  }
+
+  // При запуске все интерфейсы должны существовать (опечатка в имени -
+  // ошибка); исчезновение и возвращение интерфейса потом обрабатываются
+  int ifindexes[FDDI_MAX_INTERFACES];
+  for (unsigned int i = 0; i < cfg.iface_count; i++) {
+    ifindexes[i] = if_nametoindex(cfg.ifnames[i]);
+    if (ifindexes[i] == 0) {
+      fprintf(stderr, "Unknown interface %s\n", cfg.ifnames[i]);
+      return 1;
+    }
+  }
+
+  // Остановка по Ctrl+C или SIGTERM: буферы вывода дописываются до выхода
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_stop_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  // Сегмент телеметрии: по слоту на интерфейс, общему для всех потоков
+  telemetry_t *telemetry = NULL;
+  struct telemetry_iface *telemetry_slots[FDDI_MAX_INTERFACES] = {};
+  if (cfg.telemetry_path) {
+    int status;
+    telemetry = telemetry_attach(cfg.telemetry_path, &status);
+    if (!telemetry) {
+      fprintf(stderr, "Failed to open telemetry segment %s: %s\n", cfg.telemetry_path, strerror(-status));
+      return 1;
+    }
+    for (unsigned int i = 0; i < cfg.iface_count; i++) {
+      telemetry_slots[i] = telemetry_iface_slot(telemetry, cfg.ifnames[i]);
+      if (!telemetry_slots[i]) {
+        fprintf(stderr, "No free telemetry slot for %s\n", cfg.ifnames[i]);
+      }
+    }
+  }
+
+  static struct capture_worker workers[FDDI_MAX_WORKERS];
+  long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpu_count < 1) {
+    cpu_count = 1;
+  }
+  int fanout_group = getpid() & 0xffff;
+
+  for (unsigned int i = 0; i < cfg.workers; i++) {
+    workers[i].id = i;
+    workers[i].cpu = i % cpu_count;
+    workers[i].epfd = -1;
+    workers[i].nlfd = -1;
+    workers[i].fanout_group = fanout_group;
+    workers[i].cfg = &cfg;
+    for (unsigned int j = 0; j < cfg.iface_count; j++) {
+      workers[i].sources[j].telemetry = telemetry_slots[j];
+    }
+    if (fddi_spsc_init(&workers[i].queue, cfg.queue_slots) < 0) {
+      fprintf(stderr, "Failed to allocate output queue\n");
+      return 1;
+    }
+    if (open_worker(&workers[i], ifindexes) < 0) {
+      for (unsigned int j = 0; j <= i; j++) {
+        close_worker(&workers[j]);
+      }
+      return 1;
+    }
+  }
+
+  static struct output_stage output;
+  output.workers = workers;
+  output.count = cfg.workers;
+  output.cfg = &cfg;
+  if (cfg.output_mode == OUTPUT_PCAPNG) {
+    // С несколькими интерфейсами у каждого свой файл: <путь>.<интерфейс>
+    for (unsigned int i = 0; i < cfg.iface_count; i++) {
+      char path[256];
+      if (cfg.iface_count > 1) {
+        snprintf(path, sizeof(path), "%s.%s", cfg.pcapng_path, cfg.ifnames[i]);
+      } else {
+        snprintf(path, sizeof(path), "%s", cfg.pcapng_path);
+      }
+      if (fddi_pcapng_open(&output.pcapng[i], path, cfg.ifnames[i], cfg.rotate_bytes,
+                           cfg.rotate_seconds, cfg.max_files, realtime_ns()) < 0) {
+        fprintf(stderr, "Failed to open pcapng output\n");
+        return 1;
+      }
+    }
+  }
+  if (cfg.output_mode != OUTPUT_NONE) {
+    fddi_dump_init();
+    if (pthread_create(&output.thread, NULL, output_main, &output) != 0) {
+      fprintf(stderr, "Failed to start output thread\n");
+      return 1;
+    }
+  }
+
+  // Дальнейшая обработка пакетов FDDI
+  unsigned int started = 0;
+  for (; started < cfg.workers; started++) {
+    if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+      fprintf(stderr, "Failed to start worker %u\n", started);
+      g_running.store(0);
+      break;
+    }
+  }
+
+  report_loop(workers, started, &cfg);
+
+  for (unsigned int i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  if (cfg.output_mode != OUTPUT_NONE) {
+    output.stop.store(1, std::memory_order_release);
+    pthread_join(output.thread, NULL);
+  }
+  for (unsigned int i = 0; i < cfg.workers; i++) {
+    close_worker(&workers[i]);
+  }
+  print_totals(workers, cfg.workers, &cfg);
+  for (unsigned int i = 0; i < cfg.workers; i++) {
+    fddi_spsc_destroy(&workers[i].queue);
+  }
+  telemetry_close(telemetry);
   return 0;
-}
\ No newline at end of file
+}
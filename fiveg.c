@@ -19,12 +19,33 @@
 #include <linux/string.h>
 #include <linux/sysfs.h>
 #include <linux/wwan.h>
+#include <linux/tty.h>
 #include <linux/fs.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/completion.h>
-#include <linux/kmod.h>
 #include <linux/uaccess.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/delay.h>
+#include <linux/sched/signal.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/kref.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/srcu.h>
+
+#include "qmi_codec.h"
+#include "mec_probe.h"
+
+#define CREATE_TRACE_POINTS
+#include "fiveg_trace.h"
 
 #ifndef RFKILL_TYPE_CELLULAR
 #define RFKILL_TYPE_CELLULAR 7
@@ -32,17 +53,176 @@
 
 #define DRIVER_NAME "fiveg_driver"
 #define PROC_FILENAME "fiveg_driver"
+#define PROC_QMI_FILENAME "fiveg_qmi"
 
 #define ICCID_REGISTER_OFFSET 0x100
 #define ICCID_LENGTH 20
 #define ANTENNA_POWER_REGISTER_OFFSET 0x200
 #define QMI_DEVICE_PATH "/dev/cdc-wdm0"
 #define MAX_QMI_OUTPUT_SIZE 4096
+#define QMI_HIST_BUCKETS 32     // log2 задержки в мкс
+#define STATUS_REFRESH_MIN_MS 100
+#define PORT_DEVICE_PATH "/dev/ttyUSB2"
+#define PORT_FRAG_LEN 4096
+#define PORT_BATCH 32        // skb за одну отправку в бэкенд
+#define PORT_TXQ_HIGH 256    // wwan_port_txoff
+#define PORT_TXQ_LOW 64      // wwan_port_txon
+#define MEC_BATCH_MAX 64     // UDP_MAX_SEGMENTS на старых ядрах
+#define MEC_BUF_SIZE 65507   // полезная нагрузка одной датаграммы GSO по IPv4
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("ne5link, MAIN DEV of ZenithOS.");
 MODULE_DESCRIPTION("5G driver");
 
+static unsigned int status_refresh_ms = 5000;
+module_param(status_refresh_ms, uint, 0644);
+MODULE_PARM_DESC(status_refresh_ms, "Refresh interval of the cached modem status in ms (min 100)");
+
+static char *port_backend = "tty";
+module_param(port_backend, charp, 0444);
+MODULE_PARM_DESC(port_backend, "Backend of the WWAN AT port: tty or loopback");
+
+static char *port_device = PORT_DEVICE_PATH;
+module_param(port_device, charp, 0444);
+MODULE_PARM_DESC(port_device, "Modem AT device used by the tty backend");
+
+static char *mec_address = "192.168.1.100";
+module_param(mec_address, charp, 0444);
+MODULE_PARM_DESC(mec_address, "IPv4 address of the MEC server");
+
+static int mec_port = 8944;
+module_param(mec_port, int, 0444);
+MODULE_PARM_DESC(mec_port, "UDP port of the MEC server");
+
+static unsigned int mec_batch = 32;
+module_param(mec_batch, uint, 0644);
+MODULE_PARM_DESC(mec_batch, "Datagrams per uplink batch (1-64)");
+
+static unsigned int mec_flush_us = 1000;
+module_param(mec_flush_us, uint, 0644);
+MODULE_PARM_DESC(mec_flush_us, "Longest wait of a queued datagram for its batch in us (rounded up to a jiffy)");
+
+static bool mec_gso = true;
+module_param(mec_gso, bool, 0644);
+MODULE_PARM_DESC(mec_gso, "Send runs of equal-sized datagrams as one UDP_SEGMENT (GSO) send");
+
+static unsigned int qmi_timeout_ms = 2000;
+module_param(qmi_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(qmi_timeout_ms, "Wait for a QMI response on the control device in ms");
+
+// Запрос QMI, ждущий ответа; ответ копируется читателем в response
+struct fiveg_qmi_request {
+    struct list_head list;
+    u8 service;
+    u8 client;
+    u16 tid;
+    struct completion done;
+    u8 *response;
+    size_t response_len;
+};
+
+// Клиент QMI на /dev/cdc-wdm0: запросы пишутся из вызывающего потока,
+// ответы читает поток fiveg_qmi и раздаёт по номеру транзакции
+struct fiveg_qmi {
+    struct file *filp;            // NULL - устройство не открыто
+    struct task_struct *reader;
+    u8 *rx_buf;
+    bool stopping;
+    struct mutex lock;            // открытие устройства и выделение клиентов
+    struct mutex write_lock;
+    spinlock_t pending_lock;
+    struct list_head pending;
+    atomic_t next_tid;
+    bool has_client[QMI_SERVICE_COUNT];
+    u8 client[QMI_SERVICE_COUNT];
+    spinlock_t flight_lock;
+    struct list_head flights;     // выполняющиеся запросы на чтение
+    struct mutex command_lock;    // команды, меняющие состояние модема
+};
+
+// Выполняющийся запрос на чтение: все одинаковые запросы, пришедшие до
+// его завершения, ждут его и получают тот же результат
+struct fiveg_qmi_flight {
+    struct list_head list;
+    struct kref ref;
+    struct completion done;
+    const char *command;
+    int ret;
+    char output[MAX_QMI_OUTPUT_SIZE];
+};
+
+// Счётчики команды для /proc/fiveg_qmi и debugfs; wait - от вызова до
+// результата, hist[i] - вызовов с wait в [2^i, 2^(i+1)) мкс (hist[0] - до 2 мкс)
+struct fiveg_qmi_stat {
+    atomic_t depth;               // вызовов, ждущих сейчас
+    atomic_t peak;
+    atomic64_t calls;
+    atomic64_t runs;              // обращений к модему
+    atomic64_t errors;            // вызовов с ошибкой, кроме таймаутов
+    atomic64_t timeouts;
+    atomic64_t wait_ns;
+    atomic64_t wait_max_ns;
+    atomic64_t hist[QMI_HIST_BUCKETS];
+};
+
+// Снимок состояния модема для /proc и sysfs. Пишут только fiveg_status_refresh
+// и rfkill, читатели копируют его под seqlock и модем не трогают.
+// *_ns - ktime_get_ns() последнего успешного обновления поля, 0 - ещё не было
+struct fiveg_status {
+    char iccid[ICCID_LENGTH + 1];
+    char signal[64];
+    bool radio_on;
+    u64 iccid_ns;
+    u64 signal_ns;
+    u64 radio_ns;
+};
+
+// Порт WWAN: запись из /dev/wwan0at0 копится в txq и уходит в бэкенд
+// пачками до PORT_BATCH skb одним kernel_write; приём читается пачкой в
+// rx_buf и раздаётся в wwan_port_rx кусками по frag_len. Бэкенд loopback
+// возвращает каждую пачку обратно на приём - для проверки без модема.
+struct fiveg_port {
+    struct wwan_port *wwan;
+    struct wwan_port_caps caps;
+    bool loopback;
+    struct sk_buff_head txq;
+    struct work_struct tx_work;
+    bool tx_stopped;              // под txq.lock
+    u8 *tx_buf;                   // PORT_BATCH * frag_len
+    u8 *rx_buf;                   // PORT_BATCH * frag_len
+    size_t buf_len;
+    struct file *filp;            // бэкенд tty, NULL - порт закрыт
+    struct tty_struct *tty;       // NULL - бэкенд не tty, termios не трогается
+    struct ktermios saved_termios; // вернуть при закрытии
+    struct task_struct *reader;
+    bool stopping;
+    atomic64_t queued;
+    atomic64_t sent;
+    atomic64_t dropped;
+    atomic64_t received;
+    atomic64_t batches;
+};
+
+// Канал на сервер MEC: датаграммы копятся подряд в buf и уходят пачкой
+// по mec_batch штук или через mec_flush_us. Подряд идущие датаграммы
+// одного размера отправляются одним sendmsg с UDP_SEGMENT.
+struct fiveg_mec {
+    struct mutex lock;
+    u8 *buf;                      // MEC_BUF_SIZE
+    size_t used;
+    u16 len[MEC_BATCH_MAX];
+    unsigned int count;
+    bool gso_failed;              // ядро или маршрут не умеют GSO
+    bool closed;                  // под lock: buf освобождён, отправка запрещена
+    struct delayed_work flush_work;
+    atomic_t probe_seq;           // mec_probe_store зовётся параллельно
+    atomic64_t queued;
+    atomic64_t sent;
+    atomic64_t dropped;
+    atomic64_t sends;             // вызовов sendmsg
+    atomic64_t gso_sends;
+};
+
 struct fiveg_connection {
     struct socket *sock;
     struct sockaddr_in server_addr;
@@ -50,26 +230,29 @@ struct fiveg_connection {
     char *mec_server_address;
     int mec_server_port;
     char qmi_device[64];
+    struct fiveg_qmi qmi;
+    seqlock_t status_lock;
+    struct fiveg_status status;
+    struct delayed_work status_work;
+    struct fiveg_port port;
+    struct fiveg_mec mec;
     struct proc_dir_entry *proc_file;
-};
-
-struct fiveg_command_context {
-    struct completion comp;
-    char *output_buffer;
-    int exit_code;
+    struct proc_dir_entry *qmi_proc_file;
+    struct dentry *debugfs;
 };
 
 static int fiveg_send_qmi_command(const char *command, char *output, size_t output_len);
-static int fiveg_run_command(const char *command, char *output, size_t output_len);
+static void fiveg_status_set_radio(struct fiveg_connection *conn, bool on);
+int fiveg_mec_send(const void *data, size_t len);
+void fiveg_mec_flush(void);
 
-static struct wwan_port *fiveg_wwan_port;
 static struct fiveg_connection *conn;
-static struct wwan_port_caps fiveg_wwan_port_caps;
 
-static const struct wwan_port_ops fiveg_wwan_port_ops = {
-    .start = NULL,
-    .stop = NULL,
-};
+// Соединение для экспортируемых fiveg_mec_send/fiveg_mec_flush: их зовут
+// другие модули в любой момент, поэтому указатель публикуется в конце
+// probe, а remove обнуляет его и ждёт выхода всех, кто успел его взять
+static struct fiveg_connection __rcu *fiveg_mec_conn;
+DEFINE_STATIC_SRCU(fiveg_mec_srcu);
 
 static bool fiveg_rfkill_set_block(void *data, bool blocked) {
     struct fiveg_connection *conn = data;
@@ -81,10 +264,12 @@ static bool fiveg_rfkill_set_block(void *data, bool blocked) {
     } else {
         ret = fiveg_send_qmi_command("radio on", output, sizeof(output));
     }
+    trace_fiveg_rfkill(blocked, ret);
     if (ret < 0) {
         printk(KERN_ERR "Failed to set radio state: %d\n", ret);
         return false;
     }
+    fiveg_status_set_radio(conn, !blocked);
     return true;
 }
 
@@ -94,91 +279,861 @@ static const struct rfkill_ops fiveg_rfkill_ops = {
 
 static void __iomem *base_register;
 
-static int fiveg_send_qmi_command(const char *command, char *output, size_t output_len) {
-    int ret;
-    char full_command[256];
+// --- Клиент QMI ---
+
+// Ответ от модема: поиск запроса по сервису, клиенту и транзакции.
+// Индикации не нужны ни одному из запросов и отбрасываются.
+static void fiveg_qmi_dispatch(struct fiveg_connection *conn, const u8 *buf, size_t len) {
+    struct fiveg_qmi *qmi = &conn->qmi;
+    struct fiveg_qmi_request *req, *found = NULL;
+    struct qmi_message msg;
+
+    if (qmi_decode(buf, len, &msg) < 0 || !qmi_is_response(&msg))
+        return;
+
+    spin_lock(&qmi->pending_lock);
+    list_for_each_entry(req, &qmi->pending, list) {
+        if (req->service == msg.service && req->tid == msg.tid &&
+            (msg.service == QMI_SERVICE_CTL || req->client == msg.client)) {
+            list_del_init(&req->list);
+            found = req;
+            break;
+        }
+    }
+    spin_unlock(&qmi->pending_lock);
 
-    snprintf(full_command, sizeof(full_command), "qmi-cli --device=%s %s", conn->qmi_device, command);
+    if (!found)
+        return;
+    found->response = kmemdup(buf, len, GFP_KERNEL);
+    found->response_len = found->response ? len : 0;
+    complete(&found->done);
+}
 
-    ret = fiveg_run_command(full_command, output, output_len);
-    if (ret < 0) {
-        printk(KERN_ERR "Failed to run qmi command: %s, error: %d\n", command, ret);
+static int fiveg_qmi_reader(void *data) {
+    struct fiveg_connection *conn = data;
+    struct fiveg_qmi *qmi = &conn->qmi;
+    ssize_t len;
+    loff_t pos;
+
+    // Сигнал будит поток из kernel_read при остановке
+    allow_signal(SIGINT);
+    while (!kthread_should_stop() && !READ_ONCE(qmi->stopping)) {
+        pos = 0;
+        len = kernel_read(qmi->filp, qmi->rx_buf, QMI_MAX_MESSAGE, &pos);
+        if (len > 0) {
+            fiveg_qmi_dispatch(conn, qmi->rx_buf, len);
+        } else if (signal_pending(current)) {
+            flush_signals(current);
+        } else {
+            // Устройство пропало (USB отключён, ошибка или 0 - конец файла):
+            // запросы завершатся по таймауту
+            msleep(100);
+        }
+    }
+    flush_signals(current);
+    while (!kthread_should_stop()) {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (!kthread_should_stop())
+            schedule();
+        __set_current_state(TASK_RUNNING);
+    }
+    return 0;
+}
+
+// Открытие устройства и запуск читателя; вызывается под qmi->lock
+static int fiveg_qmi_open(struct fiveg_connection *conn) {
+    struct fiveg_qmi *qmi = &conn->qmi;
+    struct file *filp;
+
+    if (qmi->filp)
+        return 0;
+
+    filp = filp_open(conn->qmi_device, O_RDWR, 0);
+    if (IS_ERR(filp))
+        return PTR_ERR(filp);
+    qmi->rx_buf = kmalloc(QMI_MAX_MESSAGE, GFP_KERNEL);
+    if (!qmi->rx_buf) {
+        filp_close(filp, NULL);
+        return -ENOMEM;
+    }
+    qmi->filp = filp;
+    qmi->stopping = false;
+    qmi->reader = kthread_run(fiveg_qmi_reader, conn, "fiveg_qmi");
+    if (IS_ERR(qmi->reader)) {
+        int ret = PTR_ERR(qmi->reader);
+        qmi->reader = NULL;
+        qmi->filp = NULL;
+        kfree(qmi->rx_buf);
+        qmi->rx_buf = NULL;
+        filp_close(filp, NULL);
         return ret;
     }
-    printk(KERN_INFO "QMI command output: %s\n", output);
     return 0;
 }
 
-static void fiveg_command_complete(struct subprocess_info *sub_info) {
-    struct fiveg_command_context *ctx = sub_info->data;
+static u16 fiveg_qmi_next_tid(struct fiveg_qmi *qmi, u8 service) {
+    u16 tid = (u16)atomic_inc_return(&qmi->next_tid);
 
-    printk(KERN_INFO "Command completed\n");
+    // У CTL номер транзакции - один байт; 0 не используется
+    if (service == QMI_SERVICE_CTL)
+        tid &= 0xFF;
+    return tid ? tid : 1;
+}
+
+// Отправка request и ожидание ответа с тем же номером транзакции. При
+// успехе ответ в req->response, освобождает вызывающий.
+static int fiveg_qmi_exchange(struct fiveg_connection *conn, const u8 *request, int len,
+                              struct fiveg_qmi_request *req) {
+    struct fiveg_qmi *qmi = &conn->qmi;
+    ssize_t written;
+    loff_t pos = 0;
+
+    init_completion(&req->done);
+    req->response = NULL;
+    req->response_len = 0;
+    spin_lock(&qmi->pending_lock);
+    list_add_tail(&req->list, &qmi->pending);
+    spin_unlock(&qmi->pending_lock);
+
+    // cdc-wdm принимает одно сообщение на write
+    mutex_lock(&qmi->write_lock);
+    written = kernel_write(qmi->filp, request, len, &pos);
+    mutex_unlock(&qmi->write_lock);
+
+    if (written == len)
+        wait_for_completion_timeout(&req->done, msecs_to_jiffies(READ_ONCE(qmi_timeout_ms)));
+
+    spin_lock(&qmi->pending_lock);
+    if (!list_empty(&req->list)) {
+        list_del_init(&req->list);
+        spin_unlock(&qmi->pending_lock);
+        if (written != len)
+            return written < 0 ? written : -EIO;
+        return -ETIMEDOUT;
+    }
+    spin_unlock(&qmi->pending_lock);
+
+    // Читатель уже снял запрос с очереди: ответ вот-вот будет скопирован
+    wait_for_completion(&req->done);
+    return req->response ? 0 : -ENOMEM;
+}
+
+// Номер клиента сервиса service; при первом обращении устройство
+// открывается и клиент выделяется через CTL Get Client ID
+static int fiveg_qmi_client(struct fiveg_connection *conn, u8 service, u8 *client) {
+    struct fiveg_qmi *qmi = &conn->qmi;
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    u8 request[32];
+    u8 got_service;
+    u16 error;
+    int len, ret;
+
+    mutex_lock(&qmi->lock);
+    ret = fiveg_qmi_open(conn);
+    if (ret == 0 && !qmi->has_client[service]) {
+        req.service = QMI_SERVICE_CTL;
+        req.client = 0;
+        req.tid = fiveg_qmi_next_tid(qmi, QMI_SERVICE_CTL);
+        len = qmi_encode_ctl_get_client_id(request, sizeof(request), (u8)req.tid, service);
+        ret = fiveg_qmi_exchange(conn, request, len, &req);
+        if (ret == 0) {
+            if (qmi_decode(req.response, req.response_len, &msg) < 0 || qmi_result(&msg, &error) < 0 ||
+                qmi_decode_ctl_get_client_id(&msg, &got_service, &qmi->client[service]) < 0 ||
+                got_service != service) {
+                printk_ratelimited(KERN_ERR "QMI client allocation for service %u failed\n", service);
+                ret = -EIO;
+            } else {
+                qmi->has_client[service] = true;
+            }
+            kfree(req.response);
+        }
+    }
+    *client = qmi->client[service];
+    mutex_unlock(&qmi->lock);
+    return ret;
+}
 
-    complete(&ctx->comp);
+// Запрос id к сервису service. При успехе разобранный ответ в msg,
+// буфер ответа req->response освобождает вызывающий.
+static int fiveg_qmi_request(struct fiveg_connection *conn, u8 service, u16 id, const struct qmi_tlv *tlvs,
+                             int count, struct fiveg_qmi_request *req, struct qmi_message *msg) {
+    u8 request[64];
+    u16 error = 0;
+    int len, ret;
+
+    ret = fiveg_qmi_client(conn, service, &req->client);
+    if (ret < 0)
+        return ret;
+    req->service = service;
+    req->tid = fiveg_qmi_next_tid(&conn->qmi, service);
+    len = qmi_encode_request(request, sizeof(request), service, req->client, req->tid, id, tlvs, count);
+    if (len < 0)
+        return -EINVAL;
+
+    ret = fiveg_qmi_exchange(conn, request, len, req);
+    if (ret < 0)
+        return ret;
+    if (qmi_decode(req->response, req->response_len, msg) < 0 || qmi_result(msg, &error) < 0) {
+        printk_ratelimited(KERN_ERR "QMI request 0x%02x/0x%04x failed: error %u\n", service, id, error);
+        kfree(req->response);
+        return -EIO;
+    }
+    return 0;
 }
 
-static int fiveg_run_command(const char *command, char *output, size_t output_len) {
-    struct subprocess_info *sub_info;
-    struct fiveg_command_context *ctx;
-    char *argv[] = {"/bin/sh", "-c", (char *)command, NULL};
-    char *envp[] = {"HOME=/", "PATH=/sbin:/usr/sbin:/bin:/usr/bin", NULL};
+// Остановка клиента: клиенты освобождаются (иначе модем держит их до
+// перезагрузки), читатель останавливается, устройство закрывается.
+// fiveg_qmi_request пишет в устройство вне qmi->lock, поэтому до вызова
+// все, кто шлёт команды (rfkill, опрос состояния), должны быть остановлены.
+static void fiveg_qmi_close(struct fiveg_connection *conn) {
+    struct fiveg_qmi *qmi = &conn->qmi;
+    struct fiveg_qmi_request req;
+    u8 request[32];
+    int service, len;
+
+    mutex_lock(&qmi->lock);
+    if (!qmi->filp) {
+        mutex_unlock(&qmi->lock);
+        return;
+    }
+
+    for (service = 0; service < QMI_SERVICE_COUNT; service++) {
+        if (!qmi->has_client[service])
+            continue;
+        req.service = QMI_SERVICE_CTL;
+        req.client = 0;
+        req.tid = fiveg_qmi_next_tid(qmi, QMI_SERVICE_CTL);
+        len = qmi_encode_ctl_release_client_id(request, sizeof(request), (u8)req.tid, service,
+                                               qmi->client[service]);
+        if (fiveg_qmi_exchange(conn, request, len, &req) == 0)
+            kfree(req.response);
+        qmi->has_client[service] = false;
+    }
+
+    WRITE_ONCE(qmi->stopping, true);
+    send_sig(SIGINT, qmi->reader, 1);
+    kthread_stop(qmi->reader);
+    filp_close(qmi->filp, NULL);
+    kfree(qmi->rx_buf);
+    qmi->filp = NULL;
+    qmi->rx_buf = NULL;
+    mutex_unlock(&qmi->lock);
+}
+
+// --- Команды QMI ---
+
+static int fiveg_qmi_set_mode(struct fiveg_connection *conn, u8 mode, char *output, size_t output_len) {
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    struct qmi_tlv tlv = {0x01, 1, &mode};
     int ret;
 
-    ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
-    if (!ctx)
-        return -ENOMEM;
-    init_completion(&ctx->comp);
-    ctx->output_buffer = kmalloc(MAX_QMI_OUTPUT_SIZE, GFP_KERNEL);
-    if (!ctx->output_buffer) {
-        kfree(ctx);
-        return -ENOMEM;
+    ret = fiveg_qmi_request(conn, QMI_SERVICE_DMS, QMI_DMS_SET_OPERATING_MODE, &tlv, 1, &req, &msg);
+    if (ret < 0)
+        return ret;
+    kfree(req.response);
+    snprintf(output, output_len, "%s", mode == QMI_DMS_MODE_ONLINE ? "online" : "low-power");
+    return 0;
+}
+
+static int fiveg_qmi_radio_on(struct fiveg_connection *conn, char *output, size_t output_len) {
+    return fiveg_qmi_set_mode(conn, QMI_DMS_MODE_ONLINE, output, output_len);
+}
+
+static int fiveg_qmi_radio_off(struct fiveg_connection *conn, char *output, size_t output_len) {
+    return fiveg_qmi_set_mode(conn, QMI_DMS_MODE_LOW_POWER, output, output_len);
+}
+
+static int fiveg_qmi_operating_mode(struct fiveg_connection *conn, char *output, size_t output_len) {
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    u8 mode;
+    int ret;
+
+    ret = fiveg_qmi_request(conn, QMI_SERVICE_DMS, QMI_DMS_GET_OPERATING_MODE, NULL, 0, &req, &msg);
+    if (ret < 0)
+        return ret;
+    ret = qmi_decode_dms_operating_mode(&msg, &mode);
+    if (ret == 0)
+        snprintf(output, output_len, "%u", mode);
+    kfree(req.response);
+    return ret < 0 ? -EIO : 0;
+}
+
+static int fiveg_qmi_signal_strength(struct fiveg_connection *conn, char *output, size_t output_len) {
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    struct qmi_nas_signal signal;
+    int ret;
+
+    ret = fiveg_qmi_request(conn, QMI_SERVICE_NAS, QMI_NAS_GET_SIGNAL_STRENGTH, NULL, 0, &req, &msg);
+    if (ret < 0)
+        return ret;
+    ret = qmi_decode_nas_signal_strength(&msg, &signal);
+    if (ret == 0)
+        snprintf(output, output_len, "%d dBm (%s)", signal.dbm, qmi_nas_radio_name(signal.radio));
+    kfree(req.response);
+    return ret < 0 ? -EIO : 0;
+}
+
+static int fiveg_qmi_serving_system(struct fiveg_connection *conn, char *output, size_t output_len) {
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    struct qmi_nas_serving_system ss;
+    int ret;
+
+    ret = fiveg_qmi_request(conn, QMI_SERVICE_NAS, QMI_NAS_GET_SERVING_SYSTEM, NULL, 0, &req, &msg);
+    if (ret < 0)
+        return ret;
+    ret = qmi_decode_nas_serving_system(&msg, &ss);
+    if (ret == 0)
+        snprintf(output, output_len, "registration %u, ps attached %u, radio %s", ss.registration,
+                 ss.ps_attached, qmi_nas_radio_name(ss.radio));
+    kfree(req.response);
+    return ret < 0 ? -EIO : 0;
+}
+
+// Строковые ответы DMS (IMEI, ICCID, IMSI): TLV type
+static int fiveg_qmi_dms_string(struct fiveg_connection *conn, u16 id, u8 type, char *output, size_t output_len) {
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    int ret;
+
+    ret = fiveg_qmi_request(conn, QMI_SERVICE_DMS, id, NULL, 0, &req, &msg);
+    if (ret < 0)
+        return ret;
+    ret = qmi_tlv_string(&msg, type, output, output_len);
+    kfree(req.response);
+    return ret < 0 ? -EIO : 0;
+}
+
+static int fiveg_qmi_imei(struct fiveg_connection *conn, char *output, size_t output_len) {
+    return fiveg_qmi_dms_string(conn, QMI_DMS_GET_IDS, 0x11, output, output_len);
+}
+
+static int fiveg_qmi_iccid(struct fiveg_connection *conn, char *output, size_t output_len) {
+    return fiveg_qmi_dms_string(conn, QMI_DMS_UIM_GET_ICCID, 0x01, output, output_len);
+}
+
+static int fiveg_qmi_imsi(struct fiveg_connection *conn, char *output, size_t output_len) {
+    return fiveg_qmi_dms_string(conn, QMI_DMS_UIM_GET_IMSI, 0x01, output, output_len);
+}
+
+static int fiveg_qmi_packet_status(struct fiveg_connection *conn, char *output, size_t output_len) {
+    struct fiveg_qmi_request req;
+    struct qmi_message msg;
+    u8 status;
+    int ret;
+
+    ret = fiveg_qmi_request(conn, QMI_SERVICE_WDS, QMI_WDS_GET_PACKET_SERVICE_STATUS, NULL, 0, &req, &msg);
+    if (ret < 0)
+        return ret;
+    ret = qmi_decode_wds_packet_service_status(&msg, &status);
+    if (ret == 0)
+        snprintf(output, output_len, "%s", status == QMI_WDS_CONNECTED ? "connected" : "disconnected");
+    kfree(req.response);
+    return ret < 0 ? -EIO : 0;
+}
+
+struct fiveg_qmi_handler {
+    const char *command;
+    int (*run)(struct fiveg_connection *conn, char *output, size_t output_len);
+    bool writes;                  // меняет состояние: не объединяется, идёт по очереди
+};
+
+// Команды, которые драйвер умеет выполнять; других нет
+static const struct fiveg_qmi_handler fiveg_qmi_handlers[] = {
+    {"radio on", fiveg_qmi_radio_on, true},
+    {"radio off", fiveg_qmi_radio_off, true},
+    {"dms get-operating-mode", fiveg_qmi_operating_mode},
+    {"dms get-ids", fiveg_qmi_imei},
+    {"dms uim-get-iccid", fiveg_qmi_iccid},
+    {"dms uim-get-imsi", fiveg_qmi_imsi},
+    {"nas get-signal-strength", fiveg_qmi_signal_strength},
+    {"nas get-serving-system", fiveg_qmi_serving_system},
+    {"wds get-packet-service-status", fiveg_qmi_packet_status},
+};
+
+static struct fiveg_qmi_stat fiveg_qmi_stats[ARRAY_SIZE(fiveg_qmi_handlers)];
+
+static int fiveg_qmi_find_handler(const char *command) {
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(fiveg_qmi_handlers); i++) {
+        if (strcmp(command, fiveg_qmi_handlers[i].command) == 0)
+            return i;
     }
+    return -1;
+}
 
-    sub_info = call_usermodehelper_setup(argv[0], argv, envp, GFP_KERNEL,
-                                        fiveg_command_complete, NULL, ctx);
-    if (!sub_info) {
-        kfree(ctx->output_buffer);
-        kfree(ctx);
-        return -ENOMEM;
+// Выполнение команды напрямую через /dev/cdc-wdm0. Ошибка устройства
+// (нет /dev/cdc-wdm0, модем отключён) возвращается как есть: снимок
+// состояния оставляет прежнее значение с его временем. Вывод попадает
+// только в fiveg_qmi_finish, в журнал - лишь ошибки и не чаще ratelimit.
+static int fiveg_qmi_run(const char *command, int handler, char *output, size_t output_len) {
+    u64 start = ktime_get_ns();
+    int ret;
+
+    trace_fiveg_qmi_start(command, handler);
+    if (output_len)
+        output[0] = '\0';
+    ret = fiveg_qmi_handlers[handler].run(conn, output, output_len);
+    if (ret < 0)
+        printk_ratelimited(KERN_ERR "Failed to run qmi command: %s, error: %d\n", command, ret);
+    trace_fiveg_qmi_finish(command, ret, ktime_get_ns() - start, output_len ? output : "");
+    return ret;
+}
+
+static void fiveg_qmi_flight_free(struct kref *ref) {
+    kfree(container_of(ref, struct fiveg_qmi_flight, ref));
+}
+
+static void fiveg_qmi_stat_max(atomic64_t *max, s64 value) {
+    s64 old = atomic64_read(max);
+
+    while (value > old && !atomic64_try_cmpxchg(max, &old, value))
+        ;
+}
+
+static unsigned int fiveg_qmi_hist_bucket(u64 ns) {
+    return min_t(unsigned int, ilog2(div_u64(ns, NSEC_PER_USEC) | 1), QMI_HIST_BUCKETS - 1);
+}
+
+// Чтение, которое присоединяется к такому же выполняющемуся запросу или
+// выполняет его само. Сколько бы читателей ни пришло одновременно, к
+// модему уходит один запрос.
+static int fiveg_qmi_read(const char *command, int handler, char *output, size_t output_len) {
+    struct fiveg_qmi *qmi = &conn->qmi;
+    struct fiveg_qmi_flight *flight, *found = NULL;
+    int ret;
+
+    spin_lock(&qmi->flight_lock);
+    list_for_each_entry(flight, &qmi->flights, list) {
+        if (strcmp(flight->command, command) == 0) {
+            kref_get(&flight->ref);
+            found = flight;
+            break;
+        }
+    }
+    spin_unlock(&qmi->flight_lock);
+
+    if (!found) {
+        // Без памяти под общий результат - отдельный запрос
+        atomic64_inc(&fiveg_qmi_stats[handler].runs);
+        flight = kmalloc(sizeof(*flight), GFP_KERNEL);
+        if (!flight)
+            return fiveg_qmi_run(command, handler, output, output_len);
+        kref_init(&flight->ref);
+        init_completion(&flight->done);
+        flight->command = command;
+
+        spin_lock(&qmi->flight_lock);
+        list_add_tail(&flight->list, &qmi->flights);
+        spin_unlock(&qmi->flight_lock);
+
+        flight->ret = fiveg_qmi_run(command, handler, flight->output, sizeof(flight->output));
+
+        // Строка команды принадлежит этому вызову: после удаления из списка
+        // её больше никто не сравнивает
+        spin_lock(&qmi->flight_lock);
+        list_del(&flight->list);
+        spin_unlock(&qmi->flight_lock);
+        complete_all(&flight->done);
+        found = flight;
+    }
+
+    // Ведущий ограничен таймаутом QMI; ждущего можно убить
+    ret = wait_for_completion_killable(&found->done);
+    if (ret == 0) {
+        ret = found->ret;
+        if (output_len)
+            strscpy(output, found->output, output_len);
+    }
+    kref_put(&found->ref, fiveg_qmi_flight_free);
+    return ret;
+}
+
+// Команда QMI. Одинаковые чтения объединяются, команды, меняющие
+// состояние, выполняются строго по одной. Команды не из таблицы не
+// выполняются: -EOPNOTSUPP.
+static int fiveg_send_qmi_command(const char *command, char *output, size_t output_len) {
+    int handler = fiveg_qmi_find_handler(command);
+    struct fiveg_qmi_stat *stat;
+    u64 start = ktime_get_ns(), waited;
+    int depth, peak, ret;
+
+    if (handler < 0)
+        return -EOPNOTSUPP;
+    stat = &fiveg_qmi_stats[handler];
+    atomic64_inc(&stat->calls);
+    depth = atomic_inc_return(&stat->depth);
+    peak = atomic_read(&stat->peak);
+    while (depth > peak && !atomic_try_cmpxchg(&stat->peak, &peak, depth))
+        ;
+
+    if (!fiveg_qmi_handlers[handler].writes) {
+        ret = fiveg_qmi_read(command, handler, output, output_len);
+    } else {
+        mutex_lock(&conn->qmi.command_lock);
+        atomic64_inc(&stat->runs);
+        ret = fiveg_qmi_run(command, handler, output, output_len);
+        mutex_unlock(&conn->qmi.command_lock);
+    }
+
+    waited = ktime_get_ns() - start;
+    atomic_dec(&stat->depth);
+    atomic64_add(waited, &stat->wait_ns);
+    fiveg_qmi_stat_max(&stat->wait_max_ns, waited);
+    atomic64_inc(&stat->hist[fiveg_qmi_hist_bucket(waited)]);
+    if (ret == -ETIMEDOUT)
+        atomic64_inc(&stat->timeouts);
+    else if (ret < 0)
+        atomic64_inc(&stat->errors);
+    return ret;
+}
+
+// --- Порт WWAN ---
+
+// Приём пачки: skb по frag_len байт, каждый в очередь порта
+static void fiveg_port_rx(struct fiveg_port *port, const u8 *data, size_t len) {
+    struct sk_buff *skb;
+    size_t chunk;
+
+    while (len) {
+        chunk = min_t(size_t, len, port->caps.frag_len);
+        skb = alloc_skb(chunk, GFP_KERNEL);
+        if (!skb) {
+            atomic64_inc(&port->dropped);
+            return;
+        }
+        skb_put_data(skb, data, chunk);
+        wwan_port_rx(port->wwan, skb);
+        atomic64_inc(&port->received);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+static int fiveg_port_flush(struct fiveg_port *port, size_t len) {
+    loff_t pos = 0;
+    size_t done = 0;
+    ssize_t ret;
+
+    if (port->loopback) {
+        fiveg_port_rx(port, port->tx_buf, len);
+        return 0;
     }
+    while (done < len) {
+        ret = kernel_write(port->filp, port->tx_buf + done, len - done, &pos);
+        if (ret <= 0)
+            return ret < 0 ? ret : -EIO;
+        done += ret;
+    }
+    return 0;
+}
+
+// Пачка skb склеивается в tx_buf; большие skb (запись больше буфера)
+// уходят несколькими kernel_write
+static void fiveg_port_submit(struct fiveg_port *port, struct sk_buff_head *batch) {
+    struct sk_buff *skb;
+    size_t used = 0, offset, chunk;
+    unsigned int count = 0;
+    int ret = 0;
+
+    while ((skb = __skb_dequeue(batch))) {
+        for (offset = 0; offset < skb->len && !ret; offset += chunk) {
+            chunk = min_t(size_t, skb->len - offset, port->buf_len - used);
+            skb_copy_bits(skb, offset, port->tx_buf + used, chunk);
+            used += chunk;
+            if (used == port->buf_len) {
+                ret = fiveg_port_flush(port, used);
+                used = 0;
+            }
+        }
+        consume_skb(skb);
+        count++;
+    }
+    if (used && !ret)
+        ret = fiveg_port_flush(port, used);
+
+    atomic64_inc(&port->batches);
+    if (ret) {
+        atomic64_add(count, &port->dropped);
+        pr_err_ratelimited("%s: port write failed: %d\n", DRIVER_NAME, ret);
+    } else {
+        atomic64_add(count, &port->sent);
+    }
+}
+
+static void fiveg_port_tx_work(struct work_struct *work) {
+    struct fiveg_port *port = container_of(work, struct fiveg_port, tx_work);
+    struct sk_buff_head batch;
+    struct sk_buff *skb;
+    bool wake;
+
+    __skb_queue_head_init(&batch);
+    do {
+        spin_lock_bh(&port->txq.lock);
+        while (skb_queue_len(&batch) < PORT_BATCH && (skb = __skb_dequeue(&port->txq)))
+            __skb_queue_tail(&batch, skb);
+        wake = port->tx_stopped && skb_queue_len(&port->txq) <= PORT_TXQ_LOW;
+        if (wake)
+            port->tx_stopped = false;
+        spin_unlock_bh(&port->txq.lock);
+
+        if (wake)
+            wwan_port_txon(port->wwan);
+        if (!skb_queue_empty(&batch))
+            fiveg_port_submit(port, &batch);
+    } while (!skb_queue_empty(&port->txq));
+}
 
-    ret = call_usermodehelper_exec(sub_info, UMH_NO_WAIT);
+static int fiveg_port_tx(struct wwan_port *wwan, struct sk_buff *skb) {
+    struct fiveg_connection *conn = wwan_port_get_drvdata(wwan);
+    struct fiveg_port *port = &conn->port;
+    bool stop;
+
+    spin_lock_bh(&port->txq.lock);
+    __skb_queue_tail(&port->txq, skb);
+    stop = !port->tx_stopped && skb_queue_len(&port->txq) >= PORT_TXQ_HIGH;
+    if (stop)
+        port->tx_stopped = true;
+    spin_unlock_bh(&port->txq.lock);
+
+    // Пишущие в порт ждут (или получают EAGAIN), пока очередь не
+    // опустится до PORT_TXQ_LOW
+    if (stop)
+        wwan_port_txoff(wwan);
+    atomic64_inc(&port->queued);
+    queue_work(system_unbound_wq, &port->tx_work);
+    return 0;
+}
+
+static int fiveg_port_reader(void *data) {
+    struct fiveg_port *port = data;
+    ssize_t len;
+    loff_t pos;
+
+    // Сигнал будит поток из kernel_read при остановке
+    allow_signal(SIGINT);
+    while (!kthread_should_stop() && !READ_ONCE(port->stopping)) {
+        pos = 0;
+        len = kernel_read(port->filp, port->rx_buf, port->buf_len, &pos);
+        if (len > 0) {
+            fiveg_port_rx(port, port->rx_buf, len);
+        } else if (signal_pending(current)) {
+            flush_signals(current);
+        } else {
+            // Ошибка или 0 - tty повешен (модем отключён)
+            msleep(100);
+        }
+    }
+    flush_signals(current);
+    while (!kthread_should_stop()) {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (!kthread_should_stop())
+            schedule();
+        __set_current_state(TASK_RUNNING);
+    }
+    return 0;
+}
+
+// Сырой режим, как cfmakeraw: без эха, построчного ввода, замены CR/LF
+// и сигналов по управляющим символам - AT-клиенту нужен байт в байт
+static int fiveg_port_set_raw(struct fiveg_port *port) {
+    struct ktermios raw;
+    struct tty_struct *tty;
+    int ret;
+
+    tty = tty_kopen_shared(file_inode(port->filp)->i_rdev);
+    if (IS_ERR_OR_NULL(tty)) {
+        ret = tty ? PTR_ERR(tty) : -ENODEV;
+        // Не tty (например, FIFO для проверки): настраивать нечего
+        return ret == -ENODEV ? 0 : ret;
+    }
+
+    down_read(&tty->termios_rwsem);
+    port->saved_termios = tty->termios;
+    up_read(&tty->termios_rwsem);
+
+    raw = port->saved_termios;
+    raw.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+    raw.c_oflag &= ~OPOST;
+    raw.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    raw.c_cflag &= ~(CSIZE | PARENB);
+    raw.c_cflag |= CS8;
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    ret = tty_set_termios(tty, &raw);
     if (ret < 0) {
-        kfree(ctx->output_buffer);
-        kfree(ctx);
+        tty_kref_put(tty);
         return ret;
     }
+    port->tty = tty;
+    return 0;
+}
 
-    wait_for_completion_interruptible(&ctx->comp);
+// Открытие /dev/wwan0at0: бэкенд tty открывается только на это время
+static int fiveg_port_start(struct wwan_port *wwan) {
+    struct fiveg_connection *conn = wwan_port_get_drvdata(wwan);
+    struct fiveg_port *port = &conn->port;
+    struct file *filp;
+    int ret;
 
-    size_t copy_len = min((size_t)output_len - 1, strlen(ctx->output_buffer));
-    strncpy(output, ctx->output_buffer, copy_len);
-    output[copy_len] = '\0';
+    if (port->loopback)
+        return 0;
 
-    kfree(ctx->output_buffer);
-    kfree(ctx);
-    return ret; // Возвращаем ret из call_usermodehelper_exec
-}
+    filp = filp_open(port_device, O_RDWR | O_NOCTTY, 0);
+    if (IS_ERR(filp)) {
+        printk(KERN_ERR "Failed to open %s: %ld\n", port_device, PTR_ERR(filp));
+        return PTR_ERR(filp);
+    }
+    port->filp = filp;
+    // Режим задаётся до запуска читателя, чтобы первый ответ не прошёл
+    // через эхо и ICRNL
+    ret = fiveg_port_set_raw(port);
+    if (ret < 0) {
+        printk(KERN_ERR "Failed to set raw mode on %s: %d\n", port_device, ret);
+        goto err_close;
+    }
+    port->stopping = false;
+    port->reader = kthread_run(fiveg_port_reader, port, "fiveg_port");
+    if (IS_ERR(port->reader)) {
+        ret = PTR_ERR(port->reader);
+        goto err_restore;
+    }
+    return 0;
 
+err_restore:
+    if (port->tty) {
+        tty_set_termios(port->tty, &port->saved_termios);
+        tty_kref_put(port->tty);
+        port->tty = NULL;
+    }
+err_close:
+    filp_close(filp, NULL);
+    port->filp = NULL;
+    return ret;
+}
 
+// Последнее закрытие: неотправленное отбрасывается и считается в dropped
+static void fiveg_port_stop(struct wwan_port *wwan) {
+    struct fiveg_connection *conn = wwan_port_get_drvdata(wwan);
+    struct fiveg_port *port = &conn->port;
+
+    cancel_work_sync(&port->tx_work);
+    atomic64_add(skb_queue_len(&port->txq), &port->dropped);
+    skb_queue_purge(&port->txq);
+    if (port->tx_stopped) {
+        port->tx_stopped = false;
+        wwan_port_txon(wwan);
+    }
 
+    if (!port->filp)
+        return;
+    WRITE_ONCE(port->stopping, true);
+    send_sig(SIGINT, port->reader, 1);
+    kthread_stop(port->reader);
+    if (port->tty) {
+        tty_set_termios(port->tty, &port->saved_termios);
+        tty_kref_put(port->tty);
+        port->tty = NULL;
+    }
+    filp_close(port->filp, NULL);
+    port->filp = NULL;
+}
 
-static char *fiveg_get_iccid(void) {
-    char *iccid;
-    int i;
+static const struct wwan_port_ops fiveg_wwan_port_ops = {
+    .start = fiveg_port_start,
+    .stop = fiveg_port_stop,
+    .tx = fiveg_port_tx,
+};
 
-    iccid = kmalloc(ICCID_LENGTH + 1, GFP_KERNEL);
-    if (!iccid) {
-        return NULL;
+static int fiveg_port_init(struct fiveg_port *port) {
+    port->loopback = !strcmp(port_backend, "loopback");
+    port->caps.frag_len = PORT_FRAG_LEN;
+    port->caps.headroom_len = 0;
+    port->buf_len = PORT_BATCH * port->caps.frag_len;
+    skb_queue_head_init(&port->txq);
+    INIT_WORK(&port->tx_work, fiveg_port_tx_work);
+    port->tx_buf = kvmalloc(port->buf_len, GFP_KERNEL);
+    port->rx_buf = kvmalloc(port->buf_len, GFP_KERNEL);
+    if (!port->tx_buf || !port->rx_buf) {
+        kvfree(port->tx_buf);
+        kvfree(port->rx_buf);
+        return -ENOMEM;
     }
+    return 0;
+}
+
+static void fiveg_port_free(struct fiveg_port *port) {
+    kvfree(port->tx_buf);
+    kvfree(port->rx_buf);
+}
+
+
+
+
+static void fiveg_read_iccid(char *iccid) {
+    u64 start = ktime_get_ns();
+    int i;
 
     for (i = 0; i < ICCID_LENGTH; i++) {
         iccid[i] = readb(base_register + ICCID_REGISTER_OFFSET + i);
     }
 
     iccid[ICCID_LENGTH] = '\0';
+    trace_fiveg_iccid_read(iccid, ktime_get_ns() - start);
+}
 
-    return iccid;
+// --- Кэш состояния ---
+
+static void fiveg_status_read(struct fiveg_connection *conn, struct fiveg_status *status) {
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&conn->status_lock);
+        *status = conn->status;
+    } while (read_seqretry(&conn->status_lock, seq));
+}
+
+static void fiveg_status_set_radio(struct fiveg_connection *conn, bool on) {
+    write_seqlock(&conn->status_lock);
+    conn->status.radio_on = on;
+    conn->status.radio_ns = ktime_get_ns();
+    write_sequnlock(&conn->status_lock);
+}
+
+// Опрос модема вне seqlock; неудачный опрос оставляет прежнее значение и его
+// время, так что читатель видит, насколько оно устарело
+static void fiveg_status_refresh(struct work_struct *work) {
+    struct fiveg_connection *conn = container_of(to_delayed_work(work), struct fiveg_connection, status_work);
+    char signal[sizeof(conn->status.signal)];
+    char mode[16];
+    bool have_signal, have_mode;
+    u8 value;
+    u64 now;
+
+    have_signal = fiveg_send_qmi_command("nas get-signal-strength", signal, sizeof(signal)) == 0 && signal[0];
+    have_mode = fiveg_send_qmi_command("dms get-operating-mode", mode, sizeof(mode)) == 0 &&
+                kstrtou8(mode, 10, &value) == 0;
+
+    now = ktime_get_ns();
+    write_seqlock(&conn->status_lock);
+    if (have_signal) {
+        strscpy(conn->status.signal, signal, sizeof(conn->status.signal));
+        conn->status.signal_ns = now;
+    }
+    if (have_mode) {
+        conn->status.radio_on = value == QMI_DMS_MODE_ONLINE;
+        conn->status.radio_ns = now;
+    }
+    write_sequnlock(&conn->status_lock);
+
+    // Опрос может ждать таймаутов QMI, поэтому system_long_wq
+    queue_delayed_work(system_long_wq, &conn->status_work,
+                       msecs_to_jiffies(max_t(unsigned int, READ_ONCE(status_refresh_ms), STATUS_REFRESH_MIN_MS)));
 }
 
 static int fiveg_connect(struct fiveg_connection *conn, const char *ip, int port, struct device *dev) {
@@ -220,6 +1175,162 @@ static int fiveg_connect(struct fiveg_connection *conn, const char *ip, int port
     return 0;
 }
 
+// --- Канал на сервер MEC ---
+
+// Одна отправка: segment > 0 - len байт режутся ядром на датаграммы по
+// segment (последняя может быть короче)
+static int fiveg_mec_sendmsg(struct fiveg_connection *conn, u8 *data, size_t len, u16 segment) {
+    char control[CMSG_SPACE(sizeof(u16))];
+    struct msghdr msg = {
+        .msg_name = &conn->server_addr,
+        .msg_namelen = sizeof(conn->server_addr),
+    };
+    struct kvec iov = {data, len};
+    struct cmsghdr *cmsg;
+
+    if (segment) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(u16));
+        *(u16 *)CMSG_DATA(cmsg) = segment;
+        atomic64_inc(&conn->mec.gso_sends);
+    }
+    atomic64_inc(&conn->mec.sends);
+    return kernel_sendmsg(conn->sock, &msg, &iov, 1, len);
+}
+
+// Отправка накопленного; вызывается под mec->lock
+static void fiveg_mec_flush_locked(struct fiveg_connection *conn) {
+    struct fiveg_mec *mec = &conn->mec;
+    unsigned int i = 0, j, k;
+    size_t offset = 0, run, pos;
+    bool gso = READ_ONCE(mec_gso) && !mec->gso_failed;
+    int ret;
+
+    while (i < mec->count) {
+        // Серия одного размера и, возможно, одна более короткая в конце
+        run = mec->len[i];
+        for (j = i + 1; gso && j < mec->count && mec->len[j] == mec->len[i]; j++)
+            run += mec->len[j];
+        if (gso && j < mec->count && mec->len[j] < mec->len[i])
+            run += mec->len[j++];
+
+        ret = fiveg_mec_sendmsg(conn, mec->buf + offset, run, j - i > 1 ? mec->len[i] : 0);
+        if (ret < 0 && j - i > 1 && (ret == -EINVAL || ret == -EIO || ret == -EOPNOTSUPP)) {
+            // EINVAL - сегмент больше MTU, серия уходит по одной датаграмме;
+            // EIO/EOPNOTSUPP - устройство не умеет GSO, тогда и все следующие
+            if (ret != -EINVAL && !mec->gso_failed) {
+                printk(KERN_WARNING "MEC uplink: UDP_SEGMENT failed (%d), sending datagrams one by one\n", ret);
+                mec->gso_failed = true;
+                gso = false;
+            }
+            for (k = i, pos = offset, ret = 0; k < j && ret >= 0; pos += mec->len[k++])
+                ret = fiveg_mec_sendmsg(conn, mec->buf + pos, mec->len[k], 0);
+        }
+        if (ret < 0) {
+            atomic64_add(j - i, &mec->dropped);
+            pr_err_ratelimited("MEC uplink: send failed: %d\n", ret);
+        } else {
+            atomic64_add(j - i, &mec->sent);
+        }
+        offset += run;
+        i = j;
+    }
+    mec->count = 0;
+    mec->used = 0;
+}
+
+static void fiveg_mec_flush_work(struct work_struct *work) {
+    struct fiveg_mec *mec = container_of(to_delayed_work(work), struct fiveg_mec, flush_work);
+    struct fiveg_connection *conn = container_of(mec, struct fiveg_connection, mec);
+
+    mutex_lock(&mec->lock);
+    if (mec->count)
+        fiveg_mec_flush_locked(conn);
+    mutex_unlock(&mec->lock);
+}
+
+// Датаграмма на сервер MEC. Копируется в пачку и уходит, когда пачка
+// наберёт mec_batch датаграмм или через mec_flush_us после первой.
+// Может спать: только из контекста процесса.
+int fiveg_mec_send(const void *data, size_t len) {
+    struct fiveg_connection *conn;
+    struct fiveg_mec *mec;
+    unsigned int batch = clamp_t(unsigned int, READ_ONCE(mec_batch), 1, MEC_BATCH_MAX);
+    int idx, ret = 0;
+
+    if (!len || len > MEC_BUF_SIZE)
+        return -EMSGSIZE;
+
+    idx = srcu_read_lock(&fiveg_mec_srcu);
+    conn = srcu_dereference(fiveg_mec_conn, &fiveg_mec_srcu);
+    if (!conn) {
+        ret = -ENODEV;
+        goto out;
+    }
+    mec = &conn->mec;
+
+    mutex_lock(&mec->lock);
+    if (mec->closed) {
+        ret = -ENODEV;
+        goto out_unlock;
+    }
+    if (mec->used + len > MEC_BUF_SIZE)
+        fiveg_mec_flush_locked(conn);
+    memcpy(mec->buf + mec->used, data, len);
+    mec->used += len;
+    mec->len[mec->count++] = len;
+    atomic64_inc(&mec->queued);
+    if (mec->count >= batch)
+        fiveg_mec_flush_locked(conn);
+    else if (mec->count == 1)
+        queue_delayed_work(system_highpri_wq, &mec->flush_work, usecs_to_jiffies(READ_ONCE(mec_flush_us)));
+out_unlock:
+    mutex_unlock(&mec->lock);
+out:
+    srcu_read_unlock(&fiveg_mec_srcu, idx);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(fiveg_mec_send);
+
+// Немедленная отправка накопленного
+void fiveg_mec_flush(void) {
+    struct fiveg_connection *conn;
+    int idx;
+
+    idx = srcu_read_lock(&fiveg_mec_srcu);
+    conn = srcu_dereference(fiveg_mec_conn, &fiveg_mec_srcu);
+    if (conn) {
+        mutex_lock(&conn->mec.lock);
+        if (!conn->mec.closed && conn->mec.count)
+            fiveg_mec_flush_locked(conn);
+        mutex_unlock(&conn->mec.lock);
+    }
+    srcu_read_unlock(&fiveg_mec_srcu, idx);
+}
+EXPORT_SYMBOL_GPL(fiveg_mec_flush);
+
+// Неотправленное при выгрузке отбрасывается. Буфер освобождается под lock,
+// после чего отправка видит closed и не трогает его; работа, пришедшая
+// позже, находит пустую пачку
+static void fiveg_mec_close(struct fiveg_connection *conn) {
+    struct fiveg_mec *mec = &conn->mec;
+
+    mutex_lock(&mec->lock);
+    mec->closed = true;
+    atomic64_add(mec->count, &mec->dropped);
+    mec->count = 0;
+    mec->used = 0;
+    kvfree(mec->buf);
+    mec->buf = NULL;
+    mutex_unlock(&mec->lock);
+    cancel_delayed_work_sync(&mec->flush_work);
+}
+
 static ssize_t antenna_power_show(struct device *dev, struct device_attribute *attr, char *buf) {
     u8 power_state = readb(base_register + ANTENNA_POWER_REGISTER_OFFSET);
     return sprintf(buf, "%u\n", power_state);
@@ -243,18 +1354,90 @@ static ssize_t antenna_power_store(struct device *dev, struct device_attribute *
 }
 static DEVICE_ATTR(antenna_power, 0644, antenna_power_show, antenna_power_store);
 
-static int fiveg_proc_show(struct seq_file *m, void *v) {
-    char iccid[ICCID_LENGTH + 1];
-    char signal_strength[256];
+static ssize_t iccid_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct fiveg_status status;
+
+    fiveg_status_read(conn, &status);
+    return sprintf(buf, "%s\n", status.iccid);
+}
+static DEVICE_ATTR(iccid, 0444, iccid_show, NULL);
 
-    memset(iccid, 0, sizeof(iccid));
-    memset(signal_strength, 0, sizeof(signal_strength));
-    strncpy(iccid, fiveg_get_iccid(), ICCID_LENGTH);
+static ssize_t signal_strength_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct fiveg_status status;
+
+    fiveg_status_read(conn, &status);
+    return sprintf(buf, "%s\n", status.signal);
+}
+static DEVICE_ATTR(signal_strength, 0444, signal_strength_show, NULL);
 
-    fiveg_send_qmi_command("nas get-signal-strength", signal_strength, sizeof(signal_strength));
+// Проверочная нагрузка для mec_sink: "<число> [размер]" отправляет
+// столько датаграмм с номером и временем отправки
+static ssize_t mec_probe_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+    unsigned int number, size = 1200, i;
+    u8 *datagram;
+    int ret = 0;
 
-    seq_printf(m, "ICCID: %s\n", iccid);
-    seq_printf(m, "Signal Strength: %s\n", signal_strength);
+    if (sscanf(buf, "%u %u", &number, &size) < 1)
+        return -EINVAL;
+    if (size < MEC_PROBE_HEADER || size > MEC_BUF_SIZE)
+        return -EINVAL;
+    datagram = kzalloc(size, GFP_KERNEL);
+    if (!datagram)
+        return -ENOMEM;
+    for (i = 0; i < number && ret == 0; i++) {
+        mec_probe_encode(datagram, (u32)atomic_inc_return(&conn->mec.probe_seq) - 1, ktime_get_ns());
+        ret = fiveg_mec_send(datagram, size);
+        if (fatal_signal_pending(current))
+            ret = -EINTR;
+    }
+    fiveg_mec_flush();
+    kfree(datagram);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR(mec_probe, 0200, NULL, mec_probe_store);
+
+static struct attribute *fiveg_attrs[] = {
+    &dev_attr_antenna_power.attr,
+    &dev_attr_iccid.attr,
+    &dev_attr_signal_strength.attr,
+    &dev_attr_mec_probe.attr,
+    NULL,
+};
+
+static const struct attribute_group fiveg_attr_group = {
+    .attrs = fiveg_attrs,
+};
+
+static void fiveg_proc_age(struct seq_file *m, const char *name, u64 stamp, u64 now) {
+    if (stamp)
+        seq_printf(m, "%s Age: %llu ms\n", name, div_u64(now - stamp, NSEC_PER_MSEC));
+    else
+        seq_printf(m, "%s Age: never\n", name);
+}
+
+// Только копия снимка: чтение не обращается ни к MMIO, ни к модему
+static int fiveg_proc_show(struct seq_file *m, void *v) {
+    struct fiveg_status status;
+    u64 now;
+
+    trace_fiveg_proc_read(PROC_FILENAME);
+    fiveg_status_read(conn, &status);
+    now = ktime_get_ns();
+
+    seq_printf(m, "ICCID: %s\n", status.iccid);
+    seq_printf(m, "Signal Strength: %s\n", status.signal);
+    seq_printf(m, "Radio: %s\n", !status.radio_ns ? "unknown" : status.radio_on ? "on" : "off");
+    fiveg_proc_age(m, "ICCID", status.iccid_ns, now);
+    fiveg_proc_age(m, "Signal Strength", status.signal_ns, now);
+    fiveg_proc_age(m, "Radio", status.radio_ns, now);
+    seq_printf(m, "WWAN Port: %s queued %lld sent %lld dropped %lld received %lld batches %lld\n",
+               conn->port.loopback ? "loopback" : port_device, atomic64_read(&conn->port.queued),
+               atomic64_read(&conn->port.sent), atomic64_read(&conn->port.dropped),
+               atomic64_read(&conn->port.received), atomic64_read(&conn->port.batches));
+    seq_printf(m, "MEC Uplink: %pI4:%u queued %lld sent %lld dropped %lld sends %lld gso %lld\n",
+               &conn->server_addr.sin_addr, ntohs(conn->server_addr.sin_port), atomic64_read(&conn->mec.queued),
+               atomic64_read(&conn->mec.sent), atomic64_read(&conn->mec.dropped), atomic64_read(&conn->mec.sends),
+               atomic64_read(&conn->mec.gso_sends));
 
     return 0;
 }
@@ -263,18 +1446,78 @@ static int fiveg_proc_open(struct inode *inode, struct file *file) {
     return single_open(file, fiveg_proc_show, NULL);
 }
 
-static const struct file_operations fiveg_proc_fops = {
-    .open = fiveg_proc_open,
-    .read = seq_read,
-    .llseek = seq_lseek,
-    .release = single_release,
+static const struct proc_ops fiveg_proc_ops = {
+    .proc_open = fiveg_proc_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
 };
 
+// Строка на команду: calls - вызовов, runs - из них ушло в модем,
+// depth/peak - ждущих сейчас и максимум, wait - от вызова до результата
+static int fiveg_qmi_proc_show(struct seq_file *m, void *v) {
+    struct fiveg_qmi_stat *stat;
+    s64 calls;
+    int i;
+
+    trace_fiveg_proc_read(PROC_QMI_FILENAME);
+    for (i = 0; i < ARRAY_SIZE(fiveg_qmi_stats); i++) {
+        stat = &fiveg_qmi_stats[i];
+        calls = atomic64_read(&stat->calls);
+        seq_printf(m, "%s: calls %lld runs %lld depth %d peak %d wait avg %llu us max %llu us\n",
+                   fiveg_qmi_handlers[i].command, calls,
+                   atomic64_read(&stat->runs), atomic_read(&stat->depth), atomic_read(&stat->peak),
+                   calls ? div64_u64(atomic64_read(&stat->wait_ns), calls) / NSEC_PER_USEC : 0,
+                   (u64)atomic64_read(&stat->wait_max_ns) / NSEC_PER_USEC);
+    }
+    return 0;
+}
+
+static int fiveg_qmi_proc_open(struct inode *inode, struct file *file) {
+    return single_open(file, fiveg_qmi_proc_show, NULL);
+}
+
+static const struct proc_ops fiveg_qmi_proc_ops = {
+    .proc_open = fiveg_qmi_proc_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+// debugfs fiveg_driver/qmi_stats: счётчики и гистограмма ожидания команды,
+// "<N us: count" - вызовов, дождавшихся результата быстрее N мкс
+static int fiveg_qmi_debugfs_show(struct seq_file *m, void *v) {
+    struct fiveg_qmi_stat *stat;
+    s64 count;
+    int i, b;
+
+    for (i = 0; i < ARRAY_SIZE(fiveg_qmi_stats); i++) {
+        stat = &fiveg_qmi_stats[i];
+        seq_printf(m, "%s: calls %lld runs %lld errors %lld timeouts %lld\n",
+                   fiveg_qmi_handlers[i].command,
+                   atomic64_read(&stat->calls), atomic64_read(&stat->runs), atomic64_read(&stat->errors),
+                   atomic64_read(&stat->timeouts));
+        for (b = 0; b < QMI_HIST_BUCKETS; b++) {
+            count = atomic64_read(&stat->hist[b]);
+            if (count)
+                seq_printf(m, "  <%llu us: %lld\n", 2ULL << b, count);
+        }
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fiveg_qmi_debugfs);
+
+// Ошибки debugfs не мешают работе драйвера и не проверяются
+static void fiveg_debugfs_init(struct fiveg_connection *conn) {
+    conn->debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+    debugfs_create_file("qmi_stats", 0444, conn->debugfs, NULL, &fiveg_qmi_debugfs_fops);
+    debugfs_create_u32("qmi_timeout_ms", 0644, conn->debugfs, &qmi_timeout_ms);
+}
+
 static int fiveg_probe(struct platform_device *pdev) {
     int ret;
     struct device *dev = &pdev->dev;
     struct resource *res;
-    char *iccid;
 
     printk(KERN_INFO "%s: Probing...\n", DRIVER_NAME);
 
@@ -285,6 +1528,19 @@ static int fiveg_probe(struct platform_device *pdev) {
 
     strncpy(conn->qmi_device, QMI_DEVICE_PATH, sizeof(conn->qmi_device) -1);
     conn->qmi_device[sizeof(conn->qmi_device) - 1] = '\0';
+    mutex_init(&conn->qmi.lock);
+    mutex_init(&conn->qmi.write_lock);
+    spin_lock_init(&conn->qmi.pending_lock);
+    INIT_LIST_HEAD(&conn->qmi.pending);
+    atomic_set(&conn->qmi.next_tid, 0);
+    spin_lock_init(&conn->qmi.flight_lock);
+    INIT_LIST_HEAD(&conn->qmi.flights);
+    mutex_init(&conn->qmi.command_lock);
+    seqlock_init(&conn->status_lock);
+    INIT_DELAYED_WORK(&conn->status_work, fiveg_status_refresh);
+    mutex_init(&conn->mec.lock);
+    atomic_set(&conn->mec.probe_seq, 0);
+    INIT_DELAYED_WORK(&conn->mec.flush_work, fiveg_mec_flush_work);
 
     res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
     if (!res) {
@@ -298,66 +1554,96 @@ static int fiveg_probe(struct platform_device *pdev) {
         goto err_free_conn;
     }
 
-    iccid = fiveg_get_iccid();
-    if (iccid) {
-        printk(KERN_INFO "ICCID: %s\n", iccid);
-        kfree(iccid);
-    } else {
-        printk(KERN_ERR "Failed to read ICCID\n");
-    }
+    // ICCID не меняется, пока карта в слоте: читаем один раз
+    fiveg_read_iccid(conn->status.iccid);
+    conn->status.iccid_ns = ktime_get_ns();
+    printk(KERN_INFO "ICCID: %s\n", conn->status.iccid);
 
-    ret = fiveg_connect(conn, "192.168.1.100", 8944, dev);
+    conn->mec_server_address = mec_address;
+    conn->mec_server_port = mec_port;
+    ret = fiveg_connect(conn, conn->mec_server_address, conn->mec_server_port, dev);
     if (ret < 0) {
         goto err_free_conn;
     }
 
-    ret = device_create_file(dev, &dev_attr_antenna_power);
+    conn->mec.buf = kvmalloc(MEC_BUF_SIZE, GFP_KERNEL);
+    if (!conn->mec.buf) {
+        ret = -ENOMEM;
+        goto err_rfkill;
+    }
+
+    ret = sysfs_create_group(&dev->kobj, &fiveg_attr_group);
     if (ret) {
         dev_err(dev, "Failed to create sysfs attributes\n");
         goto err_rfkill;
     }
 
-    conn->proc_file = proc_create(PROC_FILENAME, 0644, NULL, &fiveg_proc_fops);
+    conn->proc_file = proc_create(PROC_FILENAME, 0644, NULL, &fiveg_proc_ops);
     if (!conn->proc_file) {
         printk(KERN_ERR "Failed to create /proc/%s file\n", PROC_FILENAME);
+        ret = -ENOMEM;
         goto err_sysfs;
     }
 
-    fiveg_wwan_port_caps.frag_len = 4096;
-    fiveg_wwan_port_caps.headroom_len = 0;
+    conn->qmi_proc_file = proc_create(PROC_QMI_FILENAME, 0444, NULL, &fiveg_qmi_proc_ops);
+    if (!conn->qmi_proc_file) {
+        printk(KERN_ERR "Failed to create /proc/%s file\n", PROC_QMI_FILENAME);
+        ret = -ENOMEM;
+        goto err_proc;
+    }
 
-    fiveg_wwan_port = wwan_create_port(dev, WWAN_PORT_AT, &fiveg_wwan_port_ops, &fiveg_wwan_port_caps, conn);
-    if (IS_ERR(fiveg_wwan_port)) {
-        printk(KERN_ERR "Failed to create WWAN port\n");
-        ret = PTR_ERR(fiveg_wwan_port);
+    ret = fiveg_port_init(&conn->port);
+    if (ret)
         goto err_proc;
+
+    conn->port.wwan = wwan_create_port(dev, WWAN_PORT_AT, &fiveg_wwan_port_ops, &conn->port.caps, conn);
+    if (IS_ERR(conn->port.wwan)) {
+        printk(KERN_ERR "Failed to create WWAN port\n");
+        ret = PTR_ERR(conn->port.wwan);
+        goto err_port;
     }
 
+    fiveg_debugfs_init(conn);
     platform_set_drvdata(pdev, conn);
+    rcu_assign_pointer(fiveg_mec_conn, conn);
+    queue_delayed_work(system_long_wq, &conn->status_work, 0);
     printk(KERN_INFO "%s: Probed successfully\n", DRIVER_NAME);
     return 0;
 
+err_port:
+    fiveg_port_free(&conn->port);
+
 err_proc:
+    proc_remove(conn->qmi_proc_file);
     proc_remove(conn->proc_file);
 
 err_sysfs:
-    device_remove_file(dev, &dev_attr_antenna_power);
+    sysfs_remove_group(&dev->kobj, &fiveg_attr_group);
 
 err_rfkill:
+    fiveg_mec_close(conn);
     rfkill_unregister(conn->rfkill);
     rfkill_destroy(conn->rfkill);
     sock_release(conn->sock);
 
 err_free_conn:
+    fiveg_qmi_close(conn);
     kfree(conn);
+    conn = NULL;
     return ret;
 }
 
+// Работает с глобальным conn (его же хранит drvdata), чтобы обнулить
+// его вместе с освобождением
 static void fiveg_remove(struct platform_device *pdev) {
-    struct fiveg_connection *conn = platform_get_drvdata(pdev);
-
-    if (fiveg_wwan_port) {
-        wwan_remove_port(fiveg_wwan_port);
+    // Сначала закрывается вход для других модулей: после synchronize_srcu
+    // никто из них не держит conn
+    RCU_INIT_POINTER(fiveg_mec_conn, NULL);
+    synchronize_srcu(&fiveg_mec_srcu);
+
+    if (conn->port.wwan) {
+        wwan_remove_port(conn->port.wwan);
+        fiveg_port_free(&conn->port);
         printk(KERN_INFO "WWAN port removed\n");
     }
 
@@ -365,17 +1651,25 @@ static void fiveg_remove(struct platform_device *pdev) {
         proc_remove(conn->proc_file);
         printk(KERN_INFO "/proc/%s file removed\n", PROC_FILENAME);
     }
+    proc_remove(conn->qmi_proc_file);
+    debugfs_remove_recursive(conn->debugfs);
 
-    device_remove_file(&pdev->dev, &dev_attr_antenna_power);
+    sysfs_remove_group(&pdev->dev.kobj, &fiveg_attr_group);
 
-    if (conn && conn->rfkill) {
-        rfkill_unregister(conn->rfkill);
-        rfkill_destroy(conn->rfkill);
-    }
-    if (conn && conn->sock) {
+    // Команды QMI шлют только rfkill и опрос состояния: после
+    // rfkill_unregister set_block не вызывается и не выполняется, опрос
+    // отменяется вместе с перепостановкой
+    rfkill_unregister(conn->rfkill);
+    cancel_delayed_work_sync(&conn->status_work);
+    fiveg_qmi_close(conn);
+    fiveg_mec_close(conn);
+    rfkill_destroy(conn->rfkill);
+
+    if (conn->sock) {
         sock_release(conn->sock);
     }
     kfree(conn);
+    conn = NULL;
 
     printk(KERN_INFO "%s: Removed\n", DRIVER_NAME);
 }
@@ -0,0 +1,96 @@
+// Точки трассировки драйвера fiveg: /sys/kernel/tracing/events/fiveg/.
+// Заголовок читается дважды (TRACE_HEADER_MULTI_READ); события создаёт
+// fiveg.c через CREATE_TRACE_POINTS, для поиска заголовка в каталоге
+// модуля в Kbuild нужно CFLAGS_fiveg.o := -I$(src). __assign_str с одним
+// аргументом требует ядра 6.10 и новее
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM fiveg
+
+#if !defined(_FIVEG_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _FIVEG_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+#define FIVEG_TRACE_OUTPUT 128   // начало вывода команды в событии
+
+// Обращение к модему за командой (после объединения одинаковых чтений)
+TRACE_EVENT(fiveg_qmi_start,
+    TP_PROTO(const char *command, int handler),
+    TP_ARGS(command, handler),
+    TP_STRUCT__entry(
+        __string(command, command)
+        __field(int, handler)
+    ),
+    TP_fast_assign(
+        __assign_str(command);
+        __entry->handler = handler;
+    ),
+    TP_printk("command=\"%s\" handler=%d", __get_str(command), __entry->handler)
+);
+
+TRACE_EVENT(fiveg_qmi_finish,
+    TP_PROTO(const char *command, int ret, u64 duration_ns, const char *output),
+    TP_ARGS(command, ret, duration_ns, output),
+    TP_STRUCT__entry(
+        __string(command, command)
+        __field(int, ret)
+        __field(u64, duration_ns)
+        __array(char, output, FIVEG_TRACE_OUTPUT)
+    ),
+    TP_fast_assign(
+        __assign_str(command);
+        __entry->ret = ret;
+        __entry->duration_ns = duration_ns;
+        strscpy(__entry->output, output, FIVEG_TRACE_OUTPUT);
+    ),
+    TP_printk("command=\"%s\" ret=%d duration=%llu ns output=\"%s\"", __get_str(command),
+              __entry->ret, __entry->duration_ns, __entry->output)
+);
+
+TRACE_EVENT(fiveg_rfkill,
+    TP_PROTO(bool blocked, int ret),
+    TP_ARGS(blocked, ret),
+    TP_STRUCT__entry(
+        __field(bool, blocked)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->blocked = blocked;
+        __entry->ret = ret;
+    ),
+    TP_printk("radio=%s ret=%d", __entry->blocked ? "off" : "on", __entry->ret)
+);
+
+TRACE_EVENT(fiveg_iccid_read,
+    TP_PROTO(const char *iccid, u64 duration_ns),
+    TP_ARGS(iccid, duration_ns),
+    TP_STRUCT__entry(
+        __string(iccid, iccid)
+        __field(u64, duration_ns)
+    ),
+    TP_fast_assign(
+        __assign_str(iccid);
+        __entry->duration_ns = duration_ns;
+    ),
+    TP_printk("iccid=%s duration=%llu ns", __get_str(iccid), __entry->duration_ns)
+);
+
+TRACE_EVENT(fiveg_proc_read,
+    TP_PROTO(const char *file),
+    TP_ARGS(file),
+    TP_STRUCT__entry(
+        __string(file, file)
+    ),
+    TP_fast_assign(
+        __assign_str(file);
+    ),
+    TP_printk("file=%s", __get_str(file))
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE fiveg_trace
+#include <trace/define_trace.h>
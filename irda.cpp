@@ -4,12 +4,26 @@
 #include <fcntl.h>
 #include "socket.h"
 #include "irda.h"
+#include "irda_session.h"
+#include "irda_txq.h"
+#include <pthread.h>
+#include <atomic>
 #include <unistd.h> //  for  close()
 #include <errno.h>  //  for  errno
 #include <string.h> //  fot  strerror()
 
 //ATTENTION, ALL COMMENTS WILL BE IN RUSSIAN NOW
 #define TAG "IrDA_JNI"
+#define IRDA_CONTROLLER_CLASS "com/example/app/IrDAController"
+
+//  Класс IrDAController, закреплённый в JNI_OnLoad, и его onTxComplete
+static jclass g_controller_class = nullptr;
+static jmethodID g_on_tx_complete = nullptr;
+static JavaVM *g_vm = nullptr;
+//  Потоки очередей подключаются к JVM один раз и отключаются при выходе
+static pthread_key_t g_detach_key;
+//  Сегмент телеметрии процесса (nativeTelemetry), nullptr - не подключён
+static std::atomic<telemetry_t *> g_telemetry(nullptr);
 
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_example_app_IrDAController_sendIrDAData(JNIEnv *env, jobject /* this */, jstring data) {
@@ -31,6 +45,7 @@ Java_com_example_app_IrDAController_sendIrDAData(JNIEnv *env, jobject /* this */
     //  Проверяем  наличие  IrDA
     if (access("/dev/irda0", F_OK) == -1) {
         __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: IrDA device not found");
+        env->ReleaseStringUTFChars(data, nativeData);
         return env->NewStringUTF("Error: IrDA device not found");
     }
 
@@ -39,6 +54,7 @@ Java_com_example_app_IrDAController_sendIrDAData(JNIEnv *env, jobject /* this */
 
     if (irda_device_fd < 0) {
         __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: Failed to open IrDA device: %s", strerror(errno));
+        env->ReleaseStringUTFChars(data, nativeData);
         return env->NewStringUTF("Error: Failed to open IrDA device");
     }
 
@@ -48,6 +64,7 @@ Java_com_example_app_IrDAController_sendIrDAData(JNIEnv *env, jobject /* this */
     if (result < 0) {
         __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: Failed to send data via IrDA: %s", strerror(errno));
         close(irda_device_fd);
+        env->ReleaseStringUTFChars(data, nativeData);
         return env->NewStringUTF("Error: Failed to send data via IrDA");
     }
 
@@ -59,3 +76,351 @@ Java_com_example_app_IrDAController_sendIrDAData(JNIEnv *env, jobject /* this */
 
     return env->NewStringUTF("Data sent successfully");
 }
+
+//  --- Сессия ---
+//
+//  Устройство открывается один раз (nativeOpen), дескриптор сессии
+//  хранится в Java как long. Отправка берёт данные прямо из direct
+//  ByteBuffer без копирования и без преобразования в строку, поэтому
+//  проходят любые байты. Все методы возвращают число >= 0 или -errno;
+//  строки на каждый вызов не создаются.
+//
+//  На стороне Java:
+//    private static native long nativeOpen(String path);      // null - /dev/irda0
+//    private static native int nativeSend(long handle, ByteBuffer buffer, int offset, int length);
+//    private static native int nativeSendBytes(long handle, byte[] data, int offset, int length);
+//    private static native int nativeClose(long handle);
+
+static irda_session* session_from_handle(jlong handle) {
+    return reinterpret_cast<irda_session*>(static_cast<intptr_t>(handle));
+}
+
+static bool range_valid(jlong capacity, jint offset, jint length) {
+    return offset >= 0 && length >= 0 && (jlong)offset + length <= capacity;
+}
+
+//  Дескриптор сессии или -errno
+static jlong irda_native_open(JNIEnv *env, jclass, jstring path) {
+    const char *nativePath = nullptr;
+    if (path != nullptr) {
+        nativePath = env->GetStringUTFChars(path, nullptr);
+        if (nativePath == nullptr) {
+            return -ENOMEM;
+        }
+    }
+    int status;
+    irda_session *session = irda_session_open(nativePath, &status);
+    if (session == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: Failed to open %s: %s",
+                            nativePath ? nativePath : IRDA_DEVICE_PATH, strerror(-status));
+    } else {
+        session->telemetry = g_telemetry.load();
+    }
+    if (nativePath != nullptr) {
+        env->ReleaseStringUTFChars(path, nativePath);
+    }
+    return session ? static_cast<jlong>(reinterpret_cast<intptr_t>(session)) : status;
+}
+
+//  Отправка length байт из direct ByteBuffer начиная с offset
+static jint irda_native_send(JNIEnv *env, jclass, jlong handle, jobject buffer, jint offset, jint length) {
+    irda_session *session = session_from_handle(handle);
+    if (session == nullptr) {
+        return -EBADF;
+    }
+    char *address = buffer ? static_cast<char *>(env->GetDirectBufferAddress(buffer)) : nullptr;
+    if (address == nullptr || !range_valid(env->GetDirectBufferCapacity(buffer), offset, length)) {
+        return -EINVAL;
+    }
+    return irda_session_send(session, address + offset, length);
+}
+
+//  Отправка из byte[] для вызывающих без direct-буфера; массив может
+//  быть скопирован виртуальной машиной
+static jint irda_native_send_bytes(JNIEnv *env, jclass, jlong handle, jbyteArray data, jint offset, jint length) {
+    irda_session *session = session_from_handle(handle);
+    if (session == nullptr) {
+        return -EBADF;
+    }
+    if (data == nullptr || !range_valid(env->GetArrayLength(data), offset, length)) {
+        return -EINVAL;
+    }
+    //  Не GetPrimitiveArrayCritical: write может надолго заблокироваться
+    jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+    if (bytes == nullptr) {
+        return -ENOMEM;
+    }
+    int result = irda_session_send(session, bytes + offset, length);
+    env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+    return result;
+}
+
+static jint irda_native_close(JNIEnv *, jclass, jlong handle) {
+    irda_session *session = session_from_handle(handle);
+    if (session == nullptr) {
+        return -EBADF;
+    }
+    return irda_session_close(session);
+}
+
+//  --- Телеметрия ---
+//
+//  Сегмент телеметрии (telemetry.h) подключается один раз на процесс и
+//  остаётся до его завершения; сессии, открытые после этого, считают в
+//  нём отправки, байты и ошибки без системных вызовов:
+//
+//    private static native int nativeTelemetry(String path);   // 0 или -errno
+
+static jint irda_native_telemetry(JNIEnv *env, jclass, jstring path) {
+    if (path == nullptr) {
+        return -EINVAL;
+    }
+    if (g_telemetry.load() != nullptr) {
+        return -EALREADY;
+    }
+    const char *nativePath = env->GetStringUTFChars(path, nullptr);
+    if (nativePath == nullptr) {
+        return -ENOMEM;
+    }
+    int status;
+    telemetry_t *telemetry = telemetry_attach(nativePath, &status);
+    if (telemetry == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: Failed to open telemetry %s: %s", nativePath,
+                            strerror(-status));
+    }
+    env->ReleaseStringUTFChars(path, nativePath);
+    if (telemetry == nullptr) {
+        return status;
+    }
+    telemetry_t *expected = nullptr;
+    if (!g_telemetry.compare_exchange_strong(expected, telemetry)) {
+        telemetry_close(telemetry);
+        return -EALREADY;
+    }
+    return 0;
+}
+
+//  --- Очередь передачи ---
+//
+//  Постановка в очередь не блокирует вызывающий поток (обычно UI):
+//  данные копируются, отправляет их поток очереди. О результатах он
+//  сообщает пачкой, одним вызовом на до IRDA_TX_BATCH записей:
+//
+//    private static native long nativeTxStart(long session, int frameSize, int capacity);
+//    private static native int nativeTxEnqueue(long queue, long id, ByteBuffer buffer, int offset, int length);
+//    private static native int nativeTxEnqueueBytes(long queue, long id, byte[] data, int offset, int length);
+//    private static native int nativeTxStats(long queue, long[] out);
+//    private static native int nativeTxStop(long queue);
+//    private static void onTxComplete(long queue, long[] ids, int[] statuses);
+//
+//  frameSize и capacity 0 - значения по умолчанию. status в onTxComplete -
+//  длина записи или -errno. nativeTxStop дожидается отправки уже
+//  поставленного; из onTxComplete его вызывать нельзя. nativeTxStart
+//  возвращает -EAGAIN или -ENOMEM, если поток очереди не создался; пока
+//  очередь не остановлена, nativeClose её сессии возвращает -EBUSY.
+
+struct irda_jni_txq {
+    irda_txq *queue;
+};
+
+//  Порядок значений nativeTxStats
+enum {
+    IRDA_TX_STAT_DEPTH,
+    IRDA_TX_STAT_ENQUEUED,
+    IRDA_TX_STAT_SENT,
+    IRDA_TX_STAT_FAILED,
+    IRDA_TX_STAT_REJECTED,
+    IRDA_TX_STAT_BYTES,
+    IRDA_TX_STAT_FRAMES,
+    IRDA_TX_STAT_ELAPSED_US,
+    IRDA_TX_STAT_LATENCY_P50_US,
+    IRDA_TX_STAT_LATENCY_P99_US,
+    IRDA_TX_STAT_COUNT
+};
+
+static void irda_detach_thread(void *) {
+    g_vm->DetachCurrentThread();
+}
+
+static JNIEnv *irda_attach_thread() {
+    JNIEnv *env = nullptr;
+    if (g_vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        return env;
+    }
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        return nullptr;
+    }
+    pthread_setspecific(g_detach_key, env);
+    return env;
+}
+
+static void irda_tx_complete(void *context, const irda_tx_completion *done, size_t count) {
+    if (g_on_tx_complete == nullptr) {
+        return;
+    }
+    JNIEnv *env = irda_attach_thread();
+    if (env == nullptr) {
+        return;
+    }
+    jlong ids[IRDA_TX_BATCH];
+    jint statuses[IRDA_TX_BATCH];
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = static_cast<jlong>(done[i].id);
+        statuses[i] = done[i].status;
+    }
+    jlongArray idArray = env->NewLongArray(count);
+    jintArray statusArray = env->NewIntArray(count);
+    if (idArray != nullptr && statusArray != nullptr) {
+        env->SetLongArrayRegion(idArray, 0, count, ids);
+        env->SetIntArrayRegion(statusArray, 0, count, statuses);
+        env->CallStaticVoidMethod(g_controller_class, g_on_tx_complete,
+                                  static_cast<jlong>(reinterpret_cast<intptr_t>(context)), idArray, statusArray);
+    }
+    if (env->ExceptionCheck()) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: onTxComplete threw an exception");
+        env->ExceptionClear();
+    }
+    env->DeleteLocalRef(idArray);
+    env->DeleteLocalRef(statusArray);
+}
+
+static irda_jni_txq *txq_from_handle(jlong handle) {
+    return reinterpret_cast<irda_jni_txq *>(static_cast<intptr_t>(handle));
+}
+
+static jlong irda_native_tx_start(JNIEnv *, jclass, jlong sessionHandle, jint frameSize, jint capacity) {
+    irda_session *session = session_from_handle(sessionHandle);
+    if (session == nullptr) {
+        return -EBADF;
+    }
+    if (frameSize < 0 || capacity < 0) {
+        return -EINVAL;
+    }
+    irda_jni_txq *handle = new (std::nothrow) irda_jni_txq();
+    if (handle == nullptr) {
+        return -ENOMEM;
+    }
+    int status;
+    handle->queue = irda_txq_start(session, frameSize, capacity, irda_tx_complete, handle, &status);
+    if (handle->queue == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: Failed to start TX queue: %s", strerror(-status));
+        delete handle;
+        return status;
+    }
+    return static_cast<jlong>(reinterpret_cast<intptr_t>(handle));
+}
+
+static jint irda_native_tx_enqueue(JNIEnv *env, jclass, jlong handle, jlong id, jobject buffer, jint offset,
+                                   jint length) {
+    irda_jni_txq *txq = txq_from_handle(handle);
+    if (txq == nullptr) {
+        return -EBADF;
+    }
+    char *address = buffer ? static_cast<char *>(env->GetDirectBufferAddress(buffer)) : nullptr;
+    if (address == nullptr || !range_valid(env->GetDirectBufferCapacity(buffer), offset, length)) {
+        return -EINVAL;
+    }
+    return irda_txq_enqueue(txq->queue, static_cast<uint64_t>(id), address + offset, length);
+}
+
+//  Одно копирование: из массива сразу в буфер, который уйдёт в очередь
+static jint irda_native_tx_enqueue_bytes(JNIEnv *env, jclass, jlong handle, jlong id, jbyteArray data, jint offset,
+                                         jint length) {
+    irda_jni_txq *txq = txq_from_handle(handle);
+    if (txq == nullptr) {
+        return -EBADF;
+    }
+    if (data == nullptr || length == 0 || !range_valid(env->GetArrayLength(data), offset, length)) {
+        return -EINVAL;
+    }
+    char *copy = static_cast<char *>(malloc(length));
+    if (copy == nullptr) {
+        return -ENOMEM;
+    }
+    env->GetByteArrayRegion(data, offset, length, reinterpret_cast<jbyte *>(copy));
+    return irda_txq_enqueue_owned(txq->queue, static_cast<uint64_t>(id), copy, length);
+}
+
+//  Заполняет out значениями IRDA_TX_STAT_*, возвращает их число
+static jint irda_native_tx_stats(JNIEnv *env, jclass, jlong handle, jlongArray out) {
+    irda_jni_txq *txq = txq_from_handle(handle);
+    if (txq == nullptr) {
+        return -EBADF;
+    }
+    if (out == nullptr) {
+        return -EINVAL;
+    }
+    irda_tx_stats stats;
+    irda_txq_get_stats(txq->queue, &stats);
+    jlong values[IRDA_TX_STAT_COUNT];
+    values[IRDA_TX_STAT_DEPTH] = stats.depth;
+    values[IRDA_TX_STAT_ENQUEUED] = stats.enqueued;
+    values[IRDA_TX_STAT_SENT] = stats.sent;
+    values[IRDA_TX_STAT_FAILED] = stats.failed;
+    values[IRDA_TX_STAT_REJECTED] = stats.rejected;
+    values[IRDA_TX_STAT_BYTES] = stats.bytes;
+    values[IRDA_TX_STAT_FRAMES] = stats.frames;
+    values[IRDA_TX_STAT_ELAPSED_US] = stats.elapsed_us;
+    values[IRDA_TX_STAT_LATENCY_P50_US] = stats.latency_p50_us;
+    values[IRDA_TX_STAT_LATENCY_P99_US] = stats.latency_p99_us;
+    jint count = env->GetArrayLength(out);
+    if (count > IRDA_TX_STAT_COUNT) {
+        count = IRDA_TX_STAT_COUNT;
+    }
+    env->SetLongArrayRegion(out, 0, count, values);
+    return count;
+}
+
+static jint irda_native_tx_stop(JNIEnv *, jclass, jlong handle) {
+    irda_jni_txq *txq = txq_from_handle(handle);
+    if (txq == nullptr) {
+        return -EBADF;
+    }
+    irda_txq_stop(txq->queue);
+    delete txq;
+    return 0;
+}
+
+static const JNINativeMethod g_irda_methods[] = {
+    {"nativeOpen", "(Ljava/lang/String;)J", reinterpret_cast<void *>(irda_native_open)},
+    {"nativeSend", "(JLjava/nio/ByteBuffer;II)I", reinterpret_cast<void *>(irda_native_send)},
+    {"nativeSendBytes", "(J[BII)I", reinterpret_cast<void *>(irda_native_send_bytes)},
+    {"nativeClose", "(J)I", reinterpret_cast<void *>(irda_native_close)},
+    {"nativeTelemetry", "(Ljava/lang/String;)I", reinterpret_cast<void *>(irda_native_telemetry)},
+    {"nativeTxStart", "(JII)J", reinterpret_cast<void *>(irda_native_tx_start)},
+    {"nativeTxEnqueue", "(JJLjava/nio/ByteBuffer;II)I", reinterpret_cast<void *>(irda_native_tx_enqueue)},
+    {"nativeTxEnqueueBytes", "(JJ[BII)I", reinterpret_cast<void *>(irda_native_tx_enqueue_bytes)},
+    {"nativeTxStats", "(J[J)I", reinterpret_cast<void *>(irda_native_tx_stats)},
+    {"nativeTxStop", "(J)I", reinterpret_cast<void *>(irda_native_tx_stop)},
+};
+
+//  Методы сессии регистрируются явно: без поиска по имени символа при
+//  первом вызове. Если в классе их нет (старая версия Java-кода),
+//  библиотека всё равно загружается ради sendIrDAData.
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *) {
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    g_vm = vm;
+    pthread_key_create(&g_detach_key, irda_detach_thread);
+    jclass controller = env->FindClass(IRDA_CONTROLLER_CLASS);
+    if (controller == nullptr) {
+        env->ExceptionClear();
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: %s not found", IRDA_CONTROLLER_CLASS);
+        return JNI_VERSION_1_6;
+    }
+    g_controller_class = static_cast<jclass>(env->NewGlobalRef(controller));
+    env->DeleteLocalRef(controller);
+    if (env->RegisterNatives(g_controller_class, g_irda_methods,
+                             sizeof(g_irda_methods) / sizeof(g_irda_methods[0])) != JNI_OK) {
+        env->ExceptionClear();
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: Failed to register IrDA session natives");
+    }
+    g_on_tx_complete = env->GetStaticMethodID(g_controller_class, "onTxComplete", "(J[J[I)V");
+    if (g_on_tx_complete == nullptr) {
+        env->ExceptionClear();
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Error: IrDAController.onTxComplete not found");
+    }
+    return JNI_VERSION_1_6;
+}
@@ -0,0 +1,396 @@
+#ifndef _IRDA_FRAMING_H_
+#define _IRDA_FRAMING_H_
+
+// Кадры IrDA в программе, для адаптеров, которые принимают сырой поток
+// (SIR через UART) или ждут готовую CRC (FIR):
+//
+//   SIR (IrLAP asynchronous wrapper): [XBOF 0xFF...] BOF 0xC0, данные и
+//   FCS с экранированием, EOF 0xC1. Байты 0xC0, 0xC1 и 0x7D передаются
+//   как 0x7D, байт ^ 0x20. FCS - CRC-16 CCITT (отражённый 0x8408, начало
+//   0xFFFF, инверсия), младшим байтом вперёд; по всему кадру с FCS
+//   остаток 0xF0B8.
+//   FIR: данные и CRC-32 IEEE 802.3 (отражённый 0xEDB88320), младшим
+//   байтом вперёд; преамбулу и 4PPM делает контроллер.
+//
+// CRC считаются по 8 байт за шаг (slicing-by-8, таблицы строятся при
+// компиляции). Байты, которые нужно экранировать, ищутся по 16 байт
+// (SSE2 или NEON) или по 8 (в 64-битном слове), а промежутки между ними
+// копируются memcpy. Всё пишется в буферы вызывающего, без выделения
+// памяти.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define IRDA_SIR_XBOF 0xFF
+#define IRDA_SIR_BOF 0xC0
+#define IRDA_SIR_EOF 0xC1
+#define IRDA_SIR_CE 0x7D
+#define IRDA_SIR_TRANS 0x20
+#define IRDA_SIR_XBOFS 10                // XBOF перед кадром по умолчанию (9600 бит/с)
+
+#define IRDA_CRC16_INIT 0xFFFF
+#define IRDA_CRC16_GOOD 0xF0B8
+#define IRDA_CRC32_INIT 0xFFFFFFFFu
+#define IRDA_CRC32_GOOD 0xDEBB20E3u
+
+// Ошибки (отрицательные результаты)
+#define IRDA_FRAME_ERR_SPACE -1          // не хватает места в буфере
+#define IRDA_FRAME_ERR_FCS -2            // неверная CRC или кадр короче CRC
+#define IRDA_FRAME_ERR_INCOMPLETE -3     // нет EOF
+
+// --- CRC ---
+
+struct irda_crc16_table {
+    uint16_t t[8][256];
+};
+
+struct irda_crc32_table {
+    uint32_t t[8][256];
+};
+
+// t[0] - обычная таблица на байт, t[k] - тот же байт, за которым идут
+// ещё k нулевых
+static constexpr struct irda_crc16_table irda_make_crc16_table() {
+    struct irda_crc16_table table = {};
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0x8408) : (uint16_t)(crc >> 1);
+        }
+        table.t[0][i] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint16_t prev = table.t[k - 1][i];
+            table.t[k][i] = (uint16_t)((prev >> 8) ^ table.t[0][prev & 0xFF]);
+        }
+    }
+    return table;
+}
+
+static constexpr struct irda_crc32_table irda_make_crc32_table() {
+    struct irda_crc32_table table = {};
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = (uint32_t)i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table.t[0][i] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t prev = table.t[k - 1][i];
+            table.t[k][i] = (prev >> 8) ^ table.t[0][prev & 0xFF];
+        }
+    }
+    return table;
+}
+
+static constexpr struct irda_crc16_table irda_crc16 = irda_make_crc16_table();
+static constexpr struct irda_crc32_table irda_crc32 = irda_make_crc32_table();
+
+// Продолжение CRC-16 без начального значения и инверсии
+static inline uint16_t irda_crc16_update(uint16_t crc, const uint8_t* data, size_t len) {
+    const uint16_t (*t)[256] = irda_crc16.t;
+    while (len >= 8) {
+        uint16_t x = crc ^ (uint16_t)(data[0] | (data[1] << 8));
+        crc = t[7][x & 0xFF] ^ t[6][x >> 8] ^ t[5][data[2]] ^ t[4][data[3]] ^ t[3][data[4]] ^ t[2][data[5]] ^
+              t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (uint16_t)((crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF]);
+    }
+    return crc;
+}
+
+static inline uint32_t irda_crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
+    const uint32_t (*t)[256] = irda_crc32.t;
+    while (len >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 |
+                             (uint32_t)data[3] << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+// FCS кадра SIR (уже с инверсией)
+static inline uint16_t irda_sir_fcs(const uint8_t* data, size_t len) {
+    return (uint16_t)~irda_crc16_update(IRDA_CRC16_INIT, data, len);
+}
+
+static inline uint32_t irda_fir_crc(const uint8_t* data, size_t len) {
+    return ~irda_crc32_update(IRDA_CRC32_INIT, data, len);
+}
+
+// --- Поиск байтов для экранирования ---
+
+static inline bool irda_sir_special(uint8_t b) {
+    return (b & 0xFE) == IRDA_SIR_BOF || b == IRDA_SIR_CE;
+}
+
+// Сколько байт с начала не нужно экранировать (индекс первого 0xC0,
+// 0xC1 или 0x7D, либо len)
+static inline size_t irda_sir_scan(const uint8_t* data, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i fe = _mm_set1_epi8((char)0xFE);
+    const __m128i bof = _mm_set1_epi8((char)IRDA_SIR_BOF);
+    const __m128i ce = _mm_set1_epi8((char)IRDA_SIR_CE);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(v, fe), bof), _mm_cmpeq_epi8(v, ce));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t fe = vdupq_n_u8(0xFE);
+    const uint8x16_t bof = vdupq_n_u8(IRDA_SIR_BOF);
+    const uint8x16_t ce = vdupq_n_u8(IRDA_SIR_CE);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t hit = vorrq_u8(vceqq_u8(vandq_u8(v, fe), bof), vceqq_u8(v, ce));
+        // 4 бита маски на байт
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask) {
+            return i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // В слове: нулевой байт в x - (x - 0x01..) & ~x & 0x80.. (младший
+    // найденный точен, ложные бывают только выше него)
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        uint64_t a = (v & (ones * 0xFE)) ^ (ones * IRDA_SIR_BOF);
+        uint64_t b = v ^ (ones * IRDA_SIR_CE);
+        uint64_t hit = ((a - ones) & ~a & high) | ((b - ones) & ~b & high);
+        if (hit) {
+            return i + (__builtin_ctzll(hit) >> 3);
+        }
+    }
+#endif
+    while (i < len && !irda_sir_special(data[i])) {
+        i++;
+    }
+    return i;
+}
+
+// --- SIR: упаковка ---
+
+// Наибольший размер кадра SIR для len байт данных
+static inline size_t irda_sir_wrap_bound(size_t len, int xbofs) {
+    return (size_t)xbofs + 1 + 2 * (len + 2) + 1;
+}
+
+// Экранирование с копированием промежутков; out должно вмещать 2 * len
+static inline size_t irda_sir_stuff(const uint8_t* in, size_t len, uint8_t* out) {
+    uint8_t* p = out;
+    size_t i = 0;
+    while (i < len) {
+        size_t run = irda_sir_scan(in + i, len - i);
+        memcpy(p, in + i, run);
+        p += run;
+        i += run;
+        if (i < len) {
+            *p++ = IRDA_SIR_CE;
+            *p++ = in[i++] ^ IRDA_SIR_TRANS;
+        }
+    }
+    return p - out;
+}
+
+// Кадр SIR из len байт данных; результат - длина кадра или
+// IRDA_FRAME_ERR_SPACE, если cap меньше irda_sir_wrap_bound
+static inline int irda_sir_wrap(const uint8_t* in, size_t len, int xbofs, uint8_t* out, size_t cap) {
+    if (cap < irda_sir_wrap_bound(len, xbofs)) {
+        return IRDA_FRAME_ERR_SPACE;
+    }
+    uint8_t* p = out;
+    memset(p, IRDA_SIR_XBOF, xbofs);
+    p += xbofs;
+    *p++ = IRDA_SIR_BOF;
+    p += irda_sir_stuff(in, len, p);
+    uint16_t fcs = irda_sir_fcs(in, len);
+    uint8_t trailer[2] = {(uint8_t)fcs, (uint8_t)(fcs >> 8)};
+    p += irda_sir_stuff(trailer, 2, p);
+    *p++ = IRDA_SIR_EOF;
+    return (int)(p - out);
+}
+
+// --- SIR: разбор потока ---
+
+#define IRDA_SIR_HUNT 0                  // ждём BOF
+#define IRDA_SIR_DATA 1
+#define IRDA_SIR_ESCAPE 2                // был CE, ждём байт
+
+// Разбор потока с линии, кусками любой длины. Данные кадра
+// собираются в buf вызывающего; кадр, не влезший в buf, отбрасывается.
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    int state;
+    unsigned long long frames;
+    unsigned long long bad_fcs;
+    unsigned long long overruns;
+    unsigned long long aborts;           // CE перед BOF/EOF
+} irda_sir_decoder_t;
+
+static inline void irda_sir_decoder_init(irda_sir_decoder_t* dec, uint8_t* buf, size_t cap) {
+    memset(dec, 0, sizeof(*dec));
+    dec->buf = buf;
+    dec->cap = cap;
+    dec->state = IRDA_SIR_HUNT;
+}
+
+static inline void irda_sir_put(irda_sir_decoder_t* dec, uint8_t b) {
+    if (dec->len < dec->cap) {
+        dec->buf[dec->len++] = b;
+    } else {
+        dec->overruns++;
+        dec->state = IRDA_SIR_HUNT;
+    }
+}
+
+// Проверка FCS по остатку: CRC всего кадра вместе с FCS
+template <typename Handler>
+static inline void irda_sir_deliver(irda_sir_decoder_t* dec, Handler& on_frame) {
+    if (dec->len < 2 || irda_crc16_update(IRDA_CRC16_INIT, dec->buf, dec->len) != IRDA_CRC16_GOOD) {
+        dec->bad_fcs++;
+        return;
+    }
+    dec->frames++;
+    on_frame(dec->buf, dec->len - 2);
+}
+
+// on_frame(const uint8_t* data, size_t len) - для каждого кадра с верной
+// FCS, данные без FCS; действительны до следующего вызова
+template <typename Handler>
+static inline void irda_sir_decode(irda_sir_decoder_t* dec, const uint8_t* data, size_t len, Handler on_frame) {
+    size_t i = 0;
+    while (i < len) {
+        if (dec->state == IRDA_SIR_HUNT) {
+            const uint8_t* bof = (const uint8_t*)memchr(data + i, IRDA_SIR_BOF, len - i);
+            if (!bof) {
+                return;
+            }
+            i = bof - data + 1;
+            dec->len = 0;
+            dec->state = IRDA_SIR_DATA;
+            continue;
+        }
+        uint8_t b = data[i];
+        if (dec->state == IRDA_SIR_ESCAPE) {
+            i++;
+            if (b == IRDA_SIR_BOF || b == IRDA_SIR_EOF) {
+                dec->aborts++;
+                dec->len = 0;
+                dec->state = b == IRDA_SIR_BOF ? IRDA_SIR_DATA : IRDA_SIR_HUNT;
+                continue;
+            }
+            dec->state = IRDA_SIR_DATA;
+            irda_sir_put(dec, b ^ IRDA_SIR_TRANS);
+            continue;
+        }
+
+        size_t run = irda_sir_scan(data + i, len - i);
+        if (run) {
+            if (dec->len + run > dec->cap) {
+                dec->overruns++;
+                dec->state = IRDA_SIR_HUNT;
+                i += run;
+                continue;
+            }
+            memcpy(dec->buf + dec->len, data + i, run);
+            dec->len += run;
+            i += run;
+            continue;
+        }
+        i++;
+        if (b == IRDA_SIR_BOF) {
+            dec->len = 0;                // повторный BOF - кадр заново
+        } else if (b == IRDA_SIR_EOF) {
+            irda_sir_deliver(dec, on_frame);
+            dec->state = IRDA_SIR_HUNT;
+        } else {
+            dec->state = IRDA_SIR_ESCAPE;
+        }
+    }
+}
+
+// Разбор первого кадра в in: длина данных или ошибка. FCS тоже
+// собирается в out, поэтому cap должен вмещать данные и ещё 2 байта.
+static inline int irda_sir_unwrap(const uint8_t* in, size_t len, uint8_t* out, size_t cap) {
+    irda_sir_decoder_t dec;
+    int result = IRDA_FRAME_ERR_INCOMPLETE;
+    bool done = false;
+    // Только до первого EOF после BOF, чтобы следующий кадр не затёр out
+    const uint8_t* bof = (const uint8_t*)memchr(in, IRDA_SIR_BOF, len);
+    const uint8_t* eof = bof ? (const uint8_t*)memchr(bof, IRDA_SIR_EOF, in + len - bof) : NULL;
+    if (!eof) {
+        return IRDA_FRAME_ERR_INCOMPLETE;
+    }
+    irda_sir_decoder_init(&dec, out, cap);
+    irda_sir_decode(&dec, bof, eof - bof + 1, [&](const uint8_t*, size_t frame_len) {
+        if (!done) {
+            result = (int)frame_len;
+            done = true;
+        }
+    });
+    if (!done && dec.bad_fcs) {
+        return IRDA_FRAME_ERR_FCS;
+    }
+    if (!done && dec.overruns) {
+        return IRDA_FRAME_ERR_SPACE;
+    }
+    return result;
+}
+
+// --- FIR ---
+
+// Данные и CRC-32; in и out могут совпадать. Длина кадра или
+// IRDA_FRAME_ERR_SPACE.
+static inline int irda_fir_wrap(const uint8_t* in, size_t len, uint8_t* out, size_t cap) {
+    if (cap < len + 4) {
+        return IRDA_FRAME_ERR_SPACE;
+    }
+    uint32_t crc = irda_fir_crc(in, len);
+    memmove(out, in, len);
+    out[len] = (uint8_t)crc;
+    out[len + 1] = (uint8_t)(crc >> 8);
+    out[len + 2] = (uint8_t)(crc >> 16);
+    out[len + 3] = (uint8_t)(crc >> 24);
+    return (int)(len + 4);
+}
+
+// Проверка CRC и копия данных в out (in и out могут совпадать)
+static inline int irda_fir_unwrap(const uint8_t* in, size_t len, uint8_t* out, size_t cap) {
+    if (len < 4 || irda_crc32_update(IRDA_CRC32_INIT, in, len) != IRDA_CRC32_GOOD) {
+        return IRDA_FRAME_ERR_FCS;
+    }
+    if (cap < len - 4) {
+        return IRDA_FRAME_ERR_SPACE;
+    }
+    memmove(out, in, len - 4);
+    return (int)(len - 4);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef _IRDA_SESSION_H_
+#define _IRDA_SESSION_H_
+
+// Сессия IrDA: устройство открывается один раз, дальше каждая отправка -
+// один write() без access/open/close. Без JNI, поэтому её же используют
+// irda.cpp (обёртка для Java) и irdabench (замеры на FIFO или pty).
+//
+// Все функции возвращают число >= 0 при успехе или -errno.
+//
+// Если в session->telemetry задан сегмент телеметрии (telemetry.h),
+// отправки и ошибки считаются и в нём.
+
+#include "telemetry.h"
+#include <atomic>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define IRDA_DEVICE_PATH "/dev/irda0"
+
+struct irda_session {
+    int fd;
+    std::atomic<uint64_t> sends;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> errors;
+    std::atomic<int> queues;           // очередей irda_txq.h, пишущих в fd
+    telemetry_t* telemetry;
+};
+
+static inline irda_session* irda_session_open(const char* path, int* status) {
+    int fd = open(path ? path : IRDA_DEVICE_PATH, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        *status = -errno;
+        return nullptr;
+    }
+    irda_session* session = new irda_session();
+    session->fd = fd;
+    session->sends = 0;
+    session->bytes = 0;
+    session->errors = 0;
+    session->queues = 0;
+    session->telemetry = nullptr;
+    *status = 0;
+    return session;
+}
+
+// Отправка length байт целиком: write повторяется после EINTR и
+// частичной записи. Возвращает length или -errno.
+static inline int irda_session_send(irda_session* session, const void* data, size_t length) {
+    const char* p = static_cast<const char*>(data);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = write(session->fd, p + done, length - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int status = -errno;
+            session->errors++;
+            if (session->telemetry) {
+                telemetry_irda_send(session->telemetry, length, status);
+            }
+            return status;
+        }
+        done += n;
+    }
+    session->sends++;
+    session->bytes += length;
+    if (session->telemetry) {
+        telemetry_irda_send(session->telemetry, length, (int)length);
+    }
+    return (int)length;
+}
+
+// Пока к сессии подключена очередь irda_txq.h, её поток может писать в
+// fd: сессия не закрывается, -EBUSY. Сначала irda_txq_stop.
+static inline int irda_session_close(irda_session* session) {
+    if (session->queues > 0) {
+        return -EBUSY;
+    }
+    int status = close(session->fd) < 0 ? -errno : 0;
+    delete session;
+    return status;
+}
+
+#endif
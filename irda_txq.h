@@ -0,0 +1,280 @@
+#ifndef _IRDA_TXQ_H_
+#define _IRDA_TXQ_H_
+
+// Асинхронная очередь передачи IrDA поверх irda_session.h. Постановка в
+// очередь не ждёт устройства: данные копируются, и вызов сразу
+// возвращается. Отдельный поток забирает из очереди до IRDA_TX_BATCH
+// записей за раз, режет каждую на кадры по frame_size байт (одна запись
+// в устройство - один кадр) и сообщает о результатах всей пачки одним
+// вызовом complete.
+//
+// Как и в irda_session.h, результаты - число >= 0 или -errno.
+
+#include "irda_session.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define IRDA_TX_BATCH 64
+#define IRDA_TX_CAPACITY 1024          // записей в очереди по умолчанию
+#define IRDA_TX_FRAME 2048             // наибольший кадр FIR
+#define IRDA_LATENCY_BUCKETS 32        // степени двойки микросекунд
+
+struct irda_tx_item {
+    uint64_t id;
+    char* data;
+    size_t length;
+    long long enqueued_ns;
+};
+
+// status - длина записи при успехе или -errno первого неудачного кадра
+struct irda_tx_completion {
+    uint64_t id;
+    int status;
+};
+
+typedef void (*irda_tx_complete_fn)(void* context, const irda_tx_completion* done, size_t count);
+
+struct irda_tx_stats {
+    uint64_t depth;
+    uint64_t enqueued;
+    uint64_t sent;
+    uint64_t failed;
+    uint64_t rejected;                 // очередь была полна
+    uint64_t bytes;
+    uint64_t frames;
+    long long elapsed_us;              // с запуска очереди
+    long long latency_p50_us;          // от постановки до отправки
+    long long latency_p99_us;
+};
+
+struct irda_txq {
+    irda_session* session;
+    size_t frame_size;
+    size_t capacity;
+    irda_tx_complete_fn complete;
+    void* context;
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<irda_tx_item> items;
+    bool stopping;
+    std::thread writer;
+    long long started_ns;
+    std::atomic<uint64_t> enqueued;
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> latency[IRDA_LATENCY_BUCKETS];
+};
+
+static inline long long irda_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int irda_latency_bucket(long long us) {
+    int bucket = 0;
+    while (us > 0 && bucket < IRDA_LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Верхняя граница корзины, в которую попадает перцентиль
+static inline long long irda_latency_percentile(const uint64_t* counts, double percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < IRDA_LATENCY_BUCKETS; i++) {
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(total * percentile / 100.0);
+    uint64_t seen = 0;
+    for (int i = 0; i < IRDA_LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen > target) {
+            return (1LL << i) - 1;
+        }
+    }
+    return (1LL << (IRDA_LATENCY_BUCKETS - 1)) - 1;
+}
+
+// Запись целиком, кадрами по frame_size
+static inline int irda_txq_send_item(irda_txq* queue, const irda_tx_item* item) {
+    size_t offset = 0;
+    do {
+        size_t frame = item->length - offset < queue->frame_size ? item->length - offset : queue->frame_size;
+        int status = irda_session_send(queue->session, item->data + offset, frame);
+        if (status < 0) {
+            return status;
+        }
+        queue->frames++;
+        offset += frame;
+    } while (offset < item->length);
+    return (int)item->length;
+}
+
+static inline void irda_txq_writer(irda_txq* queue) {
+    std::vector<irda_tx_item> batch;
+    std::vector<irda_tx_completion> done;
+    batch.reserve(IRDA_TX_BATCH);
+    done.reserve(IRDA_TX_BATCH);
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(queue->lock);
+            queue->ready.wait(guard, [queue] { return queue->stopping || !queue->items.empty(); });
+            if (queue->items.empty()) {
+                break;
+            }
+            while (!queue->items.empty() && batch.size() < IRDA_TX_BATCH) {
+                batch.push_back(queue->items.front());
+                queue->items.pop_front();
+            }
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            int status = irda_txq_send_item(queue, &batch[i]);
+            long long us = (irda_now_ns() - batch[i].enqueued_ns) / 1000;
+            queue->latency[irda_latency_bucket(us)]++;
+            if (status < 0) {
+                queue->failed++;
+            } else {
+                queue->sent++;
+                queue->bytes += batch[i].length;
+            }
+            done.push_back({batch[i].id, status});
+            free(batch[i].data);
+        }
+        if (queue->complete) {
+            queue->complete(queue->context, done.data(), done.size());
+        }
+        batch.clear();
+        done.clear();
+    }
+}
+
+// Очередь и её поток; frame_size и capacity 0 - значения по умолчанию.
+// Не создался поток или нет памяти - nullptr и -errno в status, без
+// исключений: функцию зовут и из JNI. Пока очередь не остановлена,
+// сессия не закрывается (irda_session_close вернёт -EBUSY).
+static inline irda_txq* irda_txq_start(irda_session* session, size_t frame_size, size_t capacity,
+                                       irda_tx_complete_fn complete, void* context, int* status) {
+    irda_txq* queue = new (std::nothrow) irda_txq();
+    if (queue == nullptr) {
+        *status = -ENOMEM;
+        return nullptr;
+    }
+    queue->session = session;
+    queue->frame_size = frame_size ? frame_size : IRDA_TX_FRAME;
+    queue->capacity = capacity ? capacity : IRDA_TX_CAPACITY;
+    queue->complete = complete;
+    queue->context = context;
+    queue->stopping = false;
+    queue->started_ns = irda_now_ns();
+    queue->enqueued = 0;
+    queue->sent = 0;
+    queue->failed = 0;
+    queue->rejected = 0;
+    queue->bytes = 0;
+    queue->frames = 0;
+    for (int i = 0; i < IRDA_LATENCY_BUCKETS; i++) {
+        queue->latency[i] = 0;
+    }
+    try {
+        queue->writer = std::thread(irda_txq_writer, queue);
+    } catch (const std::system_error& e) {
+        delete queue;
+        *status = e.code().value() ? -e.code().value() : -EAGAIN;
+        return nullptr;
+    } catch (const std::bad_alloc&) {
+        delete queue;
+        *status = -ENOMEM;
+        return nullptr;
+    }
+    session->queues++;
+    *status = 0;
+    return queue;
+}
+
+// Постановка уже выделенного malloc буфера: очередь забирает его себе
+// и освобождает после отправки (или сразу, если очередь полна)
+static inline int irda_txq_enqueue_owned(irda_txq* queue, uint64_t id, char* data, size_t length) {
+    if (length == 0) {
+        free(data);
+        return -EINVAL;
+    }
+    irda_tx_item item = {id, data, length, irda_now_ns()};
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if (queue->stopping || queue->items.size() >= queue->capacity) {
+            queue->rejected++;
+            free(data);
+            return queue->stopping ? -EPIPE : -EAGAIN;
+        }
+        wake = queue->items.empty();
+        queue->items.push_back(item);
+    }
+    queue->enqueued++;
+    if (wake) {
+        queue->ready.notify_one();
+    }
+    return 0;
+}
+
+static inline int irda_txq_enqueue(irda_txq* queue, uint64_t id, const void* data, size_t length) {
+    char* copy = static_cast<char*>(malloc(length ? length : 1));
+    if (!copy) {
+        return -ENOMEM;
+    }
+    memcpy(copy, data, length);
+    return irda_txq_enqueue_owned(queue, id, copy, length);
+}
+
+static inline void irda_txq_get_stats(irda_txq* queue, irda_tx_stats* stats) {
+    uint64_t counts[IRDA_LATENCY_BUCKETS];
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        stats->depth = queue->items.size();
+    }
+    stats->enqueued = queue->enqueued;
+    stats->sent = queue->sent;
+    stats->failed = queue->failed;
+    stats->rejected = queue->rejected;
+    stats->bytes = queue->bytes;
+    stats->frames = queue->frames;
+    stats->elapsed_us = (irda_now_ns() - queue->started_ns) / 1000;
+    for (int i = 0; i < IRDA_LATENCY_BUCKETS; i++) {
+        counts[i] = queue->latency[i];
+    }
+    stats->latency_p50_us = irda_latency_percentile(counts, 50);
+    stats->latency_p99_us = irda_latency_percentile(counts, 99);
+}
+
+// Остановка: уже поставленное отправляется и подтверждается, новые
+// записи отклоняются с -EPIPE. Сессию не закрывает.
+static inline void irda_txq_stop(irda_txq* queue) {
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->stopping = true;
+    }
+    queue->ready.notify_one();
+    queue->writer.join();
+    queue->session->queues--;
+    delete queue;
+}
+
+#endif
@@ -0,0 +1,523 @@
+// Замеры отправки IrDA без устройства: вместо /dev/irda0 - FIFO или
+// псевдотерминал, с другой стороны которого поток вычитывает данные.
+// Сравниваются старый путь sendIrDAData (access, open, запись, close на
+// каждый вызов), сессия irda_session.h (один write на вызов) и очередь
+// irda_txq.h, где замеряется постановка в очередь - то, что ждёт
+// вызывающий поток, - и время до подтверждения всех записей.
+//
+// Пример: irdabench -n 200000 -s 64          (FIFO во временном каталоге)
+//         irdabench -p -n 100000 -s 256      (псевдотерминал)
+//         irdabench -s 5000 -f 2048          (записи режутся на кадры)
+//         irdabench -T /dev/shm/zenith-telemetry   (сессия пишет в телеметрию)
+//
+// На каждый режим выводится строка
+// "<mode>: calls N errors N p50 N us p99 N us N calls/s". Все записанные
+// байты должны выйти с другой стороны, иначе код выхода 1.
+//
+// С -F вместо этого проверяется irda_framing.h: CRC по эталонным
+// значениям и побитовому расчёту, кадры SIR и FIR туда и обратно на
+// случайных данных (с частыми 0xC0, 0xC1, 0x7D), разбор потока кусками,
+// и выводится скорость в MB/s.
+//
+//         irdabench -F -s 2048              (кадры по 2048 байт)
+
+// IrDA send benchmark without the device: a FIFO or a pseudo-terminal
+// stands in for /dev/irda0 while a thread drains the other end. Compares
+// the old sendIrDAData path (access, open, write, close on every call),
+// an irda_session.h session (one write per call) and the irda_txq.h queue,
+// where the enqueue (what the caller waits for) is timed along with the
+// time until every payload is confirmed.
+//
+// Example: irdabench -n 200000 -s 64          (FIFO in a temporary directory)
+//          irdabench -p -n 100000 -s 256      (pseudo-terminal)
+//          irdabench -s 5000 -f 2048          (payloads split into frames)
+//          irdabench -T /dev/shm/zenith-telemetry   (session feeds telemetry)
+//
+// Each mode prints "<mode>: calls N errors N p50 N us p99 N us N calls/s".
+// Every byte written must come out of the drained end, otherwise the exit
+// status is 1.
+//
+// With -F it checks irda_framing.h instead: CRCs against reference values
+// and a bitwise implementation, SIR and FIR round trips on random payloads
+// (rich in 0xC0, 0xC1 and 0x7D), stream decoding in pieces, and prints
+// throughput in MB/s.
+//
+//          irdabench -F -s 2048              (2048-byte frames)
+
+#include "irda_framing.h"
+#include "irda_txq.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pty.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define IRDABENCH_CALLS 100000
+#define IRDABENCH_SIZE 64
+#define IRDABENCH_FRAMING_BYTES (256 << 20)   // объём на каждый замер -F
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-p] [-F] [-n calls] [-s size] [-f frame] [-T path]\n"
+            "  -p  use a pseudo-terminal instead of a FIFO\n"
+            "  -F  check and time SIR/FIR framing instead of sending\n"
+            "  -n  calls per mode (default %d)\n"
+            "  -s  bytes per call (default %d)\n"
+            "  -f  largest frame for the queue (default %d)\n"
+            "  -T  count session sends in this telemetry segment\n",
+            prog, IRDABENCH_CALLS, IRDABENCH_SIZE, IRDA_TX_FRAME);
+}
+
+// Старый путь: как в sendIrDAData, только write вместо ioctl
+// Побитовые CRC для сверки с табличными
+static uint16_t crc16_bitwise(const uint8_t* data, size_t len) {
+    uint16_t crc = IRDA_CRC16_INIT;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0x8408) : (uint16_t)(crc >> 1);
+        }
+    }
+    return (uint16_t)~crc;
+}
+
+static uint32_t crc32_bitwise(const uint8_t* data, size_t len) {
+    uint32_t crc = IRDA_CRC32_INIT;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+// Побайтовая упаковка SIR - эталон для irda_sir_wrap
+static std::vector<uint8_t> sir_wrap_bytewise(const uint8_t* data, size_t len, int xbofs) {
+    std::vector<uint8_t> out(xbofs, IRDA_SIR_XBOF);
+    out.push_back(IRDA_SIR_BOF);
+    uint16_t fcs = crc16_bitwise(data, len);
+    std::vector<uint8_t> body(data, data + len);
+    body.push_back((uint8_t)fcs);
+    body.push_back((uint8_t)(fcs >> 8));
+    for (uint8_t b : body) {
+        if (b == IRDA_SIR_BOF || b == IRDA_SIR_EOF || b == IRDA_SIR_CE) {
+            out.push_back(IRDA_SIR_CE);
+            out.push_back(b ^ IRDA_SIR_TRANS);
+        } else {
+            out.push_back(b);
+        }
+    }
+    out.push_back(IRDA_SIR_EOF);
+    return out;
+}
+
+static unsigned int framing_failures;
+
+static void framing_check(bool ok, const char* what, size_t len) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s (%zu bytes)\n", what, len);
+        framing_failures++;
+    }
+}
+
+// Данные, в которых экранируемые байты встречаются часто
+static void fill_random(uint8_t* data, size_t len, unsigned int* seed) {
+    static const uint8_t special[] = {IRDA_SIR_BOF, IRDA_SIR_EOF, IRDA_SIR_CE, IRDA_SIR_XBOF};
+    for (size_t i = 0; i < len; i++) {
+        int r = rand_r(seed);
+        data[i] = (r & 7) == 0 ? special[(r >> 3) & 3] : (uint8_t)(r >> 8);
+    }
+}
+
+static void framing_selftest(void) {
+    const uint8_t check[] = "123456789";
+    framing_check(irda_sir_fcs(check, 9) == 0x906E, "CRC-16 check value", 9);
+    framing_check(irda_fir_crc(check, 9) == 0xCBF43926, "CRC-32 check value", 9);
+
+    unsigned int seed = 1;
+    std::vector<uint8_t> data(4096), frame(irda_sir_wrap_bound(4096, IRDA_SIR_XBOFS)), back(4096 + 4);
+    for (size_t len = 0; len <= 4096; len = len < 64 ? len + 1 : len * 2 - 1) {
+        fill_random(data.data(), len, &seed);
+        framing_check(irda_sir_fcs(data.data(), len) == crc16_bitwise(data.data(), len), "CRC-16", len);
+        framing_check(irda_fir_crc(data.data(), len) == crc32_bitwise(data.data(), len), "CRC-32", len);
+
+        int n = irda_sir_wrap(data.data(), len, IRDA_SIR_XBOFS, frame.data(), frame.size());
+        std::vector<uint8_t> expected = sir_wrap_bytewise(data.data(), len, IRDA_SIR_XBOFS);
+        framing_check(n == (int)expected.size() && memcmp(frame.data(), expected.data(), n) == 0, "SIR wrap", len);
+        int m = irda_sir_unwrap(frame.data(), n, back.data(), back.size());
+        framing_check(m == (int)len && memcmp(back.data(), data.data(), len) == 0, "SIR unwrap", len);
+        framing_check(irda_sir_wrap(data.data(), len, 0, frame.data(), irda_sir_wrap_bound(len, 0) - 1) ==
+                          IRDA_FRAME_ERR_SPACE,
+                      "SIR wrap short buffer", len);
+        if (len > 0) {
+            // Один испорченный байт данных - ошибка FCS (байт до и после
+            // порчи не служебный, иначе меняется разметка кадра)
+            size_t at = IRDA_SIR_XBOFS + 1;
+            if (!irda_sir_special(frame[at]) && !irda_sir_special(frame[at] ^ 0x01)) {
+                frame[at] ^= 0x01;
+                framing_check(irda_sir_unwrap(frame.data(), n, back.data(), back.size()) == IRDA_FRAME_ERR_FCS,
+                              "SIR corrupted frame", len);
+            }
+        }
+
+        n = irda_fir_wrap(data.data(), len, frame.data(), frame.size());
+        framing_check(n == (int)len + 4, "FIR wrap", len);
+        m = irda_fir_unwrap(frame.data(), n, back.data(), back.size());
+        framing_check(m == (int)len && memcmp(back.data(), data.data(), len) == 0, "FIR unwrap", len);
+        frame[len / 2] ^= 0x80;
+        framing_check(irda_fir_unwrap(frame.data(), n, back.data(), back.size()) == IRDA_FRAME_ERR_FCS,
+                      "FIR corrupted frame", len);
+    }
+
+    // Поток из кадров с мусором между ними, поданный кусками случайной
+    // длины: все кадры должны собраться без изменений
+    std::vector<uint8_t> stream;
+    std::vector<std::vector<uint8_t>> sent;
+    for (int i = 0; i < 500; i++) {
+        size_t len = rand_r(&seed) % 300;
+        std::vector<uint8_t> payload(len);
+        fill_random(payload.data(), len, &seed);
+        std::vector<uint8_t> wrapped = sir_wrap_bytewise(payload.data(), len, i % 3);
+        stream.insert(stream.end(), wrapped.begin(), wrapped.end());
+        if (i % 7 == 0) {
+            stream.push_back(IRDA_SIR_EOF);  // мусор вне кадра
+        }
+        sent.push_back(payload);
+    }
+    std::vector<uint8_t> buf(512);
+    irda_sir_decoder_t dec;
+    irda_sir_decoder_init(&dec, buf.data(), buf.size());
+    size_t received = 0;
+    bool same = true;
+    for (size_t pos = 0; pos < stream.size();) {
+        size_t piece = 1 + rand_r(&seed) % 97;
+        piece = std::min(piece, stream.size() - pos);
+        irda_sir_decode(&dec, stream.data() + pos, piece, [&](const uint8_t* p, size_t len) {
+            if (received >= sent.size() || sent[received].size() != len ||
+                (len && memcmp(sent[received].data(), p, len) != 0)) {
+                same = false;
+            }
+            received++;
+        });
+        pos += piece;
+    }
+    framing_check(same && received == sent.size() && dec.bad_fcs == 0, "SIR stream decode", stream.size());
+    printf("framing self-test: %s\n", framing_failures ? "FAILED" : "ok");
+}
+
+static void framing_rate(const char* what, size_t bytes, long long elapsed_ns) {
+    printf("%s: %.0f MB/s\n", what, elapsed_ns > 0 ? bytes * 1e3 / elapsed_ns : 0.0);
+}
+
+// Скорость на кадрах по size байт: обычные данные и худший для SIR
+// случай, когда экранировать приходится каждый байт
+static void framing_bench(size_t size) {
+    unsigned int seed = 2;
+    std::vector<uint8_t> data(size), escaped(size, IRDA_SIR_CE);
+    std::vector<uint8_t> frame(irda_sir_wrap_bound(size, 0)), back(size + 4);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)rand_r(&seed);
+    }
+    size_t rounds = std::max<size_t>(1, IRDABENCH_FRAMING_BYTES / size);
+    volatile uint32_t sink = 0;
+    long long start;
+
+    start = now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        sink = sink + irda_sir_fcs(data.data(), size);
+    }
+    framing_rate("crc16 slicing-by-8", rounds * size, now_ns() - start);
+    start = now_ns();
+    for (size_t r = 0; r < rounds / 8 + 1; r++) {
+        sink = sink + crc16_bitwise(data.data(), size);
+    }
+    framing_rate("crc16 bitwise", (rounds / 8 + 1) * size, now_ns() - start);
+    start = now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        sink = sink + irda_fir_crc(data.data(), size);
+    }
+    framing_rate("crc32 slicing-by-8", rounds * size, now_ns() - start);
+
+    const struct {
+        const char* name;
+        const uint8_t* payload;
+    } inputs[] = {{"random", data.data()}, {"all-escaped", escaped.data()}};
+    for (const auto& input : inputs) {
+        char name[64];
+        int n = 0;
+        start = now_ns();
+        for (size_t r = 0; r < rounds; r++) {
+            n = irda_sir_wrap(input.payload, size, 0, frame.data(), frame.size());
+        }
+        snprintf(name, sizeof(name), "sir wrap %s", input.name);
+        framing_rate(name, rounds * size, now_ns() - start);
+        start = now_ns();
+        for (size_t r = 0; r < rounds; r++) {
+            sink = sink + irda_sir_unwrap(frame.data(), n, back.data(), back.size());
+        }
+        snprintf(name, sizeof(name), "sir unwrap %s", input.name);
+        framing_rate(name, rounds * size, now_ns() - start);
+    }
+
+    int n = 0;
+    start = now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        n = irda_fir_wrap(data.data(), size, frame.data(), frame.size());
+    }
+    framing_rate("fir wrap", rounds * size, now_ns() - start);
+    start = now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        sink = sink + irda_fir_unwrap(frame.data(), n, back.data(), back.size());
+    }
+    framing_rate("fir unwrap", rounds * size, now_ns() - start);
+    (void)sink;
+}
+
+static int send_reopen(const char* path, const void* data, size_t length) {
+    if (access(path, F_OK) == -1) {
+        return -errno;
+    }
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -errno;
+    }
+    int result = write(fd, data, length) == (ssize_t)length ? (int)length : -EIO;
+    close(fd);
+    return result;
+}
+
+struct async_result {
+    std::atomic<unsigned long long> completed;
+    std::atomic<unsigned long long> failed;
+    std::atomic<unsigned long long> callbacks;
+};
+
+static void async_complete(void* context, const irda_tx_completion* done, size_t count) {
+    struct async_result* result = static_cast<struct async_result*>(context);
+    for (size_t i = 0; i < count; i++) {
+        if (done[i].status < 0) {
+            result->failed++;
+        }
+    }
+    result->callbacks++;
+    result->completed += count;
+}
+
+static void report(const char* mode, std::vector<long long>* samples, unsigned int errors, long long elapsed_ns) {
+    std::sort(samples->begin(), samples->end());
+    size_t n = samples->size();
+    printf("%s: calls %zu errors %u p50 %.1f us p99 %.1f us %.0f calls/s\n", mode, n, errors,
+           n ? (*samples)[n / 2] / 1000.0 : 0.0, n ? (*samples)[n * 99 / 100] / 1000.0 : 0.0,
+           elapsed_ns > 0 ? n * 1e9 / elapsed_ns : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    bool use_pty = false;
+    bool framing = false;
+    const char* telemetry_path = NULL;
+    unsigned int calls = IRDABENCH_CALLS;
+    size_t size = IRDABENCH_SIZE;
+    size_t frame = IRDA_TX_FRAME;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "pFn:s:f:T:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            use_pty = true;
+            break;
+        case 'F':
+            framing = true;
+            break;
+        case 'n':
+            calls = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            size = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            frame = strtoul(optarg, NULL, 0);
+            break;
+        case 'T':
+            telemetry_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (size == 0 || frame == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (framing) {
+        framing_selftest();
+        framing_bench(size);
+        return framing_failures ? 1 : 0;
+    }
+
+    // Сторона "устройства": всё записанное вычитывается и отбрасывается
+    std::string path;
+    int drain_fd = -1;
+    char dir[] = "/tmp/irdabench.XXXXXX";
+    if (use_pty) {
+        int slave;
+        if (openpty(&drain_fd, &slave, NULL, NULL, NULL) < 0) {
+            perror("openpty");
+            return 1;
+        }
+        struct termios tio;
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+        path = ttyname(slave);
+        // Слейв остаётся открытым, иначе мастер получает EIO между вызовами
+    } else {
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        path = std::string(dir) + "/irda0";
+        if (mkfifo(path.c_str(), 0600) < 0) {
+            perror("mkfifo");
+            return 1;
+        }
+        drain_fd = open(path.c_str(), O_RDWR);
+    }
+    std::atomic<bool> stop(false);
+    std::atomic<unsigned long long> drained(0);
+    std::thread drain([&] {
+        std::vector<char> buf(65536);
+        while (!stop) {
+            struct pollfd pfd = {drain_fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0) {
+                continue;
+            }
+            ssize_t n = read(drain_fd, buf.data(), buf.size());
+            if (n > 0) {
+                drained += n;
+            }
+        }
+    });
+
+    std::vector<char> payload(size);
+    for (size_t i = 0; i < size; i++) {
+        payload[i] = (char)i;
+    }
+    std::vector<long long> samples;
+    samples.reserve(calls);
+    unsigned int errors = 0;
+
+    long long start = now_ns();
+    for (unsigned int i = 0; i < calls; i++) {
+        long long before = now_ns();
+        if (send_reopen(path.c_str(), payload.data(), size) < 0) {
+            errors++;
+        }
+        samples.push_back(now_ns() - before);
+    }
+    report("reopen", &samples, errors, now_ns() - start);
+
+    int status;
+    irda_session* session = irda_session_open(path.c_str(), &status);
+    if (!session) {
+        fprintf(stderr, "%s: %s\n", path.c_str(), strerror(-status));
+        return 1;
+    }
+    telemetry_t* telemetry = NULL;
+    if (telemetry_path) {
+        telemetry = telemetry_attach(telemetry_path, &status);
+        if (!telemetry) {
+            fprintf(stderr, "%s: %s\n", telemetry_path, strerror(-status));
+            return 1;
+        }
+        session->telemetry = telemetry;
+    }
+    samples.clear();
+    errors = 0;
+    start = now_ns();
+    for (unsigned int i = 0; i < calls; i++) {
+        long long before = now_ns();
+        if (irda_session_send(session, payload.data(), size) < 0) {
+            errors++;
+        }
+        samples.push_back(now_ns() - before);
+    }
+    report("session", &samples, errors, now_ns() - start);
+
+    // Очередь: при полной очереди постановка повторяется, как сделал бы
+    // вызывающий, получив -EAGAIN
+    struct async_result result;
+    result.completed = 0;
+    result.failed = 0;
+    result.callbacks = 0;
+    irda_txq* queue = irda_txq_start(session, frame, 0, async_complete, &result, &status);
+    if (queue == nullptr) {
+        fprintf(stderr, "irda_txq_start: %s\n", strerror(-status));
+        return 1;
+    }
+    samples.clear();
+    errors = 0;
+    unsigned long long retries = 0;
+    start = now_ns();
+    for (unsigned int i = 0; i < calls; i++) {
+        long long before = now_ns();
+        int status;
+        while ((status = irda_txq_enqueue(queue, i, payload.data(), size)) == -EAGAIN) {
+            retries++;
+            std::this_thread::yield();
+        }
+        if (status < 0) {
+            errors++;
+        }
+        samples.push_back(now_ns() - before);
+    }
+    while (result.completed < calls - errors) {
+        std::this_thread::yield();
+    }
+    long long elapsed = now_ns() - start;
+    report("async-enqueue", &samples, errors, elapsed);
+    irda_tx_stats stats;
+    irda_txq_get_stats(queue, &stats);
+    printf("async: completed %llu failed %llu in %llu callbacks, %llu frames, queue-full retries %llu, "
+           "enqueue-to-send p50 %lld us p99 %lld us, %.1f MB/s\n",
+           (unsigned long long)result.completed, (unsigned long long)result.failed,
+           (unsigned long long)result.callbacks, (unsigned long long)stats.frames, retries, stats.latency_p50_us,
+           stats.latency_p99_us, elapsed > 0 ? stats.bytes * 1e3 / elapsed : 0.0);
+    // Сессию с подключённой очередью закрыть нельзя
+    int busy = irda_session_close(session);
+    irda_txq_stop(queue);
+    irda_session_close(session);
+    telemetry_close(telemetry);
+
+    unsigned long long expected = 3ULL * calls * size;
+    for (int i = 0; i < 100 && drained < expected; i++) {
+        usleep(10000);
+    }
+    stop = true;
+    drain.join();
+    printf("Drained: %llu bytes (expected %llu)\n", (unsigned long long)drained, expected);
+    if (!use_pty) {
+        unlink(path.c_str());
+        rmdir(dir);
+    }
+    if (busy != -EBUSY) {
+        printf("FAIL: close with a queue attached returned %d, expected %d\n", busy, -EBUSY);
+    }
+    return drained == expected && result.failed == 0 && busy == -EBUSY ? 0 : 1;
+}
@@ -0,0 +1,843 @@
+// Проверка и замеры LDPC.h на встроенной таблице BG2 (или на таблице из
+// файла спецификации, -t):
+//  - строение таблицы по тексту 5.3.2: размеры, число элементов, ядро и
+//    строки расширения, диапазоны сдвигов; -V сверяет значения сдвигов
+//    с файлом таблицы спецификации;
+//  - кодер на всех Zc: кодовое слово удовлетворяет всем строкам графа,
+//    без шума декодер возвращает исходные биты (rv 0 и 3, QPSK и 64QAM);
+//  - ядра проверочных узлов: скалярное против AVX2 и NEON побайтно на
+//    случайных, насыщенных и равных по модулю входах, вместе с результатом;
+//  - BER и BLER по Eb/N0 в канале AWGN против эталонного декодера
+//    sum-product с плавающей точкой (заливка, без квантования), и на тех
+//    же кадрах - совпадение выхода и числа итераций у всех ядер;
+//  - скорость декодера на одном ядре процессора в Mbit/s информационных
+//    бит: с ранним остановом на верхней точке Eb/N0 и на шуме, где
+//    декодер делает все итерации.
+//
+// Ядро NEON на x86 собирается на переносимых заменах интринсиков (ниже,
+// по их описанию в Arm ARM), так что сверяется логика ядра, но не код
+// компилятора для ARM. Скорость считается только у ядер этой сборки;
+// скалярное ядро как основное - сборка с -DLDPC_SCALAR.
+//
+// Пример: ldpcbench                        (BG2, K' 3840, R 1/2)
+//         ldpcbench -k 1000 -r 0.2 -n 500   (короткий блок, низкая скорость)
+//         ldpcbench -b 1 -t bg1.txt -k 8448 -r 0.33
+//         ldpcbench -V bg2.txt              (сверка таблицы со встроенной)
+//         ldpcbench -R -n 1000              (без эталона, только int8)
+//
+// На каждую точку выводится строка "Eb/N0 N dB: BER N BLER N it N |
+// reference BER N BLER N". При ошибке в строении таблицы, ошибке кодера,
+// расхождении ядер или несовпадении таблицы с -V код выхода 1.
+
+// Checks and benchmarks LDPC.h on the built-in BG2 table (or on a table
+// loaded from a spec file with -t):
+//  - table structure per the text of 5.3.2: dimensions, entry count, core
+//    and extension rows, shift ranges; -V diffs the shift values against
+//    a spec table file;
+//  - the encoder at every Zc: the codeword satisfies every graph row, and
+//    without noise the decoder returns the original bits (rv 0 and 3,
+//    QPSK and 64QAM);
+//  - check node kernels: scalar against AVX2 and NEON byte for byte on
+//    random, saturated and equal-magnitude inputs, return value included;
+//  - BER and BLER versus Eb/N0 over AWGN against a floating point
+//    flooding sum-product reference (no quantisation), and on the same
+//    frames every kernel must return the same bits and iteration count;
+//  - single-core decoder throughput in Mbit/s of information bits: with
+//    early termination at the top Eb/N0 point, and on noise, where the
+//    decoder runs every iteration.
+//
+// On x86 the NEON kernel is built against portable stand-ins for its
+// intrinsics (below, following their Arm ARM descriptions), so the kernel
+// logic is checked but not the code an ARM compiler generates. Throughput
+// is only measured for the kernels native to the build; build with
+// -DLDPC_SCALAR to make the scalar kernel the default one.
+//
+// Example: ldpcbench                        (BG2, K' 3840, R 1/2)
+//          ldpcbench -k 1000 -r 0.2 -n 500   (short block, low rate)
+//          ldpcbench -b 1 -t bg1.txt -k 8448 -r 0.33
+//          ldpcbench -V bg2.txt              (diff a table file against the built-in one)
+//          ldpcbench -R -n 1000              (no reference, int8 only)
+//
+// Each point prints "Eb/N0 N dB: BER N BLER N it N | reference BER N
+// BLER N". A table structure error, an encoder failure, a kernel mismatch or a -V difference makes
+// the exit status 1.
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LDPC_BUILD_NEON
+#else
+// Интринсики NEON, которыми пользуется ldpc_check_node_neon, поэлементно
+#define LDPC_BUILD_NEON
+#define LDPCBENCH_NEON_EMULATED
+
+typedef struct { int8_t v[16]; } int8x16_t;
+typedef struct { uint8_t v[16]; } uint8x16_t;
+typedef struct { uint64_t v[2]; } uint64x2_t;
+
+static inline int8_t neon_sat8(int x) {
+    return (int8_t)(x > 127 ? 127 : x < -128 ? -128 : x);
+}
+
+static inline int8x16_t vdupq_n_s8(int8_t x) {
+    int8x16_t r;
+    for (int i = 0; i < 16; i++) r.v[i] = x;
+    return r;
+}
+
+static inline uint8x16_t vdupq_n_u8(uint8_t x) {
+    uint8x16_t r;
+    for (int i = 0; i < 16; i++) r.v[i] = x;
+    return r;
+}
+
+static inline int8x16_t vld1q_s8(const int8_t* p) {
+    int8x16_t r;
+    for (int i = 0; i < 16; i++) r.v[i] = p[i];
+    return r;
+}
+
+static inline void vst1q_s8(int8_t* p, int8x16_t a) {
+    for (int i = 0; i < 16; i++) p[i] = a.v[i];
+}
+
+static inline int8x16_t vqsubq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = neon_sat8(a.v[i] - b.v[i]);
+    return a;
+}
+
+static inline int8x16_t vqaddq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = neon_sat8(a.v[i] + b.v[i]);
+    return a;
+}
+
+static inline int8x16_t vsubq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = (int8_t)(uint8_t)(a.v[i] - b.v[i]);
+    return a;
+}
+
+static inline int8x16_t vmaxq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+    return a;
+}
+
+static inline int8x16_t vminq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+    return a;
+}
+
+// Без насыщения: vabsq_s8(-128) и vnegq_s8(-128) дают -128
+static inline int8x16_t vabsq_s8(int8x16_t a) {
+    for (int i = 0; i < 16; i++) a.v[i] = (int8_t)(uint8_t)(a.v[i] < 0 ? -a.v[i] : a.v[i]);
+    return a;
+}
+
+static inline int8x16_t vnegq_s8(int8x16_t a) {
+    for (int i = 0; i < 16; i++) a.v[i] = (int8_t)(uint8_t)-a.v[i];
+    return a;
+}
+
+static inline int8x16_t veorq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] ^= b.v[i];
+    return a;
+}
+
+static inline int8x16_t vorrq_s8(int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] |= b.v[i];
+    return a;
+}
+
+static inline uint8x16_t vcgtq_s8(int8x16_t a, int8x16_t b) {
+    uint8x16_t r;
+    for (int i = 0; i < 16; i++) r.v[i] = a.v[i] > b.v[i] ? 0xff : 0;
+    return r;
+}
+
+static inline uint8x16_t vcltq_s8(int8x16_t a, int8x16_t b) {
+    uint8x16_t r;
+    for (int i = 0; i < 16; i++) r.v[i] = a.v[i] < b.v[i] ? 0xff : 0;
+    return r;
+}
+
+static inline uint8x16_t vceqq_u8(uint8x16_t a, uint8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = a.v[i] == b.v[i] ? 0xff : 0;
+    return a;
+}
+
+// Побитовый выбор: биты mask из a, остальные из b
+static inline uint8x16_t vbslq_u8(uint8x16_t mask, uint8x16_t a, uint8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = (uint8_t)((mask.v[i] & a.v[i]) | (~mask.v[i] & b.v[i]));
+    return a;
+}
+
+static inline int8x16_t vbslq_s8(uint8x16_t mask, int8x16_t a, int8x16_t b) {
+    for (int i = 0; i < 16; i++) a.v[i] = (int8_t)((mask.v[i] & (uint8_t)a.v[i]) | (~mask.v[i] & (uint8_t)b.v[i]));
+    return a;
+}
+
+static inline uint64x2_t vreinterpretq_u64_s8(int8x16_t a) {
+    uint64x2_t r;
+    memcpy(r.v, a.v, 16);
+    return r;
+}
+
+static inline uint64_t vgetq_lane_u64(uint64x2_t a, int lane) {
+    return a.v[lane];
+}
+#endif
+
+#include "LDPC.h"
+#include <math.h>
+#include <random>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LDPCBENCH_K_BG1 8448
+#define LDPCBENCH_K_BG2 3840
+#define LDPCBENCH_RATE 0.5
+#define LDPCBENCH_FRAMES 100          // кадров на точку Eb/N0
+#define LDPCBENCH_EBN0_TOP 3.0        // верхняя точка, dB; шаг 0.5 dB от 0
+#define LDPCBENCH_SCALE 4.0           // множитель LLR перед округлением, см. LDPC.h
+#define LDPCBENCH_REF_ITERATIONS 50
+#define LDPCBENCH_KERNEL_TRIALS 20000
+#define LDPCBENCH_BLOCKS 2000         // блоков на замер скорости
+
+static int failures;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-b bg] [-t table] [-k bits] [-r rate] [-n frames] [-e dB] [-i iterations] [-R] [-S seed]\n"
+            "       %s -V table\n"
+            "  -b  base graph, 1 or 2 (default 2)\n"
+            "  -t  load the base graph from a spec table file (required for BG1)\n"
+            "  -k  K', code block bits with CRC (default %d for BG1, %d for BG2)\n"
+            "  -r  code rate (default %.2f)\n"
+            "  -n  frames per Eb/N0 point (default %d)\n"
+            "  -e  top Eb/N0 point in dB, swept from 0 in 0.5 dB steps (default %.1f)\n"
+            "  -i  decoder iterations (default %d)\n"
+            "  -R  skip the floating point reference decoder\n"
+            "  -S  random seed\n"
+            "  -V  compare a BG2 table file against the built-in table and exit\n",
+            prog, prog, LDPCBENCH_K_BG1, LDPCBENCH_K_BG2, LDPCBENCH_RATE, LDPCBENCH_FRAMES, LDPCBENCH_EBN0_TOP,
+            LDPC_DEFAULT_ITERATIONS);
+}
+
+struct kernel {
+    const char* name;
+    ldpc_check_node_t check_node;
+    bool native;    // ядро этой сборки (не замена интринсиков): у него меряется скорость
+};
+
+static std::vector<kernel> kernels(void) {
+    std::vector<kernel> list;
+    list.push_back({"scalar", ldpc_check_node_scalar, true});
+#if defined(LDPC_KERNEL_AVX2)
+    list.push_back({"avx2", ldpc_check_node_avx2, true});
+#endif
+#if defined(LDPCBENCH_NEON_EMULATED)
+    list.push_back({"neon (emulated)", ldpc_check_node_neon, false});
+#else
+    list.push_back({"neon", ldpc_check_node_neon, true});
+#endif
+    return list;
+}
+
+static const char* default_kernel_name(void) {
+#if defined(LDPC_KERNEL_AVX2)
+    return "avx2";
+#elif defined(LDPC_KERNEL_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// --- Таблица ---
+
+// Плотная матрица сдвигов: -1 - нулевой элемент
+static void dense_table(const struct ldpc_base_graph* graph, std::vector<int>& shifts) {
+    shifts.assign((size_t)LDPC_MAX_ROWS * LDPC_MAX_COLS * LDPC_ILS_COUNT, -1);
+    for (int r = 0; r < graph->rows; r++) {
+        for (int e = graph->row_start[r]; e < graph->row_start[r + 1]; e++) {
+            for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+                shifts[((size_t)r * LDPC_MAX_COLS + graph->col[e]) * LDPC_ILS_COUNT + ils] = graph->shift[e][ils];
+            }
+        }
+    }
+}
+
+static int verify_table(const char* path) {
+    ldpc_base_graph_builtin();
+    std::vector<int> builtin;
+    std::vector<int> loaded;
+    dense_table(&ldpc_base_graphs[LDPC_BG2 - 1], builtin);
+    if (ldpc_load_base_graph(LDPC_BG2, path) < 0) {
+        fprintf(stderr, "%s: not a valid BG2 table\n", path);
+        return 1;
+    }
+    dense_table(&ldpc_base_graphs[LDPC_BG2 - 1], loaded);
+
+    int differences = 0;
+    for (int r = 0; r < LDPC_MAX_ROWS; r++) {
+        for (int c = 0; c < LDPC_MAX_COLS; c++) {
+            const int* a = &builtin[((size_t)r * LDPC_MAX_COLS + c) * LDPC_ILS_COUNT];
+            const int* b = &loaded[((size_t)r * LDPC_MAX_COLS + c) * LDPC_ILS_COUNT];
+            if (memcmp(a, b, LDPC_ILS_COUNT * sizeof(int)) == 0) {
+                continue;
+            }
+            differences++;
+            printf("i %d j %d: built-in", r, c);
+            for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+                printf(" %d", a[ils]);
+            }
+            printf(", file");
+            for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+                printf(" %d", b[ils]);
+            }
+            printf("\n");
+        }
+    }
+    printf("table: %d entries, %d differ from the built-in BG2\n", ldpc_base_graphs[LDPC_BG2 - 1].edge_count,
+           differences);
+    return differences ? 1 : 0;
+}
+
+// Строение графа по тексту 5.3.2, независимо от значений сдвигов:
+// размеры и число ненулевых элементов (316 у BG1, 197 у BG2), столбцы
+// ядра kb + 1..kb + 3 - лестница из нулевых сдвигов в строках 0-1, 1-2 и
+// 2-3, у столбца kb три элемента в строках ядра, у строки расширения i
+// единственный проверочный столбец kb + i с нулевым сдвигом, каждый сдвиг
+// меньше наибольшего Zc своего набора. Циклы длины 4 при наибольшем Zc
+// каждого набора выводятся для сравнения с таблицей спецификации.
+static void structure_check(int bg) {
+    const struct ldpc_base_graph* graph = &ldpc_base_graphs[bg - 1];
+    int kb = graph->kb;
+    int errors = 0;
+    std::vector<int> dense;
+    dense_table(graph, dense);
+    auto at = [&](int r, int c, int ils) { return dense[((size_t)r * LDPC_MAX_COLS + c) * LDPC_ILS_COUNT + ils]; };
+
+    if (graph->rows != (bg == LDPC_BG1 ? 46 : 42) || graph->cols != (bg == LDPC_BG1 ? 68 : 52) ||
+        graph->edge_count != (bg == LDPC_BG1 ? 316 : 197)) {
+        printf("FAIL: BG%d is %dx%d with %d entries\n", bg, graph->rows, graph->cols, graph->edge_count);
+        errors++;
+    }
+    int core_weight = 0;
+    for (int r = 0; r < LDPC_CORE_ROWS; r++) {
+        core_weight += at(r, kb, 0) >= 0;
+        for (int c = 1; c < LDPC_CORE_ROWS; c++) {
+            bool expected = r == c - 1 || r == c;
+            for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+                if (at(r, kb + c, ils) != (expected ? 0 : -1)) {
+                    printf("FAIL: BG%d core entry i %d j %d iLS %d is %d\n", bg, r, kb + c, ils, at(r, kb + c, ils));
+                    errors++;
+                }
+            }
+        }
+    }
+    if (core_weight != 3) {
+        printf("FAIL: BG%d column %d has %d core entries\n", bg, kb, core_weight);
+        errors++;
+    }
+    for (int r = LDPC_CORE_ROWS; r < graph->rows; r++) {
+        for (int c = kb + LDPC_CORE_ROWS; c < graph->cols; c++) {
+            for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+                if (at(r, c, ils) != (c == kb + r ? 0 : -1)) {
+                    printf("FAIL: BG%d extension entry i %d j %d iLS %d is %d\n", bg, r, c, ils, at(r, c, ils));
+                    errors++;
+                }
+            }
+        }
+    }
+
+    int z_max[LDPC_ILS_COUNT];
+    for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+        for (int k = 0; k < 8 && ldpc_lifting_sets[ils][k]; k++) {
+            z_max[ils] = ldpc_lifting_sets[ils][k];
+        }
+        for (int e = 0; e < graph->edge_count; e++) {
+            if (graph->shift[e][ils] >= z_max[ils]) {
+                printf("FAIL: BG%d entry %d shift %d for iLS %d is not below %d\n", bg, e, graph->shift[e][ils], ils,
+                       z_max[ils]);
+                errors++;
+            }
+        }
+    }
+
+    printf("table BG%d: %d entries, 4-cycles at the largest Zc of each set:", bg, graph->edge_count);
+    for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+        int z = z_max[ils];
+        int cycles = 0;
+        for (int a = 0; a < graph->rows; a++) {
+            for (int b = a + 1; b < graph->rows; b++) {
+                for (int c1 = 0; c1 < graph->cols; c1++) {
+                    if (at(a, c1, ils) < 0 || at(b, c1, ils) < 0) {
+                        continue;
+                    }
+                    for (int c2 = c1 + 1; c2 < graph->cols; c2++) {
+                        if (at(a, c2, ils) >= 0 && at(b, c2, ils) >= 0 &&
+                            (at(a, c1, ils) - at(a, c2, ils) + at(b, c2, ils) - at(b, c1, ils)) % z == 0) {
+                            cycles++;
+                        }
+                    }
+                }
+            }
+        }
+        printf(" %d", cycles);
+    }
+    printf("\n");
+    failures += errors;
+}
+
+// --- Кодер ---
+
+static bool syndrome_ok(const ldpc_code_t* code, const uint8_t* codeword) {
+    const struct ldpc_base_graph* graph = code->graph;
+    int z = code->z;
+    std::vector<uint8_t> sum(z);
+    for (int r = 0; r < graph->rows; r++) {
+        memset(sum.data(), 0, z);
+        for (int e = graph->row_start[r]; e < graph->row_start[r + 1]; e++) {
+            ldpc_rotate_xor(sum.data(), codeword + graph->col[e] * z, z, code->shift[e]);
+        }
+        for (int i = 0; i < z; i++) {
+            if (sum[i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Все Zc: K' = kb * Zc, кодовое слово против H и декодирование без шума
+// для самодекодируемых версий rv 0 и 3
+static void encoder_check(int bg, double rate, std::mt19937& rng) {
+    ldpc_decoder_t* decoder = ldpc_decoder_create();
+    int sizes = 0;
+    int errors = 0;
+    for (int ils = 0; ils < LDPC_ILS_COUNT; ils++) {
+        for (int k = 0; k < 8 && ldpc_lifting_sets[ils][k]; k++) {
+            int z = ldpc_lifting_sets[ils][k];
+            int kb = bg == LDPC_BG1 ? 22 : 10;
+            ldpc_code_t code;
+            if (ldpc_code_init(&code, bg, kb * z, 1 << 20) < 0 || code.z != z) {
+                printf("encoder: Zc %d: code init failed\n", z);
+                errors++;
+                continue;
+            }
+            sizes++;
+            std::vector<uint8_t> info(code.k_prime);
+            std::vector<uint8_t> codeword(code.n);
+            for (auto& bit : info) {
+                bit = rng() & 1;
+            }
+            ldpc_encode(&code, info.data(), codeword.data());
+            if (!syndrome_ok(&code, codeword.data())) {
+                printf("encoder: Zc %d: codeword fails the parity checks\n", z);
+                errors++;
+                continue;
+            }
+            static const int qms[] = {2, 6};
+            static const int rvs[] = {0, 3};
+            for (int qm : qms) {
+                for (int rv : rvs) {
+                    int e = (int)(code.k_prime / rate / qm) * qm;
+                    std::vector<uint8_t> tx(e);
+                    std::vector<int8_t> rx(e);
+                    std::vector<int8_t> llr(code.n);
+                    std::vector<uint8_t> out(code.k_prime);
+                    ldpc_rate_match(&code, codeword.data(), rv, e, qm, tx.data());
+                    for (int i = 0; i < e; i++) {
+                        rx[i] = tx[i] ? -32 : 32;
+                    }
+                    int cols = ldpc_rate_recover(&code, rx.data(), rv, e, qm, llr.data());
+                    int ret = ldpc_decode(decoder, &code, llr.data(), out.data(), cols);
+                    if (ret < 0 || out != info) {
+                        printf("encoder: Zc %d rv %d Qm %d: noiseless decode %s\n", z, rv, qm,
+                               ret < 0 ? "did not converge" : "returned wrong bits");
+                        errors++;
+                    }
+                }
+            }
+        }
+    }
+    ldpc_decoder_destroy(decoder);
+    printf("encoder: %d lifting sizes, %d errors\n", sizes, errors);
+    failures += errors;
+}
+
+// --- Ядра ---
+
+// Вход ядра в пределах, которые держит декодер: |tmp| <= LDPC_LLR_MAX,
+// |msg| <= LDPC_MSG_MAX. Режимы: равномерно, малые модули (много равных
+// минимумов), края диапазона (насыщение)
+static void kernel_input(int8_t* tmp, int8_t* msg, size_t size, int mode, std::mt19937& rng) {
+    for (size_t i = 0; i < size; i++) {
+        int t;
+        int m;
+        switch (mode) {
+        case 0:
+            t = (int)(rng() % (2 * LDPC_LLR_MAX + 1)) - LDPC_LLR_MAX;
+            m = (int)(rng() % (2 * LDPC_MSG_MAX + 1)) - LDPC_MSG_MAX;
+            break;
+        case 1:
+            t = (int)(rng() % 7) - 3;
+            m = (int)(rng() % 5) - 2;
+            break;
+        default:
+            t = (rng() & 1) ? LDPC_LLR_MAX - (int)(rng() % 3) : -LDPC_LLR_MAX + (int)(rng() % 3);
+            m = (rng() & 1) ? LDPC_MSG_MAX - (int)(rng() % 3) : -LDPC_MSG_MAX + (int)(rng() % 3);
+            break;
+        }
+        tmp[i] = (int8_t)t;
+        msg[i] = (int8_t)m;
+    }
+}
+
+static void kernel_check(std::mt19937& rng) {
+    std::vector<kernel> list = kernels();
+    size_t size = (size_t)LDPC_MAX_DEGREE * LDPC_ZMAX;
+    int8_t* tmp = (int8_t*)aligned_alloc(64, size);
+    int8_t* msg = (int8_t*)aligned_alloc(64, size);
+    int8_t* ref_tmp = (int8_t*)aligned_alloc(64, size);
+    int8_t* ref_msg = (int8_t*)aligned_alloc(64, size);
+    int8_t* in_tmp = (int8_t*)aligned_alloc(64, size);
+    int8_t* in_msg = (int8_t*)aligned_alloc(64, size);
+    std::vector<int> mismatches(list.size(), 0);
+
+    for (int trial = 0; trial < LDPCBENCH_KERNEL_TRIALS; trial++) {
+        int deg = 2 + (int)(rng() % (LDPC_MAX_DEGREE - 1));
+        int stride = LDPC_ALIGN * (1 + (int)(rng() % (LDPC_ZMAX / LDPC_ALIGN)));
+        int offset = (int)(rng() % 4);
+        kernel_input(in_tmp, in_msg, (size_t)deg * stride, trial % 3, rng);
+        memcpy(ref_tmp, in_tmp, (size_t)deg * stride);
+        memcpy(ref_msg, in_msg, (size_t)deg * stride);
+        int ref = ldpc_check_node_scalar(ref_tmp, ref_msg, deg, stride, stride, offset) != 0;
+        for (size_t k = 1; k < list.size(); k++) {
+            memcpy(tmp, in_tmp, (size_t)deg * stride);
+            memcpy(msg, in_msg, (size_t)deg * stride);
+            int ret = list[k].check_node(tmp, msg, deg, stride, stride, offset) != 0;
+            if (ret != ref || memcmp(tmp, ref_tmp, (size_t)deg * stride) != 0 ||
+                memcmp(msg, ref_msg, (size_t)deg * stride) != 0) {
+                if (mismatches[k]++ == 0) {
+                    printf("kernel %s: trial %d deg %d lanes %d offset %d differs from scalar\n", list[k].name, trial,
+                           deg, stride, offset);
+                }
+            }
+        }
+    }
+    for (size_t k = 1; k < list.size(); k++) {
+        printf("kernel scalar vs %s: %d layers, %d mismatches\n", list[k].name, LDPCBENCH_KERNEL_TRIALS,
+               mismatches[k]);
+        failures += mismatches[k];
+    }
+    free(tmp);
+    free(msg);
+    free(ref_tmp);
+    free(ref_msg);
+    free(in_tmp);
+    free(in_msg);
+}
+
+// --- Эталон ---
+
+// Sum-product с заливкой: на итерации все проверки считают сообщения по
+// апостериорным LLR прошлой итерации; останов по синдрому жёстких решений.
+// llr - n значений без масштаба, заполнители - большие положительные.
+static void reference_decode(const ldpc_code_t* code, const std::vector<double>& llr, int cols, int iterations,
+                             std::vector<uint8_t>& out) {
+    const struct ldpc_base_graph* graph = code->graph;
+    int z = code->z;
+    int rows = graph->rows;
+    if (cols > 0 && cols - graph->kb < rows) {
+        rows = cols - graph->kb < LDPC_CORE_ROWS ? LDPC_CORE_ROWS : cols - graph->kb;
+    }
+    int edges = graph->row_start[rows];
+    std::vector<double> msg((size_t)edges * z, 0.0);
+    std::vector<double> app(llr.begin(), llr.begin() + (size_t)(graph->kb + rows) * z);
+    std::vector<double> th(LDPC_MAX_DEGREE);
+    std::vector<double> before(LDPC_MAX_DEGREE + 1);
+    std::vector<uint8_t> hard(app.size());
+
+    for (int it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < app.size(); i++) {
+            hard[i] = app[i] < 0;
+        }
+        bool satisfied = true;
+        for (int r = 0; r < rows && satisfied; r++) {
+            for (int i = 0; i < z && satisfied; i++) {
+                uint8_t parity = 0;
+                for (int e = graph->row_start[r]; e < graph->row_start[r + 1]; e++) {
+                    parity ^= hard[graph->col[e] * z + (i + code->shift[e]) % z];
+                }
+                satisfied = parity == 0;
+            }
+        }
+        if (satisfied) {
+            break;
+        }
+
+        std::vector<double> next(app.size());
+        std::copy(llr.begin(), llr.begin() + app.size(), next.begin());
+        for (int r = 0; r < rows; r++) {
+            int first = graph->row_start[r];
+            int deg = graph->row_start[r + 1] - first;
+            for (int i = 0; i < z; i++) {
+                for (int e = 0; e < deg; e++) {
+                    size_t v = (size_t)graph->col[first + e] * z + (i + code->shift[first + e]) % z;
+                    double t = app[v] - msg[(size_t)(first + e) * z + i];
+                    th[e] = tanh(fmax(-30.0, fmin(30.0, t)) / 2);
+                }
+                before[0] = 1.0;
+                for (int e = 0; e < deg; e++) {
+                    before[e + 1] = before[e] * th[e];
+                }
+                double after = 1.0;
+                for (int e = deg - 1; e >= 0; e--) {
+                    double p = fmax(-0.999999999999, fmin(0.999999999999, before[e] * after));
+                    after *= th[e];
+                    double m = 2 * atanh(p);
+                    msg[(size_t)(first + e) * z + i] = m;
+                    next[(size_t)graph->col[first + e] * z + (i + code->shift[first + e]) % z] += m;
+                }
+            }
+        }
+        app.swap(next);
+    }
+
+    out.resize(code->k_prime);
+    for (int i = 0; i < code->k_prime; i++) {
+        out[i] = app[i] < 0;
+    }
+}
+
+// --- BER ---
+
+struct point_stats {
+    long long bit_errors;
+    int block_errors;
+    long long iterations;
+};
+
+int main(int argc, char** argv) {
+    int bg = LDPC_BG2;
+    const char* table_path = NULL;
+    const char* verify_path = NULL;
+    int k_prime = 0;
+    double rate = LDPCBENCH_RATE;
+    int frames = LDPCBENCH_FRAMES;
+    double top = LDPCBENCH_EBN0_TOP;
+    int iterations = LDPC_DEFAULT_ITERATIONS;
+    bool reference = true;
+    unsigned int seed = (unsigned int)time(NULL);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:t:k:r:n:e:i:RS:V:h")) != -1) {
+        switch (opt) {
+        case 'b':
+            bg = atoi(optarg);
+            break;
+        case 't':
+            table_path = optarg;
+            break;
+        case 'k':
+            k_prime = atoi(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'e':
+            top = atof(optarg);
+            break;
+        case 'i':
+            iterations = atoi(optarg);
+            break;
+        case 'R':
+            reference = false;
+            break;
+        case 'S':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'V':
+            verify_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (verify_path) {
+        return verify_table(verify_path);
+    }
+    if ((bg != LDPC_BG1 && bg != LDPC_BG2) || rate <= 0 || rate >= 1 || frames <= 0 || iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (table_path && ldpc_load_base_graph(bg, table_path) < 0) {
+        fprintf(stderr, "%s: not a valid BG%d table\n", table_path, bg);
+        return 1;
+    }
+    if (bg == LDPC_BG1 && !table_path) {
+        fprintf(stderr, "BG1 is not built in: give the Table 5.3.2-2 file with -t\n");
+        return 1;
+    }
+    if (k_prime == 0) {
+        k_prime = bg == LDPC_BG1 ? LDPCBENCH_K_BG1 : LDPCBENCH_K_BG2;
+    }
+    printf("seed %u, default kernel %s\n", seed, default_kernel_name());
+    std::mt19937 rng(seed);
+
+    ldpc_base_graph_builtin();
+    structure_check(bg);
+
+    encoder_check(bg, rate, rng);
+    kernel_check(rng);
+
+    ldpc_code_t code;
+    if (ldpc_code_init(&code, bg, k_prime, k_prime) < 0) {
+        fprintf(stderr, "no code block for BG%d with K' %d\n", bg, k_prime);
+        return 1;
+    }
+    const int qm = 2;
+    int e = (int)(k_prime / rate / qm) * qm;
+    printf("BG%d K' %d Zc %d E %d (R %.3f), QPSK, %d iterations, %d frames per point\n", bg, k_prime, code.z, e,
+           (double)k_prime / e, iterations, frames);
+
+    // Все ядра декодируют одни и те же кадры; первым идёт ядро сборки
+    std::vector<kernel> list = kernels();
+    std::vector<ldpc_decoder_t*> decoders;
+    for (size_t k = 0; k < list.size(); k++) {
+        ldpc_decoder_t* decoder = ldpc_decoder_create();
+        if (!decoder) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        decoder->max_iterations = iterations;
+        decoder->check_node = list[k].check_node;
+        decoders.push_back(decoder);
+    }
+    ldpc_decoder_t* main_decoder = ldpc_decoder_create();
+    main_decoder->max_iterations = iterations;
+
+    std::normal_distribution<double> noise;
+    std::vector<uint8_t> info(k_prime);
+    std::vector<uint8_t> codeword(code.n);
+    std::vector<uint8_t> tx(e);
+    std::vector<double> y(e);
+    std::vector<int8_t> rx(e);
+    std::vector<int8_t> llr(code.n);
+    std::vector<uint8_t> out(k_prime);
+    std::vector<uint8_t> other(k_prime);
+    std::vector<uint8_t> ref_out;
+    std::vector<double> ref_llr(code.n);
+    long long decode_mismatches = 0;
+    long long decoded = 0;
+
+    for (double ebn0 = 0.0; ebn0 <= top + 1e-9; ebn0 += 0.5) {
+        double sigma = sqrt(1.0 / (2 * rate * pow(10, ebn0 / 10)));
+        point_stats stats = {0, 0, 0};
+        point_stats ref_stats = {0, 0, 0};
+        for (int f = 0; f < frames; f++) {
+            for (auto& bit : info) {
+                bit = rng() & 1;
+            }
+            ldpc_encode(&code, info.data(), codeword.data(), ldpc_columns_needed(&code, 0, e));
+            ldpc_rate_match(&code, codeword.data(), 0, e, qm, tx.data());
+            for (int i = 0; i < e; i++) {
+                y[i] = (tx[i] ? -1.0 : 1.0) + sigma * noise(rng);
+                double l = 2 * y[i] / (sigma * sigma) * LDPCBENCH_SCALE;
+                rx[i] = (int8_t)fmax(-LDPC_LLR_MAX, fmin(LDPC_LLR_MAX, round(l)));
+            }
+            int cols = ldpc_rate_recover(&code, rx.data(), 0, e, qm, llr.data());
+
+            int ret = ldpc_decode(main_decoder, &code, llr.data(), out.data(), cols);
+            int errors = 0;
+            for (int i = 0; i < k_prime; i++) {
+                errors += out[i] != info[i];
+            }
+            stats.bit_errors += errors;
+            stats.block_errors += errors > 0;
+            stats.iterations += ret < 0 ? iterations : ret;
+
+            for (size_t k = 0; k < list.size(); k++) {
+                int other_ret = ldpc_decode(decoders[k], &code, llr.data(), other.data(), cols);
+                if (other_ret != ret || other != out) {
+                    if (decode_mismatches++ == 0) {
+                        printf("decode: kernel %s differs from %s at Eb/N0 %.1f dB frame %d (%d vs %d iterations)\n",
+                               list[k].name, default_kernel_name(), ebn0, f, other_ret, ret);
+                    }
+                }
+            }
+            decoded++;
+
+            if (reference) {
+                std::fill(ref_llr.begin(), ref_llr.end(), 0.0);
+                for (int i = k_prime; i < code.k; i++) {
+                    ref_llr[i] = 1e3;
+                }
+                ldpc_rate_walk(&code, 0, e, qm, [&](int pos, int idx) { ref_llr[pos] += 2 * y[idx] / (sigma * sigma); });
+                reference_decode(&code, ref_llr, cols, LDPCBENCH_REF_ITERATIONS, ref_out);
+                int ref_errors = 0;
+                for (int i = 0; i < k_prime; i++) {
+                    ref_errors += ref_out[i] != info[i];
+                }
+                ref_stats.bit_errors += ref_errors;
+                ref_stats.block_errors += ref_errors > 0;
+            }
+        }
+        printf("Eb/N0 %.1f dB: BER %.2e BLER %.3f it %.2f", ebn0, (double)stats.bit_errors / k_prime / frames,
+               (double)stats.block_errors / frames, (double)stats.iterations / frames);
+        if (reference) {
+            printf(" | reference BER %.2e BLER %.3f", (double)ref_stats.bit_errors / k_prime / frames,
+                   (double)ref_stats.block_errors / frames);
+        }
+        printf("\n");
+    }
+    printf("decode: %zu kernels x %lld frames, %lld mismatches\n", list.size(), decoded, decode_mismatches);
+    failures += decode_mismatches > 0;
+
+    // Скорость: один поток, блок с верхней точки Eb/N0 (ранний останов) и
+    // шум без кодового слова (все итерации)
+    std::vector<int8_t> noise_llr(code.n);
+    for (auto& v : noise_llr) {
+        v = (int8_t)((int)(rng() % 33) - 16);
+    }
+    int cols = ldpc_rate_recover(&code, rx.data(), 0, e, qm, llr.data());
+    for (size_t k = 0; k < list.size(); k++) {
+        if (!list[k].native) {
+            continue;
+        }
+        for (int on_noise = 0; on_noise < 2; on_noise++) {
+            const int8_t* input = on_noise ? noise_llr.data() : llr.data();
+            long long total_iterations = 0;
+            long long start = now_ns();
+            for (int b = 0; b < LDPCBENCH_BLOCKS; b++) {
+                int ret = ldpc_decode(decoders[k], &code, input, out.data(), cols);
+                total_iterations += ret < 0 ? iterations : ret;
+            }
+            double seconds = (now_ns() - start) / 1e9;
+            printf("throughput %s, %s: %.1f Mbit/s per core, %.2f iterations, %.1f us per block\n", list[k].name,
+                   on_noise ? "noise" : "top Eb/N0", (double)k_prime * LDPCBENCH_BLOCKS / seconds / 1e6,
+                   (double)total_iterations / LDPCBENCH_BLOCKS, seconds / LDPCBENCH_BLOCKS * 1e6);
+        }
+    }
+
+    for (ldpc_decoder_t* decoder : decoders) {
+        ldpc_decoder_destroy(decoder);
+    }
+    ldpc_decoder_destroy(main_decoder);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef _MEC_PROBE_H_
+#define _MEC_PROBE_H_
+
+// Заголовок проверочных датаграмм канала на сервер MEC: номер и время
+// отправки (CLOCK_MONOTONIC, в ядре ktime_get_ns). Его ставит fiveg.c
+// (атрибут mec_probe) и генератор mec_sink, а mec_sink по нему считает
+// задержку и потери. Общий для модуля ядра и пространства пользователя.
+//
+// Формат, little-endian: u32 MEC_PROBE_MAGIC, u32 номер, u64 время, нс
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#endif
+
+#define MEC_PROBE_MAGIC 0x3547434Du   // "MCG5"
+#define MEC_PROBE_HEADER 16
+
+static inline void mec_probe_put(uint8_t *p, uint64_t value, int bytes) {
+    int i;
+
+    for (i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t mec_probe_get(const uint8_t *p, int bytes) {
+    uint64_t value = 0;
+    int i;
+
+    for (i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+static inline void mec_probe_encode(uint8_t *buf, uint32_t seq, uint64_t sent_ns) {
+    mec_probe_put(buf, MEC_PROBE_MAGIC, 4);
+    mec_probe_put(buf + 4, seq, 4);
+    mec_probe_put(buf + 8, sent_ns, 8);
+}
+
+// 0 - проверочная датаграмма, -1 - чужая или короткая
+static inline int mec_probe_decode(const uint8_t *buf, size_t len, uint32_t *seq, uint64_t *sent_ns) {
+    if (len < MEC_PROBE_HEADER || mec_probe_get(buf, 4) != MEC_PROBE_MAGIC) {
+        return -1;
+    }
+    *seq = (uint32_t)mec_probe_get(buf + 4, 4);
+    *sent_ns = mec_probe_get(buf + 8, 8);
+    return 0;
+}
+
+#endif
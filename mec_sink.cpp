@@ -0,0 +1,391 @@
+// Приёмник канала на сервер MEC на loopback: считает датаграммы в
+// секунду, потери и задержку проверочных датаграмм (mec_probe.h), которые
+// отправляет fiveg.c через атрибут mec_probe. Встроенный генератор
+// повторяет отправку пачками в пространстве пользователя, чтобы сравнить
+// UDP_SEGMENT, sendmmsg и sendto по одной без модуля.
+//
+// Пример: insmod fiveg.ko mec_address=127.0.0.1
+//         mec_sink -d 10 &
+//         echo "1000000 1200" > /sys/devices/platform/fiveg_driver/mec_probe
+//
+//         mec_sink -g 2000000 -m gso -B 32      (генератор и приёмник вместе)
+//
+// Раз в интервал выводится строка "<с>: datagrams N/s ... p50 N us
+// p99 N us", в конце - "Total: ...".
+
+// MEC uplink sink on loopback: counts datagrams per second, loss and
+// latency of the probe datagrams (mec_probe.h) that fiveg.c sends through
+// its mec_probe attribute. A built-in generator reproduces batched
+// sending in userspace to compare UDP_SEGMENT, sendmmsg and one sendto
+// per datagram without the module.
+//
+// Example: insmod fiveg.ko mec_address=127.0.0.1
+//          mec_sink -d 10 &
+//          echo "1000000 1200" > /sys/devices/platform/fiveg_driver/mec_probe
+//
+//          mec_sink -g 2000000 -m gso -B 32      (generator and sink together)
+//
+// Every interval prints "<s>: datagrams N/s ... p50 N us p99 N us", and
+// "Total: ..." at the end.
+
+#include "5g_data.h"
+#include "mec_probe.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define MEC_SINK_PORT 8944
+#define MEC_SINK_BATCH 64                  // датаграмм за один recvmmsg
+#define MEC_SINK_BUFFER 65536
+#define MEC_SINK_RCVBUF (16 * 1024 * 1024)
+#define MEC_SINK_PAYLOAD 65507
+
+enum gen_mode { GEN_SINGLE, GEN_MMSG, GEN_GSO };
+
+struct generator {
+    struct sockaddr_in target;
+    unsigned long long count;
+    unsigned int size;
+    unsigned int batch;
+    unsigned long long rate;               // датаграмм в секунду, 0 - без ограничения
+    enum gen_mode mode;
+    std::atomic<bool> done;
+    unsigned long long sent;
+    unsigned long long calls;
+    long long elapsed_us;
+};
+
+struct sink_stats {
+    unsigned long long datagrams;
+    unsigned long long bytes;
+    unsigned long long probes;
+    unsigned long long lost;
+    unsigned int next_seq;
+    fiveg_latency_hist_t latency;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-a addr] [-p port] [-d seconds] [-i seconds] [-g count [-s size] [-r rate] [-B batch] "
+            "[-m gso|mmsg|single]]\n"
+            "  -a  address to listen on (default 127.0.0.1)\n"
+            "  -p  UDP port (default %d)\n"
+            "  -d  stop after this many seconds (default: Ctrl-C, or when the generator is done)\n"
+            "  -i  report interval in seconds (default 1)\n"
+            "  -g  also send this many probe datagrams to the sink\n"
+            "  -s  datagram size for -g (default 1200)\n"
+            "  -r  datagrams per second for -g (default: unlimited)\n"
+            "  -B  datagrams per send for -g (default 32)\n"
+            "  -m  send mode for -g: gso (UDP_SEGMENT), mmsg (sendmmsg) or single (default gso)\n",
+            prog, MEC_SINK_PORT);
+}
+
+static void sink_account(struct sink_stats* stats, const unsigned char* data, size_t len, long long now_us) {
+    uint32_t seq;
+    uint64_t sent_ns;
+
+    stats->datagrams++;
+    stats->bytes += len;
+    if (mec_probe_decode(data, len, &seq, &sent_ns) < 0) {
+        return;
+    }
+    // Номер 0 - новый поток (повторный запуск генератора или mec_probe
+    // после перезагрузки модуля)
+    if (seq == 0 || seq < stats->next_seq) {
+        stats->next_seq = seq;
+    }
+    stats->lost += seq - stats->next_seq;
+    stats->next_seq = seq + 1;
+    stats->probes++;
+    fiveg_latency_add(&stats->latency, now_us - (long long)(sent_ns / 1000));
+}
+
+static unsigned long long probe_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Отправка пачками тем же способом, что и канал MEC в fiveg.c: batch
+// датаграмм одного размера - один sendmsg с UDP_SEGMENT
+static void run_generator(struct generator* gen) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&gen->target, sizeof(gen->target)) < 0) {
+        perror("generator socket");
+        gen->done = true;
+        return;
+    }
+    std::vector<unsigned char> buf((size_t)gen->size * gen->batch);
+    std::vector<struct mmsghdr> msgs(gen->batch);
+    std::vector<struct iovec> iovs(gen->batch);
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    long long start = fiveg_data_now_us();
+    unsigned int seq = 0;
+
+    while (gen->sent < gen->count && !g_stop) {
+        unsigned int n = gen->count - gen->sent < gen->batch ? (unsigned int)(gen->count - gen->sent) : gen->batch;
+        for (unsigned int i = 0; i < n; i++) {
+            mec_probe_encode(&buf[(size_t)i * gen->size], seq + i, probe_now_ns());
+        }
+
+        int ret;
+        if (gen->mode == GEN_GSO) {
+            struct iovec iov = {buf.data(), (size_t)n * gen->size};
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            if (n > 1) {
+                memset(control, 0, sizeof(control));
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                *(uint16_t*)CMSG_DATA(cmsg) = (uint16_t)gen->size;
+            }
+            ret = sendmsg(fd, &msg, 0) < 0 ? -1 : (int)n;
+            gen->calls++;
+        } else if (gen->mode == GEN_MMSG) {
+            for (unsigned int i = 0; i < n; i++) {
+                iovs[i].iov_base = &buf[(size_t)i * gen->size];
+                iovs[i].iov_len = gen->size;
+                memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            ret = sendmmsg(fd, msgs.data(), n, 0);
+            gen->calls++;
+        } else {
+            ret = 0;
+            for (unsigned int i = 0; i < n && send(fd, &buf[(size_t)i * gen->size], gen->size, 0) >= 0; i++) {
+                ret++;
+                gen->calls++;
+            }
+        }
+        if (ret <= 0) {
+            perror("send");
+            break;
+        }
+        seq += ret;
+        gen->sent += ret;
+
+        if (gen->rate) {
+            long long due = start + (long long)(gen->sent * 1000000 / gen->rate);
+            long long now = fiveg_data_now_us();
+            if (due > now) {
+                usleep(due - now);
+            }
+        }
+    }
+    gen->elapsed_us = fiveg_data_now_us() - start;
+    close(fd);
+    gen->done = true;
+}
+
+static void print_stats(const char* label, const struct sink_stats* stats, const struct sink_stats* base,
+                        double seconds) {
+    unsigned long long datagrams = stats->datagrams - base->datagrams;
+    unsigned long long bytes = stats->bytes - base->bytes;
+    fiveg_latency_hist_t latency = stats->latency;
+    for (int i = 0; i < FIVEG_LATENCY_BUCKETS; i++) {
+        latency.count[i] -= base->latency.count[i];
+    }
+    latency.total -= base->latency.total;
+    printf("%s: datagrams %llu (%.0f/s) %.1f MB/s lost %llu p50 %lld us p99 %lld us\n", label, datagrams,
+           seconds > 0 ? datagrams / seconds : 0.0, seconds > 0 ? bytes / seconds / 1e6 : 0.0,
+           stats->lost - base->lost, fiveg_latency_percentile(&latency, 50), fiveg_latency_percentile(&latency, 99));
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    const char* address = "127.0.0.1";
+    int port = MEC_SINK_PORT;
+    double duration = 0;
+    double interval = 1;
+    struct generator gen;
+    gen.count = 0;
+    gen.size = 1200;
+    gen.batch = 32;
+    gen.rate = 0;
+    gen.mode = GEN_GSO;
+    gen.done = false;
+    gen.sent = 0;
+    gen.calls = 0;
+    gen.elapsed_us = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:p:d:i:g:s:r:B:m:h")) != -1) {
+        switch (opt) {
+        case 'a':
+            address = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'i':
+            interval = atof(optarg);
+            break;
+        case 'g':
+            gen.count = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            gen.size = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            gen.rate = strtoull(optarg, NULL, 0);
+            break;
+        case 'B':
+            gen.batch = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (!strcmp(optarg, "gso")) {
+                gen.mode = GEN_GSO;
+            } else if (!strcmp(optarg, "mmsg")) {
+                gen.mode = GEN_MMSG;
+            } else if (!strcmp(optarg, "single")) {
+                gen.mode = GEN_SINGLE;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (gen.size < MEC_PROBE_HEADER || gen.size > MEC_SINK_PAYLOAD || gen.batch == 0 || interval <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    // Пачка GSO - одна датаграмма IPv4
+    if (gen.mode == GEN_GSO && (size_t)gen.size * gen.batch > MEC_SINK_PAYLOAD) {
+        gen.batch = MEC_SINK_PAYLOAD / gen.size;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        return 1;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    int rcvbuf = MEC_SINK_RCVBUF;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("Listening on %s:%d\n", address, port);
+    fflush(stdout);
+
+    std::thread sender;
+    if (gen.count) {
+        gen.target = addr;
+        sender = std::thread(run_generator, &gen);
+    }
+
+    std::vector<unsigned char> buffers((size_t)MEC_SINK_BATCH * MEC_SINK_BUFFER);
+    std::vector<struct mmsghdr> msgs(MEC_SINK_BATCH);
+    std::vector<struct iovec> iovs(MEC_SINK_BATCH);
+    struct sink_stats stats, last;
+    memset(&stats, 0, sizeof(stats));
+    last = stats;
+    long long start = fiveg_data_now_us();
+    long long last_report = start;
+    long long idle_since = 0;
+
+    while (!g_stop) {
+        long long now = fiveg_data_now_us();
+        if (duration > 0 && now - start >= duration * 1e6) {
+            break;
+        }
+        // Генератор закончил, и полсекунды ничего не приходит
+        if (gen.count && gen.done && idle_since && now - idle_since > 500000) {
+            break;
+        }
+        if (now - last_report >= interval * 1e6) {
+            char label[32];
+            snprintf(label, sizeof(label), "%.1f s", (now - start) / 1e6);
+            print_stats(label, &stats, &last, (now - last_report) / 1e6);
+            last = stats;
+            last_report = now;
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            if (!idle_since) {
+                idle_since = fiveg_data_now_us();
+            }
+            continue;
+        }
+        for (int i = 0; i < MEC_SINK_BATCH; i++) {
+            iovs[i].iov_base = &buffers[(size_t)i * MEC_SINK_BUFFER];
+            iovs[i].iov_len = MEC_SINK_BUFFER;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(fd, msgs.data(), MEC_SINK_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            continue;
+        }
+        idle_since = 0;
+        now = fiveg_data_now_us();
+        for (int i = 0; i < n; i++) {
+            sink_account(&stats, &buffers[(size_t)i * MEC_SINK_BUFFER], msgs[i].msg_len, now);
+        }
+    }
+
+    g_stop = 1;
+    if (sender.joinable()) {
+        sender.join();
+    }
+    memset(&last, 0, sizeof(last));
+    print_stats("Total", &stats, &last, (fiveg_data_now_us() - start) / 1e6);
+    if (gen.count) {
+        printf("Generator: sent %llu in %llu calls (%.1f per call) %.0f/s\n", gen.sent, gen.calls,
+               gen.calls ? (double)gen.sent / gen.calls : 0.0,
+               gen.elapsed_us > 0 ? gen.sent * 1e6 / gen.elapsed_us : 0.0);
+    }
+    printf("Probes: %llu, max latency %lld us\n", stats.probes, stats.latency.max_us);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,1380 @@
+// Симулятор модема 5G на псевдотерминале: отвечает на AT-команды, которые
+// отправляет 5g.h (AT+CSQ, +COPS?, +CSTT, +CIICR, +CIFSR, +CGATT, +CGACT?,
+// +ZRESTART, регистрация, IMEI/IMSI), чтобы слой модема можно было
+// запускать и измерять на обычной машине с Linux. Задержки ответов, URC и
+// ошибки задаются сценарием.
+//
+// Пример: modemsim -l /tmp/modem -s slow.txt      (симулятор на /tmp/modem)
+//         modemsim -b -n 500 -s slow.txt           (замеры всех fiveg_*_impl)
+//
+// Сценарий - строки вида:
+//   delay <команда> <мс> [разброс_мс]   задержка ответа
+//   error <команда> <доля> [код]        доля ответов ERROR или +CME ERROR: код
+//   reply <команда> <строка>            строка ответа вместо стандартной (копятся)
+//   after <команда> <строка>            URC сразу после ответа на команду
+//   urc <период_мс> <строка>            периодический URC
+// <команда> - начало текста команды ("AT+CSQ", "AT+CGACT?") или "*".
+//
+// После AT+CMUX симулятор говорит кадрами TS 27.010: канал 1 - команды
+// AT, канал 2 - эхо данных, канал 3 - URC. С -c замеры идут через
+// мультиплексор 5g_cmux.h, пока по каналу данных идёт проверяемый поток.
+//
+// С -w тот же проверяемый поток идёт через готовое устройство, например
+// порт WWAN драйвера fiveg.c с port_backend=loopback:
+//         modemsim -w /dev/wwan0at0 -t 10
+//
+// С -T соединение замеров пишет время ответа AT и RSSI/BER в сегмент
+// телеметрии (telemetry.h), который можно смотреть telemetry_read:
+//         modemsim -b -n 1000 -T /dev/shm/zenith-telemetry
+//
+// С -p проверяются разборщики 5g_parse.h без модема: корпус ответов с
+// ожидаемыми результатами, случайные правки корпуса (имеет смысл
+// собирать с -fsanitize=address), сверка с sscanf и замер против него:
+//         modemsim -p -n 1000000 -S 42
+
+// 5G modem simulator on a pseudo-terminal: answers the AT commands sent by
+// 5g.h (AT+CSQ, +COPS?, +CSTT, +CIICR, +CIFSR, +CGATT, +CGACT?, +ZRESTART,
+// registration, IMEI/IMSI) so the modem layer can be run and measured on a
+// plain Linux machine. Response delays, URCs and errors come from a script.
+//
+// Example: modemsim -l /tmp/modem -s slow.txt      (simulator on /tmp/modem)
+//          modemsim -b -n 500 -s slow.txt           (benchmark every fiveg_*_impl)
+//          modemsim -b -c 1                         (same over advanced CMUX)
+//
+// After AT+CMUX the simulator speaks TS 27.010 frames: DLCI 1 carries AT
+// commands, DLCI 2 echoes data back, DLCI 3 carries URCs. With -c the
+// benchmark runs through the 5g_cmux.h multiplexer while a verified data
+// stream runs on the data channel.
+//
+// With -w the same verified stream runs through an existing device, e.g.
+// the fiveg.c WWAN port loaded with port_backend=loopback:
+//          modemsim -w /dev/wwan0at0 -t 10
+//
+// With -T the benchmark connection writes AT response times and RSSI/BER
+// to a telemetry segment (telemetry.h), to be watched with telemetry_read:
+//          modemsim -b -n 1000 -T /dev/shm/zenith-telemetry
+//
+// With -p the 5g_parse.h parsers are checked without a modem: a corpus of
+// responses with expected results, random edits of the corpus (worth
+// building with -fsanitize=address), a cross-check against sscanf and a
+// benchmark against it:
+//          modemsim -p -n 1000000 -S 42
+//
+// In benchmark mode one line per function and mode is printed:
+// "<mode> <function>: calls N errors N p50 N us p99 N us N calls/s".
+
+#include "5g.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <pty.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MODEMSIM_BENCH_CALLS 200
+#define MODEMSIM_LOOP_HIGH (256 * 1024)      // эхо данных: выше - FC приложению
+#define MODEMSIM_DATA_WINDOW (128 * 1024)    // данных в полёте при замерах
+#define MODEMSIM_PORT_SECONDS 5
+#define MODEMSIM_FUZZ_COUNT 1000000         // случайных ответов в -p
+#define MODEMSIM_PARSE_ROUNDS 1000000       // разборов на замер в -p
+
+struct sim_rule {
+    std::string command;       // начало команды, "*" - любая
+    int delay_ms;
+    int jitter_ms;
+    double error_rate;
+    int cme_error;             // -1 - простой ERROR
+    std::vector<std::string> reply;
+    std::vector<std::string> after;
+};
+
+struct sim_urc {
+    int period_ms;
+    std::string line;
+    long long next_ms;
+};
+
+// Ответ, ждущий своего времени
+struct sim_output {
+    long long due_ms;
+    int dlci;                  // канал под CMUX
+    int cmux;                  // режим CMUX, включаемый после записи, -1 - нет
+    std::string text;
+};
+
+struct sim_modem {
+    int fd;
+    bool echo;
+    std::vector<struct sim_rule> rules;
+    std::vector<struct sim_urc> urcs;
+    std::deque<struct sim_output> pending;
+    std::mt19937 rng;
+    char line[FIVEG_AT_LINE_MAX];
+    size_t line_len;
+
+    // Состояние сети
+    std::string apn;
+    bool attached;
+    bool active;
+    unsigned long long commands;
+
+    // CMUX: после ответа на AT+CMUX линия переходит на кадры
+    int cmux;                  // режим кадров, -1 - обычная линия
+    int cmux_next;             // режим из последней AT+CMUX
+    size_t n1;
+    fiveg_cmux_decoder_t* decoder;
+    bool data_stopped;         // приложение прислало FC по каналу данных
+    bool data_held;            // мы прислали FC: эхо не успевает уходить
+    std::string loop;          // эхо данных, ждущее снятия FC
+    unsigned long long data_bytes;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-l link] [-s script] [-E] [-b [-n calls] [-c mode] [-T path]] [-w device [-t seconds]]\n"
+            "       %s -p [-n inputs] [-S seed]\n"
+            "  -l  create a symlink to the pseudo-terminal at this path\n"
+            "  -s  script with delays, errors, replies and URCs\n"
+            "  -E  start with echo off (ATE0)\n"
+            "  -b  benchmark every fiveg_*_impl function against the simulator\n"
+            "  -n  calls per function in benchmark mode (default %d)\n"
+            "  -c  benchmark over CMUX (0 basic, 1 advanced) with a data stream alongside\n"
+            "  -T  write benchmark AT timings and signal to this telemetry segment\n"
+            "  -w  run the verified data stream through a looped-back device instead\n"
+            "  -t  seconds of data for -w (default %d)\n"
+            "  -p  check the AT response parsers: corpus, -n fuzzed inputs (default %d),\n"
+            "      comparison with sscanf and a benchmark against it\n"
+            "  -S  fuzz seed for -p (default 1)\n",
+            prog, prog, MODEMSIM_BENCH_CALLS, MODEMSIM_PORT_SECONDS, MODEMSIM_FUZZ_COUNT);
+}
+
+// Правило для команды: первое подходящее по началу текста
+static const struct sim_rule* find_rule(const struct sim_modem* modem, const char* command) {
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        const std::string& prefix = modem->rules[i].command;
+        if (prefix == "*" || strncasecmp(command, prefix.c_str(), prefix.size()) == 0) {
+            return &modem->rules[i];
+        }
+    }
+    return NULL;
+}
+
+static struct sim_rule* rule_for(struct sim_modem* modem, const std::string& command) {
+    for (size_t i = 0; i < modem->rules.size(); i++) {
+        if (modem->rules[i].command == command) {
+            return &modem->rules[i];
+        }
+    }
+    struct sim_rule rule;
+    rule.command = command;
+    rule.delay_ms = 0;
+    rule.jitter_ms = 0;
+    rule.error_rate = 0;
+    rule.cme_error = -1;
+    modem->rules.push_back(rule);
+    return &modem->rules.back();
+}
+
+static int load_script(struct sim_modem* modem, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    char buf[512];
+    int number = 0;
+    while (fgets(buf, sizeof(buf), file)) {
+        number++;
+        buf[strcspn(buf, "\r\n")] = '\0';
+        char keyword[16];
+        char command[64];
+        int consumed = 0;
+        if (buf[0] == '#' || sscanf(buf, "%15s %63s %n", keyword, command, &consumed) < 2) {
+            continue;
+        }
+        const char* rest = buf + consumed;
+
+        if (strcmp(keyword, "delay") == 0) {
+            struct sim_rule* rule = rule_for(modem, command);
+            if (sscanf(rest, "%d %d", &rule->delay_ms, &rule->jitter_ms) < 1) {
+                break;
+            }
+        } else if (strcmp(keyword, "error") == 0) {
+            struct sim_rule* rule = rule_for(modem, command);
+            if (sscanf(rest, "%lf %d", &rule->error_rate, &rule->cme_error) < 1) {
+                break;
+            }
+        } else if (strcmp(keyword, "reply") == 0) {
+            rule_for(modem, command)->reply.push_back(rest);
+        } else if (strcmp(keyword, "after") == 0) {
+            rule_for(modem, command)->after.push_back(rest);
+        } else if (strcmp(keyword, "urc") == 0) {
+            struct sim_urc urc;
+            urc.period_ms = atoi(command);
+            urc.line = rest;
+            urc.next_ms = fiveg_at_now_ms() + urc.period_ms;
+            if (urc.period_ms <= 0) {
+                break;
+            }
+            modem->urcs.push_back(urc);
+        } else {
+            break;
+        }
+    }
+    bool failed = !feof(file);
+    fclose(file);
+    if (failed) {
+        fprintf(stderr, "%s:%d: bad script line\n", path, number);
+        return -1;
+    }
+    return 0;
+}
+
+// Стандартный ответ на команду: информационные строки и финальная
+// строка. AT+CIFSR отвечает голым адресом без OK.
+static void default_reply(struct sim_modem* modem, const char* cmd, std::vector<std::string>* lines,
+                          std::string* final_line, std::vector<std::string>* after) {
+    *final_line = "OK";
+    if (strcasecmp(cmd, "AT") == 0) {
+    } else if (strcasecmp(cmd, "ATE0") == 0 || strcasecmp(cmd, "ATE1") == 0) {
+        modem->echo = cmd[3] == '1';
+    } else if (strcasecmp(cmd, "AT+CSQ") == 0) {
+        lines->push_back("+CSQ: 23,99");
+    } else if (strcasecmp(cmd, "AT+COPS?") == 0) {
+        lines->push_back("+COPS: 0,0,\"ZenithNet\",11");
+    } else if (strncasecmp(cmd, "AT+CSTT=", 8) == 0) {
+        const char* quote = strchr(cmd, '"');
+        const char* end = quote ? strchr(quote + 1, '"') : NULL;
+        if (!end) {
+            *final_line = "ERROR";
+        } else {
+            modem->apn.assign(quote + 1, end - quote - 1);
+        }
+    } else if (strcasecmp(cmd, "AT+CIICR") == 0) {
+        if (modem->apn.empty()) {
+            *final_line = "ERROR";
+        } else {
+            modem->attached = true;
+            modem->active = true;
+        }
+    } else if (strcasecmp(cmd, "AT+CIFSR") == 0) {
+        if (modem->active) {
+            lines->push_back("10.64.12.7");
+            final_line->clear();
+        } else {
+            *final_line = "ERROR";
+        }
+    } else if (strcasecmp(cmd, "AT+CGATT=0") == 0 || strcasecmp(cmd, "AT+CGATT=1") == 0) {
+        modem->attached = cmd[9] == '1';
+        if (!modem->attached) {
+            modem->active = false;
+        }
+    } else if (strcasecmp(cmd, "AT+CGATT?") == 0) {
+        lines->push_back(modem->attached ? "+CGATT: 1" : "+CGATT: 0");
+    } else if (strcasecmp(cmd, "AT+CGACT?") == 0) {
+        lines->push_back(modem->active ? "+CGACT: 1,1" : "+CGACT: 1,0");
+    } else if (strcasecmp(cmd, "AT+ZRESTART") == 0) {
+        // После перезагрузки контекст не активен, модем заново
+        // сообщает о регистрации
+        modem->attached = false;
+        modem->active = false;
+        after->push_back("+CEREG: 1");
+    } else if (strcasecmp(cmd, "AT+C5GREG?") == 0) {
+        lines->push_back("+C5GREG: 2,1,\"00A1\",\"0001B2C3D\",11");
+    } else if (strcasecmp(cmd, "AT+CEREG?") == 0) {
+        lines->push_back("+CEREG: 2,1,\"00A1\",\"01B2C3D\",7");
+    } else if (strncasecmp(cmd, "AT+C5GREG=", 10) == 0 || strncasecmp(cmd, "AT+CEREG=", 9) == 0 ||
+               strncasecmp(cmd, "AT+CREG=", 8) == 0 || strncasecmp(cmd, "AT+CGREG=", 9) == 0) {
+    } else if (strncasecmp(cmd, "AT+CMUX=", 8) == 0) {
+        // AT+CMUX=<mode>[,<subset>[,<port_speed>[,<N1>]]]
+        int mode = -1;
+        int n1 = FIVEG_CMUX_N1;
+        if (sscanf(cmd + 8, "%d,%*d,%*d,%d", &mode, &n1) < 1 || (mode != FIVEG_CMUX_BASIC && mode != FIVEG_CMUX_ADVANCED) ||
+            n1 < 1 || n1 > FIVEG_CMUX_N1_MAX) {
+            *final_line = "ERROR";
+        } else {
+            modem->cmux_next = mode;
+            modem->n1 = n1;
+        }
+    } else if (strcasecmp(cmd, "AT+CGSN") == 0) {
+        lines->push_back("356938035643809");
+    } else if (strcasecmp(cmd, "AT+CIMI") == 0) {
+        lines->push_back("250011234567890");
+    } else {
+        *final_line = "ERROR";
+    }
+}
+
+static void queue_output(struct sim_modem* modem, long long due_ms, int dlci, const std::string& text) {
+    struct sim_output out;
+    out.due_ms = due_ms;
+    out.dlci = dlci;
+    out.cmux = -1;
+    out.text = text;
+    modem->pending.push_back(out);
+}
+
+// Команда из одной строки: ответ ставится в очередь со своей задержкой.
+// Модем обрабатывает команды по одной, поэтому ответ не может обогнать
+// ответ на предыдущую команду.
+static void handle_command(struct sim_modem* modem, const char* cmd) {
+    long long now = fiveg_at_now_ms();
+    long long due = modem->pending.empty() ? now : modem->pending.back().due_ms;
+    if (due < now) {
+        due = now;
+    }
+    modem->commands++;
+    modem->cmux_next = -1;
+
+    std::vector<std::string> lines;
+    std::vector<std::string> after;
+    std::string final_line;
+    default_reply(modem, cmd, &lines, &final_line, &after);
+
+    const struct sim_rule* rule = find_rule(modem, cmd);
+    if (rule) {
+        int jitter = rule->jitter_ms > 0 ? (int)(modem->rng() % (rule->jitter_ms + 1)) : 0;
+        due += rule->delay_ms + jitter;
+        if (!rule->reply.empty()) {
+            lines = rule->reply;
+        }
+        after.insert(after.end(), rule->after.begin(), rule->after.end());
+        if (rule->error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(modem->rng) < rule->error_rate) {
+            lines.clear();
+            after.clear();
+            final_line = rule->cme_error >= 0 ? "+CME ERROR: " + std::to_string(rule->cme_error) : "ERROR";
+        }
+    }
+
+    std::string text;
+    if (modem->echo) {
+        text += std::string(cmd) + "\r";
+    }
+    for (size_t i = 0; i < lines.size(); i++) {
+        text += "\r\n" + lines[i] + "\r\n";
+    }
+    if (!final_line.empty()) {
+        text += "\r\n" + final_line + "\r\n";
+    }
+    queue_output(modem, due, FIVEG_CMUX_DLCI_AT, text);
+    if (final_line == "OK") {
+        modem->pending.back().cmux = modem->cmux_next;
+    }
+
+    // URC после ответа; под CMUX - в своём канале
+    text.clear();
+    for (size_t i = 0; i < after.size(); i++) {
+        text += "\r\n" + after[i] + "\r\n";
+    }
+    if (!text.empty()) {
+        queue_output(modem, due, FIVEG_CMUX_DLCI_URC, text);
+    }
+}
+
+static int write_all(int fd, const std::string& text) {
+    size_t off = 0;
+    while (off < text.size()) {
+        ssize_t len = write(fd, text.data() + off, text.size() - off);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        off += len;
+    }
+    return 0;
+}
+
+// Запись в линию: под CMUX текст режется на кадры UIH канала dlci
+static int sim_emit(struct sim_modem* modem, int dlci, const std::string& text) {
+    if (modem->cmux < 0) {
+        return write_all(modem->fd, text);
+    }
+    std::string frames;
+    for (size_t off = 0; off < text.size(); off += modem->n1) {
+        size_t len = text.size() - off < modem->n1 ? text.size() - off : modem->n1;
+        fiveg_cmux_encode(modem->cmux, (uint8_t)dlci, false, FIVEG_CMUX_UIH, (const uint8_t*)text.data() + off, len,
+                          &frames);
+    }
+    return write_all(modem->fd, frames);
+}
+
+// Эхо канала данных. Пока приложение держит FC, эхо копится; при
+// переполнении симулятор сам шлёт FC, как модем с полным буфером.
+static void sim_flush_loop(struct sim_modem* modem) {
+    if (!modem->data_stopped && !modem->loop.empty()) {
+        sim_emit(modem, FIVEG_CMUX_DLCI_DATA, modem->loop);
+        modem->loop.clear();
+    }
+    bool hold = modem->loop.size() > MODEMSIM_LOOP_HIGH;
+    if (hold != modem->data_held) {
+        std::string out;
+        modem->data_held = hold;
+        fiveg_cmux_encode_msc(modem->cmux, false, FIVEG_CMUX_DLCI_DATA, hold, &out);
+        write_all(modem->fd, out);
+    }
+}
+
+static void sim_feed_lines(struct sim_modem* modem, const char* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = buf[i];
+        if (c == '\r' || c == '\n') {
+            if (modem->line_len > 0) {
+                modem->line[modem->line_len] = '\0';
+                modem->line_len = 0;
+                handle_command(modem, modem->line);
+            }
+        } else if (modem->line_len < sizeof(modem->line) - 1) {
+            modem->line[modem->line_len++] = c;
+        }
+    }
+}
+
+// Кадр от приложения. Симулятор - отвечающая сторона: его команды идут
+// с C/R = 0, ответы - с C/R = 1.
+static void sim_handle_frame(struct sim_modem* modem, const fiveg_cmux_frame_t* frame) {
+    std::string out;
+    bool leave = false;
+    int mode = modem->cmux;
+
+    switch (frame->control) {
+    case FIVEG_CMUX_SABM:
+        fiveg_cmux_encode(mode, frame->dlci, true,
+                          (frame->dlci < FIVEG_CMUX_CHANNELS ? FIVEG_CMUX_UA : FIVEG_CMUX_DM) | FIVEG_CMUX_PF, NULL, 0,
+                          &out);
+        break;
+    case FIVEG_CMUX_DISC:
+        fiveg_cmux_encode(mode, frame->dlci, true, FIVEG_CMUX_UA | FIVEG_CMUX_PF, NULL, 0, &out);
+        leave = frame->dlci == FIVEG_CMUX_DLCI_CONTROL;
+        break;
+    case FIVEG_CMUX_UIH:
+    case FIVEG_CMUX_UI:
+        if (frame->dlci == FIVEG_CMUX_DLCI_AT) {
+            sim_feed_lines(modem, (const char*)frame->info, frame->len);
+        } else if (frame->dlci == FIVEG_CMUX_DLCI_DATA) {
+            modem->data_bytes += frame->len;
+            modem->loop.append((const char*)frame->info, frame->len);
+            sim_flush_loop(modem);
+        } else if (frame->dlci == FIVEG_CMUX_DLCI_CONTROL && frame->len >= 2) {
+            uint8_t type = frame->info[0] & ~FIVEG_CMUX_CR;
+            size_t value_len = frame->info[1] >> 1;
+            const uint8_t* value = frame->info + 2;
+            if (!(frame->info[0] & FIVEG_CMUX_CR) || value_len > frame->len - 2) {
+                break;
+            }
+            if (type == FIVEG_CMUX_MSG_MSC && value_len >= 2 && (value[0] >> 2) == FIVEG_CMUX_DLCI_DATA) {
+                modem->data_stopped = (value[1] & FIVEG_CMUX_V24_FC) != 0;
+            }
+            leave = type == FIVEG_CMUX_MSG_CLD;
+            fiveg_cmux_encode_message(mode, false, type, false, value, value_len, &out);
+        }
+        break;
+    }
+    if (leave) {
+        modem->cmux = -1;
+    }
+    write_all(modem->fd, out);
+    if (!leave && !modem->data_stopped && !modem->loop.empty()) {
+        sim_flush_loop(modem);
+    }
+}
+
+static void sim_input(struct sim_modem* modem, const char* buf, size_t len) {
+    if (modem->cmux < 0) {
+        sim_feed_lines(modem, buf, len);
+        return;
+    }
+    fiveg_cmux_decode(modem->decoder, (const uint8_t*)buf, len,
+                      [modem](const fiveg_cmux_frame_t* frame) { sim_handle_frame(modem, frame); });
+}
+
+// Цикл симулятора: команды из tty, отложенные ответы и URC по таймеру.
+// URC не вклиниваются в отложенный ответ: они уходят между ответами.
+static void run_modem(struct sim_modem* modem, const std::atomic<bool>* stop) {
+    while (!g_stop && !(stop && *stop)) {
+        long long now = fiveg_at_now_ms();
+        long long wake = now + 1000;
+        while (!modem->pending.empty() && modem->pending.front().due_ms <= now) {
+            const struct sim_output* out = &modem->pending.front();
+            if (sim_emit(modem, out->dlci, out->text) < 0) {
+                return;
+            }
+            if (out->cmux >= 0) {
+                modem->cmux = out->cmux;
+                modem->data_stopped = false;
+                modem->data_held = false;
+                modem->loop.clear();
+                fiveg_cmux_decoder_init(modem->decoder, modem->cmux, modem->n1);
+            }
+            modem->pending.pop_front();
+        }
+        for (size_t i = 0; i < modem->urcs.size(); i++) {
+            struct sim_urc* urc = &modem->urcs[i];
+            if (urc->next_ms <= now) {
+                queue_output(modem, modem->pending.empty() ? now : modem->pending.back().due_ms, FIVEG_CMUX_DLCI_URC,
+                             "\r\n" + urc->line + "\r\n");
+                urc->next_ms = now + urc->period_ms;
+            }
+            if (urc->next_ms < wake) {
+                wake = urc->next_ms;
+            }
+        }
+        if (!modem->pending.empty() && modem->pending.front().due_ms < wake) {
+            wake = modem->pending.front().due_ms;
+        }
+
+        struct pollfd pfd = {modem->fd, POLLIN, 0};
+        int timeout = wake > now ? (int)(wake - now) : 0;
+        if (stop && timeout > 100) {
+            timeout = 100;
+        }
+        int ready = poll(&pfd, 1, timeout);
+        if (ready <= 0) {
+            continue;
+        }
+        char buf[65536];
+        ssize_t len = read(modem->fd, buf, sizeof(buf));
+        if (len <= 0) {
+            if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            // EIO: сторона приложения закрыла терминал, ждём нового открытия
+            usleep(100000);
+            continue;
+        }
+        sim_input(modem, buf, len);
+    }
+}
+
+static int open_modem(struct sim_modem* modem, int* slave, bool echo) {
+    int master;
+    if (openpty(&master, slave, NULL, NULL, NULL) < 0) {
+        perror("openpty");
+        return -1;
+    }
+    // Обе стороны без обработки строк: симулятор видит байты как есть
+    struct termios tio;
+    tcgetattr(*slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    modem->fd = master;
+    modem->echo = echo;
+    modem->rng.seed(1);
+    modem->line_len = 0;
+    modem->attached = true;
+    modem->active = false;
+    modem->commands = 0;
+    modem->cmux = -1;
+    modem->cmux_next = -1;
+    modem->n1 = FIVEG_CMUX_N1;
+    modem->decoder = new fiveg_cmux_decoder_t();
+    modem->data_stopped = false;
+    modem->data_held = false;
+    modem->data_bytes = 0;
+    return 0;
+}
+
+// --- Замеры ---
+
+struct bench_case {
+    const char* name;
+    int (*call)(fiveg_connection_t* connection);
+};
+
+static int bench_check_modem_status(fiveg_connection_t* c) {
+    fiveg_csq_t csq;
+    return fiveg_check_modem_status_impl(c, &csq);
+}
+
+static int bench_get_network_info(fiveg_connection_t* c) {
+    fiveg_cops_t cops;
+    return fiveg_get_network_info_impl(c, &cops);
+}
+
+static int bench_get_registration(fiveg_connection_t* c) {
+    fiveg_reg_t reg;
+    return fiveg_get_registration_impl(c, &reg);
+}
+
+static int bench_check_connection_status(fiveg_connection_t* c) {
+    fiveg_cgact_t contexts;
+    return fiveg_check_connection_status_impl(c, &contexts);
+}
+
+static int bench_set_apn(fiveg_connection_t* c) {
+    return fiveg_set_apn_impl(c, "internet", "", "");
+}
+
+static int bench_start_connection(fiveg_connection_t* c) {
+    return fiveg_start_connection_impl(c);
+}
+
+static int bench_get_ip_address_cifsr(fiveg_connection_t* c) {
+    fiveg_cifsr_t address;
+    return fiveg_get_ip_address_cifsr_impl(c, &address);
+}
+
+static int bench_get_signal_strength(fiveg_connection_t* c) {
+    int dbm;
+    return fiveg_get_signal_strength_impl(c, &dbm);
+}
+
+static int bench_get_network_operator(fiveg_connection_t* c) {
+    char name[64];
+    return fiveg_get_network_operator_impl(c, name, sizeof(name));
+}
+
+static int bench_get_ip_address(fiveg_connection_t* c) {
+    char address[64];
+    return fiveg_get_ip_address_impl(c, address, sizeof(address));
+}
+
+static int bench_get_imei(fiveg_connection_t* c) {
+    char imei[32];
+    return fiveg_get_imei_impl(c, imei, sizeof(imei));
+}
+
+static int bench_get_imsi(fiveg_connection_t* c) {
+    char imsi[32];
+    return fiveg_get_imsi_impl(c, imsi, sizeof(imsi));
+}
+
+static int bench_deactivate_network(fiveg_connection_t* c) {
+    return fiveg_deactivate_network_impl(c);
+}
+
+static int bench_restart_modem(fiveg_connection_t* c) {
+    return fiveg_restart_modem_impl(c);
+}
+
+// Порядок важен: адрес есть только после CSTT/CIICR, а отключение и
+// перезагрузка сбрасывают контекст
+static const struct bench_case bench_cases[] = {
+    {"check_modem_status", bench_check_modem_status},
+    {"get_network_info", bench_get_network_info},
+    {"get_registration", bench_get_registration},
+    {"check_connection_status", bench_check_connection_status},
+    {"set_apn", bench_set_apn},
+    {"start_connection", bench_start_connection},
+    {"get_ip_address_cifsr", bench_get_ip_address_cifsr},
+    {"get_signal_strength", bench_get_signal_strength},
+    {"get_network_operator", bench_get_network_operator},
+    {"get_ip_address", bench_get_ip_address},
+    {"get_imei", bench_get_imei},
+    {"get_imsi", bench_get_imsi},
+    {"deactivate_network", bench_deactivate_network},
+    {"restart_modem", bench_restart_modem},
+};
+
+// Кэш без движка AT: каждое поле обновляет свой поток, срок жизни 1 мс,
+// так что обновления разных полей идут по fd одновременно. Прямой обмен
+// должен пропускать их по одной команде, иначе ответы перемешиваются.
+static int (*const bench_cache_fields[])(fiveg_connection_t*) = {
+    bench_get_signal_strength, bench_get_network_operator, bench_get_ip_address, bench_get_imei, bench_get_imsi,
+};
+
+static unsigned int bench_cache_threads(const char* mode, fiveg_connection_t* connection, unsigned int calls) {
+    const size_t count = sizeof(bench_cache_fields) / sizeof(bench_cache_fields[0]);
+    std::atomic<unsigned int> errors(0);
+    std::vector<std::thread> threads;
+
+    // После restart_modem контекст не активен и AT+CIFSR отвечает ERROR
+    fiveg_start_connection_impl(connection);
+    fiveg_cache_set_ttl(connection->cache, FIVEG_CACHE_SIGNAL, 1);
+    fiveg_cache_set_ttl(connection->cache, FIVEG_CACHE_OPERATOR, 1);
+    fiveg_cache_set_ttl(connection->cache, FIVEG_CACHE_ADDRESS, 1);
+    long long start = fiveg_data_now_us();
+    for (size_t i = 0; i < count; i++) {
+        threads.emplace_back([&, i] {
+            for (unsigned int n = 0; n < calls && !g_stop; n++) {
+                if (bench_cache_fields[i](connection) != FIVEG_SUCCESS) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    long long elapsed = fiveg_data_now_us() - start;
+    printf("%s %zu threads: calls %zu errors %u %.0f calls/s\n", mode, count, count * calls, errors.load(),
+           elapsed > 0 ? count * calls * 1e6 / elapsed : 0.0);
+    return errors;
+}
+
+// Поток данных по каналу CMUX, идущий во время замеров: симулятор
+// возвращает байты обратно, каждый байт сверяется с шаблоном
+struct bench_data {
+    std::atomic<bool> stop;
+    unsigned long long sent;
+    unsigned long long received;
+    unsigned long long mismatches;
+    long long elapsed_us;
+};
+
+static unsigned char bench_pattern(unsigned long long offset) {
+    return (unsigned char)(offset * 7 + (offset >> 8));
+}
+
+static void bench_data_loop(fiveg_connection_t* connection, struct bench_data* data) {
+    std::vector<unsigned char> out(FIVEG_DATA_CHUNK);
+    std::vector<unsigned char> in(65536);
+    long long start = fiveg_data_now_us();
+    long long drain_deadline = 0;
+
+    for (;;) {
+        bool stopping = data->stop;
+        if (stopping && drain_deadline == 0) {
+            drain_deadline = fiveg_data_now_us() + 2000000;
+        }
+        if (stopping && (data->received == data->sent || fiveg_data_now_us() > drain_deadline)) {
+            break;
+        }
+        bool window_full = data->sent - data->received >= MODEMSIM_DATA_WINDOW;
+        if (!stopping && !window_full) {
+            for (size_t i = 0; i < out.size(); i++) {
+                out[i] = bench_pattern(data->sent + i);
+            }
+            if (fiveg_send_data_impl(connection, out.data(), out.size()) != FIVEG_SUCCESS) {
+                break;
+            }
+            data->sent += out.size();
+        }
+        int len = fiveg_receive_data_impl(connection, in.data(), in.size(), stopping || window_full ? 100 : 0);
+        if (len < 0) {
+            break;
+        }
+        for (int i = 0; i < len; i++) {
+            if (in[i] != bench_pattern(data->received + i)) {
+                data->mismatches++;
+            }
+        }
+        data->received += len;
+    }
+    data->elapsed_us = fiveg_data_now_us() - start;
+}
+
+static void bench_mode(const char* mode, fiveg_connection_t* connection, unsigned int calls) {
+    for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+        fiveg_latency_hist_t hist;
+        memset(&hist, 0, sizeof(hist));
+        unsigned int errors = 0;
+        long long start = fiveg_data_now_us();
+        for (unsigned int n = 0; n < calls && !g_stop; n++) {
+            long long before = fiveg_data_now_us();
+            if (bench_cases[i].call(connection) != FIVEG_SUCCESS) {
+                errors++;
+            }
+            fiveg_latency_add(&hist, fiveg_data_now_us() - before);
+        }
+        long long elapsed = fiveg_data_now_us() - start;
+        printf("%s %s: calls %llu errors %u p50 %lld us p99 %lld us %.0f calls/s\n", mode, bench_cases[i].name,
+               (unsigned long long)hist.total, errors, fiveg_latency_percentile(&hist, 50),
+               fiveg_latency_percentile(&hist, 99), elapsed > 0 ? hist.total * 1e6 / elapsed : 0.0);
+    }
+}
+
+// Замеры в трёх режимах: прямой обмен через fd, движок AT-команд и
+// движок с кэшем состояния; между первыми двумя - кэш без движка с
+// обновлением полей из нескольких потоков. Под CMUX (cmux >= 0) всё это время по
+// каналу данных идёт поток с проверкой эха.
+static int run_bench(struct sim_modem* modem, int slave, unsigned int calls, int cmux, telemetry_t* telemetry) {
+    std::atomic<bool> stop(false);
+    std::thread sim(run_modem, modem, &stop);
+
+    fiveg_connection_t connection = {};
+    connection.fd = slave;
+    fiveg_attach_telemetry(&connection, telemetry);
+
+    struct bench_data data;
+    data.stop = false;
+    data.sent = 0;
+    data.received = 0;
+    data.mismatches = 0;
+    data.elapsed_us = 0;
+    std::thread stream;
+    if (cmux >= 0) {
+        if (fiveg_start_cmux_impl(&connection, cmux) != FIVEG_SUCCESS ||
+            fiveg_start_data_mode_impl(&connection) != FIVEG_SUCCESS) {
+            fprintf(stderr, "Failed to start CMUX\n");
+            stop = true;
+            sim.join();
+            return 1;
+        }
+        stream = std::thread(bench_data_loop, &connection, &data);
+    }
+    std::string prefix = cmux >= 0 ? "cmux-" : "";
+
+    bench_mode((prefix + "direct").c_str(), &connection, calls);
+    fiveg_start_state_cache_impl(&connection);
+    unsigned int cache_errors = bench_cache_threads((prefix + "direct-cached").c_str(), &connection, calls);
+    fiveg_stop_state_cache_impl(&connection);
+
+    if (fiveg_start_at_engine_impl(&connection) != FIVEG_SUCCESS) {
+        fprintf(stderr, "Failed to start the AT engine\n");
+    } else {
+        bench_mode((prefix + "engine").c_str(), &connection, calls);
+        fiveg_start_state_cache_impl(&connection);
+        bench_mode((prefix + "cached").c_str(), &connection, calls);
+        fiveg_stop_state_cache_impl(&connection);
+        fiveg_stop_at_engine_impl(&connection);
+    }
+
+    int result = cache_errors ? 1 : 0;
+    if (cmux >= 0) {
+        data.stop = true;
+        stream.join();
+        printf("cmux data: sent %llu received %llu mismatches %llu %.1f MB/s\n", data.sent, data.received,
+               data.mismatches, data.elapsed_us > 0 ? data.received / (double)data.elapsed_us : 0.0);
+        fiveg_print_cmux_stats(&connection, stdout);
+        fiveg_stop_data_mode_impl(&connection);
+        fiveg_stop_cmux_impl(&connection);
+        if (data.mismatches || data.received != data.sent) {
+            result = 1;
+        }
+    }
+
+    stop = true;
+    sim.join();
+    printf("Total: %llu commands answered\n", modem->commands);
+    return result;
+}
+
+// Поток с проверкой эха через устройство, которое само возвращает
+// записанное (порт WWAN с бэкендом loopback); симулятор не нужен
+static int run_port(const char* path, int seconds) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    fiveg_connection_t connection = {};
+    connection.fd = fd;
+    if (fiveg_start_data_mode_impl(&connection, FIVEG_FLOW_NONE) != FIVEG_SUCCESS) {
+        fprintf(stderr, "Failed to start data mode on %s\n", path);
+        close(fd);
+        return 1;
+    }
+
+    struct bench_data data;
+    data.stop = false;
+    data.sent = 0;
+    data.received = 0;
+    data.mismatches = 0;
+    data.elapsed_us = 0;
+    std::thread stream(bench_data_loop, &connection, &data);
+    for (int i = 0; i < seconds * 10 && !g_stop; i++) {
+        usleep(100000);
+    }
+    data.stop = true;
+    stream.join();
+
+    printf("port data: sent %llu received %llu mismatches %llu %.1f MB/s\n", data.sent, data.received,
+           data.mismatches, data.elapsed_us > 0 ? data.received / (double)data.elapsed_us : 0.0);
+    fiveg_print_data_stats(&connection, stdout);
+    fiveg_stop_data_mode_impl(&connection);
+    close(fd);
+    return data.mismatches || data.received != data.sent ? 1 : 0;
+}
+
+// --- Проверка разбора ответов (5g_parse.h) ---
+
+enum {
+    PARSE_CSQ,
+    PARSE_COPS,
+    PARSE_CGACT,
+    PARSE_CIFSR,
+    PARSE_CEREG,
+    PARSE_C5GREG,
+    PARSE_ID,
+    PARSE_KINDS,
+};
+
+static const char* const parse_names[PARSE_KINDS] = {"csq", "cops", "cgact", "cifsr", "cereg", "c5greg", "id"};
+
+// Ответ в том виде, как его возвращает send_at_command, и ожидаемый
+// результат разбора в записи parse_run ("-" - строка не разобрана)
+struct parse_case {
+    int kind;
+    const char* text;
+    const char* expect;
+};
+
+static const struct parse_case parse_corpus[] = {
+    {PARSE_CSQ, "+CSQ: 21,99", "21,99"},
+    {PARSE_CSQ, "+CSQ:21,99", "21,99"},
+    {PARSE_CSQ, "+CSQ: 12,3\r", "12,3"},
+    {PARSE_CSQ, "AT+CSQ\n+CSQ: 31,0", "31,0"},
+    {PARSE_CSQ, "+CSQ: -5,99", "-5,99"},
+    {PARSE_CSQ, "+CSQ: 21,99,7", "21,99"},
+    {PARSE_CSQ, "+CSQ: ,99", "-1,99"},
+    {PARSE_CSQ, "+CSQ: 5", "-"},
+    {PARSE_CSQ, "+CSQ: 2a,99", "-"},
+    {PARSE_CSQ, "+CSQ: 21;99", "-"},
+    {PARSE_CSQ, "+CSQX: 1,2", "-"},
+    {PARSE_CSQ, "+CSQ", "-"},
+    {PARSE_CSQ, "", "-"},
+    {PARSE_COPS, "+COPS: 0,0,\"Operator\",13", "0,0,Operator,13"},
+    {PARSE_COPS, "+COPS: 0,2,\"25001\",7", "0,2,25001,7"},
+    {PARSE_COPS, "+COPS: 1,0,Bare,12", "1,0,Bare,12"},
+    {PARSE_COPS, "+COPS: 0", "0,-1,,-1"},
+    {PARSE_COPS, "+COPS: 0,0,\"With, comma\",11", "0,0,With, comma,11"},
+    {PARSE_COPS, "+COPS: 1,0,\"0123456789012345678901234567890123456789012345678901234567890123456789\",12",
+     "1,0,012345678901234567890123456789012345678901234567890123456789012,12"},
+    {PARSE_COPS, "+COPS: 0,0,\"Unterminated", "-"},
+    {PARSE_COPS, "+COPS: x", "-"},
+    {PARSE_CGACT, "+CGACT: 1,1\n+CGACT: 2,0", "2:1,1;2,0;"},
+    {PARSE_CGACT, "+CGACT: 1,1\r\n+CGACT: 5,1\r\n", "2:1,1;5,1;"},
+    {PARSE_CGACT, "", "0:"},
+    {PARSE_CGACT,
+     "+CGACT: 1,1\n+CGACT: 2,1\n+CGACT: 3,1\n+CGACT: 4,1\n+CGACT: 5,1\n+CGACT: 6,1\n+CGACT: 7,1\n+CGACT: 8,1\n"
+     "+CGACT: 9,1",
+     "8:1,1;2,1;3,1;4,1;5,1;6,1;7,1;8,1;"},
+    {PARSE_CGACT, "+CGACT: 1", "-"},
+    {PARSE_CGACT, "+CGACT: 1,1\n+CGACT: z,1", "-"},
+    {PARSE_CIFSR, "10.0.0.1", "10.0.0.1 4 10.0.0.1"},
+    {PARSE_CIFSR, "\r\n192.168.100.254\r\n", "192.168.100.254 4 192.168.100.254"},
+    {PARSE_CIFSR, "2001:db8::1", "2001:db8::1 6 0.0.0.0"},
+    {PARSE_CIFSR, "256.1.1.1", "256.1.1.1 6 0.0.0.0"},
+    {PARSE_CIFSR, "10.0.0", "10.0.0 6 0.0.0.0"},
+    {PARSE_CIFSR, "ERROR", "-"},
+    {PARSE_CIFSR, "", "-"},
+    {PARSE_CEREG, "+CEREG: 2,1,\"1A2B\",\"01ABCDEF\",7", "2,1,1a2b,1abcdef,7"},
+    {PARSE_CEREG, "+CEREG: 0,4", "0,4,-1,-1,-1"},
+    {PARSE_CEREG, "+CEREG: 1,\"1A2B\",\"01ABCDEF\",7", "-1,1,1a2b,1abcdef,7"},
+    {PARSE_CEREG, "+CEREG: 5", "-1,5,-1,-1,-1"},
+    {PARSE_CEREG, "+CEREG: 2,1,\"1A2B", "-"},
+    {PARSE_CEREG, "+CREG: 0,1", "-"},
+    {PARSE_C5GREG, "+C5GREG: 2,1,\"00AB12\",\"123456789\",11", "2,1,ab12,123456789,11"},
+    {PARSE_C5GREG, "+C5GREG: 5,\"00AB12\",\"FFFFFFFFF\",11", "-1,5,ab12,fffffffff,11"},
+    {PARSE_ID, "867530912345678", "867530912345678"},
+    {PARSE_ID, "+CGSN: \"867530912345678\"", "867530912345678"},
+    {PARSE_ID, "AT+CIMI\n250011234567890", "250011234567890"},
+    {PARSE_ID, "12345", "-"},
+    {PARSE_ID, "12345678901234567890123", "-"},
+};
+
+// Разбор text парсером kind, запись результата в out. Возвращает 0 или
+// -1, как парсер, и 1, если разобранная структура нарушает свои пределы.
+static int parse_run(int kind, const char* text, char* out, size_t size) {
+    int result = -1;
+    int broken = 0;
+    out[0] = '\0';
+
+    switch (kind) {
+    case PARSE_CSQ: {
+        fiveg_csq_t csq;
+        result = fiveg_parse_csq(text, &csq);
+        if (result == 0) {
+            snprintf(out, size, "%d,%d", csq.rssi, csq.ber);
+        }
+        break;
+    }
+    case PARSE_COPS: {
+        fiveg_cops_t cops;
+        result = fiveg_parse_cops(text, &cops);
+        if (result == 0) {
+            broken = strnlen(cops.oper, sizeof(cops.oper)) == sizeof(cops.oper);
+            snprintf(out, size, "%d,%d,%.*s,%d", cops.mode, cops.format, (int)sizeof(cops.oper), cops.oper,
+                     cops.act);
+        }
+        break;
+    }
+    case PARSE_CGACT: {
+        fiveg_cgact_t cgact;
+        result = fiveg_parse_cgact(text, &cgact);
+        if (result == 0) {
+            broken = cgact.count < 0 || cgact.count > FIVEG_MAX_CONTEXTS;
+            int len = snprintf(out, size, "%d:", cgact.count);
+            for (int i = 0; i < cgact.count && !broken && (size_t)len < size; i++) {
+                len += snprintf(out + len, size - len, "%d,%d;", cgact.contexts[i].cid, cgact.contexts[i].state);
+            }
+        }
+        break;
+    }
+    case PARSE_CIFSR: {
+        fiveg_cifsr_t cifsr;
+        result = fiveg_parse_cifsr(text, &cifsr);
+        if (result == 0) {
+            size_t len = strnlen(cifsr.address, sizeof(cifsr.address));
+            broken = len == 0 || len == sizeof(cifsr.address) ||
+                     (!cifsr.is_ipv4 && (cifsr.ipv4[0] | cifsr.ipv4[1] | cifsr.ipv4[2] | cifsr.ipv4[3]) != 0);
+            snprintf(out, size, "%.*s %d %u.%u.%u.%u", (int)sizeof(cifsr.address), cifsr.address,
+                     cifsr.is_ipv4 ? 4 : 6, cifsr.ipv4[0], cifsr.ipv4[1], cifsr.ipv4[2], cifsr.ipv4[3]);
+        }
+        break;
+    }
+    case PARSE_CEREG:
+    case PARSE_C5GREG: {
+        fiveg_reg_t reg;
+        result = fiveg_parse_reg(text, kind == PARSE_CEREG ? "+CEREG" : "+C5GREG", &reg);
+        if (result == 0) {
+            broken = reg.tac < -1 || reg.ci < -1;
+            snprintf(out, size, "%d,%d,%s%llx,%s%llx,%d", reg.n, reg.stat, reg.tac < 0 ? "-" : "",
+                     (unsigned long long)(reg.tac < 0 ? -reg.tac : reg.tac), reg.ci < 0 ? "-" : "",
+                     (unsigned long long)(reg.ci < 0 ? -reg.ci : reg.ci), reg.act);
+        }
+        break;
+    }
+    case PARSE_ID: {
+        fiveg_id_t id;
+        result = fiveg_parse_id(text, &id);
+        if (result == 0) {
+            size_t len = strnlen(id.digits, sizeof(id.digits));
+            broken = len < 6 || len == sizeof(id.digits) || strspn(id.digits, "0123456789") != len;
+            snprintf(out, size, "%.*s", (int)sizeof(id.digits), id.digits);
+        }
+        break;
+    }
+    }
+    if (result < 0) {
+        snprintf(out, size, "-");
+    }
+    return broken ? 1 : result;
+}
+
+static unsigned long long parse_rand(unsigned long long* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Случайная правка ответа из корпуса: замена байта символом, значимым
+// для разбора, вставка, обрезка или повтор куска
+static void parse_mutate(std::string* text, unsigned long long* state) {
+    static const char alphabet[] = "0123456789aAfF+-,:\" \r\n.CSQ";
+    int edits = 1 + parse_rand(state) % 4;
+    for (int i = 0; i < edits; i++) {
+        size_t pos = text->empty() ? 0 : parse_rand(state) % (text->size() + 1);
+        char c = parse_rand(state) % 8 == 0 ? (char)(1 + parse_rand(state) % 255)
+                                             : alphabet[parse_rand(state) % (sizeof(alphabet) - 1)];
+        switch (parse_rand(state) % 4) {
+        case 0:
+            if (pos < text->size()) {
+                (*text)[pos] = c;
+            }
+            break;
+        case 1:
+            text->insert(pos, 1, c);
+            break;
+        case 2:
+            text->resize(pos);
+            break;
+        default:
+            if (pos < text->size()) {
+                text->insert(pos, text->substr(pos, parse_rand(state) % 16));
+            }
+            break;
+        }
+    }
+}
+
+// Ответ с заданными значениями: результат разбора должен совпасть и с
+// ними, и с sscanf
+static int parse_reference(unsigned long long* state) {
+    int rssi = (int)(parse_rand(state) % 200000) - 100000;
+    int ber = (int)(parse_rand(state) % 100);
+    char text[160];
+    char out[FIVEG_AT_LINE_MAX];
+    char expect[160];
+    int failures = 0;
+
+    snprintf(text, sizeof(text), "+CSQ: %d,%d", rssi, ber);
+    int scanned_rssi = 0;
+    int scanned_ber = 0;
+    int scanned = sscanf(text, "+CSQ: %d,%d", &scanned_rssi, &scanned_ber);
+    snprintf(expect, sizeof(expect), "%d,%d", scanned_rssi, scanned_ber);
+    if (scanned != 2 || parse_run(PARSE_CSQ, text, out, sizeof(out)) != 0 || strcmp(out, expect) != 0) {
+        fprintf(stderr, "csq: \"%s\" parsed as %s\n", text, out);
+        failures++;
+    }
+
+    char oper[FIVEG_OPERATOR_MAX];
+    size_t oper_len = 1 + parse_rand(state) % (sizeof(oper) - 1);
+    for (size_t i = 0; i < oper_len; i++) {
+        oper[i] = ' ' + 1 + parse_rand(state) % 94;
+        if (oper[i] == '"') {
+            oper[i] = '\'';
+        }
+    }
+    oper[oper_len] = '\0';
+    int mode = parse_rand(state) % 5;
+    int act = parse_rand(state) % 14;
+    snprintf(text, sizeof(text), "+COPS: %d,0,\"%s\",%d", mode, oper, act);
+    int scanned_mode = 0;
+    int scanned_format = 0;
+    int scanned_act = 0;
+    char scanned_oper[FIVEG_OPERATOR_MAX] = "";
+    scanned = sscanf(text, "+COPS: %d,%d,\"%63[^\"]\",%d", &scanned_mode, &scanned_format, scanned_oper, &scanned_act);
+    snprintf(expect, sizeof(expect), "%d,%d,%s,%d", scanned_mode, scanned_format, scanned_oper, scanned_act);
+    if (scanned != 4 || parse_run(PARSE_COPS, text, out, sizeof(out)) != 0 || strcmp(out, expect) != 0) {
+        fprintf(stderr, "cops: \"%s\" parsed as %s\n", text, out);
+        failures++;
+    }
+
+    unsigned int tac = parse_rand(state) & 0xffff;
+    unsigned int ci = parse_rand(state) & 0xfffffff;
+    snprintf(text, sizeof(text), "+CEREG: 2,1,\"%04X\",\"%08X\",7", tac, ci);
+    snprintf(expect, sizeof(expect), "2,1,%x,%x,7", tac, ci);
+    if (parse_run(PARSE_CEREG, text, out, sizeof(out)) || strcmp(out, expect) != 0) {
+        fprintf(stderr, "cereg: \"%s\" parsed as %s\n", text, out);
+        failures++;
+    }
+    return failures;
+}
+
+static long long parse_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static volatile int parse_sink;
+
+// Время разбора одной строки таблицей 5g_parse.h и прежним sscanf
+static void parse_bench(void) {
+    static const char csq[] = "+CSQ: 21,99";
+    static const char cops[] = "+COPS: 0,0,\"Operator Name\",13";
+    static const char cereg[] = "+CEREG: 2,1,\"1A2B\",\"01ABCDEF\",7";
+    const int rounds = MODEMSIM_PARSE_ROUNDS;
+    long long start;
+    long long table_ns[3];
+    long long sscanf_ns[3];
+
+    start = parse_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        fiveg_csq_t out;
+        parse_sink = fiveg_parse_csq(csq, &out) + out.rssi;
+    }
+    table_ns[0] = parse_now_ns() - start;
+    start = parse_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        int rssi;
+        int ber;
+        parse_sink = sscanf(csq, "+CSQ: %d,%d", &rssi, &ber) + rssi;
+    }
+    sscanf_ns[0] = parse_now_ns() - start;
+
+    start = parse_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        fiveg_cops_t out;
+        parse_sink = fiveg_parse_cops(cops, &out) + out.oper[0];
+    }
+    table_ns[1] = parse_now_ns() - start;
+    start = parse_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        int mode;
+        int format;
+        int act;
+        char oper[FIVEG_OPERATOR_MAX];
+        parse_sink = sscanf(cops, "+COPS: %d,%d,\"%63[^\"]\",%d", &mode, &format, oper, &act) + oper[0];
+    }
+    sscanf_ns[1] = parse_now_ns() - start;
+
+    start = parse_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        fiveg_reg_t out;
+        parse_sink = fiveg_parse_reg(cereg, "+CEREG", &out) + (int)out.ci;
+    }
+    table_ns[2] = parse_now_ns() - start;
+    start = parse_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        int n;
+        int stat;
+        unsigned int tac;
+        unsigned int ci;
+        int act;
+        parse_sink = sscanf(cereg, "+CEREG: %d,%d,\"%x\",\"%x\",%d", &n, &stat, &tac, &ci, &act) + (int)ci;
+    }
+    sscanf_ns[2] = parse_now_ns() - start;
+
+    static const char* const names[] = {"csq", "cops", "cereg"};
+    for (int i = 0; i < 3; i++) {
+        printf("parse %s: table %.1f ns sscanf %.1f ns\n", names[i], (double)table_ns[i] / rounds,
+               (double)sscanf_ns[i] / rounds);
+    }
+}
+
+// Самопроверка разборщиков: корпус с ожидаемыми результатами, count
+// случайных правок корпуса через все разборщики (без падений и выхода
+// за пределы структур, удобно запускать под ASan), сверка с sscanf на
+// сгенерированных ответах и замер против sscanf
+static int run_parse_check(unsigned long long count, unsigned long long seed) {
+    char out[FIVEG_AT_LINE_MAX];
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(parse_corpus) / sizeof(parse_corpus[0]); i++) {
+        const struct parse_case* c = &parse_corpus[i];
+        if (parse_run(c->kind, c->text, out, sizeof(out)) > 0 || strcmp(out, c->expect) != 0) {
+            fprintf(stderr, "%s: \"%s\" parsed as \"%s\", expected \"%s\"\n", parse_names[c->kind], c->text, out,
+                    c->expect);
+            failures++;
+        }
+    }
+    printf("parse corpus: %zu responses, %d failures\n", sizeof(parse_corpus) / sizeof(parse_corpus[0]), failures);
+
+    unsigned long long state = seed ? seed : 1;
+    unsigned long long parsed = 0;
+    int fuzz_failures = 0;
+    for (unsigned long long n = 0; n < count && !g_stop; n++) {
+        std::string text = parse_corpus[parse_rand(&state) % (sizeof(parse_corpus) / sizeof(parse_corpus[0]))].text;
+        parse_mutate(&text, &state);
+        // Копия точной длины: чтение за концом строки видно под ASan
+        char* copy = (char*)malloc(text.size() + 1);
+        memcpy(copy, text.c_str(), text.size() + 1);
+        for (int kind = 0; kind < PARSE_KINDS; kind++) {
+            int result = parse_run(kind, copy, out, sizeof(out));
+            if (result > 0) {
+                if (fuzz_failures++ < 10) {
+                    fprintf(stderr, "%s: \"%s\" gave out-of-range %s\n", parse_names[kind], copy, out);
+                }
+            } else if (result == 0) {
+                parsed++;
+            }
+        }
+        free(copy);
+        fuzz_failures += parse_reference(&state);
+    }
+    printf("parse fuzz: %llu inputs, %llu parsed, seed %llu, %d failures\n", count, parsed, seed, fuzz_failures);
+
+    parse_bench();
+    return failures || fuzz_failures ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    struct sim_modem modem;
+    const char* link = NULL;
+    const char* script = NULL;
+    bool echo = true;
+    bool bench = false;
+    unsigned int calls = MODEMSIM_BENCH_CALLS;
+    bool calls_set = false;
+    bool parse_check = false;
+    unsigned long long seed = 1;
+    int cmux = -1;
+    const char* port = NULL;
+    int seconds = MODEMSIM_PORT_SECONDS;
+    const char* telemetry_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:s:Ebn:c:w:t:T:pS:h")) != -1) {
+        switch (opt) {
+        case 'l':
+            link = optarg;
+            break;
+        case 's':
+            script = optarg;
+            break;
+        case 'E':
+            echo = false;
+            break;
+        case 'b':
+            bench = true;
+            break;
+        case 'n':
+            calls = strtoul(optarg, NULL, 0);
+            calls_set = true;
+            break;
+        case 'c':
+            cmux = atoi(optarg);
+            break;
+        case 'w':
+            port = optarg;
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'T':
+            telemetry_path = optarg;
+            break;
+        case 'p':
+            parse_check = true;
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (parse_check) {
+        return run_parse_check(calls_set ? calls : MODEMSIM_FUZZ_COUNT, seed);
+    }
+    if (port) {
+        return run_port(port, seconds);
+    }
+
+    int slave;
+    if (open_modem(&modem, &slave, echo) < 0 || (script && load_script(&modem, script) < 0)) {
+        return 1;
+    }
+
+    if (bench) {
+        telemetry_t* telemetry = NULL;
+        if (telemetry_path) {
+            int status;
+            telemetry = telemetry_attach(telemetry_path, &status);
+            if (!telemetry) {
+                fprintf(stderr, "%s: %s\n", telemetry_path, strerror(-status));
+                return 1;
+            }
+        }
+        int result = run_bench(&modem, slave, calls, cmux, telemetry);
+        telemetry_close(telemetry);
+        return result;
+    }
+
+    const char* path = ttyname(slave);
+    printf("Modem simulator on %s\n", path);
+    if (link) {
+        unlink(link);
+        if (symlink(path, link) < 0) {
+            perror(link);
+            return 1;
+        }
+        printf("Linked as %s\n", link);
+    }
+    fflush(stdout);
+
+    // Слейв остаётся открытым: иначе после закрытия последним клиентом
+    // мастер получает EIO до следующего открытия
+    run_modem(&modem, NULL);
+
+    if (link) {
+        unlink(link);
+    }
+    printf("Total: %llu commands answered\n", modem.commands);
+    return 0;
+}
@@ -0,0 +1,363 @@
+#ifndef _QMI_CODEC_H_
+#define _QMI_CODEC_H_
+
+// Кодек сообщений QMI (QMUX + TLV) для сервисов CTL, WDS, DMS и NAS.
+// Без выделения памяти и без зависимостей, кроме memcpy: один и тот же
+// файл собирается в модуле ядра (fiveg.c) и в программах пространства
+// пользователя, поэтому кодек проверяется без модема, на заглушке QMI
+// (qmistub).
+//
+// Формат на линии (/dev/cdc-wdm0, одно сообщение на read/write), все
+// числа little-endian:
+//   QMUX: 0x01, u16 длина (без первого байта), u8 флаги, u8 сервис, u8 клиент
+//   SDU:  u8 флаги, u8 (CTL) или u16 (остальные) номер транзакции
+//   сообщение: u16 id, u16 длина TLV, затем TLV: u8 тип, u16 длина, данные
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/string.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef int8_t s8;
+typedef int16_t s16;
+#endif
+
+#define QMI_MAX_MESSAGE 4096
+#define QMI_QMUX_HEADER 6
+#define QMI_TLV_HEADER 3
+
+// Сервисы
+#define QMI_SERVICE_CTL 0x00
+#define QMI_SERVICE_WDS 0x01
+#define QMI_SERVICE_DMS 0x02
+#define QMI_SERVICE_NAS 0x03
+#define QMI_SERVICE_COUNT 4
+
+// Флаги SDU
+#define QMI_CTL_FLAG_RESPONSE 0x01
+#define QMI_CTL_FLAG_INDICATION 0x02
+#define QMI_FLAG_RESPONSE 0x02
+#define QMI_FLAG_INDICATION 0x04
+
+// Сообщения
+#define QMI_CTL_GET_CLIENT_ID 0x0022
+#define QMI_CTL_RELEASE_CLIENT_ID 0x0023
+#define QMI_WDS_GET_PACKET_SERVICE_STATUS 0x0022
+#define QMI_DMS_GET_IDS 0x0025
+#define QMI_DMS_GET_OPERATING_MODE 0x002D
+#define QMI_DMS_SET_OPERATING_MODE 0x002E
+#define QMI_DMS_UIM_GET_ICCID 0x003C
+#define QMI_DMS_UIM_GET_IMSI 0x0043
+#define QMI_NAS_GET_SIGNAL_STRENGTH 0x0020
+#define QMI_NAS_GET_SERVING_SYSTEM 0x0024
+
+// Общие TLV
+#define QMI_TLV_RESULT 0x02
+
+// Режимы DMS Set Operating Mode
+#define QMI_DMS_MODE_ONLINE 0x00
+#define QMI_DMS_MODE_LOW_POWER 0x01
+
+// Ошибки кодека
+#define QMI_ERR_SHORT -1          // буфер мал или сообщение обрезано
+#define QMI_ERR_FORMAT -2         // сообщение не QMUX или длины не сходятся
+#define QMI_ERR_MISSING -3        // нет обязательного TLV
+#define QMI_ERR_RESULT -4         // модем ответил ошибкой (код в error)
+
+struct qmi_tlv {
+    u8 type;
+    u16 len;
+    const void *value;
+};
+
+// Разобранное сообщение; tlvs указывает в исходный буфер
+struct qmi_message {
+    u8 service;
+    u8 client;
+    u8 flags;
+    u16 tid;
+    u16 id;
+    const u8 *tlvs;
+    u16 tlvs_len;
+};
+
+static inline void qmi_put_le16(u8 *p, u16 v) {
+    p[0] = (u8)v;
+    p[1] = (u8)(v >> 8);
+}
+
+static inline u16 qmi_get_le16(const u8 *p) {
+    return (u16)(p[0] | (p[1] << 8));
+}
+
+// Запрос service/id от клиента client с TLV tlvs[count]; возвращает
+// длину сообщения или QMI_ERR_SHORT
+static inline int qmi_encode_request(u8 *buf, size_t cap, u8 service, u8 client, u16 tid, u16 id,
+                                     const struct qmi_tlv *tlvs, int count) {
+    size_t sdu = service == QMI_SERVICE_CTL ? 2 : 3;
+    size_t len = QMI_QMUX_HEADER + sdu + 4;
+    size_t tlvs_len = 0;
+    u8 *p;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        tlvs_len += QMI_TLV_HEADER + tlvs[i].len;
+    }
+    if (len + tlvs_len > cap || len + tlvs_len - 1 > 0xFFFF) {
+        return QMI_ERR_SHORT;
+    }
+
+    p = buf;
+    *p++ = 0x01;
+    qmi_put_le16(p, (u16)(len + tlvs_len - 1));
+    p += 2;
+    *p++ = 0x00;
+    *p++ = service;
+    *p++ = service == QMI_SERVICE_CTL ? 0 : client;
+    *p++ = 0x00;
+    if (service == QMI_SERVICE_CTL) {
+        *p++ = (u8)tid;
+    } else {
+        qmi_put_le16(p, tid);
+        p += 2;
+    }
+    qmi_put_le16(p, id);
+    qmi_put_le16(p + 2, (u16)tlvs_len);
+    p += 4;
+    for (i = 0; i < count; i++) {
+        *p++ = tlvs[i].type;
+        qmi_put_le16(p, tlvs[i].len);
+        p += 2;
+        if (tlvs[i].len) {
+            memcpy(p, tlvs[i].value, tlvs[i].len);
+        }
+        p += tlvs[i].len;
+    }
+    return (int)(len + tlvs_len);
+}
+
+// Разбор сообщения целиком: заголовки и границы всех TLV
+static inline int qmi_decode(const u8 *buf, size_t len, struct qmi_message *msg) {
+    size_t sdu;
+    size_t off;
+    const u8 *p;
+
+    if (len < QMI_QMUX_HEADER + 2 + 4 || buf[0] != 0x01) {
+        return QMI_ERR_FORMAT;
+    }
+    if ((size_t)qmi_get_le16(buf + 1) + 1 != len) {
+        return QMI_ERR_SHORT;
+    }
+    msg->service = buf[4];
+    msg->client = buf[5];
+    sdu = msg->service == QMI_SERVICE_CTL ? 2 : 3;
+    if (len < QMI_QMUX_HEADER + sdu + 4) {
+        return QMI_ERR_FORMAT;
+    }
+    p = buf + QMI_QMUX_HEADER;
+    msg->flags = p[0];
+    msg->tid = sdu == 2 ? p[1] : qmi_get_le16(p + 1);
+    p += sdu;
+    msg->id = qmi_get_le16(p);
+    msg->tlvs_len = qmi_get_le16(p + 2);
+    msg->tlvs = p + 4;
+    if ((size_t)(msg->tlvs - buf) + msg->tlvs_len != len) {
+        return QMI_ERR_FORMAT;
+    }
+    for (off = 0; off < msg->tlvs_len;) {
+        if (msg->tlvs_len - off < QMI_TLV_HEADER ||
+            msg->tlvs_len - off - QMI_TLV_HEADER < qmi_get_le16(msg->tlvs + off + 1)) {
+            return QMI_ERR_FORMAT;
+        }
+        off += QMI_TLV_HEADER + qmi_get_le16(msg->tlvs + off + 1);
+    }
+    return 0;
+}
+
+static inline int qmi_is_response(const struct qmi_message *msg) {
+    return msg->service == QMI_SERVICE_CTL ? (msg->flags & QMI_CTL_FLAG_RESPONSE) != 0
+                                           : (msg->flags & QMI_FLAG_RESPONSE) != 0;
+}
+
+static inline int qmi_is_indication(const struct qmi_message *msg) {
+    return msg->service == QMI_SERVICE_CTL ? (msg->flags & QMI_CTL_FLAG_INDICATION) != 0
+                                           : (msg->flags & QMI_FLAG_INDICATION) != 0;
+}
+
+// TLV type или NULL; границы проверены в qmi_decode
+static inline const u8 *qmi_find_tlv(const struct qmi_message *msg, u8 type, u16 *len) {
+    size_t off = 0;
+
+    while (off < msg->tlvs_len) {
+        u16 tlv_len = qmi_get_le16(msg->tlvs + off + 1);
+        if (msg->tlvs[off] == type) {
+            *len = tlv_len;
+            return msg->tlvs + off + QMI_TLV_HEADER;
+        }
+        off += QMI_TLV_HEADER + tlv_len;
+    }
+    return NULL;
+}
+
+// Результат ответа (TLV 0x02): 0 - успех, QMI_ERR_RESULT и код ошибки
+// QMI в error - отказ
+static inline int qmi_result(const struct qmi_message *msg, u16 *error) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, QMI_TLV_RESULT, &len);
+
+    *error = 0;
+    if (!v || len < 4) {
+        return QMI_ERR_MISSING;
+    }
+    *error = qmi_get_le16(v + 2);
+    return qmi_get_le16(v) == 0 ? 0 : QMI_ERR_RESULT;
+}
+
+// Строка из TLV в out с завершающим нулём
+static inline int qmi_tlv_string(const struct qmi_message *msg, u8 type, char *out, size_t out_len) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, type, &len);
+
+    if (!v || out_len == 0) {
+        return QMI_ERR_MISSING;
+    }
+    if (len > out_len - 1) {
+        len = (u16)(out_len - 1);
+    }
+    memcpy(out, v, len);
+    out[len] = '\0';
+    return 0;
+}
+
+// --- CTL ---
+
+static inline int qmi_encode_ctl_get_client_id(u8 *buf, size_t cap, u8 tid, u8 service) {
+    struct qmi_tlv tlv = {0x01, 1, &service};
+    return qmi_encode_request(buf, cap, QMI_SERVICE_CTL, 0, tid, QMI_CTL_GET_CLIENT_ID, &tlv, 1);
+}
+
+static inline int qmi_decode_ctl_get_client_id(const struct qmi_message *msg, u8 *service, u8 *client) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, 0x01, &len);
+
+    if (!v || len < 2) {
+        return QMI_ERR_MISSING;
+    }
+    *service = v[0];
+    *client = v[1];
+    return 0;
+}
+
+static inline int qmi_encode_ctl_release_client_id(u8 *buf, size_t cap, u8 tid, u8 service, u8 client) {
+    u8 value[2] = {service, client};
+    struct qmi_tlv tlv = {0x01, 2, value};
+    return qmi_encode_request(buf, cap, QMI_SERVICE_CTL, 0, tid, QMI_CTL_RELEASE_CLIENT_ID, &tlv, 1);
+}
+
+// --- DMS ---
+
+static inline int qmi_encode_dms_set_operating_mode(u8 *buf, size_t cap, u8 client, u16 tid, u8 mode) {
+    struct qmi_tlv tlv = {0x01, 1, &mode};
+    return qmi_encode_request(buf, cap, QMI_SERVICE_DMS, client, tid, QMI_DMS_SET_OPERATING_MODE, &tlv, 1);
+}
+
+static inline int qmi_decode_dms_operating_mode(const struct qmi_message *msg, u8 *mode) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, 0x01, &len);
+
+    if (!v || len < 1) {
+        return QMI_ERR_MISSING;
+    }
+    *mode = v[0];
+    return 0;
+}
+
+// DMS Get IDs: ESN (0x10), IMEI (0x11), MEID (0x12); нужен только IMEI
+static inline int qmi_decode_dms_get_ids(const struct qmi_message *msg, char *imei, size_t imei_len) {
+    return qmi_tlv_string(msg, 0x11, imei, imei_len);
+}
+
+// --- NAS ---
+
+#define QMI_NAS_RADIO_NONE 0x00
+#define QMI_NAS_RADIO_GSM 0x04
+#define QMI_NAS_RADIO_UMTS 0x05
+#define QMI_NAS_RADIO_LTE 0x08
+#define QMI_NAS_RADIO_NR5G 0x0C
+
+struct qmi_nas_signal {
+    s8 dbm;              // уровень сигнала текущей сети
+    u8 radio;            // QMI_NAS_RADIO_*
+};
+
+static inline int qmi_decode_nas_signal_strength(const struct qmi_message *msg, struct qmi_nas_signal *signal) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, 0x01, &len);
+
+    if (!v || len < 2) {
+        return QMI_ERR_MISSING;
+    }
+    signal->dbm = (s8)v[0];
+    signal->radio = v[1];
+    return 0;
+}
+
+struct qmi_nas_serving_system {
+    u8 registration;     // 1 - зарегистрирован
+    u8 cs_attached;
+    u8 ps_attached;
+    u8 network;          // 1 - 3GPP2, 2 - 3GPP
+    u8 radio;            // первый интерфейс из списка, QMI_NAS_RADIO_*
+};
+
+static inline int qmi_decode_nas_serving_system(const struct qmi_message *msg, struct qmi_nas_serving_system *ss) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, 0x01, &len);
+
+    if (!v || len < 5) {
+        return QMI_ERR_MISSING;
+    }
+    ss->registration = v[0];
+    ss->cs_attached = v[1];
+    ss->ps_attached = v[2];
+    ss->network = v[3];
+    ss->radio = v[4] > 0 && len >= 6 ? v[5] : QMI_NAS_RADIO_NONE;
+    return 0;
+}
+
+static inline const char *qmi_nas_radio_name(u8 radio) {
+    switch (radio) {
+    case QMI_NAS_RADIO_GSM:
+        return "gsm";
+    case QMI_NAS_RADIO_UMTS:
+        return "umts";
+    case QMI_NAS_RADIO_LTE:
+        return "lte";
+    case QMI_NAS_RADIO_NR5G:
+        return "5gnr";
+    default:
+        return "none";
+    }
+}
+
+// --- WDS ---
+
+#define QMI_WDS_DISCONNECTED 0x01
+#define QMI_WDS_CONNECTED 0x02
+
+static inline int qmi_decode_wds_packet_service_status(const struct qmi_message *msg, u8 *status) {
+    u16 len;
+    const u8 *v = qmi_find_tlv(msg, 0x01, &len);
+
+    if (!v || len < 1) {
+        return QMI_ERR_MISSING;
+    }
+    *status = v[0];
+    return 0;
+}
+
+#endif // _QMI_CODEC_H_
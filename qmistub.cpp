@@ -0,0 +1,751 @@
+// Заглушка модема QMI для проверки qmi_codec.h без /dev/cdc-wdm0. На
+// другом конце socketpair(SOCK_SEQPACKET) - одно сообщение на read/write,
+// как у cdc-wdm - поток "модема" разбирает запросы тем же кодеком и
+// отвечает по своему состоянию, а клиент повторяет обмен fiveg.c:
+// выделение клиентов CTL, все команды таблицы fiveg_qmi_handlers,
+// освобождение клиентов. Перед каждым ответом модем шлёт индикацию,
+// которую клиент должен пропустить, а часть ответов - с ошибкой QMI.
+//
+// Кроме обмена проверяются:
+//  - обрезанные сообщения: каждый префикс каждого ответа отвергается;
+//  - кодер: запрос не помещается в буфер - QMI_ERR_SHORT, байты за
+//    границей буфера не тронуты;
+//  - испорченные TLV: случайные правки ответов (байты, длины TLV, обрезка
+//    и дописывание с исправленными длинами заголовков, TLV короче или
+//    длиннее при верных длинах) сверяются с отдельной проверкой формата,
+//    и на каждом принятом сообщении вызываются все функции разбора. Каждое сообщение лежит в отдельном
+//    буфере ровно своей длины: имеет смысл собирать с -fsanitize=address.
+//
+// Пример: qmistub                       (1000 обменов, 1000000 правок)
+//         qmistub -r 100000 -n 0 -S 42
+//
+// Выводится строка на проверку; при любой ошибке код выхода 1.
+
+// QMI modem stub for checking qmi_codec.h without /dev/cdc-wdm0. On the
+// far end of a socketpair(SOCK_SEQPACKET) - one message per read/write,
+// like cdc-wdm - a "modem" thread decodes requests with the same codec and
+// answers from its own state, while the client repeats the fiveg.c
+// exchange: CTL client allocation, every command of the
+// fiveg_qmi_handlers table, client release. Before each response the
+// modem sends an indication the client has to skip, and some responses
+// carry a QMI error.
+//
+// Besides the exchange it checks:
+//  - truncated messages: every prefix of every response is rejected;
+//  - the encoder: a request that does not fit returns QMI_ERR_SHORT and
+//    leaves the bytes past the buffer alone;
+//  - corrupt TLVs: random edits of responses (bytes, TLV lengths,
+//    truncation and extension with fixed-up header lengths, a TLV shrunk
+//    or grown with every length kept consistent) are checked against a
+//    separate format check, and every accepted message goes through all
+//    the decode helpers. Each message sits in its own buffer of exactly
+//    its length: worth building with -fsanitize=address.
+//
+// Example: qmistub                       (1000 exchanges, 1000000 edits)
+//          qmistub -r 100000 -n 0 -S 42
+//
+// Prints one line per check; any failure makes the exit status 1.
+
+#include "qmi_codec.h"
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define QMISTUB_ROUNDS 1000
+#define QMISTUB_EDITS 1000000
+#define QMISTUB_ERROR_EVERY 7      // каждый такой ответ модема не CTL - с ошибкой QMI
+#define QMISTUB_ERROR_CODE 0x0030  // QMI_ERR_NOT_SUPPORTED
+
+static int failures;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-r rounds] [-n edits] [-S seed]\n"
+            "  -r  exchanges with the stub modem (default %d)\n"
+            "  -n  random edits of responses (default %d)\n"
+            "  -S  random seed\n",
+            prog, QMISTUB_ROUNDS, QMISTUB_EDITS);
+}
+
+static void fail(const char* what, const char* detail) {
+    if (failures++ < 10) {
+        printf("FAIL %s: %s\n", what, detail);
+    }
+}
+
+static uint32_t stub_rand_state = 1;
+
+static uint32_t stub_rand(void) {
+    uint32_t x = stub_rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    stub_rand_state = x;
+    return x;
+}
+
+// --- Модем ---
+
+// Значения, которые модем возвращает; клиент сверяет с ними разобранное
+static const char stub_imei[] = "356938035643809";
+static const char stub_iccid[] = "89014103211118510720";
+static const char stub_imsi[] = "310150123456789";
+static const s8 stub_dbm = -71;
+static const u8 stub_radio = QMI_NAS_RADIO_NR5G;
+static const u8 stub_packet_status = QMI_WDS_CONNECTED;
+
+struct stub_modem {
+    int fd;
+    u8 mode;
+    u8 next_client;
+    bool client[QMI_SERVICE_COUNT][256];
+    unsigned int responses;
+    unsigned int bad_requests;
+    std::vector<std::vector<u8>> sent;     // все ответы - материал для правок
+};
+
+// Ответ на сообщение: запрос с флагом ответа (и флагом QMUX "от сервиса")
+static int stub_encode(u8* buf, size_t cap, const struct qmi_message* request, u8 flags, const struct qmi_tlv* tlvs,
+                       int count) {
+    int len = qmi_encode_request(buf, cap, request->service, request->client, request->tid, request->id, tlvs, count);
+    if (len > 0) {
+        buf[3] = 0x80;
+        buf[QMI_QMUX_HEADER] = flags;
+    }
+    return len;
+}
+
+static void stub_send(struct stub_modem* modem, const u8* buf, int len) {
+    if (len <= 0 || write(modem->fd, buf, len) != len) {
+        fail("stub", "write failed");
+        return;
+    }
+    modem->sent.push_back(std::vector<u8>(buf, buf + len));
+}
+
+// Запрос, которого клиент fiveg.c не пошлёт: ответ с ошибкой, чтобы
+// клиент не ждал, и отметка для итога
+static void stub_reject(struct stub_modem* modem, u8* result) {
+    modem->bad_requests++;
+    qmi_put_le16(result, 1);
+    qmi_put_le16(result + 2, 0x0001);  // QMI_ERR_MALFORMED_MSG
+}
+
+static void stub_handle(struct stub_modem* modem, const u8* buf, size_t len) {
+    struct qmi_message req;
+    struct qmi_tlv tlvs[4];
+    u8 result[4] = {0, 0, 0, 0};
+    u8 value[8];
+    u8 out[QMI_MAX_MESSAGE];
+    int count = 0;
+    bool ctl;
+
+    if (qmi_decode(buf, len, &req) < 0 || qmi_is_response(&req)) {
+        modem->bad_requests++;
+        return;
+    }
+    ctl = req.service == QMI_SERVICE_CTL;
+
+    // Индикация того же сервиса с тем же номером транзакции: клиент
+    // должен отличить её от ответа по флагам
+    struct qmi_tlv indication = {0x10, 1, &stub_radio};
+    stub_send(modem, out, stub_encode(out, sizeof(out), &req, ctl ? QMI_CTL_FLAG_INDICATION : QMI_FLAG_INDICATION,
+                                      &indication, 1));
+
+    tlvs[count++] = {QMI_TLV_RESULT, 4, result};
+    // Ошибки - только у сервисов: клиенты CTL должны сходиться с модемом
+    if (++modem->responses % QMISTUB_ERROR_EVERY == 0 && !ctl) {
+        qmi_put_le16(result, 1);
+        qmi_put_le16(result + 2, QMISTUB_ERROR_CODE);
+    } else if (!ctl && (req.service >= QMI_SERVICE_COUNT || !modem->client[req.service][req.client])) {
+        qmi_put_le16(result, 1);
+        qmi_put_le16(result + 2, 0x0022);  // QMI_ERR_INVALID_CLIENT_ID
+    } else {
+        u16 tlv_len;
+        const u8* v;
+        switch (req.service << 16 | req.id) {
+        case QMI_SERVICE_CTL << 16 | QMI_CTL_GET_CLIENT_ID:
+            v = qmi_find_tlv(&req, 0x01, &tlv_len);
+            if (!v || tlv_len != 1 || v[0] >= QMI_SERVICE_COUNT) {
+                stub_reject(modem, result);
+                break;
+            }
+            value[0] = v[0];
+            value[1] = ++modem->next_client ? modem->next_client : ++modem->next_client;
+            modem->client[value[0]][value[1]] = true;
+            tlvs[count++] = {0x01, 2, value};
+            break;
+        case QMI_SERVICE_CTL << 16 | QMI_CTL_RELEASE_CLIENT_ID:
+            v = qmi_find_tlv(&req, 0x01, &tlv_len);
+            if (!v || tlv_len != 2 || v[0] >= QMI_SERVICE_COUNT || !modem->client[v[0]][v[1]]) {
+                stub_reject(modem, result);
+                break;
+            }
+            modem->client[v[0]][v[1]] = false;
+            value[0] = v[0];
+            value[1] = v[1];
+            tlvs[count++] = {0x01, 2, value};
+            break;
+        case QMI_SERVICE_DMS << 16 | QMI_DMS_SET_OPERATING_MODE:
+            v = qmi_find_tlv(&req, 0x01, &tlv_len);
+            if (!v || tlv_len != 1) {
+                stub_reject(modem, result);
+                break;
+            }
+            modem->mode = v[0];
+            break;
+        case QMI_SERVICE_DMS << 16 | QMI_DMS_GET_OPERATING_MODE:
+            tlvs[count++] = {0x01, 1, &modem->mode};
+            break;
+        case QMI_SERVICE_DMS << 16 | QMI_DMS_GET_IDS:
+            tlvs[count++] = {0x10, 1, "0"};
+            tlvs[count++] = {0x11, (u16)strlen(stub_imei), stub_imei};
+            break;
+        case QMI_SERVICE_DMS << 16 | QMI_DMS_UIM_GET_ICCID:
+            tlvs[count++] = {0x01, (u16)strlen(stub_iccid), stub_iccid};
+            break;
+        case QMI_SERVICE_DMS << 16 | QMI_DMS_UIM_GET_IMSI:
+            tlvs[count++] = {0x01, (u16)strlen(stub_imsi), stub_imsi};
+            break;
+        case QMI_SERVICE_NAS << 16 | QMI_NAS_GET_SIGNAL_STRENGTH:
+            value[0] = (u8)stub_dbm;
+            value[1] = stub_radio;
+            tlvs[count++] = {0x01, 2, value};
+            break;
+        case QMI_SERVICE_NAS << 16 | QMI_NAS_GET_SERVING_SYSTEM:
+            value[0] = 1;
+            value[1] = 0;
+            value[2] = 1;
+            value[3] = 2;
+            value[4] = 1;
+            value[5] = stub_radio;
+            tlvs[count++] = {0x01, 6, value};
+            break;
+        case QMI_SERVICE_WDS << 16 | QMI_WDS_GET_PACKET_SERVICE_STATUS:
+            tlvs[count++] = {0x01, 1, &stub_packet_status};
+            break;
+        default:
+            qmi_put_le16(result, 1);
+            qmi_put_le16(result + 2, 0x0047);  // QMI_ERR_INVALID_QMI_CMD
+            break;
+        }
+    }
+    stub_send(modem, out, stub_encode(out, sizeof(out), &req, ctl ? QMI_CTL_FLAG_RESPONSE : QMI_FLAG_RESPONSE, tlvs,
+                                      count));
+}
+
+static void stub_run(struct stub_modem* modem) {
+    u8 buf[QMI_MAX_MESSAGE];
+    ssize_t len;
+
+    while ((len = read(modem->fd, buf, sizeof(buf))) > 0) {
+        stub_handle(modem, buf, len);
+    }
+}
+
+// --- Клиент ---
+
+struct stub_client {
+    int fd;
+    u16 next_tid;
+    u8 client[QMI_SERVICE_COUNT];
+    bool has_client[QMI_SERVICE_COUNT];
+    u8 response[QMI_MAX_MESSAGE];
+    size_t response_len;
+    unsigned int indications;
+};
+
+// Запрос и ожидание ответа с тем же сервисом и транзакцией; индикации
+// пропускаются, как в fiveg_qmi_dispatch
+static int client_exchange(struct stub_client* client, const u8* request, int len, struct qmi_message* msg) {
+    struct qmi_message sent;
+    ssize_t got;
+
+    if (len <= 0 || qmi_decode(request, len, &sent) < 0) {
+        fail("client", "encoded request does not decode");
+        return -1;
+    }
+    if (write(client->fd, request, len) != len) {
+        fail("client", "write failed");
+        return -1;
+    }
+    for (;;) {
+        got = read(client->fd, client->response, sizeof(client->response));
+        if (got <= 0) {
+            fail("client", "no response");
+            return -1;
+        }
+        client->response_len = got;
+        if (qmi_decode(client->response, got, msg) < 0) {
+            fail("client", "response does not decode");
+            return -1;
+        }
+        if (qmi_is_indication(msg) && !qmi_is_response(msg)) {
+            client->indications++;
+            continue;
+        }
+        if (!qmi_is_response(msg) || msg->service != sent.service || msg->tid != sent.tid ||
+            (sent.service != QMI_SERVICE_CTL && msg->client != sent.client)) {
+            fail("client", "response does not match the request");
+            return -1;
+        }
+        return 0;
+    }
+}
+
+static u16 client_tid(struct stub_client* client, u8 service) {
+    u16 tid = ++client->next_tid;
+    if (service == QMI_SERVICE_CTL) {
+        tid &= 0xFF;
+    }
+    return tid ? tid : client_tid(client, service);
+}
+
+// Ответ разобран; 1 - модем ответил ошибкой QMI (это не сбой проверки)
+static int client_result(const struct qmi_message* msg) {
+    u16 error;
+    int ret = qmi_result(msg, &error);
+
+    if (ret == QMI_ERR_RESULT) {
+        if (error != QMISTUB_ERROR_CODE) {
+            fail("result", "unexpected QMI error code");
+        }
+        return 1;
+    }
+    if (ret < 0) {
+        fail("result", "no result TLV");
+    }
+    return ret;
+}
+
+static int client_allocate(struct stub_client* client, u8 service) {
+    u8 request[32];
+    struct qmi_message msg;
+    u8 got_service, got_client;
+    int ret;
+
+    if (service == QMI_SERVICE_CTL || client->has_client[service]) {
+        return 0;
+    }
+    ret = client_exchange(client, request,
+                          qmi_encode_ctl_get_client_id(request, sizeof(request),
+                                                       (u8)client_tid(client, QMI_SERVICE_CTL), service),
+                          &msg);
+    if (ret == 0 && (ret = client_result(&msg)) == 0) {
+        if (qmi_decode_ctl_get_client_id(&msg, &got_service, &got_client) < 0 || got_service != service) {
+            fail("ctl get client id", "wrong service in response");
+            return -1;
+        }
+        client->client[service] = got_client;
+        client->has_client[service] = true;
+    }
+    return ret;
+}
+
+static void client_release(struct stub_client* client) {
+    u8 request[32];
+    struct qmi_message msg;
+    u8 got_service, got_client;
+
+    for (int service = 0; service < QMI_SERVICE_COUNT; service++) {
+        if (!client->has_client[service]) {
+            continue;
+        }
+        u8 tid = (u8)client_tid(client, QMI_SERVICE_CTL);
+        int len = qmi_encode_ctl_release_client_id(request, sizeof(request), tid, service, client->client[service]);
+        if (client_exchange(client, request, len, &msg) == 0 && client_result(&msg) == 0 &&
+            (qmi_decode_ctl_get_client_id(&msg, &got_service, &got_client) < 0 || got_service != service ||
+             got_client != client->client[service])) {
+            fail("ctl release client id", "wrong client in response");
+        }
+        client->has_client[service] = false;
+    }
+}
+
+// Одна команда таблицы fiveg_qmi_handlers и сверка разобранного ответа
+static void client_command(struct stub_client* client, int command, u8* mode) {
+    static const struct {
+        u8 service;
+        u16 id;
+    } commands[] = {
+        {QMI_SERVICE_DMS, QMI_DMS_SET_OPERATING_MODE},   // radio on / radio off
+        {QMI_SERVICE_DMS, QMI_DMS_GET_OPERATING_MODE},
+        {QMI_SERVICE_DMS, QMI_DMS_GET_IDS},
+        {QMI_SERVICE_DMS, QMI_DMS_UIM_GET_ICCID},
+        {QMI_SERVICE_DMS, QMI_DMS_UIM_GET_IMSI},
+        {QMI_SERVICE_NAS, QMI_NAS_GET_SIGNAL_STRENGTH},
+        {QMI_SERVICE_NAS, QMI_NAS_GET_SERVING_SYSTEM},
+        {QMI_SERVICE_WDS, QMI_WDS_GET_PACKET_SERVICE_STATUS},
+    };
+    u8 service = commands[command].service;
+    u8 request[64];
+    struct qmi_message msg;
+    char text[64];
+    int len;
+
+    if (client_allocate(client, service) != 0) {
+        return;
+    }
+    u16 tid = client_tid(client, service);
+    if (commands[command].id == QMI_DMS_SET_OPERATING_MODE) {
+        u8 next = *mode == QMI_DMS_MODE_ONLINE ? QMI_DMS_MODE_LOW_POWER : QMI_DMS_MODE_ONLINE;
+        len = qmi_encode_dms_set_operating_mode(request, sizeof(request), client->client[service], tid, next);
+        if (client_exchange(client, request, len, &msg) == 0 && client_result(&msg) == 0) {
+            *mode = next;
+        }
+        return;
+    }
+    len = qmi_encode_request(request, sizeof(request), service, client->client[service], tid, commands[command].id,
+                             NULL, 0);
+    if (client_exchange(client, request, len, &msg) != 0 || client_result(&msg) != 0) {
+        return;
+    }
+
+    switch (commands[command].id) {
+    case QMI_DMS_GET_OPERATING_MODE: {
+        u8 got;
+        if (qmi_decode_dms_operating_mode(&msg, &got) < 0 || got != *mode) {
+            fail("dms get-operating-mode", "mode differs from the last set");
+        }
+        break;
+    }
+    case QMI_DMS_GET_IDS:
+        if (qmi_decode_dms_get_ids(&msg, text, sizeof(text)) < 0 || strcmp(text, stub_imei) != 0) {
+            fail("dms get-ids", "IMEI differs");
+        }
+        break;
+    case QMI_DMS_UIM_GET_ICCID:
+    case QMI_DMS_UIM_GET_IMSI: {
+        const char* expected = commands[command].id == QMI_DMS_UIM_GET_ICCID ? stub_iccid : stub_imsi;
+        if (qmi_tlv_string(&msg, 0x01, text, sizeof(text)) < 0 || strcmp(text, expected) != 0) {
+            fail("dms uim", "ICCID/IMSI differs");
+        }
+        // Строка длиннее буфера обрезается с завершающим нулём
+        if (qmi_tlv_string(&msg, 0x01, text, 5) < 0 || strncmp(text, expected, 4) != 0 || text[4] != '\0') {
+            fail("dms uim", "short buffer not truncated");
+        }
+        break;
+    }
+    case QMI_NAS_GET_SIGNAL_STRENGTH: {
+        struct qmi_nas_signal signal;
+        if (qmi_decode_nas_signal_strength(&msg, &signal) < 0 || signal.dbm != stub_dbm || signal.radio != stub_radio) {
+            fail("nas get-signal-strength", "signal differs");
+        }
+        break;
+    }
+    case QMI_NAS_GET_SERVING_SYSTEM: {
+        struct qmi_nas_serving_system ss;
+        if (qmi_decode_nas_serving_system(&msg, &ss) < 0 || ss.registration != 1 || ss.ps_attached != 1 ||
+            ss.network != 2 || ss.radio != stub_radio) {
+            fail("nas get-serving-system", "serving system differs");
+        }
+        break;
+    }
+    case QMI_WDS_GET_PACKET_SERVICE_STATUS: {
+        u8 status;
+        if (qmi_decode_wds_packet_service_status(&msg, &status) < 0 || status != stub_packet_status) {
+            fail("wds get-packet-service-status", "status differs");
+        }
+        break;
+    }
+    }
+}
+
+static void run_exchange(unsigned int rounds, struct stub_modem* modem) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    modem->fd = fds[1];
+    modem->mode = QMI_DMS_MODE_ONLINE;
+    std::thread stub(stub_run, modem);
+
+    struct stub_client client;
+    memset(&client, 0, sizeof(client));
+    client.fd = fds[0];
+    u8 mode = QMI_DMS_MODE_ONLINE;
+    long long start = now_ns();
+    for (unsigned int round = 0; round < rounds; round++) {
+        for (int command = 0; command < 8; command++) {
+            client_command(&client, command, &mode);
+        }
+        // Время от времени клиенты освобождаются, как при выгрузке fiveg.c
+        if (round % 100 == 99) {
+            client_release(&client);
+        }
+    }
+    client_release(&client);
+    double seconds = (now_ns() - start) / 1e9;
+    shutdown(fds[0], SHUT_WR);
+    stub.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    for (int service = 0; service < QMI_SERVICE_COUNT; service++) {
+        for (int id = 0; id < 256; id++) {
+            if (modem->client[service][id]) {
+                fail("exchange", "client left allocated in the modem");
+            }
+        }
+    }
+    if (modem->bad_requests) {
+        fail("exchange", "modem rejected a request");
+    }
+    if (client.indications != modem->sent.size() / 2) {
+        fail("exchange", "indication not skipped");
+    }
+    printf("exchange: %u rounds, %u responses, %u indications skipped, %.1f us per exchange\n", rounds,
+           modem->responses, client.indications, seconds / modem->responses * 1e6);
+}
+
+// --- Обрезка и кодер ---
+
+static void run_truncation(const struct stub_modem* modem) {
+    struct qmi_message msg;
+    long long prefixes = 0;
+
+    for (const auto& full : modem->sent) {
+        for (size_t len = 0; len < full.size(); len++) {
+            // Копия ровно длины len: чтение за её концом увидит ASan
+            u8* copy = (u8*)malloc(len ? len : 1);
+            memcpy(copy, full.data(), len);
+            if (qmi_decode(copy, len, &msg) == 0) {
+                fail("truncation", "prefix accepted");
+            }
+            free(copy);
+            prefixes++;
+        }
+        if (qmi_decode(full.data(), full.size(), &msg) != 0) {
+            fail("truncation", "full message rejected");
+        }
+    }
+    printf("truncation: %zu messages, %lld prefixes rejected\n", modem->sent.size(), prefixes);
+}
+
+static void run_encoder_bounds(void) {
+    static const char payload[] = "0123456789abcdef0123456789abcdef";
+    struct qmi_tlv tlvs[2] = {{0x01, 20, payload}, {0x10, 12, payload}};
+    u8 buf[128];
+    int checks = 0;
+
+    for (int service = 0; service < QMI_SERVICE_COUNT; service++) {
+        int full = qmi_encode_request(buf, sizeof(buf), service, 1, 1, 0x20, tlvs, 2);
+        for (int cap = 0; cap <= full; cap++) {
+            memset(buf, 0xA5, sizeof(buf));
+            int len = qmi_encode_request(buf, cap, service, 1, 1, 0x20, tlvs, 2);
+            if (cap < full ? len != QMI_ERR_SHORT : len != full) {
+                fail("encoder", "wrong result for the buffer size");
+            }
+            for (size_t i = cap; i < sizeof(buf); i++) {
+                if (buf[i] != 0xA5) {
+                    fail("encoder", "wrote past the buffer");
+                    break;
+                }
+            }
+            checks++;
+        }
+    }
+    printf("encoder: %d buffer sizes, no write past the buffer\n", checks);
+}
+
+// --- Испорченные TLV ---
+
+// Отдельная от qmi_decode проверка формата: та же спецификация, другой код
+static bool reference_valid(const u8* buf, size_t len) {
+    if (len < 3 || buf[0] != 0x01 || (size_t)(buf[1] | buf[2] << 8) + 1 != len || len < 6) {
+        return false;
+    }
+    size_t header = QMI_QMUX_HEADER + (buf[4] == QMI_SERVICE_CTL ? 2 : 3);
+    if (len < header + 4 || header + 4 + (size_t)(buf[header + 2] | buf[header + 3] << 8) != len) {
+        return false;
+    }
+    for (size_t off = header + 4; off < len;) {
+        if (len - off < 3) {
+            return false;
+        }
+        size_t tlv_len = buf[off + 1] | buf[off + 2] << 8;
+        if (off + 3 + tlv_len > len) {
+            return false;
+        }
+        off += 3 + tlv_len;
+    }
+    return true;
+}
+
+static void fix_lengths(std::vector<u8>& msg) {
+    if (msg.size() >= 3) {
+        qmi_put_le16(&msg[1], (u16)(msg.size() - 1));
+    }
+    size_t header = QMI_QMUX_HEADER + (msg.size() > 4 && msg[4] == QMI_SERVICE_CTL ? 2 : 3);
+    if (msg.size() >= header + 4) {
+        qmi_put_le16(&msg[header + 2], (u16)(msg.size() - header - 4));
+    }
+}
+
+// Начало случайного TLV верного сообщения, 0 - TLV нет
+static size_t pick_tlv(const std::vector<u8>& msg, size_t header) {
+    if (msg.size() <= header) {
+        return 0;
+    }
+    size_t off = header;
+    for (int skip = stub_rand() % 4; skip > 0 && off + 3 + qmi_get_le16(&msg[off + 1]) < msg.size(); skip--) {
+        off += 3 + qmi_get_le16(&msg[off + 1]);
+    }
+    return off;
+}
+
+// Все функции разбора на принятом сообщении; результат не важен, важно,
+// что чтение не выходит за буфер
+static void decode_all(const struct qmi_message* msg) {
+    char text[32];
+    u16 error;
+    u8 a, b;
+    struct qmi_nas_signal signal;
+    struct qmi_nas_serving_system ss;
+
+    qmi_is_response(msg);
+    qmi_is_indication(msg);
+    qmi_result(msg, &error);
+    qmi_decode_ctl_get_client_id(msg, &a, &b);
+    qmi_decode_dms_operating_mode(msg, &a);
+    qmi_decode_dms_get_ids(msg, text, sizeof(text));
+    qmi_tlv_string(msg, 0x01, text, sizeof(text));
+    qmi_decode_nas_signal_strength(msg, &signal);
+    qmi_decode_nas_serving_system(msg, &ss);
+    qmi_decode_wds_packet_service_status(msg, &a);
+}
+
+static void run_edits(unsigned int edits, const struct stub_modem* modem) {
+    struct qmi_message msg;
+    unsigned int accepted = 0;
+    unsigned int mismatches = 0;
+
+    for (unsigned int n = 0; n < edits && !modem->sent.empty(); n++) {
+        std::vector<u8> edit = modem->sent[stub_rand() % modem->sent.size()];
+        size_t header = QMI_QMUX_HEADER + (edit[4] == QMI_SERVICE_CTL ? 2 : 3) + 4;
+        switch (stub_rand() % 6) {
+        case 0:
+            // Случайные байты (заголовки тоже)
+            for (int k = 1 + stub_rand() % 3; k > 0; k--) {
+                edit[stub_rand() % edit.size()] = (u8)stub_rand();
+            }
+            break;
+        case 1: {
+            // Длина одного TLV: соседние значения, крайние и случайные
+            size_t off = pick_tlv(edit, header);
+            if (off == 0) {
+                break;
+            }
+            static const int deltas[] = {-3, -1, 1, 2, 3};
+            u16 tlv_len = qmi_get_le16(&edit[off + 1]);
+            u16 values[] = {0, 0xFFFF, (u16)stub_rand(), (u16)(tlv_len + deltas[stub_rand() % 5])};
+            qmi_put_le16(&edit[off + 1], values[stub_rand() % 4]);
+            break;
+        }
+        case 5: {
+            // TLV короче или длиннее, все длины сходятся: сообщение верно,
+            // функции разбора должны проверить длину значения сами
+            size_t off = pick_tlv(edit, header);
+            if (off == 0) {
+                break;
+            }
+            u16 tlv_len = qmi_get_le16(&edit[off + 1]);
+            u16 new_len = (u16)(stub_rand() % (tlv_len + 3));
+            if (new_len < tlv_len) {
+                edit.erase(edit.begin() + off + 3 + new_len, edit.begin() + off + 3 + tlv_len);
+            } else {
+                edit.insert(edit.begin() + off + 3 + tlv_len, new_len - tlv_len, (u8)stub_rand());
+            }
+            qmi_put_le16(&edit[off + 1], new_len);
+            fix_lengths(edit);
+            break;
+        }
+        case 2:
+            // Обрезка с исправленными длинами QMUX и TLV-блока
+            edit.resize(stub_rand() % edit.size() + 1);
+            fix_lengths(edit);
+            break;
+        case 3:
+            // Дописывание: хвост без заголовка TLV или с неполным
+            for (int k = 1 + stub_rand() % 5; k > 0; k--) {
+                edit.push_back((u8)stub_rand());
+            }
+            fix_lengths(edit);
+            break;
+        default:
+            // Случайные байты в TLV при верных заголовках
+            for (int k = 1 + stub_rand() % 3; k > 0 && edit.size() > header; k--) {
+                edit[header + stub_rand() % (edit.size() - header)] = (u8)stub_rand();
+            }
+            fix_lengths(edit);
+            break;
+        }
+
+        u8* copy = (u8*)malloc(edit.size());
+        memcpy(copy, edit.data(), edit.size());
+        bool ok = qmi_decode(copy, edit.size(), &msg) == 0;
+        if (ok != reference_valid(copy, edit.size())) {
+            if (mismatches++ < 5) {
+                printf("edit %u: qmi_decode %s, reference %s:", n, ok ? "accepts" : "rejects",
+                       ok ? "rejects" : "accepts");
+                for (size_t i = 0; i < edit.size() && i < 32; i++) {
+                    printf(" %02x", edit[i]);
+                }
+                printf("\n");
+            }
+        }
+        if (ok) {
+            accepted++;
+            decode_all(&msg);
+        }
+        free(copy);
+    }
+    printf("edits: %u edits, %u accepted, %u disagree with the reference check\n", edits, accepted, mismatches);
+    failures += mismatches;
+}
+
+int main(int argc, char** argv) {
+    unsigned int rounds = QMISTUB_ROUNDS;
+    unsigned int edits = QMISTUB_EDITS;
+    unsigned int seed = (unsigned int)time(NULL);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:n:S:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            edits = strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    stub_rand_state = seed ? seed : 1;
+    printf("seed %u\n", seed);
+
+    struct stub_modem* modem = new stub_modem();
+    run_exchange(rounds, modem);
+    run_truncation(modem);
+    run_encoder_bounds();
+    run_edits(edits, modem);
+    delete modem;
+    return failures ? 1 : 0;
+}
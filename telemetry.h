@@ -0,0 +1,401 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+// Общий сегмент телеметрии: счётчики и показатели захвата FDDI (fddiv),
+// модема (5g.h), QMI и IrDA в одной разделяемой памяти. Компоненты пишут
+// в неё прямо из рабочих потоков без системных вызовов, а читатель
+// (telemetry_read) отображает тот же файл и снимает значения с любой
+// частотой, ничего не ожидая от пишущих.
+//
+// - Счётчики - 64-битные атомарные, прибавление без блокировок.
+// - Связанные значения (RSSI и BER с временем обновления, гистограмма
+//   с числом и суммой) защищены seqlock: пишущий делает seq нечётным,
+//   меняет поля и делает его чётным; читатель повторяет чтение, если
+//   seq был нечётным или изменился. Несколько пишущих одного блока
+//   по очереди занимают seq через CAS.
+// - Сегмент - файл в /dev/shm (или другой путь) либо memfd, если путь
+//   не задан; memfd передаётся читателю как дескриптор или открывается
+//   через /proc/<pid>/fd/<n>.
+// - Заголовок несёт magic, версию и размер: читатель другой версии
+//   получает ошибку, а не чужие поля.
+//
+// Все функции открытия возвращают NULL и -errno в *status при ошибке.
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TELEMETRY_MAGIC 0x4D4C4554u          // "TELM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_DEFAULT_PATH "/dev/shm/zenith-telemetry"
+#define TELEMETRY_MAX_IFACES 16
+#define TELEMETRY_IFNAMSIZ 16
+#define TELEMETRY_HIST_BUCKETS 32            // степени двойки микросекунд
+#define TELEMETRY_CACHE_LINE 64
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "telemetry needs lock-free 64-bit atomics");
+
+// Состояние слота интерфейса
+#define TELEMETRY_SLOT_FREE 0
+#define TELEMETRY_SLOT_CLAIMED 1             // имя ещё пишется
+#define TELEMETRY_SLOT_READY 2
+
+struct alignas(TELEMETRY_CACHE_LINE) telemetry_iface {
+    std::atomic<uint32_t> state;
+    char name[TELEMETRY_IFNAMSIZ];
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> drops;             // потери в ядре
+    std::atomic<uint64_t> output_drops;      // не выведено (очередь вывода полна)
+};
+
+// Гистограмма времени ответа под seqlock
+struct alignas(TELEMETRY_CACHE_LINE) telemetry_hist {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_us;
+    std::atomic<uint64_t> max_us;
+    std::atomic<uint64_t> buckets[TELEMETRY_HIST_BUCKETS];
+};
+
+// Запросы к модему (AT или QMI): счётчики и гистограмма
+struct telemetry_requests {
+    alignas(TELEMETRY_CACHE_LINE) std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> timeouts;
+    struct telemetry_hist rtt;
+};
+
+struct alignas(TELEMETRY_CACHE_LINE) telemetry_signal {
+    std::atomic<uint32_t> seq;
+    std::atomic<int32_t> rssi;               // +CSQ: 0..31, 99 - неизвестно
+    std::atomic<int32_t> ber;
+    std::atomic<int64_t> updated_ns;         // CLOCK_MONOTONIC, 0 - ещё не было
+};
+
+struct alignas(TELEMETRY_CACHE_LINE) telemetry_irda {
+    std::atomic<uint64_t> sends;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> failures;
+};
+
+struct telemetry_segment_data {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+    int64_t created_ns;                      // CLOCK_REALTIME
+    struct telemetry_iface ifaces[TELEMETRY_MAX_IFACES];
+    struct telemetry_requests at;
+    struct telemetry_requests qmi;
+    struct telemetry_signal signal;
+    struct telemetry_irda irda;
+};
+
+typedef struct {
+    int fd;
+    struct telemetry_segment_data* data;
+} telemetry_t;
+
+static inline int64_t telemetry_now_ns(clockid_t clock = CLOCK_MONOTONIC) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// --- Открытие ---
+
+static inline telemetry_t* telemetry_map(int fd, bool writable, int* status) {
+    void* map = mmap(NULL, sizeof(struct telemetry_segment_data), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        *status = -errno;
+        close(fd);
+        return NULL;
+    }
+    telemetry_t* telemetry = new telemetry_t();
+    telemetry->fd = fd;
+    telemetry->data = static_cast<struct telemetry_segment_data*>(map);
+    *status = 0;
+    return telemetry;
+}
+
+// Подключение пишущего: сегмент создаётся, если его нет. Размечает его
+// тот, кто первым взял flock; остальные видят готовый заголовок.
+// path NULL - анонимный memfd (дескриптор в telemetry->fd).
+static inline telemetry_t* telemetry_attach(const char* path, int* status) {
+    int fd = path ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)
+                  : memfd_create("zenith-telemetry", MFD_CLOEXEC);
+    if (fd < 0) {
+        *status = -errno;
+        return NULL;
+    }
+    flock(fd, LOCK_EX);
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (st.st_size == 0 && ftruncate(fd, sizeof(struct telemetry_segment_data)) < 0)) {
+        *status = -errno;
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        st.st_size = sizeof(struct telemetry_segment_data);
+    }
+    telemetry_t* telemetry = telemetry_map(fd, true, status);
+    if (!telemetry) {
+        return NULL;
+    }
+    struct telemetry_segment_data* data = telemetry->data;
+    // magic 0 - новый файл (после ftruncate он заполнен нулями, счётчики
+    // уже обнулены) или создатель не успел его разметить
+    if ((size_t)st.st_size == sizeof(*data) && data->magic == 0) {
+        data->size = sizeof(*data);
+        data->version = TELEMETRY_VERSION;
+        data->created_ns = telemetry_now_ns(CLOCK_REALTIME);
+        __atomic_store_n(&data->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+    } else if ((size_t)st.st_size != sizeof(*data) || data->magic != TELEMETRY_MAGIC ||
+               data->version != TELEMETRY_VERSION || data->size != sizeof(*data)) {
+        *status = -EPROTO;
+        flock(fd, LOCK_UN);
+        munmap(data, sizeof(*data));
+        close(fd);
+        delete telemetry;
+        return NULL;
+    }
+    flock(fd, LOCK_UN);
+    return telemetry;
+}
+
+// Подключение читателя: только чтение, сегмент должен существовать
+static inline telemetry_t* telemetry_open(const char* path, int* status) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *status = -errno;
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size != sizeof(struct telemetry_segment_data)) {
+        *status = -EPROTO;
+        close(fd);
+        return NULL;
+    }
+    telemetry_t* telemetry = telemetry_map(fd, false, status);
+    if (!telemetry) {
+        return NULL;
+    }
+    const struct telemetry_segment_data* data = telemetry->data;
+    if (__atomic_load_n(&data->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC || data->version != TELEMETRY_VERSION ||
+        data->size != sizeof(*data)) {
+        *status = -EPROTO;
+        munmap(telemetry->data, sizeof(*data));
+        close(fd);
+        delete telemetry;
+        return NULL;
+    }
+    return telemetry;
+}
+
+static inline void telemetry_close(telemetry_t* telemetry) {
+    if (!telemetry) {
+        return;
+    }
+    munmap(telemetry->data, sizeof(struct telemetry_segment_data));
+    close(telemetry->fd);
+    delete telemetry;
+}
+
+// --- Запись ---
+
+static inline void telemetry_add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+// Вход пишущего в seqlock: seq из чётного в нечётный
+static inline void telemetry_write_begin(std::atomic<uint32_t>& seq) {
+    uint32_t value = seq.load(std::memory_order_relaxed);
+    for (;;) {
+        if (!(value & 1) && seq.compare_exchange_weak(value, value + 1, std::memory_order_acquire,
+                                                      std::memory_order_relaxed)) {
+            break;
+        }
+        value = seq.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+static inline void telemetry_write_end(std::atomic<uint32_t>& seq) {
+    seq.fetch_add(1, std::memory_order_release);
+}
+
+// Слот интерфейса по имени: уже занятый этим именем или новый. NULL,
+// если слотов не осталось.
+static inline struct telemetry_iface* telemetry_iface_slot(telemetry_t* telemetry, const char* name) {
+    struct telemetry_segment_data* data = telemetry->data;
+    for (int i = 0; i < TELEMETRY_MAX_IFACES; i++) {
+        struct telemetry_iface* slot = &data->ifaces[i];
+        uint32_t state = slot->state.load(std::memory_order_acquire);
+        // Если слот занимают одновременно, проигравший ждёт имя победителя
+        while (state != TELEMETRY_SLOT_READY) {
+            if (state == TELEMETRY_SLOT_FREE &&
+                slot->state.compare_exchange_strong(state, TELEMETRY_SLOT_CLAIMED, std::memory_order_acquire)) {
+                strncpy(slot->name, name, TELEMETRY_IFNAMSIZ - 1);
+                slot->state.store(TELEMETRY_SLOT_READY, std::memory_order_release);
+                return slot;
+            }
+            state = slot->state.load(std::memory_order_acquire);
+        }
+        if (strncmp(slot->name, name, TELEMETRY_IFNAMSIZ - 1) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static inline int telemetry_hist_bucket(uint64_t us) {
+    int bucket = 0;
+    while (us > 0 && bucket < TELEMETRY_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static inline void telemetry_hist_add(struct telemetry_hist* hist, uint64_t us) {
+    telemetry_write_begin(hist->seq);
+    hist->count.store(hist->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    hist->sum_us.store(hist->sum_us.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+    if (us > hist->max_us.load(std::memory_order_relaxed)) {
+        hist->max_us.store(us, std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t>& bucket = hist->buckets[telemetry_hist_bucket(us)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    telemetry_write_end(hist->seq);
+}
+
+// Итог одного запроса к модему: status 0 - успех, timeout - ответа не было
+static inline void telemetry_request(struct telemetry_requests* requests, uint64_t rtt_us, int status, bool timeout) {
+    telemetry_add(requests->requests, 1);
+    if (timeout) {
+        telemetry_add(requests->timeouts, 1);
+    } else if (status != 0) {
+        telemetry_add(requests->errors, 1);
+    }
+    telemetry_hist_add(&requests->rtt, rtt_us);
+}
+
+static inline void telemetry_set_signal(telemetry_t* telemetry, int rssi, int ber) {
+    struct telemetry_signal* signal = &telemetry->data->signal;
+    telemetry_write_begin(signal->seq);
+    signal->rssi.store(rssi, std::memory_order_relaxed);
+    signal->ber.store(ber, std::memory_order_relaxed);
+    signal->updated_ns.store(telemetry_now_ns(), std::memory_order_relaxed);
+    telemetry_write_end(signal->seq);
+}
+
+static inline void telemetry_irda_send(telemetry_t* telemetry, size_t length, int status) {
+    struct telemetry_irda* irda = &telemetry->data->irda;
+    if (status < 0) {
+        telemetry_add(irda->failures, 1);
+    } else {
+        telemetry_add(irda->sends, 1);
+        telemetry_add(irda->bytes, length);
+    }
+}
+
+// --- Чтение ---
+
+// Снимок гистограммы без разрывов
+struct telemetry_hist_snapshot {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[TELEMETRY_HIST_BUCKETS];
+};
+
+struct telemetry_signal_snapshot {
+    int rssi;
+    int ber;
+    int64_t updated_ns;
+};
+
+#define TELEMETRY_READ_STUCK 100000       // проверок одного и того же нечётного seq
+
+// Чтение под seqlock: read() копирует поля, пока seq не устоится. Пока
+// seq меняется, пишущий жив, и чтение повторяется; false - seq долго
+// стоит нечётным (пишущий процесс умер посреди записи), в копии может
+// быть разрыв.
+template <typename Read>
+static inline bool telemetry_read_consistent(const std::atomic<uint32_t>& seq, Read read) {
+    uint32_t stuck_seq = 0;
+    int stuck = 0;
+    for (;;) {
+        uint32_t before = seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            if (before != stuck_seq) {
+                stuck_seq = before;
+                stuck = 0;
+            } else if (++stuck >= TELEMETRY_READ_STUCK) {
+                read();
+                return false;
+            } else if (stuck > 100) {
+                sched_yield();
+            }
+            continue;
+        }
+        read();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+}
+
+static inline bool telemetry_read_hist(const struct telemetry_hist* hist, struct telemetry_hist_snapshot* out) {
+    return telemetry_read_consistent(hist->seq, [&] {
+        out->count = hist->count.load(std::memory_order_relaxed);
+        out->sum_us = hist->sum_us.load(std::memory_order_relaxed);
+        out->max_us = hist->max_us.load(std::memory_order_relaxed);
+        for (int i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+            out->buckets[i] = hist->buckets[i].load(std::memory_order_relaxed);
+        }
+    });
+}
+
+static inline bool telemetry_read_signal(const telemetry_t* telemetry, struct telemetry_signal_snapshot* out) {
+    const struct telemetry_signal* signal = &telemetry->data->signal;
+    return telemetry_read_consistent(signal->seq, [&] {
+        out->rssi = signal->rssi.load(std::memory_order_relaxed);
+        out->ber = signal->ber.load(std::memory_order_relaxed);
+        out->updated_ns = signal->updated_ns.load(std::memory_order_relaxed);
+    });
+}
+
+// Верхняя граница корзины, в которую попадает перцентиль; buckets могут
+// быть разностью двух снимков
+static inline uint64_t telemetry_hist_percentile(const uint64_t* buckets, double percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(total * percentile / 100.0);
+    uint64_t seen = 0;
+    for (int i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+            return (1ULL << i) - 1;
+        }
+    }
+    return (1ULL << (TELEMETRY_HIST_BUCKETS - 1)) - 1;
+}
+
+#endif
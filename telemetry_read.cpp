@@ -0,0 +1,348 @@
+// Читатель сегмента телеметрии (telemetry.h): раз в интервал выводит
+// разность с прошлым снимком - пакеты, байты и потери по интерфейсам,
+// запросы AT и QMI с перцентилями времени ответа за интервал, RSSI и BER
+// с возрастом значения, отправки IrDA. Снимок - только чтение общей
+// памяти, пишущие о читателе не знают.
+//
+// Пример: fddiv -s -T /dev/shm/zenith-telemetry &
+//         modemsim -b -n 1000 -T /dev/shm/zenith-telemetry &
+//         telemetry_read -i 100                  (10 снимков в секунду)
+//         telemetry_read /proc/1234/fd/5          (memfd другого процесса)
+//         telemetry_read -t -c 1                  (итоги с создания сегмента)
+//
+//         telemetry_read -B -n 10000000           (цена обновлений)
+//
+// С -B читатель проверяет сам механизм: пишущие потоки обновляют счётчик,
+// гистограмму и сигнал в сегменте, пока другой поток непрерывно снимает
+// их, и выводится цена одного обновления и одного снимка в нс. Снимок с
+// разрывом (RSSI не равен BER, число в гистограмме не равно сумме
+// корзин) - код выхода 1.
+
+// Reader for the telemetry segment (telemetry.h): every interval prints
+// the difference from the previous snapshot - packets, bytes and drops per
+// interface, AT and QMI requests with response-time percentiles for the
+// interval, RSSI and BER with the age of the value, IrDA sends. A snapshot
+// only reads shared memory; writers do not know the reader exists.
+//
+// Example: fddiv -s -T /dev/shm/zenith-telemetry &
+//          modemsim -b -n 1000 -T /dev/shm/zenith-telemetry &
+//          telemetry_read -i 100                  (10 snapshots a second)
+//          telemetry_read /proc/1234/fd/5          (another process's memfd)
+//          telemetry_read -t -c 1                  (totals since the segment was created)
+//
+//          telemetry_read -B -n 10000000           (cost of updates)
+//
+// With -B the reader checks the mechanism itself: writer threads update a
+// counter, a histogram and the signal in a segment while another thread
+// samples them continuously, and the cost of one update and one snapshot
+// is printed in ns. A torn snapshot (RSSI not equal to BER, histogram
+// count not equal to the sum of its buckets) makes the exit status 1.
+
+#include "telemetry.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TELEMETRY_READ_INTERVAL_MS 1000
+#define TELEMETRY_BENCH_UPDATES 5000000
+
+static std::atomic<bool> g_stop(false);
+
+static void handle_stop_signal(int) {
+    g_stop = true;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-i interval_ms] [-c count] [-t] [path]\n"
+            "       %s -B [-n updates] [-w writers]\n"
+            "  path  telemetry segment (default %s)\n"
+            "  -i    milliseconds between snapshots (default %d)\n"
+            "  -c    stop after this many snapshots (default: Ctrl-C)\n"
+            "  -t    print totals since the segment was created instead of per-interval changes\n"
+            "  -B    measure the cost of updates and snapshots and check for torn reads\n"
+            "  -n    updates per writer thread for -B (default %d)\n"
+            "  -w    writer threads for -B (default 2)\n",
+            prog, prog, TELEMETRY_DEFAULT_PATH, TELEMETRY_READ_INTERVAL_MS, TELEMETRY_BENCH_UPDATES);
+}
+
+struct requests_snapshot {
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t timeouts;
+    struct telemetry_hist_snapshot rtt;
+};
+
+struct snapshot {
+    uint64_t packets[TELEMETRY_MAX_IFACES];
+    uint64_t bytes[TELEMETRY_MAX_IFACES];
+    uint64_t drops[TELEMETRY_MAX_IFACES];
+    uint64_t output_drops[TELEMETRY_MAX_IFACES];
+    struct requests_snapshot at;
+    struct requests_snapshot qmi;
+    struct telemetry_signal_snapshot signal;
+    uint64_t irda_sends;
+    uint64_t irda_bytes;
+    uint64_t irda_failures;
+};
+
+static void read_requests(const struct telemetry_requests* requests, struct requests_snapshot* out) {
+    out->requests = requests->requests.load(std::memory_order_relaxed);
+    out->errors = requests->errors.load(std::memory_order_relaxed);
+    out->timeouts = requests->timeouts.load(std::memory_order_relaxed);
+    telemetry_read_hist(&requests->rtt, &out->rtt);
+}
+
+static void take_snapshot(const telemetry_t* telemetry, struct snapshot* out) {
+    const struct telemetry_segment_data* data = telemetry->data;
+    for (int i = 0; i < TELEMETRY_MAX_IFACES; i++) {
+        out->packets[i] = data->ifaces[i].packets.load(std::memory_order_relaxed);
+        out->bytes[i] = data->ifaces[i].bytes.load(std::memory_order_relaxed);
+        out->drops[i] = data->ifaces[i].drops.load(std::memory_order_relaxed);
+        out->output_drops[i] = data->ifaces[i].output_drops.load(std::memory_order_relaxed);
+    }
+    read_requests(&data->at, &out->at);
+    read_requests(&data->qmi, &out->qmi);
+    telemetry_read_signal(telemetry, &out->signal);
+    out->irda_sends = data->irda.sends.load(std::memory_order_relaxed);
+    out->irda_bytes = data->irda.bytes.load(std::memory_order_relaxed);
+    out->irda_failures = data->irda.failures.load(std::memory_order_relaxed);
+}
+
+static void print_requests(const char* name, const struct requests_snapshot* now, const struct requests_snapshot* last) {
+    uint64_t buckets[TELEMETRY_HIST_BUCKETS];
+    for (int i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+        buckets[i] = now->rtt.buckets[i] - last->rtt.buckets[i];
+    }
+    uint64_t count = now->rtt.count - last->rtt.count;
+    printf("  %s: requests %llu errors %llu timeouts %llu rtt avg %.0f us p50 %llu us p99 %llu us max %llu us\n", name,
+           (unsigned long long)(now->requests - last->requests), (unsigned long long)(now->errors - last->errors),
+           (unsigned long long)(now->timeouts - last->timeouts),
+           count ? (double)(now->rtt.sum_us - last->rtt.sum_us) / count : 0.0,
+           (unsigned long long)telemetry_hist_percentile(buckets, 50),
+           (unsigned long long)telemetry_hist_percentile(buckets, 99), (unsigned long long)now->rtt.max_us);
+}
+
+static int run_reader(const char* path, int interval_ms, long count, bool totals) {
+    int status;
+    telemetry_t* telemetry = telemetry_open(path, &status);
+    if (!telemetry) {
+        fprintf(stderr, "%s: %s\n", path, status == -EPROTO ? "not a telemetry segment of this version" : strerror(-status));
+        return 1;
+    }
+    const struct telemetry_segment_data* data = telemetry->data;
+    // С -t разность считается от нуля
+    static struct snapshot last, now;
+    if (!totals) {
+        take_snapshot(telemetry, &last);
+    }
+    int64_t last_ns = telemetry_now_ns();
+
+    for (long n = 0; (count <= 0 || n < count) && !g_stop; n++) {
+        usleep(interval_ms * 1000);
+        take_snapshot(telemetry, &now);
+        int64_t now_ns = telemetry_now_ns();
+        double seconds = (now_ns - last_ns) / 1e9;
+        if (totals) {
+            seconds = (telemetry_now_ns(CLOCK_REALTIME) - data->created_ns) / 1e9;
+        }
+
+        if (totals) {
+            printf("totals over %.1f s:\n", seconds);
+        } else {
+            printf("%.3f s:\n", seconds);
+        }
+        for (int i = 0; i < TELEMETRY_MAX_IFACES; i++) {
+            if (data->ifaces[i].state.load(std::memory_order_acquire) != TELEMETRY_SLOT_READY) {
+                continue;
+            }
+            uint64_t packets = now.packets[i] - last.packets[i];
+            printf("  %.*s: packets %llu (%.0f/s) bytes %llu dropped %llu not printed %llu\n", TELEMETRY_IFNAMSIZ,
+                   data->ifaces[i].name, (unsigned long long)packets, packets / seconds,
+                   (unsigned long long)(now.bytes[i] - last.bytes[i]), (unsigned long long)(now.drops[i] - last.drops[i]),
+                   (unsigned long long)(now.output_drops[i] - last.output_drops[i]));
+        }
+        print_requests("AT", &now.at, &last.at);
+        print_requests("QMI", &now.qmi, &last.qmi);
+        if (now.signal.updated_ns) {
+            printf("  signal: rssi %d ber %d, %.1f s old\n", now.signal.rssi, now.signal.ber,
+                   (now_ns - now.signal.updated_ns) / 1e9);
+        } else {
+            printf("  signal: unknown\n");
+        }
+        printf("  IrDA: sends %llu bytes %llu failures %llu\n", (unsigned long long)(now.irda_sends - last.irda_sends),
+               (unsigned long long)(now.irda_bytes - last.irda_bytes),
+               (unsigned long long)(now.irda_failures - last.irda_failures));
+        fflush(stdout);
+        if (!totals) {
+            last = now;
+        }
+        last_ns = now_ns;
+    }
+    telemetry_close(telemetry);
+    return 0;
+}
+
+// --- Замеры (-B) ---
+
+// Цена одного вызова update(i) в нс на каждом из writers потоков
+template <typename Update>
+static double time_writers(unsigned int writers, unsigned long long updates, Update update) {
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<double> ns(writers);
+    for (unsigned int w = 0; w < writers; w++) {
+        threads.emplace_back([&, w] {
+            ready++;
+            while (!go) {
+            }
+            int64_t start = telemetry_now_ns();
+            for (unsigned long long i = 0; i < updates; i++) {
+                update(i);
+            }
+            ns[w] = (double)(telemetry_now_ns() - start) / updates;
+        });
+    }
+    while (ready < writers) {
+    }
+    go = true;
+    double total = 0;
+    for (unsigned int w = 0; w < writers; w++) {
+        threads[w].join();
+        total += ns[w];
+    }
+    return total / writers;
+}
+
+static int run_bench(unsigned long long updates, unsigned int writers) {
+    // Сегмент во временном файле: пишущие подключаются через
+    // telemetry_attach, читатель - через telemetry_open, как разные процессы
+    char path[] = "/tmp/telemetry.XXXXXX";
+    int tmp = mkstemp(path);
+    if (tmp < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(tmp);
+    int status;
+    telemetry_t* writer = telemetry_attach(path, &status);
+    telemetry_t* reader = writer ? telemetry_open(path, &status) : NULL;
+    if (!reader) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-status));
+        unlink(path);
+        return 1;
+    }
+    struct telemetry_segment_data* data = writer->data;
+    struct telemetry_iface* iface = telemetry_iface_slot(writer, "bench0");
+
+    // Поток-читатель снимает сигнал и гистограмму без пауз и проверяет
+    // их целостность
+    std::atomic<bool> stop(false);
+    unsigned long long samples = 0, torn = 0;
+    int64_t sample_ns = 0;
+    std::thread sampler([&] {
+        int64_t start = telemetry_now_ns();
+        while (!stop) {
+            struct telemetry_signal_snapshot signal;
+            struct telemetry_hist_snapshot hist;
+            telemetry_read_signal(reader, &signal);
+            telemetry_read_hist(&reader->data->at.rtt, &hist);
+            uint64_t sum = 0;
+            for (int i = 0; i < TELEMETRY_HIST_BUCKETS; i++) {
+                sum += hist.buckets[i];
+            }
+            if (signal.rssi != signal.ber || sum != hist.count || hist.sum_us != hist.count * 5) {
+                torn++;
+            }
+            samples++;
+        }
+        sample_ns = telemetry_now_ns() - start;
+    });
+
+    double uncontended = time_writers(1, updates, [&](unsigned long long) { telemetry_add(iface->packets, 1); });
+    double counter = time_writers(writers, updates, [&](unsigned long long) { telemetry_add(iface->packets, 1); });
+    double hist = time_writers(writers, updates / 4, [&](unsigned long long) { telemetry_hist_add(&data->at.rtt, 5); });
+    double request = time_writers(1, updates / 4, [&](unsigned long long) { telemetry_request(&data->at, 5, 0, false); });
+    double signal = time_writers(writers, updates / 4, [&](unsigned long long i) {
+        telemetry_set_signal(writer, (int)(i & 0xFFFF), (int)(i & 0xFFFF));
+    });
+    stop = true;
+    sampler.join();
+
+    uint64_t expected_packets = updates * (1 + writers);
+    uint64_t expected_hist = updates / 4 * (writers + 1);
+    struct telemetry_hist_snapshot final_hist;
+    telemetry_read_hist(&reader->data->at.rtt, &final_hist);
+    bool counts_ok = reader->data->ifaces[0].packets.load() == expected_packets && final_hist.count == expected_hist;
+
+    printf("counter add, 1 writer: %.1f ns/update\n", uncontended);
+    printf("counter add, %u writers on one counter: %.1f ns/update\n", writers, counter);
+    printf("histogram add, %u writers: %.1f ns/update\n", writers, hist);
+    printf("AT request (counters + histogram), 1 writer: %.1f ns/update\n", request);
+    printf("signal set, %u writers: %.1f ns/update\n", writers, signal);
+    printf("reader: %llu snapshots, %.1f ns/snapshot, torn %llu\n", samples, samples ? (double)sample_ns / samples : 0.0,
+           torn);
+    printf("totals: packets %llu (expected %llu), histogram %llu (expected %llu)\n",
+           (unsigned long long)reader->data->ifaces[0].packets.load(), (unsigned long long)expected_packets,
+           (unsigned long long)final_hist.count, (unsigned long long)expected_hist);
+
+    telemetry_close(reader);
+    telemetry_close(writer);
+    unlink(path);
+    return torn == 0 && counts_ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    int interval_ms = TELEMETRY_READ_INTERVAL_MS;
+    long count = 0;
+    bool bench = false;
+    bool totals = false;
+    unsigned long long updates = TELEMETRY_BENCH_UPDATES;
+    unsigned int writers = 2;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:c:tBn:w:h")) != -1) {
+        switch (opt) {
+        case 'i':
+            interval_ms = atoi(optarg);
+            break;
+        case 'c':
+            count = atol(optarg);
+            break;
+        case 't':
+            totals = true;
+            break;
+        case 'B':
+            bench = true;
+            break;
+        case 'n':
+            updates = strtoull(optarg, NULL, 0);
+            break;
+        case 'w':
+            writers = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (interval_ms <= 0 || updates < 4 || writers == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (bench) {
+        return run_bench(updates, writers);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    return run_reader(optind < argc ? argv[optind] : TELEMETRY_DEFAULT_PATH, interval_ms, count, totals);
+}